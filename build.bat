@@ -17,10 +17,17 @@ pushd .\build\batch\debug
 set entry=%src_dir%\main.cpp
 set src_files=%geometry_dir%\point.cpp %geometry_dir%\vector.cpp %render_dir%\color.cpp ^
 	%render_dir%\canvas.cpp %geometry_dir%\matrix.cpp %geometry_dir%\ray.cpp ^
-	%render_dir%\light.cpp %render_dir%\material.cpp ^
-	%core_dir%\file_io.cpp %core_dir%\arr.cpp %core_dir%\test_suite.cpp ^
-	%core_dir%\utils.cpp
-set test_files=%tests_dir%\tests.cpp
+	%geometry_dir%\transform_builder.cpp %geometry_dir%\quaternion.cpp ^
+	%geometry_dir%\trs_transform.cpp %geometry_dir%\ray_packet.cpp ^
+	%geometry_dir%\aabb.cpp %geometry_dir%\bvh.cpp %geometry_dir%\wide_bvh.cpp ^
+	%geometry_dir%\lbvh.cpp %geometry_dir%\instance.cpp %geometry_dir%\grid.cpp ^
+	%geometry_dir%\mesh.cpp %geometry_dir%\obj.cpp %geometry_dir%\primitive.cpp ^
+	%render_dir%\light.cpp %render_dir%\material.cpp %render_dir%\world.cpp ^
+	%core_dir%\file_io.cpp %core_dir%\arr.cpp %core_dir%\arena.cpp ^
+	%core_dir%\test_suite.cpp %core_dir%\bench_suite.cpp %core_dir%\cpu.cpp %core_dir%\utils.cpp ^
+	%core_dir%\thread_pool.cpp %core_dir%\numa.cpp %render_dir%\tile_scheduler.cpp ^
+	%render_dir%\progressive.cpp %render_dir%\render_job.cpp
+set test_files=%tests_dir%\tests.cpp %tests_dir%\benchmarks.cpp
 
 REM set third_party=User32.lib Gdi32.lib Shell32.lib
 set includes=-I%cwd% /I"%src_dir%" ^
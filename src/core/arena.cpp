@@ -0,0 +1,59 @@
+#include <core/arena.h>
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+ScratchArena::ScratchArena(const size_t capacity) noexcept
+    : buffer(std::make_unique<uint8_t[]>(capacity)),
+      capacity(capacity),
+      used(0),
+      scope_count(0) {}
+
+void* ScratchArena::Allocate(const size_t size,
+                             const size_t alignment) noexcept {
+  assert(alignment > 0 && (alignment & (alignment - 1)) == 0);
+
+  uintptr_t base = reinterpret_cast<uintptr_t>(buffer.get());
+  uintptr_t start = (base + used + alignment - 1) & ~(alignment - 1);
+  size_t end = (start - base) + size;
+  if (end > capacity) {
+    return nullptr;
+  }
+
+  used = end;
+  return reinterpret_cast<void*>(start);
+}
+
+bool ScratchArena::Extend(const void* block, const size_t size,
+                          const size_t new_size) noexcept {
+  assert(Owns(block) && new_size >= size);
+
+  const uint8_t* start = static_cast<const uint8_t*>(block);
+  size_t offset = static_cast<size_t>(start - buffer.get());
+  if (offset + size != used || offset + new_size > capacity) {
+    return false;
+  }
+
+  used = offset + new_size;
+  return true;
+}
+
+bool ScratchArena::Owns(const void* block) const noexcept {
+  const uint8_t* start = static_cast<const uint8_t*>(block);
+  return start >= buffer.get() && start < buffer.get() + capacity;
+}
+
+void ScratchArena::Reset() noexcept { used = 0; }
+
+ScratchScope::ScratchScope(ScratchArena* arena) noexcept
+    : arena(arena), mark(arena->used) {
+  ++arena->scope_count;
+}
+
+ScratchScope::~ScratchScope() noexcept {
+  assert(arena->scope_count > 0 && arena->used >= mark);
+  --arena->scope_count;
+  arena->used = mark;
+}
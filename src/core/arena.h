@@ -0,0 +1,43 @@
+#ifndef SRC_CORE_ARENA_H_
+#define SRC_CORE_ARENA_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+// NOTE: Bump allocator over a single buffer that is allocated once up front.
+// Allocate returns nullptr when the buffer is exhausted so callers can pick
+// their own fallback. Extend grows the most recent block in place. Blocks
+// are never freed one by one; the owner of the arena reclaims them all at
+// once, with a ScratchScope or Reset, so the order users let go of them in
+// does not matter.
+struct ScratchArena {
+  std::unique_ptr<uint8_t[]> buffer;
+  size_t capacity;
+  size_t used;
+  size_t scope_count;
+
+  explicit ScratchArena(size_t capacity) noexcept;
+  ScratchArena(const ScratchArena& other) = delete;
+  ScratchArena& operator=(const ScratchArena& other) = delete;
+
+  void* Allocate(size_t size, size_t alignment) noexcept;
+  bool Extend(const void* block, size_t size, size_t new_size) noexcept;
+  bool Owns(const void* block) const noexcept;
+  void Reset() noexcept;
+};
+
+// NOTE: Marks an arena and rewinds it to the mark when it goes out of
+// scope, releasing every block allocated in between. Blocks allocated
+// inside must not be used after it ends.
+struct ScratchScope {
+  ScratchArena* arena;
+  size_t mark;
+
+  explicit ScratchScope(ScratchArena* arena) noexcept;
+  ScratchScope(const ScratchScope& other) = delete;
+  ScratchScope& operator=(const ScratchScope& other) = delete;
+  ~ScratchScope() noexcept;
+};
+
+#endif  // SRC_CORE_ARENA_H_
@@ -0,0 +1,37 @@
+#include <core/bench_suite.h>
+#include <core/test_suite.h>
+
+#include <chrono>
+#include <cstdio>
+#include <functional>
+
+#define NORMAL "\033[0m"
+#define BOLD "\033[1m"
+
+double BenchmarkFramework::Run(
+    const char* name, const char* tag, size_t iterations,
+    std::function<void(size_t)> bench_function) noexcept {
+  printf("%s%s%s \"%s\"", GetColor(tag).c_str(), tag, NORMAL, name);
+  fflush(stdout);
+  total_benchmarks++;
+
+  size_t warmup_iterations = iterations / 10 > 0 ? iterations / 10 : 1;
+  bench_function(warmup_iterations);
+
+  auto start = std::chrono::steady_clock::now();
+  bench_function(iterations);
+  auto end = std::chrono::steady_clock::now();
+
+  double seconds = std::chrono::duration<double>(end - start).count();
+  double ops_per_second = static_cast<double>(iterations) / seconds;
+  double ns_per_op = seconds * 1e9 / static_cast<double>(iterations);
+
+  printf(" %s%.3f Mops/s%s (%.2f ns/op)\n", BOLD, ops_per_second / 1e6, NORMAL,
+         ns_per_op);
+
+  return ops_per_second;
+}
+
+void BenchmarkFramework::Summary() const noexcept {
+  printf("\nBenchmark summary: %zu benchmarks ran.\n", total_benchmarks);
+}
@@ -0,0 +1,26 @@
+#ifndef SRC_CORE_BENCH_SUITE_H_
+#define SRC_CORE_BENCH_SUITE_H_
+
+#include <cstddef>
+#include <functional>
+
+struct BenchmarkFramework {
+  const char* root;
+  size_t total_benchmarks = 0;
+
+  explicit BenchmarkFramework(const char* root_) noexcept : root(root_) {}
+
+  // NOTE: bench_function runs the measured operation `iterations` times.
+  // Returns operations per second.
+  double Run(const char* name, const char* tag, size_t iterations,
+             std::function<void(size_t)> bench_function) noexcept;
+  void Summary() const noexcept;
+};
+
+template <typename T>
+inline void DoNotOptimize(const T& value) noexcept {
+  static const void* volatile sink;
+  sink = &value;
+}
+
+#endif  // SRC_CORE_BENCH_SUITE_H_
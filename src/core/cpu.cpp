@@ -0,0 +1,106 @@
+#include <core/cpu.h>
+#include <immintrin.h>
+#include <intrin.h>
+
+#include <atomic>
+#include <cstdint>
+
+CpuFeatures DetectCpuFeatures() noexcept {
+  CpuFeatures features = {};
+
+  int info[4];
+  __cpuid(info, 0);
+  int max_leaf = info[0];
+
+  __cpuid(info, 1);
+  features.sse2 = (info[3] & (1 << 26)) != 0;
+  features.sse41 = (info[2] & (1 << 19)) != 0;
+  features.fma = (info[2] & (1 << 12)) != 0;
+  features.avx = (info[2] & (1 << 28)) != 0;
+  bool os_xsave = (info[2] & (1 << 27)) != 0;
+
+  if (max_leaf >= 7) {
+    __cpuidex(info, 7, 0);
+    features.avx2 = (info[1] & (1 << 5)) != 0;
+    features.avx512f = (info[1] & (1 << 16)) != 0;
+  }
+
+  // NOTE: The OS has to save the YMM (and for AVX-512 the opmask and ZMM)
+  // state on context switches, otherwise the instructions are unusable.
+  uint64_t xcr0 = os_xsave ? _xgetbv(0) : 0;
+  bool os_avx = (xcr0 & 0x6) == 0x6;
+  bool os_avx512 = (xcr0 & 0xE6) == 0xE6;
+
+  features.avx = features.avx && os_avx;
+  features.avx2 = features.avx2 && os_avx;
+  features.fma = features.fma && os_avx;
+  features.avx512f = features.avx512f && os_avx512;
+
+  return features;
+}
+
+IsaLevel DetectIsaLevel() noexcept {
+  CpuFeatures features = DetectCpuFeatures();
+
+  if (features.avx512f && features.avx2 && features.fma) {
+    return ISA_AVX512;
+  }
+  if (features.avx2 && features.fma) {
+    return ISA_AVX2;
+  }
+  if (features.sse41) {
+    return ISA_SSE41;
+  }
+  return ISA_SSE2;
+}
+
+// NOTE: Other files register callbacks from their static initializers,
+// which may run before this file's, so nothing here may depend on dynamic
+// initialization: the detected level is a function-local static and the
+// rest is constant-initialized. A forced level of -1 means none is forced.
+static IsaLevel DetectedIsaLevel() noexcept {
+  static const IsaLevel detected_isa_level = DetectIsaLevel();
+  return detected_isa_level;
+}
+
+static std::atomic<int> forced_isa_level{-1};
+static IsaLevelCallback isa_level_callbacks[ISA_MAX_LEVEL_CALLBACKS];
+static size_t isa_level_callback_count = 0;
+
+IsaLevel GetIsaLevel() noexcept {
+  int forced = forced_isa_level.load(std::memory_order_relaxed);
+  return forced < 0 ? DetectedIsaLevel() : static_cast<IsaLevel>(forced);
+}
+
+IsaLevel ForceIsaLevel(const IsaLevel level) noexcept {
+  IsaLevel detected = DetectedIsaLevel();
+  IsaLevel applied = level < detected ? level : detected;
+  forced_isa_level.store(applied, std::memory_order_relaxed);
+  for (size_t i = 0; i < isa_level_callback_count; ++i) {
+    isa_level_callbacks[i](applied);
+  }
+  return applied;
+}
+
+bool OnIsaLevelChange(const IsaLevelCallback callback) noexcept {
+  if (isa_level_callback_count == ISA_MAX_LEVEL_CALLBACKS) {
+    return false;
+  }
+  isa_level_callbacks[isa_level_callback_count++] = callback;
+  callback(GetIsaLevel());
+  return true;
+}
+
+const char* IsaLevelName(const IsaLevel level) noexcept {
+  switch (level) {
+    case ISA_SSE2:
+      return "SSE2";
+    case ISA_SSE41:
+      return "SSE4.1";
+    case ISA_AVX2:
+      return "AVX2+FMA";
+    case ISA_AVX512:
+      return "AVX-512";
+  }
+  return "UNKNOWN";
+}
@@ -0,0 +1,38 @@
+#ifndef SRC_CORE_CPU_H_
+#define SRC_CORE_CPU_H_
+
+enum IsaLevel { ISA_SSE2 = 0, ISA_SSE41 = 1, ISA_AVX2 = 2, ISA_AVX512 = 3 };
+
+struct CpuFeatures {
+  bool sse2;
+  bool sse41;
+  bool avx;
+  bool avx2;
+  bool fma;
+  bool avx512f;
+};
+
+CpuFeatures DetectCpuFeatures() noexcept;
+IsaLevel DetectIsaLevel() noexcept;
+
+// NOTE: The active level starts at the highest level the CPU supports and
+// selects which kernels the math code runs. Forcing a level is clamped to
+// what the CPU supports; the applied level is returned.
+IsaLevel GetIsaLevel() noexcept;
+IsaLevel ForceIsaLevel(IsaLevel level) noexcept;
+
+// NOTE: Lets a module pick its kernels once per level instead of reading
+// the level on every call. The callback runs with the active level when it
+// is registered and again each time ForceIsaLevel applies a level, so
+// ForceIsaLevel must not run while other threads use those kernels.
+// Registering from a static initializer is safe. Returns whether there was
+// room for it.
+#define ISA_MAX_LEVEL_CALLBACKS 8
+
+typedef void (*IsaLevelCallback)(IsaLevel level);
+
+bool OnIsaLevelChange(IsaLevelCallback callback) noexcept;
+
+const char* IsaLevelName(IsaLevel level) noexcept;
+
+#endif  // SRC_CORE_CPU_H_
@@ -3,10 +3,11 @@
 #include <strsafe.h>
 #include <windows.h>
 
-#include <cassert>
 #include <memory>
 #include <string>
 
+#define FILE_READ_PART_SIZE (1ULL << 30)
+
 // TODO(bissakov): Implement platform-independent file IO.
 FileResult ReadEntireFile(const char* file_path) noexcept {
   FileResult result = {};
@@ -28,8 +29,7 @@ FileResult ReadEntireFile(const char* file_path) noexcept {
     return result;
   }
 
-  assert(file_size.QuadPart <= 0xFF'FF'FF'FF);
-  result.file_size = static_cast<uint32_t>(file_size.QuadPart);
+  result.file_size = static_cast<uint64_t>(file_size.QuadPart);
 
   result.content = std::make_unique<BYTE[]>(result.file_size);
 
@@ -38,12 +38,19 @@ FileResult ReadEntireFile(const char* file_path) noexcept {
     return result;
   }
 
-  DWORD bytes_read = 0;
-  if ((ReadFile(file_handle, result.content.get(), result.file_size,
-                &bytes_read, 0) == 0) ||
-      result.file_size != bytes_read) {
-    CloseHandle(file_handle);
-    return result;
+  // NOTE: ReadFile takes a 32-bit length, so larger files are read in parts.
+  uint64_t offset = 0;
+  while (offset < result.file_size) {
+    DWORD part_size = static_cast<DWORD>(
+        Min(result.file_size - offset, FILE_READ_PART_SIZE));
+    DWORD bytes_read = 0;
+    if ((ReadFile(file_handle, result.content.get() + offset, part_size,
+                  &bytes_read, 0) == 0) ||
+        part_size != bytes_read) {
+      CloseHandle(file_handle);
+      return result;
+    }
+    offset += bytes_read;
   }
 
   CloseHandle(file_handle);
@@ -51,6 +58,74 @@ FileResult ReadEntireFile(const char* file_path) noexcept {
   return result;
 }
 
+MappedFile::MappedFile() noexcept
+    : data(nullptr),
+      size(0),
+      file_handle(INVALID_HANDLE_VALUE),
+      mapping_handle(nullptr) {}
+
+MappedFile::MappedFile(const char* file_path) noexcept : MappedFile() {
+  Open(file_path);
+}
+
+MappedFile::~MappedFile() noexcept { Close(); }
+
+bool MappedFile::Open(const char* file_path) noexcept {
+  Close();
+
+  file_handle = CreateFile(file_path, GENERIC_READ, FILE_SHARE_READ, 0,
+                           OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, 0);
+  if (file_handle == INVALID_HANDLE_VALUE) {
+    return false;
+  }
+
+  LARGE_INTEGER file_size;
+  if (GetFileSizeEx(file_handle, &file_size) == 0) {
+    Close();
+    return false;
+  }
+  size = static_cast<uint64_t>(file_size.QuadPart);
+
+  // NOTE: Empty files cannot be mapped, but they are valid empty input.
+  if (size == 0) {
+    data = "";
+    return true;
+  }
+
+  mapping_handle =
+      CreateFileMapping(file_handle, 0, PAGE_READONLY, 0, 0, nullptr);
+  if (mapping_handle == nullptr) {
+    Close();
+    return false;
+  }
+
+  data = static_cast<const char*>(
+      MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0));
+  if (data == nullptr) {
+    Close();
+    return false;
+  }
+  return true;
+}
+
+void MappedFile::Close() noexcept {
+  if (data != nullptr && mapping_handle != nullptr) {
+    UnmapViewOfFile(data);
+  }
+  if (mapping_handle != nullptr) {
+    CloseHandle(mapping_handle);
+  }
+  if (file_handle != INVALID_HANDLE_VALUE) {
+    CloseHandle(file_handle);
+  }
+  data = nullptr;
+  size = 0;
+  file_handle = INVALID_HANDLE_VALUE;
+  mapping_handle = nullptr;
+}
+
+bool MappedFile::IsOpen() const noexcept { return data != nullptr; }
+
 bool WriteEntireFile(const char* file_path, const uint32_t memory_size,
                      const BYTE* memory) noexcept {
   HANDLE file_handle =
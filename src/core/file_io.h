@@ -10,10 +10,30 @@
 
 struct FileResult {
   std::unique_ptr<BYTE[]> content;
-  uint32_t file_size;
+  uint64_t file_size;
   bool file_exists;
 };
 
+// NOTE: Read-only view of a whole file. Pages are read in as they are first
+// touched, so nothing is copied up front and files past 4 GB work. data is
+// nullptr while nothing is mapped; an empty file maps to size 0.
+struct MappedFile {
+  const char* data;
+  uint64_t size;
+  HANDLE file_handle;
+  HANDLE mapping_handle;
+
+  MappedFile() noexcept;
+  explicit MappedFile(const char* file_path) noexcept;
+  MappedFile(const MappedFile& other) = delete;
+  MappedFile& operator=(const MappedFile& other) = delete;
+  ~MappedFile() noexcept;
+
+  bool Open(const char* file_path) noexcept;
+  void Close() noexcept;
+  bool IsOpen() const noexcept;
+};
+
 FileResult ReadEntireFile(const char* file_path) noexcept;
 bool WriteEntireFile(const char* file_path, uint32_t memory_size,
                      const BYTE* memory) noexcept;
@@ -0,0 +1,116 @@
+#include <core/arr.h>
+#include <core/numa.h>
+#include <core/utils.h>
+#include <windows.h>
+#include <psapi.h>
+
+#include <cstdint>
+#include <format>
+#include <string>
+#include <thread>
+
+NumaTopology::NumaTopology() noexcept : node_count(0) {}
+
+NumaTopology::NumaTopology(const NumaTopology& other) noexcept
+    : cpus(other.cpus), node_count(other.node_count) {}
+
+NumaTopology& NumaTopology::operator=(const NumaTopology& other) noexcept {
+  if (this != &other) {
+    cpus = other.cpus;
+    node_count = other.node_count;
+  }
+  return *this;
+}
+
+NumaTopology::operator std::string() const noexcept {
+  return std::format("NumaTopology(nodes={}, cpus={})", node_count,
+                     cpus.size);
+}
+
+std::ostream& operator<<(std::ostream& os, const NumaTopology& topology) {
+  os << std::string(topology);
+  return os;
+}
+
+static NumaTopology DetectNumaTopology() noexcept {
+  NumaTopology topology;
+  ULONG highest_node = 0;
+  if (GetNumaHighestNodeNumber(&highest_node)) {
+    for (ULONG node = 0; node <= highest_node; ++node) {
+      GROUP_AFFINITY affinity = {};
+      if (!GetNumaNodeProcessorMaskEx(static_cast<USHORT>(node), &affinity)) {
+        continue;
+      }
+      for (uint8_t number = 0; number < sizeof(KAFFINITY) * 8; ++number) {
+        if ((affinity.Mask & (static_cast<KAFFINITY>(1) << number)) != 0) {
+          topology.cpus.Push({affinity.Group, number, node});
+        }
+      }
+    }
+    topology.node_count = highest_node + 1;
+  }
+
+  // NOTE: Without NUMA information every hardware thread is taken to be in
+  // group 0 of a single node.
+  if (topology.cpus.size == 0) {
+    size_t cpu_count = Max(std::thread::hardware_concurrency(), 1);
+    for (size_t number = 0; number < Min(cpu_count, sizeof(KAFFINITY) * 8);
+         ++number) {
+      topology.cpus.Push({0, static_cast<uint8_t>(number), 0});
+    }
+    topology.node_count = 1;
+  }
+  return topology;
+}
+
+const NumaTopology& GetNumaTopology() noexcept {
+  static const NumaTopology topology{DetectNumaTopology()};
+  return topology;
+}
+
+bool PinCurrentThread(const NumaCpu& cpu) noexcept {
+  GROUP_AFFINITY affinity = {};
+  affinity.Mask = static_cast<KAFFINITY>(1) << cpu.number;
+  affinity.Group = cpu.group;
+  return SetThreadGroupAffinity(GetCurrentThread(), &affinity, nullptr) != 0;
+}
+
+uint32_t CurrentNumaNode() noexcept {
+  PROCESSOR_NUMBER processor = {};
+  GetCurrentProcessorNumberEx(&processor);
+  USHORT node = 0;
+  if (!GetNumaProcessorNodeEx(&processor, &node)) {
+    return 0;
+  }
+  return node;
+}
+
+uint32_t PageNumaNode(const void* address) noexcept {
+  PSAPI_WORKING_SET_EX_INFORMATION info = {};
+  info.VirtualAddress = const_cast<void*>(address);
+  if (!QueryWorkingSetEx(GetCurrentProcess(), &info, sizeof(info)) ||
+      !info.VirtualAttributes.Valid) {
+    return NUMA_UNKNOWN_NODE;
+  }
+  return static_cast<uint32_t>(info.VirtualAttributes.Node);
+}
+
+void* AllocatePages(const size_t size) noexcept {
+  if (size == 0) {
+    return nullptr;
+  }
+  void* pages =
+      VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+  if (pages == nullptr) {
+    ErrorExit(TEXT("VirtualAlloc"));
+  }
+  return pages;
+}
+
+void FreePages(void* pages) noexcept {
+  if (pages != nullptr) {
+    VirtualFree(pages, 0, MEM_RELEASE);
+  }
+}
+
+void PageDeleter::operator()(void* pages) const noexcept { FreePages(pages); }
@@ -0,0 +1,58 @@
+#ifndef SRC_CORE_NUMA_H_
+#define SRC_CORE_NUMA_H_
+
+#include <core/arr.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <string>
+
+#define NUMA_UNKNOWN_NODE UINT32_MAX
+
+// NOTE: A logical processor as Windows addresses it: processor number within
+// its processor group, and the NUMA node it belongs to.
+struct NumaCpu {
+  uint16_t group;
+  uint8_t number;
+  uint32_t node;
+};
+
+// NOTE: Every logical processor of the machine, node by node, so pinning
+// threads 0..n-1 to cpus 0..n-1 fills one node before moving to the next.
+struct NumaTopology {
+  DyArray<NumaCpu> cpus;
+  uint32_t node_count;
+
+  NumaTopology() noexcept;
+  NumaTopology(const NumaTopology& other) noexcept;
+  NumaTopology& operator=(const NumaTopology& other) noexcept;
+
+  operator std::string() const noexcept;
+};
+
+std::ostream& operator<<(std::ostream& os, const NumaTopology& topology);
+
+// NOTE: Detected on first use; a machine without NUMA reports one node.
+const NumaTopology& GetNumaTopology() noexcept;
+
+bool PinCurrentThread(const NumaCpu& cpu) noexcept;
+
+// NOTE: Node of the processor the calling thread runs on right now; stable
+// only for pinned threads.
+uint32_t CurrentNumaNode() noexcept;
+
+// NOTE: Node holding the page at address, or NUMA_UNKNOWN_NODE when the
+// page has not been touched yet.
+uint32_t PageNumaNode(const void* address) noexcept;
+
+// NOTE: Zeroed pages straight from the OS, left untouched so they land on
+// the node of the first thread to write them.
+void* AllocatePages(size_t size) noexcept;
+void FreePages(void* pages) noexcept;
+
+struct PageDeleter {
+  void operator()(void* pages) const noexcept;
+};
+
+#endif  // SRC_CORE_NUMA_H_
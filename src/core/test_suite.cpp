@@ -22,7 +22,7 @@ constexpr static inline size_t Map(size_t value, size_t src_min, size_t src_max,
   return dest_min + scaled_value;
 }
 
-static inline std::string GetColor(const std::string& tag) noexcept {
+std::string GetColor(const std::string& tag) noexcept {
   std::hash<std::string> hash_fn;
   size_t color_code = Map(hash_fn(tag) % 100, 0, 100, 31, 36);
   std::string color = "\033[0;" + std::to_string(color_code) + "m";
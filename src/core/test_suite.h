@@ -8,6 +8,7 @@
 #include <render/color.h>
 
 #include <functional>
+#include <string>
 
 // NOTE: The lowest passing value so far - 3.553 * 10^-15
 // #define ABSOLUTE_TOLERANCE 1e-14  // 10^-14
@@ -38,6 +39,8 @@ struct TestFramework {
   void Summary() const noexcept;
 };
 
+std::string GetColor(const std::string& tag) noexcept;
+
 bool IsEqualDouble(double a, double b) noexcept;
 bool IsEqualFloat(float a, float b) noexcept;
 
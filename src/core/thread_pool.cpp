@@ -0,0 +1,283 @@
+#include <core/numa.h>
+#include <core/thread_pool.h>
+#include <core/utils.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+TaskGroup::TaskGroup() noexcept
+    : priority(TASK_PRIORITY_NORMAL),
+      task_count(0),
+      next_task(0),
+      finished_count(0),
+      is_on_each_thread(false),
+      is_cancelled(false) {}
+
+bool TaskGroup::IsCancelled() const noexcept {
+  return is_cancelled.load(std::memory_order_relaxed);
+}
+
+static thread_local size_t current_pool_worker = SIZE_MAX;
+
+static inline void UpdateQueuedPriority(ThreadPool* pool) noexcept {
+  int priority = pool->queue.empty()
+                     ? -1
+                     : static_cast<int>(pool->queue.front()->priority);
+  pool->queued_priority.store(priority, std::memory_order_relaxed);
+}
+
+// NOTE: Behind every group of the same or a higher priority, so the queue
+// stays sorted by priority and equal priorities keep submission order.
+static void Enqueue(ThreadPool* pool, TaskGroup* group) noexcept {
+  std::deque<TaskGroup*>::iterator it = std::find_if(
+      pool->queue.begin(), pool->queue.end(), [group](TaskGroup* queued) {
+        return queued->priority < group->priority;
+      });
+  pool->queue.insert(it, group);
+  UpdateQueuedPriority(pool);
+  pool->work_ready.notify_all();
+}
+
+// NOTE: A group leaves the queue with its last task claimed, so every group
+// in the queue still has tasks to hand out, though the ones left in a group
+// on each thread may all belong to other workers. Only groups above
+// min_priority are claimed from, -1 taking any.
+static TaskGroup* ClaimTask(ThreadPool* pool, const size_t worker_idx,
+                            const int min_priority, size_t* task_idx) noexcept {
+  for (std::deque<TaskGroup*>::iterator it = pool->queue.begin();
+       it != pool->queue.end(); ++it) {
+    TaskGroup* group = *it;
+    if (static_cast<int>(group->priority) <= min_priority) {
+      break;
+    }
+    if (group->is_on_each_thread) {
+      if (group->is_claimed[worker_idx]) {
+        continue;
+      }
+      group->is_claimed[worker_idx] = true;
+      *task_idx = worker_idx;
+    } else {
+      *task_idx = group->next_task;
+    }
+
+    ++group->next_task;
+    if (group->next_task == group->task_count) {
+      pool->queue.erase(it);
+      UpdateQueuedPriority(pool);
+      // NOTE: Workers that had nothing to claim but this group may be
+      // waiting for the queue to drain before stopping.
+      pool->work_ready.notify_all();
+    }
+    return group;
+  }
+  return nullptr;
+}
+
+static void RunTask(ThreadPool* pool, TaskGroup* group, const size_t task_idx,
+                    std::unique_lock<std::mutex>* lock) noexcept {
+  lock->unlock();
+  if (!group->IsCancelled()) {
+    group->task(task_idx);
+  }
+  lock->lock();
+
+  ++group->finished_count;
+  if (group->finished_count == group->task_count) {
+    pool->group_done.notify_all();
+    // NOTE: Copied while the group is still known to be alive; on_done may
+    // submit it again, or its owner may let it go, once it is done.
+    std::function<void()> on_done = group->on_done;
+    if (on_done) {
+      lock->unlock();
+      on_done();
+      lock->lock();
+    }
+  }
+}
+
+static void PoolWorker(ThreadPool* pool, const size_t worker_idx) noexcept {
+  current_pool_worker = worker_idx;
+  if (pool->is_pinned) {
+    const NumaTopology& topology = GetNumaTopology();
+    PinCurrentThread(topology.cpus[worker_idx % topology.cpus.size]);
+  }
+
+  std::unique_lock<std::mutex> lock{pool->mutex};
+  while (true) {
+    size_t task_idx = 0;
+    TaskGroup* group = ClaimTask(pool, worker_idx, -1, &task_idx);
+    if (group == nullptr) {
+      if (pool->is_stopping && pool->queue.empty()) {
+        return;
+      }
+      pool->work_ready.wait(lock);
+      continue;
+    }
+    RunTask(pool, group, task_idx, &lock);
+  }
+}
+
+ThreadPool::ThreadPool(size_t thread_count) noexcept
+    : ThreadPool(thread_count, false) {}
+
+ThreadPool::ThreadPool(size_t thread_count, bool is_pinned) noexcept
+    : thread_count(thread_count),
+      is_pinned(is_pinned),
+      queued_priority(-1),
+      is_stopping(false) {
+  if (this->thread_count == 0) {
+    this->thread_count = Max(std::thread::hardware_concurrency(), 1);
+  }
+  workers = std::make_unique<std::thread[]>(this->thread_count);
+  for (size_t worker_idx = 0; worker_idx < this->thread_count; ++worker_idx) {
+    workers[worker_idx] = std::thread(PoolWorker, this, worker_idx);
+  }
+}
+
+ThreadPool::~ThreadPool() noexcept {
+  {
+    std::lock_guard<std::mutex> lock{mutex};
+    is_stopping = true;
+  }
+  work_ready.notify_all();
+  for (size_t worker_idx = 0; worker_idx < thread_count; ++worker_idx) {
+    workers[worker_idx].join();
+  }
+}
+
+void ThreadPool::Submit(TaskGroup* group, std::function<void(size_t)> task,
+                        const size_t task_count) noexcept {
+  std::unique_lock<std::mutex> lock{mutex};
+  assert(group->finished_count == group->task_count);
+  group->task = std::move(task);
+  group->task_count = task_count;
+  group->next_task = 0;
+  group->finished_count = 0;
+  group->is_on_each_thread = false;
+  group->is_cancelled.store(false, std::memory_order_relaxed);
+  if (task_count == 0) {
+    std::function<void()> on_done = group->on_done;
+    lock.unlock();
+    if (on_done) {
+      on_done();
+    }
+    return;
+  }
+  Enqueue(this, group);
+}
+
+void ThreadPool::SubmitOnEachThread(
+    TaskGroup* group, std::function<void(size_t)> task) noexcept {
+  std::lock_guard<std::mutex> lock{mutex};
+  assert(group->finished_count == group->task_count);
+  group->task = std::move(task);
+  group->task_count = thread_count;
+  group->next_task = 0;
+  group->finished_count = 0;
+  group->is_claimed = std::make_unique<bool[]>(thread_count);
+  group->is_on_each_thread = true;
+  group->is_cancelled.store(false, std::memory_order_relaxed);
+  Enqueue(this, group);
+}
+
+void ThreadPool::Wait(TaskGroup* group) noexcept {
+  std::unique_lock<std::mutex> lock{mutex};
+  group_done.wait(lock, [group]() {
+    return group->finished_count == group->task_count;
+  });
+}
+
+void ThreadPool::Cancel(TaskGroup* group) noexcept {
+  std::unique_lock<std::mutex> lock{mutex};
+  group->is_cancelled.store(true, std::memory_order_relaxed);
+
+  // NOTE: Unclaimed tasks are counted as finished right away, so a group
+  // with no task running is done as soon as it is cancelled.
+  std::deque<TaskGroup*>::iterator it =
+      std::find(queue.begin(), queue.end(), group);
+  if (it == queue.end()) {
+    return;
+  }
+  queue.erase(it);
+  UpdateQueuedPriority(this);
+  work_ready.notify_all();
+  group->finished_count += group->task_count - group->next_task;
+  group->next_task = group->task_count;
+  if (group->finished_count == group->task_count) {
+    group_done.notify_all();
+    std::function<void()> on_done = group->on_done;
+    lock.unlock();
+    if (on_done) {
+      on_done();
+    }
+  }
+}
+
+bool ThreadPool::IsDone(const TaskGroup* group) noexcept {
+  std::lock_guard<std::mutex> lock{mutex};
+  return group->finished_count == group->task_count;
+}
+
+void ThreadPool::RunHigherPriorityTasks(
+    const TaskPriority priority) noexcept {
+  if (queued_priority.load(std::memory_order_relaxed) <=
+      static_cast<int>(priority)) {
+    return;
+  }
+  size_t worker_idx = CurrentPoolWorker();
+  assert(worker_idx < thread_count);
+  std::unique_lock<std::mutex> lock{mutex};
+  while (true) {
+    size_t task_idx = 0;
+    TaskGroup* group =
+        ClaimTask(this, worker_idx, static_cast<int>(priority), &task_idx);
+    if (group == nullptr) {
+      return;
+    }
+    RunTask(this, group, task_idx, &lock);
+  }
+}
+
+void ThreadPool::Run(std::function<void(size_t)> task,
+                     const size_t task_count) noexcept {
+  TaskGroup group;
+  Submit(&group, std::move(task), task_count);
+  Wait(&group);
+}
+
+static std::mutex render_pool_mutex;
+static std::unique_ptr<ThreadPool> render_pool;
+
+ThreadPool* RenderPool() noexcept {
+  std::lock_guard<std::mutex> lock{render_pool_mutex};
+  if (!render_pool) {
+    render_pool = std::make_unique<ThreadPool>(0);
+  }
+  return render_pool.get();
+}
+
+void SetRenderThreadCount(const size_t thread_count) noexcept {
+  SetRenderThreadCount(thread_count, false);
+}
+
+void SetRenderThreadCount(const size_t thread_count,
+                          const bool is_pinned) noexcept {
+  std::lock_guard<std::mutex> lock{render_pool_mutex};
+  render_pool.reset();
+  render_pool = std::make_unique<ThreadPool>(thread_count, is_pinned);
+}
+
+size_t CurrentPoolWorker() noexcept { return current_pool_worker; }
+
+TaskRange WorkerRange(const size_t count, const size_t thread_count,
+                      const size_t worker_idx) noexcept {
+  size_t chunk_size = (count + thread_count - 1) / thread_count;
+  size_t begin = Min(chunk_size * worker_idx, count);
+  return {begin, Min(begin + chunk_size, count)};
+}
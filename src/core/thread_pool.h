@@ -0,0 +1,123 @@
+#ifndef SRC_CORE_THREAD_POOL_H_
+#define SRC_CORE_THREAD_POOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+// NOTE: Order the pool claims groups in: a higher priority first, equal
+// priorities in submission order. Tasks of a lower priority let waiting
+// higher ones run between their steps through RunHigherPriorityTasks.
+enum TaskPriority {
+  TASK_PRIORITY_BATCH,
+  TASK_PRIORITY_NORMAL,
+  TASK_PRIORITY_INTERACTIVE
+};
+
+// NOTE: A batch of task_count tasks run as task(task_idx) on a ThreadPool;
+// render calls submit one per frame. Submitted with SubmitOnEachThread, it
+// runs task(worker_idx) once on every pool thread instead. Tasks not yet
+// started when the group is cancelled are skipped, tasks already running
+// finish, and long ones can poll IsCancelled to stop early. The group is
+// done once every task has run or been skipped, and can then be submitted
+// again.
+struct TaskGroup {
+  std::function<void(size_t)> task;
+  // NOTE: Set before Submit and kept across submissions. Runs once the
+  // group is done, on the thread that finished it: the pool thread of the
+  // last task, or the caller of Submit or Cancel when that finished it. It
+  // may submit the group again.
+  std::function<void()> on_done;
+  // NOTE: Set before Submit and kept across submissions.
+  TaskPriority priority;
+  size_t task_count;
+  // NOTE: Guarded by the pool's mutex while the group is submitted.
+  size_t next_task;
+  size_t finished_count;
+  std::unique_ptr<bool[]> is_claimed;
+  bool is_on_each_thread;
+  std::atomic<bool> is_cancelled;
+
+  TaskGroup() noexcept;
+  TaskGroup(const TaskGroup& other) = delete;
+  TaskGroup& operator=(const TaskGroup& other) = delete;
+
+  bool IsCancelled() const noexcept;
+};
+
+// NOTE: Threads started once and kept for the lifetime of the pool, taking
+// tasks from the submitted groups by priority, then in submission order.
+// Submit returns at once; Wait blocks until a group is done and must not be
+// called from one of the pool's own tasks. The destructor finishes every
+// submitted group before joining the threads. A pinned pool binds worker i
+// to processor i of GetNumaTopology, so memory a worker touches first stays
+// on its node.
+struct ThreadPool {
+  std::unique_ptr<std::thread[]> workers;
+  size_t thread_count;
+  bool is_pinned;
+  std::deque<TaskGroup*> queue;
+  // NOTE: Priority of the front of queue, -1 when it is empty; read
+  // without the lock as a hint by RunHigherPriorityTasks.
+  std::atomic<int> queued_priority;
+  std::mutex mutex;
+  std::condition_variable work_ready;
+  std::condition_variable group_done;
+  bool is_stopping;
+
+  // NOTE: thread_count 0 starts one thread per hardware thread.
+  explicit ThreadPool(size_t thread_count) noexcept;
+  ThreadPool(size_t thread_count, bool is_pinned) noexcept;
+  ThreadPool(const ThreadPool& other) = delete;
+  ThreadPool& operator=(const ThreadPool& other) = delete;
+  ~ThreadPool() noexcept;
+
+  void Submit(TaskGroup* group, std::function<void(size_t)> task,
+              size_t task_count) noexcept;
+  void SubmitOnEachThread(TaskGroup* group,
+                          std::function<void(size_t)> task) noexcept;
+  void Wait(TaskGroup* group) noexcept;
+  // NOTE: Skips the tasks of group that have not started; Wait still has to
+  // be called for the ones that have.
+  void Cancel(TaskGroup* group) noexcept;
+  bool IsDone(const TaskGroup* group) noexcept;
+  // NOTE: Runs queued tasks of groups above priority on the calling thread
+  // until there are none, for long tasks to call between steps so they do
+  // not hold a thread that more urgent work is waiting for. Must be called
+  // from one of the pool's own tasks; cheap when nothing is waiting.
+  void RunHigherPriorityTasks(TaskPriority priority) noexcept;
+  // NOTE: Submit followed by Wait, for callers that need the results now.
+  void Run(std::function<void(size_t)> task, size_t task_count) noexcept;
+};
+
+// NOTE: The process-wide pool render calls submit to, started on first use
+// with one thread per hardware thread.
+ThreadPool* RenderPool() noexcept;
+
+// NOTE: Restarts the render pool with thread_count threads, 0 for one per
+// hardware thread, after finishing the frames already submitted to it. No
+// frame may be submitted or waited on while it runs.
+void SetRenderThreadCount(size_t thread_count) noexcept;
+void SetRenderThreadCount(size_t thread_count, bool is_pinned) noexcept;
+
+// NOTE: Index of the calling thread in its ThreadPool, or SIZE_MAX when it
+// is not a pool thread.
+size_t CurrentPoolWorker() noexcept;
+
+struct TaskRange {
+  size_t begin;
+  size_t end;
+};
+
+// NOTE: The part of count items that task worker_idx of thread_count takes
+// when a build phase is split into equal contiguous chunks; the last chunks
+// may be short or empty.
+TaskRange WorkerRange(size_t count, size_t thread_count,
+                      size_t worker_idx) noexcept;
+
+#endif  // SRC_CORE_THREAD_POOL_H_
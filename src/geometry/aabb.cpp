@@ -0,0 +1,146 @@
+#include <geometry/aabb.h>
+#include <geometry/matrix.h>
+#include <geometry/point.h>
+#include <geometry/ray.h>
+#include <geometry/vector.h>
+
+#include <algorithm>
+#include <cmath>
+#include <format>
+#include <string>
+
+Aabb::Aabb() noexcept
+    : min({INFINITY, INFINITY, INFINITY}),
+      max({-INFINITY, -INFINITY, -INFINITY}) {}
+
+Aabb::Aabb(const Point& min, const Point& max) noexcept : min(min), max(max) {}
+
+Aabb::Aabb(const Aabb& other) noexcept : min(other.min), max(other.max) {}
+
+Aabb& Aabb::operator=(const Aabb& other) noexcept {
+  if (this != &other) {
+    min = other.min;
+    max = other.max;
+  }
+  return *this;
+}
+
+bool Aabb::operator==(const Aabb& other) const noexcept {
+  return min == other.min && max == other.max;
+}
+
+bool Aabb::operator!=(const Aabb& other) const noexcept {
+  return !(*this == other);
+}
+
+void Aabb::Grow(const Point& point) noexcept {
+  min = Point{_mm_min_ps(min.vec, point.vec)};
+  max = Point{_mm_max_ps(max.vec, point.vec)};
+}
+
+void Aabb::Grow(const Aabb& other) noexcept {
+  min = Point{_mm_min_ps(min.vec, other.min.vec)};
+  max = Point{_mm_max_ps(max.vec, other.max.vec)};
+}
+
+bool Aabb::IsEmpty() const noexcept {
+  return min.x > max.x || min.y > max.y || min.z > max.z;
+}
+
+Point Aabb::Centroid() const noexcept {
+  return {(min.x + max.x) * .5F, (min.y + max.y) * .5F,
+          (min.z + max.z) * .5F};
+}
+
+Vector Aabb::Extent() const noexcept { return max - min; }
+
+float Aabb::SurfaceArea() const noexcept {
+  if (IsEmpty()) {
+    return 0.F;
+  }
+  Vector extent{Extent()};
+  return 2.F * (extent.x * extent.y + extent.y * extent.z +
+                extent.z * extent.x);
+}
+
+// NOTE: A ray starting on a slab plane with a zero direction component gives
+// 0 * inf = NaN. The comparisons are ordered so a NaN never replaces the
+// running entry or exit.
+static inline void ClipSlab(const float min, const float max,
+                            const float origin, const float inverse_direction,
+                            float* tmin, float* tmax) noexcept {
+  float t0 = (min - origin) * inverse_direction;
+  float t1 = (max - origin) * inverse_direction;
+  if (t1 < t0) {
+    std::swap(t0, t1);
+  }
+  *tmin = t0 > *tmin ? t0 : *tmin;
+  *tmax = t1 < *tmax ? t1 : *tmax;
+}
+
+bool Aabb::Intersect(const Ray& ray, const Vector& inverse_direction,
+                     float tmin, float tmax, float* t_entry) const noexcept {
+  ClipSlab(min.x, max.x, ray.origin.x, inverse_direction.x, &tmin, &tmax);
+  ClipSlab(min.y, max.y, ray.origin.y, inverse_direction.y, &tmin, &tmax);
+  ClipSlab(min.z, max.z, ray.origin.z, inverse_direction.z, &tmin, &tmax);
+
+  if (tmin > tmax) {
+    return false;
+  }
+  *t_entry = tmin;
+  return true;
+}
+
+Aabb Union(const Aabb& a, const Aabb& b) noexcept {
+  Aabb result{a};
+  result.Grow(b);
+  return result;
+}
+
+Vector InverseDirection(const Ray& ray) noexcept {
+  return {1.F / ray.direction.x, 1.F / ray.direction.y,
+          1.F / ray.direction.z};
+}
+
+Aabb SphereBounds(const Sphere& sphere) noexcept {
+  const Matrix& transform = sphere.transform_matrix;
+  Point center{transform * sphere.origin};
+
+  Vector half_extent;
+  for (size_t row = 0; row < 3; ++row) {
+    float x = transform.At(row, 0);
+    float y = transform.At(row, 1);
+    float z = transform.At(row, 2);
+    half_extent[row] = std::sqrt(x * x + y * y + z * z);
+  }
+
+  return {center - half_extent, center + half_extent};
+}
+
+Aabb TransformBounds(const Aabb& bounds, const Matrix& transform) noexcept {
+  if (bounds.IsEmpty()) {
+    return bounds;
+  }
+
+  Point center{transform * bounds.Centroid()};
+  Vector half_extent{bounds.Extent() * .5F};
+
+  Vector transformed_extent;
+  for (size_t row = 0; row < 3; ++row) {
+    transformed_extent[row] = std::abs(transform.At(row, 0)) * half_extent.x +
+                              std::abs(transform.At(row, 1)) * half_extent.y +
+                              std::abs(transform.At(row, 2)) * half_extent.z;
+  }
+
+  return {center - transformed_extent, center + transformed_extent};
+}
+
+Aabb::operator std::string() const noexcept {
+  return std::format("Aabb(min={}, max={})", std::string(min),
+                     std::string(max));
+}
+
+std::ostream& operator<<(std::ostream& os, const Aabb& aabb) {
+  os << std::string(aabb);
+  return os;
+}
@@ -0,0 +1,59 @@
+#ifndef SRC_GEOMETRY_AABB_H_
+#define SRC_GEOMETRY_AABB_H_
+
+#include <geometry/matrix.h>
+#include <geometry/point.h>
+#include <geometry/ray.h>
+#include <geometry/vector.h>
+
+#include <iostream>
+#include <string>
+
+// NOTE: World-space axis-aligned bounding box. A default box is empty
+// (min = +inf, max = -inf), so growing it by anything yields that thing.
+struct Aabb {
+  Point min;
+  Point max;
+
+  Aabb() noexcept;
+  Aabb(const Point& min, const Point& max) noexcept;
+  Aabb(const Aabb& other) noexcept;
+  Aabb& operator=(const Aabb& other) noexcept;
+
+  bool operator==(const Aabb& other) const noexcept;
+  bool operator!=(const Aabb& other) const noexcept;
+
+  void Grow(const Point& point) noexcept;
+  void Grow(const Aabb& other) noexcept;
+
+  bool IsEmpty() const noexcept;
+  Point Centroid() const noexcept;
+  Vector Extent() const noexcept;
+  float SurfaceArea() const noexcept;
+
+  // NOTE: Slab test against [tmin, tmax]. inverse_direction is
+  // 1 / ray.direction per axis, computed once per ray. On a hit, *t_entry is
+  // where the ray enters the box, clamped to tmin.
+  bool Intersect(const Ray& ray, const Vector& inverse_direction, float tmin,
+                 float tmax, float* t_entry) const noexcept;
+
+  operator std::string() const noexcept;
+};
+
+std::ostream& operator<<(std::ostream& os, const Aabb& aabb);
+
+Aabb Union(const Aabb& a, const Aabb& b) noexcept;
+
+Vector InverseDirection(const Ray& ray) noexcept;
+
+// NOTE: Exact bounds of the transformed unit sphere. Row i of the linear
+// part stretches the sphere to a half extent of that row's length along
+// axis i, which holds for non-uniform scale, rotation and shear alike.
+Aabb SphereBounds(const Sphere& sphere) noexcept;
+
+// NOTE: Bounds of a transformed box. Each output half extent sums the
+// input half extents weighted by the absolute linear part (Arvo 1990),
+// the same box as bounding the eight transformed corners.
+Aabb TransformBounds(const Aabb& bounds, const Matrix& transform) noexcept;
+
+#endif  // SRC_GEOMETRY_AABB_H_
@@ -0,0 +1,609 @@
+#include <core/arr.h>
+#include <core/thread_pool.h>
+#include <core/utils.h>
+#include <geometry/aabb.h>
+#include <geometry/bvh.h>
+#include <geometry/point.h>
+#include <geometry/primitive.h>
+#include <geometry/ray.h>
+#include <geometry/vector.h>
+#include <immintrin.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <format>
+#include <memory>
+#include <string>
+#include <utility>
+
+BvhNode::BvhNode() noexcept : first(0), count(0) {}
+
+BvhNode::BvhNode(const BvhNode& other) noexcept
+    : bounds(other.bounds), first(other.first), count(other.count) {}
+
+BvhNode& BvhNode::operator=(const BvhNode& other) noexcept {
+  if (this != &other) {
+    bounds = other.bounds;
+    first = other.first;
+    count = other.count;
+  }
+  return *this;
+}
+
+bool BvhNode::IsLeaf() const noexcept { return count > 0; }
+
+Bvh::Bvh() noexcept : node_count(0), build_cost(0.F), cost(0.F) {}
+
+Bvh::Bvh(const Sphere* spheres, const size_t count) noexcept : Bvh() {
+  Build(spheres, count);
+}
+
+Bvh::Bvh(const Bvh& other) noexcept
+    : nodes(other.nodes),
+      indices(other.indices),
+      node_count(other.node_count),
+      build_cost(other.build_cost),
+      cost(other.cost) {}
+
+Bvh& Bvh::operator=(const Bvh& other) noexcept {
+  if (this != &other) {
+    nodes = other.nodes;
+    indices = other.indices;
+    node_count = other.node_count;
+    build_cost = other.build_cost;
+    cost = other.cost;
+  }
+  return *this;
+}
+
+void Bvh::Clear() noexcept {
+  nodes = DyArray<BvhNode>{};
+  indices = DyArray<uint32_t>{};
+  node_count = 0;
+  build_cost = 0.F;
+  cost = 0.F;
+}
+
+bool Bvh::IsBuilt() const noexcept { return node_count > 0; }
+
+size_t Bvh::MemoryUsage() const noexcept {
+  return nodes.capacity * sizeof(BvhNode) + indices.capacity * sizeof(uint32_t);
+}
+
+// NOTE: Build-time copy of one object's bounds as raw vectors. The SAH
+// passes partition these records in place rather than an index array, so
+// every pass over a node's range reads memory sequentially.
+struct BvhBuildRef {
+  __m128 min;
+  __m128 max;
+  __m128 centroid;
+  uint32_t index;
+};
+
+struct BvhBin {
+  __m128 min = _mm_set1_ps(INFINITY);
+  __m128 max = _mm_set1_ps(-INFINITY);
+  uint32_t count = 0;
+};
+
+struct BvhSplit {
+  int32_t axis;
+  uint32_t bin;
+  float cost;
+};
+
+struct BvhBuildTask {
+  uint32_t node;
+  uint32_t depth;
+};
+
+static inline float Lane(const __m128 vec, const size_t lane) noexcept {
+  alignas(16) float lanes[4];
+  _mm_store_ps(lanes, vec);
+  return lanes[lane];
+}
+
+static inline float SurfaceArea(const __m128 min, const __m128 max) noexcept {
+  alignas(16) float extent[4];
+  _mm_store_ps(extent, _mm_sub_ps(max, min));
+  if (extent[0] < 0.F || extent[1] < 0.F || extent[2] < 0.F) {
+    return 0.F;
+  }
+  return 2.F * (extent[0] * extent[1] + extent[1] * extent[2] +
+                extent[2] * extent[0]);
+}
+
+static inline uint32_t BinIndex(const float centroid, const float low,
+                                const float scale) noexcept {
+  auto bin = static_cast<uint32_t>((centroid - low) * scale);
+  return bin < BVH_BIN_COUNT ? bin : BVH_BIN_COUNT - 1;
+}
+
+// NOTE: Bins all three axes in one pass over the range. The cost of
+// splitting between bins is the SAH numerator left_count * left_area +
+// right_count * right_area; splits that leave one side empty are skipped.
+static BvhSplit FindSplit(const BvhBuildRef* refs, const uint32_t count,
+                          const __m128 centroid_min,
+                          const __m128 centroid_max) noexcept {
+  BvhSplit best{-1, 0, INFINITY};
+
+  alignas(16) float lows[4];
+  alignas(16) float extents[4];
+  _mm_store_ps(lows, centroid_min);
+  _mm_store_ps(extents, _mm_sub_ps(centroid_max, centroid_min));
+  float scales[3];
+  for (size_t axis = 0; axis < 3; ++axis) {
+    scales[axis] = extents[axis] > 0.F
+                       ? static_cast<float>(BVH_BIN_COUNT) / extents[axis]
+                       : 0.F;
+  }
+
+  BvhBin bins[3][BVH_BIN_COUNT];
+  for (uint32_t i = 0; i < count; ++i) {
+    alignas(16) float centroid[4];
+    _mm_store_ps(centroid, refs[i].centroid);
+    for (size_t axis = 0; axis < 3; ++axis) {
+      BvhBin& bin =
+          bins[axis][BinIndex(centroid[axis], lows[axis], scales[axis])];
+      bin.min = _mm_min_ps(bin.min, refs[i].min);
+      bin.max = _mm_max_ps(bin.max, refs[i].max);
+      bin.count++;
+    }
+  }
+
+  for (int32_t axis = 0; axis < 3; ++axis) {
+    if (extents[axis] <= 0.F) {
+      continue;
+    }
+
+    float left_areas[BVH_BIN_COUNT - 1];
+    uint32_t left_counts[BVH_BIN_COUNT - 1];
+    BvhBin left;
+    for (uint32_t b = 0; b < BVH_BIN_COUNT - 1; ++b) {
+      left.min = _mm_min_ps(left.min, bins[axis][b].min);
+      left.max = _mm_max_ps(left.max, bins[axis][b].max);
+      left.count += bins[axis][b].count;
+      left_areas[b] = SurfaceArea(left.min, left.max);
+      left_counts[b] = left.count;
+    }
+
+    BvhBin right;
+    for (uint32_t b = BVH_BIN_COUNT - 1; b > 0; --b) {
+      right.min = _mm_min_ps(right.min, bins[axis][b].min);
+      right.max = _mm_max_ps(right.max, bins[axis][b].max);
+      right.count += bins[axis][b].count;
+      if (left_counts[b - 1] == 0 || right.count == 0) {
+        continue;
+      }
+
+      float cost = static_cast<float>(left_counts[b - 1]) * left_areas[b - 1] +
+                   static_cast<float>(right.count) *
+                       SurfaceArea(right.min, right.max);
+      if (cost < best.cost) {
+        best = {axis, b, cost};
+      }
+    }
+  }
+
+  return best;
+}
+
+// NOTE: Median split along the widest centroid axis, for ranges the SAH
+// cannot split and ranges past BVH_MEDIAN_SPLIT_DEPTH.
+static uint32_t MedianSplit(BvhBuildRef* refs, const uint32_t count,
+                            const __m128 centroid_min,
+                            const __m128 centroid_max) noexcept {
+  alignas(16) float extent[4];
+  _mm_store_ps(extent, _mm_sub_ps(centroid_max, centroid_min));
+  size_t axis = 0;
+  if (extent[1] > extent[axis]) {
+    axis = 1;
+  }
+  if (extent[2] > extent[axis]) {
+    axis = 2;
+  }
+
+  uint32_t mid = count / 2;
+  std::nth_element(refs, refs + mid, refs + count,
+                   [axis](const BvhBuildRef& a, const BvhBuildRef& b) {
+                     return Lane(a.centroid, axis) < Lane(b.centroid, axis);
+                   });
+  return mid;
+}
+
+void Bvh::Build(const Sphere* spheres, const size_t count) noexcept {
+  std::unique_ptr<Aabb[]> bounds = std::make_unique<Aabb[]>(count);
+  for (size_t i = 0; i < count; ++i) {
+    bounds[i] = SphereBounds(spheres[i]);
+  }
+  Build(bounds.get(), count);
+}
+
+void Bvh::Build(const Aabb* bounds, const size_t count) noexcept {
+  Clear();
+  if (count == 0) {
+    return;
+  }
+
+  std::unique_ptr<BvhBuildRef[]> refs = std::make_unique<BvhBuildRef[]>(count);
+  for (size_t i = 0; i < count; ++i) {
+    refs[i].min = bounds[i].min.vec;
+    refs[i].max = bounds[i].max.vec;
+    refs[i].centroid = bounds[i].Centroid().vec;
+    refs[i].index = static_cast<uint32_t>(i);
+  }
+
+  // NOTE: A binary tree with count leaves at most has 2 * count - 1 nodes;
+  // the array is trimmed to the nodes used once the build is done.
+  DyArray<BvhNode> build_nodes{2 * count - 1};
+  build_nodes[0].first = 0;
+  build_nodes[0].count = static_cast<uint32_t>(count);
+  node_count = 1;
+
+  BvhBuildTask tasks[BVH_MAX_DEPTH + 1];
+  size_t task_count = 0;
+  tasks[task_count++] = {0, 0};
+
+  while (task_count > 0) {
+    BvhBuildTask task = tasks[--task_count];
+    BvhNode& node = build_nodes[task.node];
+    BvhBuildRef* range = refs.get() + node.first;
+
+    BvhBin bounds;
+    BvhBin centroid_bounds;
+    for (uint32_t i = 0; i < node.count; ++i) {
+      bounds.min = _mm_min_ps(bounds.min, range[i].min);
+      bounds.max = _mm_max_ps(bounds.max, range[i].max);
+      centroid_bounds.min = _mm_min_ps(centroid_bounds.min, range[i].centroid);
+      centroid_bounds.max = _mm_max_ps(centroid_bounds.max, range[i].centroid);
+    }
+    node.bounds = {Point{bounds.min}, Point{bounds.max}};
+
+    if (node.count == 1) {
+      continue;
+    }
+
+    uint32_t mid = 0;
+    if (task.depth < BVH_MEDIAN_SPLIT_DEPTH) {
+      BvhSplit split{FindSplit(range, node.count, centroid_bounds.min,
+                               centroid_bounds.max)};
+
+      float area = SurfaceArea(bounds.min, bounds.max);
+      float leaf_cost = static_cast<float>(node.count) * area;
+      bool is_split_worse = split.axis < 0 || area + split.cost >= leaf_cost;
+      if (node.count <= BVH_MAX_LEAF_SIZE && is_split_worse) {
+        continue;
+      }
+
+      if (split.axis >= 0) {
+        float low = Lane(centroid_bounds.min, split.axis);
+        float scale = static_cast<float>(BVH_BIN_COUNT) /
+                      (Lane(centroid_bounds.max, split.axis) - low);
+        BvhBuildRef* partition = std::partition(
+            range, range + node.count,
+            [&split, low, scale](const BvhBuildRef& ref) {
+              return BinIndex(Lane(ref.centroid, split.axis), low, scale) <
+                     split.bin;
+            });
+        mid = static_cast<uint32_t>(partition - range);
+      }
+    } else if (node.count <= BVH_MAX_LEAF_SIZE) {
+      continue;
+    }
+
+    if (mid == 0 || mid == node.count) {
+      mid = MedianSplit(range, node.count, centroid_bounds.min,
+                        centroid_bounds.max);
+    }
+
+    auto left = static_cast<uint32_t>(node_count);
+    node_count += 2;
+    build_nodes[left].first = node.first;
+    build_nodes[left].count = mid;
+    build_nodes[left + 1].first = node.first + mid;
+    build_nodes[left + 1].count = node.count - mid;
+    node.first = left;
+    node.count = 0;
+
+    tasks[task_count++] = {left + 1, task.depth + 1};
+    tasks[task_count++] = {left, task.depth + 1};
+  }
+
+  indices = DyArray<uint32_t>{count};
+  for (size_t i = 0; i < count; ++i) {
+    indices[i] = refs[i].index;
+  }
+  nodes = DyArray<BvhNode>{build_nodes.data.get(), node_count};
+  build_cost = SahCost();
+  cost = build_cost;
+}
+
+static inline double NodeCost(const BvhNode& node) noexcept {
+  double tests = node.IsLeaf() ? static_cast<double>(node.count) : 1.;
+  return tests * node.bounds.SurfaceArea();
+}
+
+static inline float RelativeCost(const double cost, const Aabb& root) {
+  double area = root.SurfaceArea();
+  return area > 0. ? static_cast<float>(cost / area) : 0.F;
+}
+
+float Bvh::SahCost() const noexcept {
+  if (!IsBuilt()) {
+    return 0.F;
+  }
+
+  double total = 0.;
+  for (size_t i = 0; i < node_count; ++i) {
+    total += NodeCost(nodes[i]);
+  }
+  return RelativeCost(total, nodes[0].bounds);
+}
+
+// NOTE: Shared state of one refit. The gathers split the objects across
+// thread_count pool tasks; every subtree is then a task of its own.
+struct BvhRefitContext {
+  const uint32_t* indices;
+  const Sphere* spheres;
+  const Aabb* object_bounds;
+  size_t count;
+  size_t thread_count;
+  const RefitNodeFunction* refit_subtree;
+  std::unique_ptr<Aabb[]> sphere_bounds;
+  std::unique_ptr<Aabb[]> leaf_bounds;
+  const uint32_t* subtrees;
+  std::unique_ptr<double[]> costs;
+};
+
+static void GatherSphereBounds(BvhRefitContext* context,
+                               const size_t worker_idx) noexcept {
+  TaskRange objects{
+      WorkerRange(context->count, context->thread_count, worker_idx)};
+  for (size_t i = objects.begin; i < objects.end; ++i) {
+    context->sphere_bounds[i] = SphereBounds(context->spheres[i]);
+  }
+}
+
+static void GatherLeafBounds(BvhRefitContext* context,
+                             const size_t worker_idx) noexcept {
+  TaskRange objects{
+      WorkerRange(context->count, context->thread_count, worker_idx)};
+  for (size_t i = objects.begin; i < objects.end; ++i) {
+    context->leaf_bounds[i] = context->object_bounds[context->indices[i]];
+  }
+}
+
+double RefitHierarchy(const uint32_t* indices, const Sphere* spheres,
+                      const Aabb* bounds, const size_t count,
+                      size_t thread_count,
+                      const InteriorChildrenFunction& interior_children,
+                      const RefitNodeFunction& refit_subtree,
+                      const RefitNodeFunction& refit_top) noexcept {
+  ThreadPool* pool = RenderPool();
+  if (thread_count == 0) {
+    thread_count = pool->thread_count;
+  }
+  thread_count = Min(thread_count, count);
+
+  DyArray<uint32_t> tops;
+  DyArray<uint32_t> subtrees;
+  subtrees.Push(0);
+  size_t subtree_target =
+      thread_count > 1 ? thread_count * BVH_REFIT_SUBTREES_PER_THREAD : 1;
+  while (subtrees.size < subtree_target) {
+    DyArray<uint32_t> next_subtrees;
+    size_t opened_count = 0;
+    for (size_t i = 0; i < subtrees.size; ++i) {
+      size_t first_child = next_subtrees.size;
+      interior_children(subtrees[i], &next_subtrees);
+      if (next_subtrees.size == first_child) {
+        next_subtrees.Push(subtrees[i]);
+        continue;
+      }
+      tops.Push(subtrees[i]);
+      opened_count++;
+    }
+    if (opened_count == 0) {
+      break;
+    }
+    subtrees = std::move(next_subtrees);
+  }
+
+  BvhRefitContext context{indices, spheres,      bounds,
+                          count,   thread_count, &refit_subtree};
+  context.leaf_bounds = std::make_unique<Aabb[]>(count);
+  context.subtrees = subtrees.data.get();
+  context.costs = std::make_unique<double[]>(subtrees.size);
+
+  if (spheres != nullptr) {
+    context.sphere_bounds = std::make_unique<Aabb[]>(count);
+    context.object_bounds = context.sphere_bounds.get();
+    pool->Run(
+        [&context](size_t worker_idx) {
+          GatherSphereBounds(&context, worker_idx);
+        },
+        thread_count);
+  }
+  pool->Run(
+      [&context](size_t worker_idx) {
+        GatherLeafBounds(&context, worker_idx);
+      },
+      thread_count);
+  pool->Run(
+      [&context](size_t subtree) {
+        context.costs[subtree] = (*context.refit_subtree)(
+            context.subtrees[subtree], context.leaf_bounds.get());
+      },
+      subtrees.size);
+
+  double total = 0.;
+  for (size_t i = 0; i < subtrees.size; ++i) {
+    total += context.costs[i];
+  }
+  for (size_t i = tops.size; i > 0; --i) {
+    total += refit_top(tops[i - 1], context.leaf_bounds.get());
+  }
+  return total;
+}
+
+bool IsPastRebuildThreshold(const float cost, const float build_cost,
+                            const float rebuild_threshold) noexcept {
+  return cost > build_cost * rebuild_threshold;
+}
+
+// NOTE: Post-order refit of one subtree. Paths are at most BVH_MAX_DEPTH
+// nodes long, which bounds the recursion.
+static double RefitNode(BvhNode* nodes, const Aabb* leaf_bounds,
+                        const uint32_t node_idx) noexcept {
+  BvhNode& node = nodes[node_idx];
+  if (node.IsLeaf()) {
+    Aabb bounds;
+    for (uint32_t i = 0; i < node.count; ++i) {
+      bounds.Grow(leaf_bounds[node.first + i]);
+    }
+    node.bounds = bounds;
+    return NodeCost(node);
+  }
+
+  double subtree_cost = RefitNode(nodes, leaf_bounds, node.first) +
+                        RefitNode(nodes, leaf_bounds, node.first + 1);
+  node.bounds = Union(nodes[node.first].bounds, nodes[node.first + 1].bounds);
+  return subtree_cost + NodeCost(node);
+}
+
+static inline void RebuildTree(Bvh* bvh, const Sphere* spheres,
+                               const Aabb* bounds, const size_t count) {
+  if (spheres != nullptr) {
+    bvh->Build(spheres, count);
+  } else {
+    bvh->Build(bounds, count);
+  }
+}
+
+// NOTE: Refits over either spheres or precomputed bounds; exactly one of
+// them is non-null, and a rebuild uses the same input.
+static bool RefitTree(Bvh* bvh, const Sphere* spheres, const Aabb* bounds,
+                      const size_t count, const float rebuild_threshold,
+                      const size_t thread_count) noexcept {
+  if (!bvh->IsBuilt() || bvh->indices.size != count) {
+    RebuildTree(bvh, spheres, bounds, count);
+    return true;
+  }
+
+  BvhNode* nodes = bvh->nodes.data.get();
+  double total = RefitHierarchy(
+      bvh->indices.data.get(), spheres, bounds, count, thread_count,
+      [nodes](uint32_t node_idx, DyArray<uint32_t>* children) {
+        const BvhNode& node = nodes[node_idx];
+        if (!node.IsLeaf()) {
+          children->Push(node.first);
+          children->Push(node.first + 1);
+        }
+      },
+      [nodes](uint32_t node_idx, const Aabb* leaf_bounds) {
+        return RefitNode(nodes, leaf_bounds, node_idx);
+      },
+      [nodes](uint32_t node_idx, const Aabb*) {
+        BvhNode& node = nodes[node_idx];
+        node.bounds =
+            Union(nodes[node.first].bounds, nodes[node.first + 1].bounds);
+        return NodeCost(node);
+      });
+  bvh->cost = RelativeCost(total, nodes[0].bounds);
+
+  if (IsPastRebuildThreshold(bvh->cost, bvh->build_cost, rebuild_threshold)) {
+    RebuildTree(bvh, spheres, bounds, count);
+    return true;
+  }
+  return false;
+}
+
+bool Bvh::Refit(const Sphere* spheres, const size_t count,
+                const float rebuild_threshold,
+                const size_t thread_count) noexcept {
+  return RefitTree(this, spheres, nullptr, count, rebuild_threshold,
+                   thread_count);
+}
+
+bool Bvh::Refit(const Aabb* bounds, const size_t count,
+                const float rebuild_threshold,
+                const size_t thread_count) noexcept {
+  return RefitTree(this, nullptr, bounds, count, rebuild_threshold,
+                   thread_count);
+}
+
+HitRecord Bvh::ClosestHit(const Ray& ray, const Sphere* spheres,
+                          const float tmin, const float tmax) const noexcept {
+  HitRecord record{NO_HIT_ID, tmax};
+  Traverse(ray, tmin, &record.t,
+           [&](uint32_t first, uint32_t count, float* t_hit) {
+             for (uint32_t i = first; i < first + count; ++i) {
+               if (ray.IntersectClosest(spheres[indices[i]], tmin, t_hit)) {
+                 record.object_id = indices[i];
+               }
+             }
+           });
+  return record;
+}
+
+bool Bvh::IsOccluded(const Ray& ray, const Sphere* spheres, const float tmin,
+                     const float tmax) const noexcept {
+  return AnyLeaf(ray, tmin, tmax, [&](uint32_t first, uint32_t count) {
+    for (uint32_t i = first; i < first + count; ++i) {
+      if (ray.IntersectAny(spheres[indices[i]], tmin, tmax)) {
+        return true;
+      }
+    }
+    return false;
+  });
+}
+
+HitRecord Bvh::ClosestHit(const Ray& ray, const SphereStore& store,
+                          const float tmin, const float tmax) const noexcept {
+  assert(store.Count() == indices.size);
+  HitRecord record{NO_HIT_ID, tmax};
+  SphereRays rays{MakeSphereRays(ray)};
+  Traverse(ray, tmin, &record.t,
+           [&](uint32_t first, uint32_t count, float* t_hit) {
+             uint32_t row =
+                 store.ClosestInRange(rays, first, count, tmin, t_hit);
+             if (row != NO_HIT_ID) {
+               record.object_id = indices[row];
+             }
+           });
+  return record;
+}
+
+bool Bvh::IsOccluded(const Ray& ray, const SphereStore& store,
+                     const float tmin, const float tmax) const noexcept {
+  assert(store.Count() == indices.size);
+  SphereRays rays{MakeSphereRays(ray)};
+  return AnyLeaf(ray, tmin, tmax, [&](uint32_t first, uint32_t count) {
+    return store.IsRangeOccluded(rays, first, count, tmin, tmax);
+  });
+}
+
+BvhNode::operator std::string() const noexcept {
+  if (IsLeaf()) {
+    return std::format("BvhNode(leaf, first={}, count={}, bounds={})", first,
+                       count, std::string(bounds));
+  }
+  return std::format("BvhNode(interior, children={}, bounds={})", first,
+                     std::string(bounds));
+}
+
+std::ostream& operator<<(std::ostream& os, const BvhNode& node) {
+  os << std::string(node);
+  return os;
+}
+
+Bvh::operator std::string() const noexcept {
+  return std::format("Bvh(nodes={}, objects={}, bytes={})", node_count,
+                     indices.size, MemoryUsage());
+}
+
+std::ostream& operator<<(std::ostream& os, const Bvh& bvh) {
+  os << std::string(bvh);
+  return os;
+}
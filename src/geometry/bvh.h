@@ -0,0 +1,240 @@
+#ifndef SRC_GEOMETRY_BVH_H_
+#define SRC_GEOMETRY_BVH_H_
+
+#include <core/arr.h>
+#include <geometry/aabb.h>
+#include <geometry/primitive.h>
+#include <geometry/ray.h>
+
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <utility>
+
+// NOTE: Binned SAH build parameters. Ranges of up to BVH_MAX_LEAF_SIZE
+// objects become leaves when splitting does not pay off. Ranges deeper than
+// BVH_MEDIAN_SPLIT_DEPTH are split at the median instead, which adds at most
+// 32 more levels for 32-bit object counts, so no path is longer than
+// BVH_MAX_DEPTH and the traversal stacks cannot overflow.
+#define BVH_BIN_COUNT 16
+#define BVH_MAX_LEAF_SIZE 4
+#define BVH_MEDIAN_SPLIT_DEPTH 32
+#define BVH_MAX_DEPTH 64
+// NOTE: Refit keeps the topology while the SAH cost stays within this
+// factor of the cost measured right after the last build.
+#define BVH_REBUILD_THRESHOLD 1.5F
+// NOTE: Independent subtrees handed out per refit worker, so uneven
+// subtrees still balance out.
+#define BVH_REFIT_SUBTREES_PER_THREAD 8
+
+struct BvhNode {
+  Aabb bounds;
+  // NOTE: Interior nodes (count == 0) keep their children at first and
+  // first + 1. Leaves keep count object indices from Bvh::indices[first].
+  uint32_t first;
+  uint32_t count;
+
+  BvhNode() noexcept;
+  BvhNode(const BvhNode& other) noexcept;
+  BvhNode& operator=(const BvhNode& other) noexcept;
+
+  bool IsLeaf() const noexcept;
+
+  operator std::string() const noexcept;
+};
+
+std::ostream& operator<<(std::ostream& os, const BvhNode& node);
+
+// NOTE: Binary bounding volume hierarchy over an array of spheres. It stores
+// object indices only, so queries take the same array it was built over;
+// rebuild it whenever objects are added or removed. When only transforms
+// change, Refit updates the bounds in place.
+struct Bvh {
+  DyArray<BvhNode> nodes;
+  DyArray<uint32_t> indices;
+  size_t node_count;
+  // NOTE: SahCost() right after the last build, and after the last refit.
+  float build_cost;
+  float cost;
+
+  Bvh() noexcept;
+  Bvh(const Sphere* spheres, size_t count) noexcept;
+  Bvh(const Bvh& other) noexcept;
+  Bvh& operator=(const Bvh& other) noexcept;
+
+  void Build(const Sphere* spheres, size_t count) noexcept;
+  // NOTE: Builds over arbitrary boxes, such as instances; leaf indices then
+  // index the array the boxes were computed from.
+  void Build(const Aabb* bounds, size_t count) noexcept;
+  void Clear() noexcept;
+  bool IsBuilt() const noexcept;
+  size_t MemoryUsage() const noexcept;
+
+  // NOTE: Expected number of box and sphere tests for a ray through the
+  // root: every node costs one test per object (interior nodes one box
+  // test), weighted by its surface area relative to the root.
+  float SahCost() const noexcept;
+
+  // NOTE: Recomputes every node bound bottom-up from the current transforms
+  // across thread_count tasks on the render pool; 0 uses one per pool
+  // thread, and it must not run inside a pool task. Once the SAH cost grows
+  // past rebuild_threshold times build_cost, or the object count changed,
+  // the tree is rebuilt instead. Returns whether it was rebuilt.
+  bool Refit(const Sphere* spheres, size_t count, float rebuild_threshold,
+             size_t thread_count) noexcept;
+  bool Refit(const Aabb* bounds, size_t count, float rebuild_threshold,
+             size_t thread_count) noexcept;
+
+  // NOTE: Front-to-back traversal shared by every query over the tree: the
+  // nearer child is visited first and the farther one is skipped once its
+  // entry lies beyond *tmax. leaf(first, count, tmax) tests the leaf's
+  // objects, indices[first] onwards, and lowers *tmax on a nearer hit.
+  template <typename LeafFunction>
+  void Traverse(const Ray& ray, float tmin, float* tmax,
+                LeafFunction leaf) const noexcept;
+  // NOTE: Any-order traversal that stops as soon as leaf(first, count)
+  // returns true, and returns whether one did.
+  template <typename LeafFunction>
+  bool AnyLeaf(const Ray& ray, float tmin, float tmax,
+               LeafFunction leaf) const noexcept;
+
+  HitRecord ClosestHit(const Ray& ray, const Sphere* spheres, float tmin,
+                       float tmax) const noexcept;
+  bool IsOccluded(const Ray& ray, const Sphere* spheres, float tmin,
+                  float tmax) const noexcept;
+  // NOTE: The same queries over a store built in indices order, so each
+  // leaf is the row range [first, first + count) and runs the store's
+  // 4-wide kernel; object_id is still the index into the sphere array.
+  HitRecord ClosestHit(const Ray& ray, const SphereStore& store, float tmin,
+                       float tmax) const noexcept;
+  bool IsOccluded(const Ray& ray, const SphereStore& store, float tmin,
+                  float tmax) const noexcept;
+
+  operator std::string() const noexcept;
+};
+
+std::ostream& operator<<(std::ostream& os, const Bvh& bvh);
+
+template <typename LeafFunction>
+void Bvh::Traverse(const Ray& ray, const float tmin, float* tmax,
+                   LeafFunction leaf) const noexcept {
+  Vector inverse_direction{InverseDirection(ray)};
+  float t_entry = 0;
+  if (!IsBuilt() || !nodes[0].bounds.Intersect(ray, inverse_direction, tmin,
+                                                *tmax, &t_entry)) {
+    return;
+  }
+
+  uint32_t stack[BVH_MAX_DEPTH];
+  float stack_ts[BVH_MAX_DEPTH];
+  size_t top = 0;
+  uint32_t node_idx = 0;
+
+  while (true) {
+    const BvhNode& node = nodes[node_idx];
+    if (node.IsLeaf()) {
+      leaf(node.first, node.count, tmax);
+    } else {
+      uint32_t near_idx = node.first;
+      uint32_t far_idx = node.first + 1;
+      float t_near = 0;
+      float t_far = 0;
+      bool is_near_hit = nodes[near_idx].bounds.Intersect(
+          ray, inverse_direction, tmin, *tmax, &t_near);
+      bool is_far_hit = nodes[far_idx].bounds.Intersect(
+          ray, inverse_direction, tmin, *tmax, &t_far);
+
+      if (is_near_hit && is_far_hit) {
+        if (t_far < t_near) {
+          std::swap(near_idx, far_idx);
+          std::swap(t_near, t_far);
+        }
+        stack[top] = far_idx;
+        stack_ts[top] = t_far;
+        ++top;
+        node_idx = near_idx;
+        continue;
+      }
+      if (is_near_hit || is_far_hit) {
+        node_idx = is_near_hit ? near_idx : far_idx;
+        continue;
+      }
+    }
+
+    // NOTE: Pops pending nodes until one may still hold a hit nearer than
+    // *tmax. Entries were pushed with their box entry distance.
+    bool is_popped = false;
+    while (top > 0 && !is_popped) {
+      --top;
+      is_popped = stack_ts[top] < *tmax;
+    }
+    if (!is_popped) {
+      break;
+    }
+    node_idx = stack[top];
+  }
+}
+
+template <typename LeafFunction>
+bool Bvh::AnyLeaf(const Ray& ray, const float tmin, const float tmax,
+                  LeafFunction leaf) const noexcept {
+  Vector inverse_direction{InverseDirection(ray)};
+  float t_entry = 0;
+  if (!IsBuilt() || !nodes[0].bounds.Intersect(ray, inverse_direction, tmin,
+                                                tmax, &t_entry)) {
+    return false;
+  }
+
+  uint32_t stack[BVH_MAX_DEPTH + 1];
+  size_t top = 0;
+  stack[top++] = 0;
+
+  while (top > 0) {
+    const BvhNode& node = nodes[stack[--top]];
+    if (node.IsLeaf()) {
+      if (leaf(node.first, node.count)) {
+        return true;
+      }
+      continue;
+    }
+
+    for (uint32_t child = node.first; child < node.first + 2; ++child) {
+      if (nodes[child].bounds.Intersect(ray, inverse_direction, tmin, tmax,
+                                        &t_entry)) {
+        stack[top++] = child;
+      }
+    }
+  }
+
+  return false;
+}
+
+// NOTE: Refits node_idx, and for a subtree everything below it, reading
+// object bounds gathered into indices order from leaf_bounds. Returns the
+// cost of the nodes it refit.
+typedef std::function<double(uint32_t node_idx, const Aabb* leaf_bounds)>
+    RefitNodeFunction;
+// NOTE: Appends the interior children of node_idx to children.
+typedef std::function<void(uint32_t node_idx, DyArray<uint32_t>* children)>
+    InteriorChildrenFunction;
+
+// NOTE: The layout-independent part of Bvh::Refit and WideBvh::Refit.
+// Object bounds are computed in array order, unless bounds are passed
+// instead of spheres, and gathered into indices order, since objects are
+// rarely stored near their leaves. The top of the tree is then opened level
+// by level into enough independent subtrees for thread_count pool workers
+// to refit with refit_subtree, and the opened nodes are refit last, deepest
+// first, with refit_top. Returns the summed cost of every refit node.
+double RefitHierarchy(const uint32_t* indices, const Sphere* spheres,
+                      const Aabb* bounds, size_t count, size_t thread_count,
+                      const InteriorChildrenFunction& interior_children,
+                      const RefitNodeFunction& refit_subtree,
+                      const RefitNodeFunction& refit_top) noexcept;
+
+// NOTE: Whether a refit cost has grown past rebuild_threshold times the
+// cost right after the build.
+bool IsPastRebuildThreshold(float cost, float build_cost,
+                            float rebuild_threshold) noexcept;
+
+#endif  // SRC_GEOMETRY_BVH_H_
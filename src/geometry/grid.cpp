@@ -0,0 +1,557 @@
+#include <core/arr.h>
+#include <core/thread_pool.h>
+#include <core/utils.h>
+#include <geometry/aabb.h>
+#include <geometry/grid.h>
+#include <geometry/point.h>
+#include <geometry/primitive.h>
+#include <geometry/ray.h>
+#include <geometry/vector.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <format>
+#include <memory>
+#include <string>
+
+// NOTE: Flat scenes still get cells of a finite size on every axis.
+#define GRID_MIN_EXTENT 1e-4F
+
+Grid::Grid() noexcept
+    : resolution_x(0), resolution_y(0), resolution_z(0), cell_count(0) {}
+
+Grid::Grid(const Sphere* spheres, const size_t count,
+           const size_t thread_count) noexcept
+    : Grid() {
+  Build(spheres, count, thread_count);
+}
+
+Grid::Grid(const Grid& other) noexcept
+    : bounds(other.bounds),
+      resolution_x(other.resolution_x),
+      resolution_y(other.resolution_y),
+      resolution_z(other.resolution_z),
+      cell_size(other.cell_size),
+      inverse_cell_size(other.inverse_cell_size),
+      cell_starts(other.cell_starts),
+      indices(other.indices),
+      object_bounds(other.object_bounds),
+      cell_count(other.cell_count) {}
+
+Grid& Grid::operator=(const Grid& other) noexcept {
+  if (this != &other) {
+    bounds = other.bounds;
+    resolution_x = other.resolution_x;
+    resolution_y = other.resolution_y;
+    resolution_z = other.resolution_z;
+    cell_size = other.cell_size;
+    inverse_cell_size = other.inverse_cell_size;
+    cell_starts = other.cell_starts;
+    indices = other.indices;
+    object_bounds = other.object_bounds;
+    cell_count = other.cell_count;
+  }
+  return *this;
+}
+
+void Grid::Clear() noexcept {
+  bounds = Aabb{};
+  resolution_x = 0;
+  resolution_y = 0;
+  resolution_z = 0;
+  cell_starts = DyArray<uint32_t>{};
+  indices = DyArray<uint32_t>{};
+  object_bounds = DyArray<Aabb>{};
+  cell_count = 0;
+}
+
+bool Grid::IsBuilt() const noexcept { return cell_count > 0; }
+
+size_t Grid::MemoryUsage() const noexcept {
+  return cell_starts.capacity * sizeof(uint32_t) +
+         indices.capacity * sizeof(uint32_t) +
+         object_bounds.capacity * sizeof(Aabb);
+}
+
+struct GridCellRange {
+  uint32_t min_x;
+  uint32_t min_y;
+  uint32_t min_z;
+  uint32_t max_x;
+  uint32_t max_y;
+  uint32_t max_z;
+};
+
+static inline uint32_t CellCoordinate(const float value, const float low,
+                                      const float inverse_size,
+                                      const uint32_t resolution) noexcept {
+  float cell = (value - low) * inverse_size;
+  if (!(cell > 0.F)) {
+    return 0;
+  }
+  return cell < static_cast<float>(resolution - 1)
+             ? static_cast<uint32_t>(cell)
+             : resolution - 1;
+}
+
+static inline GridCellRange CellRange(const Grid& grid,
+                                      const Aabb& bounds) noexcept {
+  const Point& low = grid.bounds.min;
+  const Vector& inverse = grid.inverse_cell_size;
+  return {CellCoordinate(bounds.min.x, low.x, inverse.x, grid.resolution_x),
+          CellCoordinate(bounds.min.y, low.y, inverse.y, grid.resolution_y),
+          CellCoordinate(bounds.min.z, low.z, inverse.z, grid.resolution_z),
+          CellCoordinate(bounds.max.x, low.x, inverse.x, grid.resolution_x),
+          CellCoordinate(bounds.max.y, low.y, inverse.y, grid.resolution_y),
+          CellCoordinate(bounds.max.z, low.z, inverse.z, grid.resolution_z)};
+}
+
+static inline uint32_t AxisResolution(const float extent,
+                                      const float cells_per_unit) noexcept {
+  float cells = std::ceil(extent * cells_per_unit);
+  if (!(cells > 1.F)) {
+    return 1;
+  }
+  return cells < GRID_MAX_RESOLUTION ? static_cast<uint32_t>(cells)
+                                     : GRID_MAX_RESOLUTION;
+}
+
+// NOTE: Picks cubic-ish cells so the grid has about GRID_DENSITY cells per
+// object, shrinking them until the total fits GRID_MAX_CELLS.
+static void SetupCells(Grid* grid, const Aabb& scene, const size_t count) {
+  Vector extent{scene.Extent()};
+  extent.x = std::max(extent.x, GRID_MIN_EXTENT);
+  extent.y = std::max(extent.y, GRID_MIN_EXTENT);
+  extent.z = std::max(extent.z, GRID_MIN_EXTENT);
+  grid->bounds = {scene.min, scene.min + extent};
+
+  float volume = extent.x * extent.y * extent.z;
+  float cells_per_unit =
+      std::cbrt(GRID_DENSITY * static_cast<float>(count) / volume);
+  while (true) {
+    grid->resolution_x = AxisResolution(extent.x, cells_per_unit);
+    grid->resolution_y = AxisResolution(extent.y, cells_per_unit);
+    grid->resolution_z = AxisResolution(extent.z, cells_per_unit);
+    grid->cell_count = static_cast<size_t>(grid->resolution_x) *
+                       grid->resolution_y * grid->resolution_z;
+    if (grid->cell_count <= GRID_MAX_CELLS) {
+      break;
+    }
+    cells_per_unit *= .95F * std::cbrt(static_cast<float>(GRID_MAX_CELLS) /
+                                       static_cast<float>(grid->cell_count));
+  }
+
+  grid->cell_size = {extent.x / static_cast<float>(grid->resolution_x),
+                     extent.y / static_cast<float>(grid->resolution_y),
+                     extent.z / static_cast<float>(grid->resolution_z)};
+  grid->inverse_cell_size = {1.F / grid->cell_size.x, 1.F / grid->cell_size.y,
+                             1.F / grid->cell_size.z};
+}
+
+// NOTE: Shared state of one build. cursors first counts the objects per
+// cell, then becomes each cell's next free slot during the scatter.
+struct GridBuildContext {
+  Grid* grid;
+  const Sphere* spheres;
+  size_t count;
+  size_t thread_count;
+  std::unique_ptr<Aabb[]> thread_bounds;
+  std::unique_ptr<uint32_t[]> thread_sums;
+  std::unique_ptr<std::atomic<uint32_t>[]> cursors;
+};
+
+template <typename Visit>
+static inline void ForEachCell(const Grid& grid, const GridCellRange& range,
+                               Visit visit) {
+  for (uint32_t z = range.min_z; z <= range.max_z; ++z) {
+    for (uint32_t y = range.min_y; y <= range.max_y; ++y) {
+      uint32_t row = grid.resolution_x * (y + grid.resolution_y * z);
+      for (uint32_t x = range.min_x; x <= range.max_x; ++x) {
+        visit(row + x);
+      }
+    }
+  }
+}
+
+static inline TaskRange ObjectChunk(const GridBuildContext* context,
+                                    const size_t worker_idx) noexcept {
+  return WorkerRange(context->count, context->thread_count, worker_idx);
+}
+
+static inline TaskRange CellChunk(const GridBuildContext* context,
+                                  const size_t worker_idx) noexcept {
+  return WorkerRange(context->grid->cell_count, context->thread_count,
+                     worker_idx);
+}
+
+static void ComputeBounds(GridBuildContext* context, const size_t worker_idx) {
+  Grid* grid = context->grid;
+  TaskRange objects{ObjectChunk(context, worker_idx)};
+  Aabb scene;
+  for (size_t i = objects.begin; i < objects.end; ++i) {
+    grid->object_bounds[i] = SphereBounds(context->spheres[i]);
+    scene.Grow(grid->object_bounds[i]);
+  }
+  context->thread_bounds[worker_idx] = scene;
+}
+
+static void CountCells(GridBuildContext* context, const size_t worker_idx) {
+  const Grid& grid = *context->grid;
+  TaskRange objects{ObjectChunk(context, worker_idx)};
+  std::atomic<uint32_t>* cursors = context->cursors.get();
+  for (size_t i = objects.begin; i < objects.end; ++i) {
+    ForEachCell(grid, CellRange(grid, grid.object_bounds[i]),
+                [cursors](uint32_t cell) {
+                  cursors[cell].fetch_add(1, std::memory_order_relaxed);
+                });
+  }
+}
+
+static void SumCells(GridBuildContext* context, const size_t worker_idx) {
+  TaskRange cells{CellChunk(context, worker_idx)};
+  uint32_t cells_sum = 0;
+  for (size_t cell = cells.begin; cell < cells.end; ++cell) {
+    cells_sum += context->cursors[cell].load(std::memory_order_relaxed);
+  }
+  context->thread_sums[worker_idx] = cells_sum;
+}
+
+static void StartCells(GridBuildContext* context, const size_t worker_idx) {
+  Grid* grid = context->grid;
+  TaskRange cells{CellChunk(context, worker_idx)};
+  std::atomic<uint32_t>* cursors = context->cursors.get();
+  uint32_t offset = context->thread_sums[worker_idx];
+  for (size_t cell = cells.begin; cell < cells.end; ++cell) {
+    uint32_t cell_objects = cursors[cell].load(std::memory_order_relaxed);
+    grid->cell_starts[cell] = offset;
+    cursors[cell].store(offset, std::memory_order_relaxed);
+    offset += cell_objects;
+  }
+}
+
+static void ScatterObjects(GridBuildContext* context,
+                           const size_t worker_idx) {
+  const Grid& grid = *context->grid;
+  TaskRange objects{ObjectChunk(context, worker_idx)};
+  std::atomic<uint32_t>* cursors = context->cursors.get();
+  uint32_t* indices = context->grid->indices.data.get();
+  for (size_t i = objects.begin; i < objects.end; ++i) {
+    ForEachCell(grid, CellRange(grid, grid.object_bounds[i]),
+                [cursors, indices, i](uint32_t cell) {
+                  uint32_t slot =
+                      cursors[cell].fetch_add(1, std::memory_order_relaxed);
+                  indices[slot] = static_cast<uint32_t>(i);
+                });
+  }
+}
+
+// NOTE: The scatter order within a cell depends on thread timing; sorting
+// restores ascending ids, so ties resolve like the other accelerators.
+static void SortCells(GridBuildContext* context, const size_t worker_idx) {
+  Grid* grid = context->grid;
+  TaskRange cells{CellChunk(context, worker_idx)};
+  uint32_t* indices = grid->indices.data.get();
+  for (size_t cell = cells.begin; cell < cells.end; ++cell) {
+    std::sort(indices + grid->cell_starts[cell],
+              indices + grid->cell_starts[cell + 1]);
+  }
+}
+
+static void RunGridPhase(ThreadPool* pool, GridBuildContext* context,
+                         void (*phase)(GridBuildContext*, size_t)) {
+  pool->Run(
+      [context, phase](size_t worker_idx) { phase(context, worker_idx); },
+      context->thread_count);
+}
+
+void Grid::Build(const Sphere* spheres, const size_t count,
+                 size_t thread_count) noexcept {
+  Clear();
+  if (count == 0) {
+    return;
+  }
+
+  ThreadPool* pool = RenderPool();
+  if (thread_count == 0) {
+    thread_count = pool->thread_count;
+  }
+  thread_count = Min(thread_count, count);
+
+  GridBuildContext context{this, spheres, count, thread_count};
+  object_bounds = DyArray<Aabb>{count};
+  context.thread_bounds = std::make_unique<Aabb[]>(thread_count);
+  context.thread_sums = std::make_unique<uint32_t[]>(thread_count);
+
+  RunGridPhase(pool, &context, ComputeBounds);
+  Aabb scene_bounds;
+  for (size_t worker = 0; worker < thread_count; ++worker) {
+    scene_bounds.Grow(context.thread_bounds[worker]);
+  }
+  SetupCells(this, scene_bounds, count);
+  cell_starts = DyArray<uint32_t>{cell_count + 1};
+  context.cursors = std::make_unique<std::atomic<uint32_t>[]>(cell_count);
+
+  RunGridPhase(pool, &context, CountCells);
+  RunGridPhase(pool, &context, SumCells);
+  uint32_t offset = 0;
+  for (size_t worker = 0; worker < thread_count; ++worker) {
+    uint32_t worker_sum = context.thread_sums[worker];
+    context.thread_sums[worker] = offset;
+    offset += worker_sum;
+  }
+  cell_starts[cell_count] = offset;
+  indices = DyArray<uint32_t>{offset};
+
+  RunGridPhase(pool, &context, StartCells);
+  RunGridPhase(pool, &context, ScatterObjects);
+  RunGridPhase(pool, &context, SortCells);
+}
+
+// NOTE: State of one 3D-DDA walk. t_nexts holds, per axis, the distance at
+// which the ray crosses into the next cell along that axis.
+struct GridWalk {
+  int32_t cell[3];
+  int32_t steps[3];
+  int32_t resolutions[3];
+  float t_nexts[3];
+  float t_deltas[3];
+  float t_exit;
+};
+
+static inline bool BeginWalk(const Grid& grid, const Ray& ray,
+                             const float tmin, const float tmax,
+                             GridWalk* walk) noexcept {
+  const float origins[3] = {ray.origin.x, ray.origin.y, ray.origin.z};
+  const float directions[3] = {ray.direction.x, ray.direction.y,
+                               ray.direction.z};
+  const float lows[3] = {grid.bounds.min.x, grid.bounds.min.y,
+                         grid.bounds.min.z};
+  const float highs[3] = {grid.bounds.max.x, grid.bounds.max.y,
+                          grid.bounds.max.z};
+  const float sizes[3] = {grid.cell_size.x, grid.cell_size.y,
+                          grid.cell_size.z};
+  walk->resolutions[0] = static_cast<int32_t>(grid.resolution_x);
+  walk->resolutions[1] = static_cast<int32_t>(grid.resolution_y);
+  walk->resolutions[2] = static_cast<int32_t>(grid.resolution_z);
+
+  float t_entry = tmin;
+  float t_exit = tmax;
+  float inverses[3];
+  for (size_t axis = 0; axis < 3; ++axis) {
+    inverses[axis] = 1.F / directions[axis];
+    float t_low = (lows[axis] - origins[axis]) * inverses[axis];
+    float t_high = (highs[axis] - origins[axis]) * inverses[axis];
+    if (t_low > t_high) {
+      std::swap(t_low, t_high);
+    }
+    // NOTE: NaN from an axis-parallel ray on a slab plane fails both tests
+    // and leaves the interval unchanged.
+    t_entry = t_low > t_entry ? t_low : t_entry;
+    t_exit = t_high < t_exit ? t_high : t_exit;
+  }
+  if (t_entry > t_exit) {
+    return false;
+  }
+  walk->t_exit = t_exit;
+
+  for (size_t axis = 0; axis < 3; ++axis) {
+    float position = origins[axis] + directions[axis] * t_entry;
+    float cell = (position - lows[axis]) / sizes[axis];
+    int32_t last = walk->resolutions[axis] - 1;
+    walk->cell[axis] = cell > 0.F ? std::min(static_cast<int32_t>(cell), last)
+                                  : 0;
+
+    if (directions[axis] > 0.F) {
+      float boundary = lows[axis] + (walk->cell[axis] + 1) * sizes[axis];
+      walk->steps[axis] = 1;
+      walk->t_nexts[axis] = (boundary - origins[axis]) * inverses[axis];
+      walk->t_deltas[axis] = sizes[axis] * inverses[axis];
+    } else if (directions[axis] < 0.F) {
+      float boundary = lows[axis] + walk->cell[axis] * sizes[axis];
+      walk->steps[axis] = -1;
+      walk->t_nexts[axis] = (boundary - origins[axis]) * inverses[axis];
+      walk->t_deltas[axis] = -sizes[axis] * inverses[axis];
+    } else {
+      walk->steps[axis] = 0;
+      walk->t_nexts[axis] = INFINITY;
+      walk->t_deltas[axis] = INFINITY;
+    }
+  }
+  return true;
+}
+
+static inline size_t NextAxis(const GridWalk& walk) noexcept {
+  if (walk.t_nexts[0] < walk.t_nexts[1]) {
+    return walk.t_nexts[0] < walk.t_nexts[2] ? 0 : 2;
+  }
+  return walk.t_nexts[1] < walk.t_nexts[2] ? 1 : 2;
+}
+
+// NOTE: Moves to the next cell; false once the walk leaves the grid.
+static inline bool StepWalk(GridWalk* walk, const size_t axis) noexcept {
+  walk->cell[axis] += walk->steps[axis];
+  if (walk->cell[axis] < 0 || walk->cell[axis] >= walk->resolutions[axis]) {
+    return false;
+  }
+  walk->t_nexts[axis] += walk->t_deltas[axis];
+  return true;
+}
+
+static inline uint32_t CellIndex(const GridWalk& walk) noexcept {
+  int32_t slice = walk.cell[1] + walk.resolutions[1] * walk.cell[2];
+  return static_cast<uint32_t>(walk.cell[0] + walk.resolutions[0] * slice);
+}
+
+// NOTE: True when id was already tested by this ray; otherwise records it.
+static inline bool IsMailboxed(uint32_t* mailbox, const uint32_t id) noexcept {
+  uint32_t& slot = mailbox[id % GRID_MAILBOX_SIZE];
+  if (slot == id) {
+    return true;
+  }
+  slot = id;
+  return false;
+}
+
+HitRecord Grid::ClosestHit(const Ray& ray, const Sphere* spheres,
+                           const float tmin, const float tmax) const noexcept {
+  HitRecord record{NO_HIT_ID, tmax};
+  GridWalk walk;
+  if (!IsBuilt() || !BeginWalk(*this, ray, tmin, tmax, &walk)) {
+    return record;
+  }
+
+  uint32_t mailbox[GRID_MAILBOX_SIZE];
+  std::fill_n(mailbox, GRID_MAILBOX_SIZE, NO_HIT_ID);
+  Vector inverse_direction{InverseDirection(ray)};
+  float t_entry = 0;
+
+  while (true) {
+    uint32_t cell = CellIndex(walk);
+    for (uint32_t i = cell_starts[cell]; i < cell_starts[cell + 1]; ++i) {
+      uint32_t idx = indices[i];
+      if (!IsMailboxed(mailbox, idx) &&
+          object_bounds[idx].Intersect(ray, inverse_direction, tmin,
+                                       record.t, &t_entry) &&
+          ray.IntersectClosest(spheres[idx], tmin, &record.t)) {
+        record.object_id = idx;
+      }
+    }
+
+    // NOTE: Objects in later cells only span distances past this cell, so
+    // a hit inside it is the nearest one.
+    size_t axis = NextAxis(walk);
+    float t_cell_exit = walk.t_nexts[axis];
+    if (record.t <= t_cell_exit || t_cell_exit > walk.t_exit ||
+        !StepWalk(&walk, axis)) {
+      break;
+    }
+  }
+
+  return record;
+}
+
+bool Grid::IsOccluded(const Ray& ray, const Sphere* spheres, const float tmin,
+                      const float tmax) const noexcept {
+  GridWalk walk;
+  if (!IsBuilt() || !BeginWalk(*this, ray, tmin, tmax, &walk)) {
+    return false;
+  }
+
+  uint32_t mailbox[GRID_MAILBOX_SIZE];
+  std::fill_n(mailbox, GRID_MAILBOX_SIZE, NO_HIT_ID);
+  Vector inverse_direction{InverseDirection(ray)};
+  float t_entry = 0;
+
+  while (true) {
+    uint32_t cell = CellIndex(walk);
+    for (uint32_t i = cell_starts[cell]; i < cell_starts[cell + 1]; ++i) {
+      uint32_t idx = indices[i];
+      if (!IsMailboxed(mailbox, idx) &&
+          object_bounds[idx].Intersect(ray, inverse_direction, tmin, tmax,
+                                       &t_entry) &&
+          ray.IntersectAny(spheres[idx], tmin, tmax)) {
+        return true;
+      }
+    }
+
+    size_t axis = NextAxis(walk);
+    if (walk.t_nexts[axis] > walk.t_exit || !StepWalk(&walk, axis)) {
+      break;
+    }
+  }
+
+  return false;
+}
+
+// NOTE: Each cell is one range of store rows, tested 4 at a time with no
+// box screen or mailbox, so a sphere spanning several cells is tested once
+// per cell.
+HitRecord Grid::ClosestHit(const Ray& ray, const SphereStore& store,
+                           const float tmin, const float tmax) const noexcept {
+  assert(store.Count() == indices.size);
+  HitRecord record{NO_HIT_ID, tmax};
+  GridWalk walk;
+  if (!IsBuilt() || !BeginWalk(*this, ray, tmin, tmax, &walk)) {
+    return record;
+  }
+
+  SphereRays rays{MakeSphereRays(ray)};
+  while (true) {
+    uint32_t cell = CellIndex(walk);
+    uint32_t row = store.ClosestInRange(
+        rays, cell_starts[cell], cell_starts[cell + 1] - cell_starts[cell],
+        tmin, &record.t);
+    if (row != NO_HIT_ID) {
+      record.object_id = indices[row];
+    }
+
+    size_t axis = NextAxis(walk);
+    float t_cell_exit = walk.t_nexts[axis];
+    if (record.t <= t_cell_exit || t_cell_exit > walk.t_exit ||
+        !StepWalk(&walk, axis)) {
+      break;
+    }
+  }
+
+  return record;
+}
+
+bool Grid::IsOccluded(const Ray& ray, const SphereStore& store,
+                      const float tmin, const float tmax) const noexcept {
+  assert(store.Count() == indices.size);
+  GridWalk walk;
+  if (!IsBuilt() || !BeginWalk(*this, ray, tmin, tmax, &walk)) {
+    return false;
+  }
+
+  SphereRays rays{MakeSphereRays(ray)};
+  while (true) {
+    uint32_t cell = CellIndex(walk);
+    if (store.IsRangeOccluded(rays, cell_starts[cell],
+                              cell_starts[cell + 1] - cell_starts[cell], tmin,
+                              tmax)) {
+      return true;
+    }
+
+    size_t axis = NextAxis(walk);
+    if (walk.t_nexts[axis] > walk.t_exit || !StepWalk(&walk, axis)) {
+      break;
+    }
+  }
+
+  return false;
+}
+
+Grid::operator std::string() const noexcept {
+  return std::format("Grid(resolution={}x{}x{}, references={}, bytes={})",
+                     resolution_x, resolution_y, resolution_z, indices.size,
+                     MemoryUsage());
+}
+
+std::ostream& operator<<(std::ostream& os, const Grid& grid) {
+  os << std::string(grid);
+  return os;
+}
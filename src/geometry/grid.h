@@ -0,0 +1,73 @@
+#ifndef SRC_GEOMETRY_GRID_H_
+#define SRC_GEOMETRY_GRID_H_
+
+#include <core/arr.h>
+#include <geometry/aabb.h>
+#include <geometry/primitive.h>
+#include <geometry/ray.h>
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+
+// NOTE: Target cells per object. Cells come out about as wide as an object
+// when objects are of similar size and spread evenly.
+#define GRID_DENSITY 2.F
+#define GRID_MAX_RESOLUTION 1024
+#define GRID_MAX_CELLS (1U << 24)
+// NOTE: Objects overlapping several cells are tested once per ray; the
+// mailbox remembers this many of the last tested ids, by id modulo size.
+#define GRID_MAILBOX_SIZE 16
+
+// NOTE: Uniform grid over an array of spheres, for dense scenes of
+// similar-sized objects where it beats a hierarchy. Cell (x, y, z) lists
+// its objects in indices[cell_starts[c]..cell_starts[c + 1]) with
+// c = x + resolution_x * (y + resolution_y * z), in ascending id order.
+// Like Bvh, it stores indices only and queries take the same array, but it
+// keeps each object's bounds so a cheap box test screens every sphere test.
+struct Grid {
+  Aabb bounds;
+  uint32_t resolution_x;
+  uint32_t resolution_y;
+  uint32_t resolution_z;
+  Vector cell_size;
+  Vector inverse_cell_size;
+  DyArray<uint32_t> cell_starts;
+  DyArray<uint32_t> indices;
+  DyArray<Aabb> object_bounds;
+  size_t cell_count;
+
+  Grid() noexcept;
+  Grid(const Sphere* spheres, size_t count, size_t thread_count) noexcept;
+  Grid(const Grid& other) noexcept;
+  Grid& operator=(const Grid& other) noexcept;
+
+  // NOTE: Counting-sort build across thread_count tasks on the render pool;
+  // 0 uses one per pool thread, and it must not run inside a pool task. The
+  // result does not depend on thread_count.
+  void Build(const Sphere* spheres, size_t count,
+             size_t thread_count) noexcept;
+  void Clear() noexcept;
+  bool IsBuilt() const noexcept;
+  size_t MemoryUsage() const noexcept;
+
+  // NOTE: 3D-DDA walk through the cells the ray crosses, nearest first,
+  // stopping at the first cell that ends beyond the nearest hit.
+  HitRecord ClosestHit(const Ray& ray, const Sphere* spheres, float tmin,
+                       float tmax) const noexcept;
+  bool IsOccluded(const Ray& ray, const Sphere* spheres, float tmin,
+                  float tmax) const noexcept;
+  // NOTE: The same walk over a store built in indices order, so every cell
+  // is one range of its rows; a sphere listed in several cells has a row in
+  // each.
+  HitRecord ClosestHit(const Ray& ray, const SphereStore& store, float tmin,
+                       float tmax) const noexcept;
+  bool IsOccluded(const Ray& ray, const SphereStore& store, float tmin,
+                  float tmax) const noexcept;
+
+  operator std::string() const noexcept;
+};
+
+std::ostream& operator<<(std::ostream& os, const Grid& grid);
+
+#endif  // SRC_GEOMETRY_GRID_H_
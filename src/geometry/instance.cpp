@@ -0,0 +1,259 @@
+#include <core/arr.h>
+#include <geometry/aabb.h>
+#include <geometry/bvh.h>
+#include <geometry/instance.h>
+#include <geometry/matrix.h>
+#include <geometry/point.h>
+#include <geometry/ray.h>
+#include <geometry/vector.h>
+#include <geometry/wide_bvh.h>
+
+#include <algorithm>
+#include <format>
+#include <string>
+#include <utility>
+
+Blas::Blas() noexcept {}
+
+Blas::Blas(const Sphere* spheres, const size_t count) noexcept : Blas() {
+  Build(spheres, count);
+}
+
+Blas::Blas(const Blas& other) noexcept
+    : spheres(other.spheres), bvh(other.bvh), bounds(other.bounds) {}
+
+Blas& Blas::operator=(const Blas& other) noexcept {
+  if (this != &other) {
+    spheres = other.spheres;
+    bvh = other.bvh;
+    bounds = other.bounds;
+  }
+  return *this;
+}
+
+void Blas::Build(const Sphere* objects, const size_t count) noexcept {
+  spheres = DyArray<Sphere>{count};
+  std::copy_n(objects, count, spheres.data.get());
+  bvh.Build(spheres.data.get(), count);
+
+  bounds = Aabb{};
+  for (size_t i = 0; i < count; ++i) {
+    bounds.Grow(SphereBounds(spheres[i]));
+  }
+}
+
+size_t Blas::MemoryUsage() const noexcept {
+  return spheres.capacity * sizeof(Sphere) + bvh.MemoryUsage();
+}
+
+Blas UnitSphereBlas() noexcept {
+  Sphere sphere;
+  return Blas{&sphere, 1};
+}
+
+Instance::Instance() noexcept : blas(nullptr) { SetTransform(Identity()); }
+
+Instance::Instance(const Blas* blas, const Matrix& transform) noexcept
+    : blas(blas) {
+  SetTransform(transform);
+}
+
+Instance::Instance(const Instance& other) noexcept
+    : transform_matrix(other.transform_matrix),
+      inverse_transform(other.inverse_transform),
+      inverse_transpose(other.inverse_transpose),
+      blas(other.blas) {}
+
+Instance& Instance::operator=(const Instance& other) noexcept {
+  if (this != &other) {
+    transform_matrix = other.transform_matrix;
+    inverse_transform = other.inverse_transform;
+    inverse_transpose = other.inverse_transpose;
+    blas = other.blas;
+  }
+  return *this;
+}
+
+void Instance::SetTransform(const Matrix& transform) noexcept {
+  transform_matrix = transform;
+  inverse_transform = AffineTransform{transform}.Inverse();
+  inverse_transpose = inverse_transform.LinearTranspose();
+}
+
+Aabb Instance::Bounds() const noexcept {
+  if (blas == nullptr) {
+    return {};
+  }
+  return TransformBounds(blas->bounds, transform_matrix);
+}
+
+bool InstanceHitRecord::IsHit() const noexcept {
+  return instance_id != NO_HIT_ID;
+}
+
+Tlas::Tlas() noexcept {}
+
+Tlas::Tlas(const Tlas& other) noexcept
+    : instances(other.instances), bounds(other.bounds), bvh(other.bvh) {}
+
+Tlas& Tlas::operator=(const Tlas& other) noexcept {
+  if (this != &other) {
+    instances = other.instances;
+    bounds = other.bounds;
+    bvh = other.bvh;
+  }
+  return *this;
+}
+
+uint32_t Tlas::AddInstance(const Blas* blas,
+                           const Matrix& transform) noexcept {
+  Instance instance{blas, transform};
+  instances.Push(instance);
+  bounds.Push(instance.Bounds());
+  bvh.Clear();
+  return static_cast<uint32_t>(instances.size - 1);
+}
+
+void Tlas::SetTransform(const uint32_t instance_id,
+                        const Matrix& transform) noexcept {
+  instances[instance_id].SetTransform(transform);
+  bounds[instance_id] = instances[instance_id].Bounds();
+}
+
+void Tlas::Build() noexcept { bvh.Build(bounds.data.get(), bounds.size); }
+
+bool Tlas::Refit(const float rebuild_threshold,
+                 const size_t thread_count) noexcept {
+  return bvh.Refit(bounds.data.get(), bounds.size, rebuild_threshold,
+                   thread_count);
+}
+
+size_t Tlas::MemoryUsage() const noexcept {
+  return instances.capacity * sizeof(Instance) +
+         bounds.capacity * sizeof(Aabb) + bvh.MemoryUsage();
+}
+
+// NOTE: Moves the ray into the instance's Blas space and runs the Blas
+// query there; record->t shrinks on a nearer hit.
+static inline void IntersectInstance(const Tlas& tlas, const Ray& ray,
+                                     const uint32_t instance_id,
+                                     const float tmin,
+                                     InstanceHitRecord* record) noexcept {
+  const Instance& instance = tlas.instances[instance_id];
+  const Blas& blas = *instance.blas;
+  Ray local_ray{ray.Transform(instance.inverse_transform)};
+  HitRecord hit{
+      blas.bvh.ClosestHit(local_ray, blas.spheres.data.get(), tmin, record->t)};
+  if (hit.IsHit()) {
+    record->instance_id = instance_id;
+    record->object_id = hit.object_id;
+    record->t = hit.t;
+  }
+}
+
+static inline bool IsInstanceOccluded(const Tlas& tlas, const Ray& ray,
+                                      const uint32_t instance_id,
+                                      const float tmin,
+                                      const float tmax) noexcept {
+  const Instance& instance = tlas.instances[instance_id];
+  const Blas& blas = *instance.blas;
+  Ray local_ray{ray.Transform(instance.inverse_transform)};
+  return blas.bvh.IsOccluded(local_ray, blas.spheres.data.get(), tmin, tmax);
+}
+
+InstanceHitRecord Tlas::ClosestHit(const Ray& ray, const float tmin,
+                                   const float tmax) const noexcept {
+  InstanceHitRecord record{NO_HIT_ID, NO_HIT_ID, tmax};
+  if (!bvh.IsBuilt()) {
+    for (size_t i = 0; i < instances.size; ++i) {
+      IntersectInstance(*this, ray, static_cast<uint32_t>(i), tmin, &record);
+    }
+    return record;
+  }
+
+  bvh.Traverse(ray, tmin, &record.t,
+               [&](uint32_t first, uint32_t count, float*) {
+                 for (uint32_t i = first; i < first + count; ++i) {
+                   IntersectInstance(*this, ray, bvh.indices[i], tmin,
+                                     &record);
+                 }
+               });
+  return record;
+}
+
+bool Tlas::IsOccluded(const Ray& ray, const float tmin,
+                      const float tmax) const noexcept {
+  if (!bvh.IsBuilt()) {
+    for (size_t i = 0; i < instances.size; ++i) {
+      if (IsInstanceOccluded(*this, ray, static_cast<uint32_t>(i), tmin,
+                             tmax)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  return bvh.AnyLeaf(ray, tmin, tmax, [&](uint32_t first, uint32_t count) {
+    for (uint32_t i = first; i < first + count; ++i) {
+      if (IsInstanceOccluded(*this, ray, bvh.indices[i], tmin, tmax)) {
+        return true;
+      }
+    }
+    return false;
+  });
+}
+
+Vector Tlas::NormalAt(const InstanceHitRecord& hit,
+                      const Point& world_point) const noexcept {
+  const Instance& instance = instances[hit.instance_id];
+  const Sphere& sphere = instance.blas->spheres[hit.object_id];
+  Point local_point{instance.inverse_transform * world_point};
+  Vector local_normal{sphere.NormalAt(local_point)};
+  Vector world_normal{(instance.inverse_transpose * local_normal).Normalize()};
+  world_normal.w = 0.0;
+  return world_normal;
+}
+
+Blas::operator std::string() const noexcept {
+  return std::format("Blas(objects={}, bounds={}, bytes={})", spheres.size,
+                     std::string(bounds), MemoryUsage());
+}
+
+std::ostream& operator<<(std::ostream& os, const Blas& blas) {
+  os << std::string(blas);
+  return os;
+}
+
+Instance::operator std::string() const noexcept {
+  return std::format("Instance(transform={}, bounds={})",
+                     std::string(transform_matrix), std::string(Bounds()));
+}
+
+std::ostream& operator<<(std::ostream& os, const Instance& instance) {
+  os << std::string(instance);
+  return os;
+}
+
+InstanceHitRecord::operator std::string() const noexcept {
+  if (!IsHit()) {
+    return "InstanceHitRecord(miss)";
+  }
+  return std::format(
+      "InstanceHitRecord(instance_id={}, object_id={}, t={:.10f})",
+      instance_id, object_id, t);
+}
+
+std::ostream& operator<<(std::ostream& os, const InstanceHitRecord& record) {
+  os << std::string(record);
+  return os;
+}
+
+Tlas::operator std::string() const noexcept {
+  return std::format("Tlas(instances={}, bvh={}, bytes={})", instances.size,
+                     std::string(bvh), MemoryUsage());
+}
+
+std::ostream& operator<<(std::ostream& os, const Tlas& tlas) {
+  os << std::string(tlas);
+  return os;
+}
@@ -0,0 +1,107 @@
+#ifndef SRC_GEOMETRY_INSTANCE_H_
+#define SRC_GEOMETRY_INSTANCE_H_
+
+#include <core/arr.h>
+#include <geometry/aabb.h>
+#include <geometry/bvh.h>
+#include <geometry/matrix.h>
+#include <geometry/point.h>
+#include <geometry/ray.h>
+#include <geometry/vector.h>
+#include <geometry/wide_bvh.h>
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+
+// NOTE: Bottom-level acceleration structure: geometry in its own object
+// space and the hierarchy over it. Every Instance pointing at it shares it,
+// so it must outlive them and stay at the same address.
+struct Blas {
+  DyArray<Sphere> spheres;
+  WideBvh bvh;
+  Aabb bounds;
+
+  Blas() noexcept;
+  Blas(const Sphere* spheres, size_t count) noexcept;
+  Blas(const Blas& other) noexcept;
+  Blas& operator=(const Blas& other) noexcept;
+
+  void Build(const Sphere* spheres, size_t count) noexcept;
+  size_t MemoryUsage() const noexcept;
+
+  operator std::string() const noexcept;
+};
+
+std::ostream& operator<<(std::ostream& os, const Blas& blas);
+
+// NOTE: One untransformed unit sphere, for instances that are one sphere.
+Blas UnitSphereBlas() noexcept;
+
+// NOTE: A placement of a Blas in the world. Rays are moved into the Blas
+// space with the cached inverse, so hit distances stay world distances.
+struct Instance {
+  Matrix transform_matrix;
+  AffineTransform inverse_transform;
+  AffineTransform inverse_transpose;
+  const Blas* blas;
+
+  Instance() noexcept;
+  Instance(const Blas* blas, const Matrix& transform) noexcept;
+  Instance(const Instance& other) noexcept;
+  Instance& operator=(const Instance& other) noexcept;
+
+  // NOTE: Write through SetTransform so the cached inverses stay in sync.
+  void SetTransform(const Matrix& transform) noexcept;
+  Aabb Bounds() const noexcept;
+
+  operator std::string() const noexcept;
+};
+
+std::ostream& operator<<(std::ostream& os, const Instance& instance);
+
+// NOTE: object_id indexes the hit instance's blas->spheres; both ids are
+// NO_HIT_ID when nothing was hit.
+struct InstanceHitRecord {
+  uint32_t instance_id;
+  uint32_t object_id;
+  float t;
+
+  bool IsHit() const noexcept;
+
+  operator std::string() const noexcept;
+};
+
+std::ostream& operator<<(std::ostream& os, const InstanceHitRecord& record);
+
+// NOTE: Top-level acceleration structure: a Bvh over the world bounds of
+// instances. Moving an instance updates its bounds only; Refit then brings
+// the top-level tree up to date without touching any Blas.
+struct Tlas {
+  DyArray<Instance> instances;
+  DyArray<Aabb> bounds;
+  Bvh bvh;
+
+  Tlas() noexcept;
+  Tlas(const Tlas& other) noexcept;
+  Tlas& operator=(const Tlas& other) noexcept;
+
+  // NOTE: Drops the tree until the next Build, like World::AddObject.
+  uint32_t AddInstance(const Blas* blas, const Matrix& transform) noexcept;
+  void SetTransform(uint32_t instance_id, const Matrix& transform) noexcept;
+  void Build() noexcept;
+  bool Refit(float rebuild_threshold, size_t thread_count) noexcept;
+  size_t MemoryUsage() const noexcept;
+
+  InstanceHitRecord ClosestHit(const Ray& ray, float tmin,
+                               float tmax) const noexcept;
+  bool IsOccluded(const Ray& ray, float tmin, float tmax) const noexcept;
+  Vector NormalAt(const InstanceHitRecord& hit,
+                  const Point& world_point) const noexcept;
+
+  operator std::string() const noexcept;
+};
+
+std::ostream& operator<<(std::ostream& os, const Tlas& tlas);
+
+#endif  // SRC_GEOMETRY_INSTANCE_H_
@@ -0,0 +1,348 @@
+#include <core/arr.h>
+#include <core/thread_pool.h>
+#include <core/utils.h>
+#include <geometry/aabb.h>
+#include <geometry/bvh.h>
+#include <geometry/lbvh.h>
+#include <geometry/point.h>
+#include <geometry/ray.h>
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+#define LBVH_RADIX_SIZE (1U << LBVH_RADIX_BITS)
+
+// NOTE: Spreads the low 10 bits of value so two zero bits follow each one.
+static inline uint32_t ExpandBits(uint32_t value) noexcept {
+  value = (value * 0x00010001U) & 0xFF0000FFU;
+  value = (value * 0x00000101U) & 0x0F00F00FU;
+  value = (value * 0x00000011U) & 0xC30C30C3U;
+  value = (value * 0x00000005U) & 0x49249249U;
+  return value;
+}
+
+static inline uint32_t Quantize(const float value) noexcept {
+  constexpr float kScale = static_cast<float>((1U << LBVH_MORTON_BITS) - 1);
+  float scaled = value * kScale;
+  if (!(scaled > 0.F)) {
+    return 0;
+  }
+  return scaled < kScale ? static_cast<uint32_t>(scaled)
+                         : static_cast<uint32_t>(kScale);
+}
+
+uint32_t MortonCode(const float x, const float y, const float z) noexcept {
+  return (ExpandBits(Quantize(x)) << 2) | (ExpandBits(Quantize(y)) << 1) |
+         ExpandBits(Quantize(z));
+}
+
+// NOTE: Shared state of one build. Every pass but the prefix sums and the
+// bounds merge splits the objects across thread_count pool tasks.
+struct LbvhBuildContext {
+  const Sphere* spheres;
+  size_t count;
+  size_t thread_count;
+  Bvh* bvh;
+
+  std::unique_ptr<Aabb[]> bounds;
+  std::unique_ptr<Aabb[]> thread_centroid_bounds;
+  Aabb centroid_bounds;
+
+  std::unique_ptr<uint32_t[]> codes;
+  std::unique_ptr<uint32_t[]> order;
+  std::unique_ptr<uint32_t[]> sort_codes;
+  std::unique_ptr<uint32_t[]> sort_order;
+  std::unique_ptr<uint32_t[]> histograms;
+
+  // NOTE: Interior node k is stored at bvh->nodes[positions[k]] and keeps
+  // its children at 2k + 1 and 2k + 2, so every node knows where to write
+  // its children without coordinating with other workers.
+  std::unique_ptr<uint32_t[]> positions;
+  std::unique_ptr<uint32_t[]> interior_parents;
+  std::unique_ptr<uint32_t[]> leaf_parents;
+  std::unique_ptr<std::atomic<uint32_t>[]> visits;
+};
+
+// NOTE: Length of the common prefix of the keys at i and j. Equal codes
+// are told apart by their positions, which makes every key unique.
+static inline int32_t CommonPrefix(const uint32_t* codes, const int64_t count,
+                                   const int64_t i, const int64_t j) noexcept {
+  if (j < 0 || j >= count) {
+    return -1;
+  }
+  uint32_t a = codes[i];
+  uint32_t b = codes[j];
+  if (a == b) {
+    return 32 + std::countl_zero(static_cast<uint32_t>(i ^ j));
+  }
+  return std::countl_zero(a ^ b);
+}
+
+static void ComputeBounds(LbvhBuildContext* context,
+                          const TaskRange& range, const size_t worker_idx) {
+  Aabb centroid_bounds;
+  for (size_t i = range.begin; i < range.end; ++i) {
+    context->bounds[i] = SphereBounds(context->spheres[i]);
+    centroid_bounds.Grow(context->bounds[i].Centroid());
+  }
+  context->thread_centroid_bounds[worker_idx] = centroid_bounds;
+}
+
+static void ComputeCodes(LbvhBuildContext* context, const TaskRange& range) {
+  const Aabb& scene = context->centroid_bounds;
+  Vector extent{scene.Extent()};
+  float scale_x = extent.x > 0.F ? 1.F / extent.x : 0.F;
+  float scale_y = extent.y > 0.F ? 1.F / extent.y : 0.F;
+  float scale_z = extent.z > 0.F ? 1.F / extent.z : 0.F;
+
+  for (size_t i = range.begin; i < range.end; ++i) {
+    Point centroid{context->bounds[i].Centroid()};
+    context->codes[i] = MortonCode((centroid.x - scene.min.x) * scale_x,
+                                   (centroid.y - scene.min.y) * scale_y,
+                                   (centroid.z - scene.min.z) * scale_z);
+    context->order[i] = static_cast<uint32_t>(i);
+  }
+}
+
+// NOTE: One stable least-significant-digit pass in three phases: every
+// worker counts the digits of its chunk, the counts become scatter offsets
+// ordered by digit and then by worker, and every worker scatters its chunk.
+static void CountDigits(LbvhBuildContext* context, const TaskRange& range,
+                        const size_t worker_idx, const uint32_t shift) {
+  uint32_t* histogram =
+      context->histograms.get() + worker_idx * LBVH_RADIX_SIZE;
+  std::fill_n(histogram, LBVH_RADIX_SIZE, 0);
+  for (size_t i = range.begin; i < range.end; ++i) {
+    histogram[(context->codes[i] >> shift) & (LBVH_RADIX_SIZE - 1)]++;
+  }
+}
+
+static void ComputeOffsets(LbvhBuildContext* context) {
+  uint32_t offset = 0;
+  for (uint32_t digit = 0; digit < LBVH_RADIX_SIZE; ++digit) {
+    for (size_t worker = 0; worker < context->thread_count; ++worker) {
+      uint32_t& slot = context->histograms[worker * LBVH_RADIX_SIZE + digit];
+      uint32_t digit_count = slot;
+      slot = offset;
+      offset += digit_count;
+    }
+  }
+}
+
+static void ScatterDigits(LbvhBuildContext* context, const TaskRange& range,
+                          const size_t worker_idx, const uint32_t shift) {
+  uint32_t* histogram =
+      context->histograms.get() + worker_idx * LBVH_RADIX_SIZE;
+  for (size_t i = range.begin; i < range.end; ++i) {
+    uint32_t code = context->codes[i];
+    uint32_t position =
+        histogram[(code >> shift) & (LBVH_RADIX_SIZE - 1)]++;
+    context->sort_codes[position] = code;
+    context->sort_order[position] = context->order[i];
+  }
+}
+
+static inline void WriteChild(LbvhBuildContext* context,
+                              const uint32_t position, const uint32_t child,
+                              const bool is_leaf, const uint32_t parent) {
+  BvhNode& node = context->bvh->nodes[position];
+  if (is_leaf) {
+    node.bounds = context->bounds[context->order[child]];
+    node.first = child;
+    node.count = 1;
+    context->leaf_parents[child] = parent;
+    return;
+  }
+
+  node.first = 2 * child + 1;
+  node.count = 0;
+  context->positions[child] = position;
+  context->interior_parents[child] = parent;
+}
+
+// NOTE: Emits interior node k from the sorted codes alone: find the key
+// range it covers, then the split where the common prefix changes.
+static void EmitInterior(LbvhBuildContext* context, const int64_t k) {
+  const uint32_t* codes = context->codes.get();
+  auto count = static_cast<int64_t>(context->count);
+
+  int64_t direction = CommonPrefix(codes, count, k, k + 1) >
+                              CommonPrefix(codes, count, k, k - 1)
+                          ? 1
+                          : -1;
+  int32_t min_prefix = CommonPrefix(codes, count, k, k - direction);
+
+  int64_t max_length = 2;
+  while (CommonPrefix(codes, count, k, k + max_length * direction) >
+         min_prefix) {
+    max_length *= 2;
+  }
+  int64_t length = 0;
+  for (int64_t step = max_length / 2; step >= 1; step /= 2) {
+    if (CommonPrefix(codes, count, k, k + (length + step) * direction) >
+        min_prefix) {
+      length += step;
+    }
+  }
+  int64_t other_end = k + length * direction;
+
+  int32_t node_prefix = CommonPrefix(codes, count, k, other_end);
+  int64_t split = 0;
+  int64_t divisor = 2;
+  int64_t step = 0;
+  do {
+    step = (length + divisor - 1) / divisor;
+    if (CommonPrefix(codes, count, k, k + (split + step) * direction) >
+        node_prefix) {
+      split += step;
+    }
+    divisor *= 2;
+  } while (step > 1);
+  int64_t gamma = k + split * direction + (direction < 0 ? -1 : 0);
+
+  auto parent = static_cast<uint32_t>(k);
+  auto left = static_cast<uint32_t>(gamma);
+  auto right = static_cast<uint32_t>(gamma + 1);
+  WriteChild(context, 2 * parent + 1, left,
+             std::min(k, other_end) == gamma, parent);
+  WriteChild(context, 2 * parent + 2, right,
+             std::max(k, other_end) == gamma + 1, parent);
+}
+
+// NOTE: Each leaf walks towards the root. The first child to reach an
+// interior node stops there; the second one knows both child bounds are
+// written and unions them, so every node is finished exactly once.
+static void PropagateBounds(LbvhBuildContext* context, const size_t leaf) {
+  uint32_t k = context->leaf_parents[leaf];
+  while (true) {
+    if (context->visits[k].fetch_add(1, std::memory_order_acq_rel) == 0) {
+      return;
+    }
+
+    BvhNode* nodes = context->bvh->nodes.data.get();
+    nodes[context->positions[k]].bounds =
+        Union(nodes[2 * k + 1].bounds, nodes[2 * k + 2].bounds);
+    if (k == 0) {
+      return;
+    }
+    k = context->interior_parents[k];
+  }
+}
+
+static inline TaskRange ObjectRange(const LbvhBuildContext* context,
+                                    const size_t worker_idx) noexcept {
+  return WorkerRange(context->count, context->thread_count, worker_idx);
+}
+
+static void RunLbvhBuild(LbvhBuildContext* context, ThreadPool* pool) {
+  size_t thread_count = context->thread_count;
+  pool->Run(
+      [context](size_t worker_idx) {
+        ComputeBounds(context, ObjectRange(context, worker_idx), worker_idx);
+      },
+      thread_count);
+  for (size_t worker = 0; worker < thread_count; ++worker) {
+    context->centroid_bounds.Grow(context->thread_centroid_bounds[worker]);
+  }
+
+  pool->Run(
+      [context](size_t worker_idx) {
+        ComputeCodes(context, ObjectRange(context, worker_idx));
+      },
+      thread_count);
+
+  for (uint32_t shift = 0; shift < 3 * LBVH_MORTON_BITS;
+       shift += LBVH_RADIX_BITS) {
+    pool->Run(
+        [context, shift](size_t worker_idx) {
+          CountDigits(context, ObjectRange(context, worker_idx), worker_idx,
+                      shift);
+        },
+        thread_count);
+    ComputeOffsets(context);
+    pool->Run(
+        [context, shift](size_t worker_idx) {
+          ScatterDigits(context, ObjectRange(context, worker_idx),
+                        worker_idx, shift);
+        },
+        thread_count);
+    std::swap(context->codes, context->sort_codes);
+    std::swap(context->order, context->sort_order);
+  }
+
+  pool->Run(
+      [context](size_t worker_idx) {
+        TaskRange objects{ObjectRange(context, worker_idx)};
+        for (size_t i = objects.begin; i < objects.end; ++i) {
+          context->bvh->indices[i] = context->order[i];
+        }
+        TaskRange interiors{WorkerRange(
+            context->count - 1, context->thread_count, worker_idx)};
+        for (size_t k = interiors.begin; k < interiors.end; ++k) {
+          EmitInterior(context, static_cast<int64_t>(k));
+        }
+      },
+      thread_count);
+
+  pool->Run(
+      [context](size_t worker_idx) {
+        TaskRange objects{ObjectRange(context, worker_idx)};
+        for (size_t i = objects.begin; i < objects.end; ++i) {
+          PropagateBounds(context, i);
+        }
+      },
+      thread_count);
+}
+
+void BuildLinearBvh(const Sphere* spheres, const size_t count,
+                    size_t thread_count, Bvh* bvh) noexcept {
+  bvh->Clear();
+  if (count == 0) {
+    return;
+  }
+
+  bvh->indices = DyArray<uint32_t>{count};
+  bvh->nodes = DyArray<BvhNode>{2 * count - 1};
+  bvh->node_count = 2 * count - 1;
+  if (count == 1) {
+    bvh->indices[0] = 0;
+    bvh->nodes[0].bounds = SphereBounds(spheres[0]);
+    bvh->nodes[0].first = 0;
+    bvh->nodes[0].count = 1;
+    bvh->build_cost = bvh->SahCost();
+    bvh->cost = bvh->build_cost;
+    return;
+  }
+
+  ThreadPool* pool = RenderPool();
+  if (thread_count == 0) {
+    thread_count = pool->thread_count;
+  }
+  thread_count = Min(thread_count, count);
+
+  LbvhBuildContext context{spheres, count, thread_count, bvh};
+  context.bounds = std::make_unique<Aabb[]>(count);
+  context.thread_centroid_bounds = std::make_unique<Aabb[]>(thread_count);
+  context.codes = std::make_unique<uint32_t[]>(count);
+  context.order = std::make_unique<uint32_t[]>(count);
+  context.sort_codes = std::make_unique<uint32_t[]>(count);
+  context.sort_order = std::make_unique<uint32_t[]>(count);
+  context.histograms =
+      std::make_unique<uint32_t[]>(thread_count * LBVH_RADIX_SIZE);
+  context.positions = std::make_unique<uint32_t[]>(count - 1);
+  context.interior_parents = std::make_unique<uint32_t[]>(count - 1);
+  context.leaf_parents = std::make_unique<uint32_t[]>(count);
+  context.visits = std::make_unique<std::atomic<uint32_t>[]>(count - 1);
+
+  bvh->nodes[0].first = 1;
+  bvh->nodes[0].count = 0;
+  context.positions[0] = 0;
+
+  RunLbvhBuild(&context, pool);
+  bvh->build_cost = bvh->SahCost();
+  bvh->cost = bvh->build_cost;
+}
@@ -0,0 +1,27 @@
+#ifndef SRC_GEOMETRY_LBVH_H_
+#define SRC_GEOMETRY_LBVH_H_
+
+#include <geometry/bvh.h>
+#include <geometry/ray.h>
+
+#include <cstdint>
+
+// NOTE: Bits of the Morton code per axis; 3 * 10 bits fit a uint32_t.
+#define LBVH_MORTON_BITS 10
+#define LBVH_RADIX_BITS 8
+
+// NOTE: 30-bit Morton code of a point with coordinates in [0, 1].
+uint32_t MortonCode(float x, float y, float z) noexcept;
+
+// NOTE: Linear BVH build for scenes that change every frame. Centroids are
+// ordered along a Morton curve with a parallel radix sort, and every
+// interior node is emitted independently from the sorted codes (Karras
+// 2012), so all phases are O(n) and split across thread_count tasks on the
+// render pool; 0 uses one per pool thread. It waits on the pool, so it must
+// not run inside a pool task. The result is an ordinary Bvh with one
+// object per leaf that the Bvh and WideBvh queries accept as is. Its
+// layout does not depend on thread_count.
+void BuildLinearBvh(const Sphere* spheres, size_t count, size_t thread_count,
+                    Bvh* bvh) noexcept;
+
+#endif  // SRC_GEOMETRY_LBVH_H_
@@ -1,3 +1,4 @@
+#include <core/cpu.h>
 #include <core/test_suite.h>
 #include <geometry/matrix.h>
 #include <immintrin.h>
@@ -133,7 +134,7 @@ void Matrix::Populate(float* elements, const size_t element_count) noexcept {
   }
 }
 
-Matrix Matrix::Transpose() noexcept {
+Matrix Matrix::Transpose() const noexcept {
   Matrix matrix(*this);
   _MM_TRANSPOSE4_PS(matrix.row0, matrix.row1, matrix.row2, matrix.row3);
   return matrix;
@@ -190,7 +191,7 @@ float Matrix::Cofactor(size_t row, size_t col) const noexcept {
   return cofactor;
 }
 
-Matrix Matrix::Inverse() const noexcept {
+Matrix Matrix::CofactorInverse() const noexcept {
   float determinant = Determinant();
 
   assert(!IsEqualFloat(determinant, 0.0));
@@ -206,7 +207,232 @@ Matrix Matrix::Inverse() const noexcept {
   return inversed_matrix;
 }
 
-Matrix Multiply(const Matrix& a, const Matrix& b) noexcept {
+#define SHUFFLE_MASK(x, y, z, w) ((x) | ((y) << 2) | ((z) << 4) | ((w) << 6))
+#define SWIZZLE(vec, x, y, z, w) \
+  _mm_shuffle_ps((vec), (vec), SHUFFLE_MASK(x, y, z, w))
+#define SHUFFLE(vec1, vec2, x, y, z, w) \
+  _mm_shuffle_ps((vec1), (vec2), SHUFFLE_MASK(x, y, z, w))
+
+// NOTE: 2x2 matrices are packed row-major into a single __m128 (a, b, c, d).
+static inline __m128 Mat2Multiply(const __m128 a, const __m128 b) noexcept {
+  return _mm_add_ps(_mm_mul_ps(a, SWIZZLE(b, 0, 3, 0, 3)),
+                    _mm_mul_ps(SWIZZLE(a, 1, 0, 3, 2), SWIZZLE(b, 2, 1, 2, 1)));
+}
+
+// NOTE: adj(a) * b
+static inline __m128 Mat2AdjMultiply(const __m128 a, const __m128 b) noexcept {
+  return _mm_sub_ps(_mm_mul_ps(SWIZZLE(a, 3, 3, 0, 0), b),
+                    _mm_mul_ps(SWIZZLE(a, 1, 1, 2, 2), SWIZZLE(b, 2, 3, 0, 1)));
+}
+
+// NOTE: a * adj(b)
+static inline __m128 Mat2MultiplyAdj(const __m128 a, const __m128 b) noexcept {
+  return _mm_sub_ps(_mm_mul_ps(a, SWIZZLE(b, 3, 0, 3, 0)),
+                    _mm_mul_ps(SWIZZLE(a, 1, 0, 3, 2), SWIZZLE(b, 2, 1, 2, 1)));
+}
+
+static inline __m128 Cross3(const __m128 a, const __m128 b) noexcept {
+  __m128 a_yzx = SWIZZLE(a, 1, 2, 0, 3);
+  __m128 b_yzx = SWIZZLE(b, 1, 2, 0, 3);
+  __m128 c = _mm_sub_ps(_mm_mul_ps(a, b_yzx), _mm_mul_ps(a_yzx, b));
+  return SWIZZLE(c, 1, 2, 0, 3);
+}
+
+bool Matrix::IsAffine() const noexcept {
+  if (rows != 4 || cols != 4) {
+    return false;
+  }
+  __m128 last_row = _mm_set_ps(1.F, 0.F, 0.F, 0.F);
+  return _mm_movemask_ps(_mm_cmpeq_ps(row3, last_row)) == 0xF;
+}
+
+Matrix Matrix::AffineInverse() const noexcept {
+  assert(IsAffine());
+  return AffineTransform{*this}.Inverse().ToMatrix();
+}
+
+// NOTE: Block-wise inverse over the 2x2 sub-matrices
+// | A B |
+// | C D |
+// with every cofactor built from 2x2 determinants and adjugates.
+static inline Matrix GeneralInverse(const Matrix& m) noexcept {
+  __m128 a = _mm_movelh_ps(m.row0, m.row1);
+  __m128 b = _mm_movehl_ps(m.row1, m.row0);
+  __m128 c = _mm_movelh_ps(m.row2, m.row3);
+  __m128 d = _mm_movehl_ps(m.row3, m.row2);
+
+  // NOTE: (|A|, |B|, |C|, |D|)
+  __m128 det_sub = _mm_sub_ps(
+      _mm_mul_ps(SHUFFLE(m.row0, m.row2, 0, 2, 0, 2),
+                 SHUFFLE(m.row1, m.row3, 1, 3, 1, 3)),
+      _mm_mul_ps(SHUFFLE(m.row0, m.row2, 1, 3, 1, 3),
+                 SHUFFLE(m.row1, m.row3, 0, 2, 0, 2)));
+  __m128 det_a = SWIZZLE(det_sub, 0, 0, 0, 0);
+  __m128 det_b = SWIZZLE(det_sub, 1, 1, 1, 1);
+  __m128 det_c = SWIZZLE(det_sub, 2, 2, 2, 2);
+  __m128 det_d = SWIZZLE(det_sub, 3, 3, 3, 3);
+
+  __m128 d_c = Mat2AdjMultiply(d, c);
+  __m128 a_b = Mat2AdjMultiply(a, b);
+
+  __m128 x = _mm_sub_ps(_mm_mul_ps(det_d, a), Mat2Multiply(b, d_c));
+  __m128 w = _mm_sub_ps(_mm_mul_ps(det_a, d), Mat2Multiply(c, a_b));
+  __m128 y = _mm_sub_ps(_mm_mul_ps(det_b, c), Mat2MultiplyAdj(d, a_b));
+  __m128 z = _mm_sub_ps(_mm_mul_ps(det_c, b), Mat2MultiplyAdj(a, d_c));
+
+  // NOTE: |M| = |A||D| + |B||C| - tr(adj(A)B adj(D)C)
+  __m128 determinant =
+      _mm_add_ps(_mm_mul_ps(det_a, det_d), _mm_mul_ps(det_b, det_c));
+  __m128 trace = _mm_mul_ps(a_b, SWIZZLE(d_c, 0, 2, 1, 3));
+  trace = _mm_hadd_ps(trace, trace);
+  trace = _mm_hadd_ps(trace, trace);
+  determinant = _mm_sub_ps(determinant, trace);
+
+  assert(!IsEqualFloat(_mm_cvtss_f32(determinant), 0.F));
+
+  __m128 inv_det = _mm_div_ps(_mm_setr_ps(1.F, -1.F, -1.F, 1.F), determinant);
+  x = _mm_mul_ps(x, inv_det);
+  y = _mm_mul_ps(y, inv_det);
+  z = _mm_mul_ps(z, inv_det);
+  w = _mm_mul_ps(w, inv_det);
+
+  return {SHUFFLE(x, y, 3, 1, 3, 1), SHUFFLE(x, y, 2, 0, 2, 0),
+          SHUFFLE(z, w, 3, 1, 3, 1), SHUFFLE(z, w, 2, 0, 2, 0)};
+}
+
+#undef SHUFFLE
+#undef SWIZZLE
+#undef SHUFFLE_MASK
+
+Matrix Matrix::Inverse() const noexcept {
+  if (rows != 4 || cols != 4) {
+    return CofactorInverse();
+  }
+
+  if (IsAffine()) {
+    return AffineInverse();
+  }
+
+  return GeneralInverse(*this);
+}
+
+AffineTransform::AffineTransform() noexcept
+    : row0(_mm_set_ps(0, 0, 0, 1)),
+      row1(_mm_set_ps(0, 0, 1, 0)),
+      row2(_mm_set_ps(0, 1, 0, 0)) {}
+
+AffineTransform::AffineTransform(const __m128 row0, const __m128 row1,
+                                 const __m128 row2) noexcept
+    : row0(row0), row1(row1), row2(row2) {}
+
+AffineTransform::AffineTransform(const Matrix& matrix) noexcept
+    : row0(matrix.row0), row1(matrix.row1), row2(matrix.row2) {
+  assert(matrix.IsAffine());
+}
+
+AffineTransform::AffineTransform(const AffineTransform& other) noexcept
+    : row0(other.row0), row1(other.row1), row2(other.row2) {}
+
+AffineTransform& AffineTransform::operator=(
+    const AffineTransform& other) noexcept {
+  if (this != &other) {
+    row0 = other.row0;
+    row1 = other.row1;
+    row2 = other.row2;
+  }
+  return *this;
+}
+
+static inline __m128 AffineRowMultiply(const __m128 row,
+                                       const AffineTransform& other) noexcept {
+  __m128 x = _mm_shuffle_ps(row, row, _MM_SHUFFLE(0, 0, 0, 0));
+  __m128 y = _mm_shuffle_ps(row, row, _MM_SHUFFLE(1, 1, 1, 1));
+  __m128 z = _mm_shuffle_ps(row, row, _MM_SHUFFLE(2, 2, 2, 2));
+  __m128 translation = _mm_blend_ps(_mm_setzero_ps(), row, 0x8);
+
+  return _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, other.row0),
+                               _mm_mul_ps(y, other.row1)),
+                    _mm_add_ps(_mm_mul_ps(z, other.row2), translation));
+}
+
+AffineTransform AffineTransform::operator*(
+    const AffineTransform& other) const noexcept {
+  return {AffineRowMultiply(row0, other), AffineRowMultiply(row1, other),
+          AffineRowMultiply(row2, other)};
+}
+
+Vector AffineTransform::operator*(const Vector& vector) const noexcept {
+  __m128 x = _mm_dp_ps(row0, vector.vec, 0x71);
+  __m128 y = _mm_dp_ps(row1, vector.vec, 0x72);
+  __m128 z = _mm_dp_ps(row2, vector.vec, 0x74);
+  return Vector{_mm_add_ps(_mm_add_ps(x, y), z)};
+}
+
+Point AffineTransform::operator*(const Point& point) const noexcept {
+  __m128 x = _mm_dp_ps(row0, point.vec, 0xF1);
+  __m128 y = _mm_dp_ps(row1, point.vec, 0xF2);
+  __m128 z = _mm_dp_ps(row2, point.vec, 0xF4);
+  __m128 w = _mm_set_ps(1.F, 0.F, 0.F, 0.F);
+  return Point{_mm_add_ps(_mm_add_ps(x, y), _mm_add_ps(z, w))};
+}
+
+bool AffineTransform::operator==(const AffineTransform& other) const noexcept {
+  return ToMatrix() == other.ToMatrix();
+}
+
+bool AffineTransform::operator!=(const AffineTransform& other) const noexcept {
+  return !(*this == other);
+}
+
+// NOTE: Inverse of [L t; 0 1] is [inv(L) -inv(L)t; 0 1]. The columns of
+// inv(L) are the cross products of the rows of L divided by det(L).
+AffineTransform AffineTransform::Inverse() const noexcept {
+  __m128 zero = _mm_setzero_ps();
+  __m128 r0 = _mm_blend_ps(row0, zero, 0x8);
+  __m128 r1 = _mm_blend_ps(row1, zero, 0x8);
+  __m128 r2 = _mm_blend_ps(row2, zero, 0x8);
+
+  __m128 c0 = Cross3(r1, r2);
+  __m128 c1 = Cross3(r2, r0);
+  __m128 c2 = Cross3(r0, r1);
+
+  __m128 determinant = _mm_dp_ps(r0, c0, 0x7F);
+  assert(!IsEqualFloat(_mm_cvtss_f32(determinant), 0.F));
+
+  __m128 inv_det = _mm_div_ps(_mm_set1_ps(1.F), determinant);
+  c0 = _mm_mul_ps(c0, inv_det);
+  c1 = _mm_mul_ps(c1, inv_det);
+  c2 = _mm_mul_ps(c2, inv_det);
+
+  __m128 t = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(m3), c0),
+                                   _mm_mul_ps(_mm_set1_ps(m7), c1)),
+                        _mm_mul_ps(_mm_set1_ps(m11), c2));
+  t = _mm_sub_ps(zero, t);
+
+  _MM_TRANSPOSE4_PS(c0, c1, c2, t);
+
+  return {c0, c1, c2};
+}
+
+// NOTE: Transpose of the upper-left 3x3 block with the translation dropped.
+// Applied to the inverse it maps object-space normals to world space.
+AffineTransform AffineTransform::LinearTranspose() const noexcept {
+  __m128 zero = _mm_setzero_ps();
+  __m128 r0 = _mm_blend_ps(row0, zero, 0x8);
+  __m128 r1 = _mm_blend_ps(row1, zero, 0x8);
+  __m128 r2 = _mm_blend_ps(row2, zero, 0x8);
+  __m128 r3 = zero;
+
+  _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+
+  return {r0, r1, r2};
+}
+
+Matrix AffineTransform::ToMatrix() const noexcept {
+  return {row0, row1, row2, _mm_set_ps(1.F, 0.F, 0.F, 0.F)};
+}
+
+static inline Matrix MultiplySSE(const Matrix& a, const Matrix& b) noexcept {
   __m128 row0 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(a.m0), b.row0),
                                       _mm_mul_ps(_mm_set1_ps(a.m1), b.row1)),
                            _mm_add_ps(_mm_mul_ps(_mm_set1_ps(a.m2), b.row2),
@@ -233,28 +459,276 @@ Matrix Multiply(const Matrix& a, const Matrix& b) noexcept {
   return res;
 }
 
+static inline __m128 MultiplyRowFMA(const __m128 row,
+                                    const Matrix& b) noexcept {
+  __m128 res0 = _mm_mul_ps(_mm_shuffle_ps(row, row, 0x00), b.row0);
+  __m128 res2 = _mm_mul_ps(_mm_shuffle_ps(row, row, 0xAA), b.row2);
+  res0 = _mm_fmadd_ps(_mm_shuffle_ps(row, row, 0x55), b.row1, res0);
+  res2 = _mm_fmadd_ps(_mm_shuffle_ps(row, row, 0xFF), b.row3, res2);
+  return _mm_add_ps(res0, res2);
+}
+
+static inline Matrix MultiplyFMA(const Matrix& a, const Matrix& b) noexcept {
+  Matrix res(MultiplyRowFMA(a.row0, b), MultiplyRowFMA(a.row1, b),
+             MultiplyRowFMA(a.row2, b), MultiplyRowFMA(a.row3, b));
+  res.rows = a.rows;
+  res.cols = b.cols;
+  return res;
+}
+
+typedef Matrix (*MultiplyFunction)(const Matrix& a,
+                                   const Matrix& b) noexcept;
+
+// NOTE: Multiply runs too often to read the ISA level per call, so the
+// kernel is picked whenever the level changes. It starts at the SSE kernel,
+// which every level can run, for products taken before the callback is
+// registered.
+static MultiplyFunction multiply_kernel = MultiplySSE;
+
+static void SelectMultiplyKernel(const IsaLevel level) noexcept {
+  multiply_kernel = level >= ISA_AVX2 ? MultiplyFMA : MultiplySSE;
+}
+
+static const bool is_multiply_kernel_registered =
+    OnIsaLevelChange(SelectMultiplyKernel);
+
+Matrix Multiply(const Matrix& a, const Matrix& b) noexcept {
+  return multiply_kernel(a, b);
+}
+
+struct BatchTransformContext {
+  const Matrix& matrix;
+  bool is_point;
+  const float* xs;
+  const float* ys;
+  const float* zs;
+  float* out_xs;
+  float* out_ys;
+  float* out_zs;
+  size_t count;
+};
+
+static inline void TransformBatchScalar(const BatchTransformContext& context,
+                                        size_t start) noexcept {
+  const Matrix& m = context.matrix;
+  float w = context.is_point ? 1.F : 0.F;
+
+  for (size_t i = start; i < context.count; ++i) {
+    float x = context.xs[i];
+    float y = context.ys[i];
+    float z = context.zs[i];
+    context.out_xs[i] = m.m0 * x + m.m1 * y + m.m2 * z + m.m3 * w;
+    context.out_ys[i] = m.m4 * x + m.m5 * y + m.m6 * z + m.m7 * w;
+    context.out_zs[i] = m.m8 * x + m.m9 * y + m.m10 * z + m.m11 * w;
+  }
+}
+
+static inline size_t TransformBatchSSE(
+    const BatchTransformContext& context) noexcept {
+  float w = context.is_point ? 1.F : 0.F;
+
+  __m128 m[12];
+  for (size_t k = 0; k < 12; ++k) {
+    float weight = (k % 4 == 3) ? w : 1.F;
+    m[k] = _mm_set1_ps(context.matrix[k] * weight);
+  }
+
+  size_t i = 0;
+  for (; i + 4 <= context.count; i += 4) {
+    __m128 x = _mm_loadu_ps(context.xs + i);
+    __m128 y = _mm_loadu_ps(context.ys + i);
+    __m128 z = _mm_loadu_ps(context.zs + i);
+
+    __m128 out_x = _mm_add_ps(
+        _mm_add_ps(_mm_mul_ps(m[0], x), _mm_mul_ps(m[1], y)),
+        _mm_add_ps(_mm_mul_ps(m[2], z), m[3]));
+    __m128 out_y = _mm_add_ps(
+        _mm_add_ps(_mm_mul_ps(m[4], x), _mm_mul_ps(m[5], y)),
+        _mm_add_ps(_mm_mul_ps(m[6], z), m[7]));
+    __m128 out_z = _mm_add_ps(
+        _mm_add_ps(_mm_mul_ps(m[8], x), _mm_mul_ps(m[9], y)),
+        _mm_add_ps(_mm_mul_ps(m[10], z), m[11]));
+
+    _mm_storeu_ps(context.out_xs + i, out_x);
+    _mm_storeu_ps(context.out_ys + i, out_y);
+    _mm_storeu_ps(context.out_zs + i, out_z);
+  }
+  return i;
+}
+
+static inline size_t TransformBatchAVX2(
+    const BatchTransformContext& context) noexcept {
+  float w = context.is_point ? 1.F : 0.F;
+
+  __m256 m[12];
+  for (size_t k = 0; k < 12; ++k) {
+    float weight = (k % 4 == 3) ? w : 1.F;
+    m[k] = _mm256_set1_ps(context.matrix[k] * weight);
+  }
+
+  size_t i = 0;
+  for (; i + 8 <= context.count; i += 8) {
+    __m256 x = _mm256_loadu_ps(context.xs + i);
+    __m256 y = _mm256_loadu_ps(context.ys + i);
+    __m256 z = _mm256_loadu_ps(context.zs + i);
+
+    __m256 out_x = _mm256_fmadd_ps(
+        m[0], x, _mm256_fmadd_ps(m[1], y, _mm256_fmadd_ps(m[2], z, m[3])));
+    __m256 out_y = _mm256_fmadd_ps(
+        m[4], x, _mm256_fmadd_ps(m[5], y, _mm256_fmadd_ps(m[6], z, m[7])));
+    __m256 out_z = _mm256_fmadd_ps(
+        m[8], x, _mm256_fmadd_ps(m[9], y, _mm256_fmadd_ps(m[10], z, m[11])));
+
+    _mm256_storeu_ps(context.out_xs + i, out_x);
+    _mm256_storeu_ps(context.out_ys + i, out_y);
+    _mm256_storeu_ps(context.out_zs + i, out_z);
+  }
+  _mm256_zeroupper();
+  return i;
+}
+
+static inline size_t TransformBatchAVX512(
+    const BatchTransformContext& context) noexcept {
+  float w = context.is_point ? 1.F : 0.F;
+
+  __m512 m[12];
+  for (size_t k = 0; k < 12; ++k) {
+    float weight = (k % 4 == 3) ? w : 1.F;
+    m[k] = _mm512_set1_ps(context.matrix[k] * weight);
+  }
+
+  size_t i = 0;
+  for (; i + 16 <= context.count; i += 16) {
+    __m512 x = _mm512_loadu_ps(context.xs + i);
+    __m512 y = _mm512_loadu_ps(context.ys + i);
+    __m512 z = _mm512_loadu_ps(context.zs + i);
+
+    __m512 out_x = _mm512_fmadd_ps(
+        m[0], x, _mm512_fmadd_ps(m[1], y, _mm512_fmadd_ps(m[2], z, m[3])));
+    __m512 out_y = _mm512_fmadd_ps(
+        m[4], x, _mm512_fmadd_ps(m[5], y, _mm512_fmadd_ps(m[6], z, m[7])));
+    __m512 out_z = _mm512_fmadd_ps(
+        m[8], x, _mm512_fmadd_ps(m[9], y, _mm512_fmadd_ps(m[10], z, m[11])));
+
+    _mm512_storeu_ps(context.out_xs + i, out_x);
+    _mm512_storeu_ps(context.out_ys + i, out_y);
+    _mm512_storeu_ps(context.out_zs + i, out_z);
+  }
+  _mm256_zeroupper();
+  return i;
+}
+
+static inline void TransformBatch(
+    const BatchTransformContext& context) noexcept {
+  size_t processed = 0;
+  switch (GetIsaLevel()) {
+    case ISA_AVX512: {
+      processed = TransformBatchAVX512(context);
+      break;
+    }
+    case ISA_AVX2: {
+      processed = TransformBatchAVX2(context);
+      break;
+    }
+    default: {
+      processed = TransformBatchSSE(context);
+      break;
+    }
+  }
+  TransformBatchScalar(context, processed);
+}
+
+void TransformPoints(const Matrix& matrix, const float* xs, const float* ys,
+                     const float* zs, float* out_xs, float* out_ys,
+                     float* out_zs, size_t count) noexcept {
+  assert(matrix.rows == 4 && matrix.cols == 4);
+  TransformBatch({matrix, true, xs, ys, zs, out_xs, out_ys, out_zs, count});
+}
+
+void TransformVectors(const Matrix& matrix, const float* xs, const float* ys,
+                      const float* zs, float* out_xs, float* out_ys,
+                      float* out_zs, size_t count) noexcept {
+  assert(matrix.rows == 4 && matrix.cols == 4);
+  TransformBatch({matrix, false, xs, ys, zs, out_xs, out_ys, out_zs, count});
+}
+
+// NOTE: The fluent steps left-multiply by an elementary matrix, which only
+// touches a few rows of the receiver, so they are applied as row operations
+// instead of a full 4x4 product.
 Matrix Matrix::Translate(float x, float y, float z) const noexcept {
-  return ::Translate(x, y, z) * (*this);
+  Matrix res{*this};
+  res.row0 = _mm_add_ps(row0, _mm_mul_ps(_mm_set1_ps(x), row3));
+  res.row1 = _mm_add_ps(row1, _mm_mul_ps(_mm_set1_ps(y), row3));
+  res.row2 = _mm_add_ps(row2, _mm_mul_ps(_mm_set1_ps(z), row3));
+  return res;
 }
 
 Matrix Matrix::Scale(float x, float y, float z) const noexcept {
-  return ::Scale(x, y, z) * (*this);
+  Matrix res{*this};
+  res.row0 = _mm_mul_ps(_mm_set1_ps(x), row0);
+  res.row1 = _mm_mul_ps(_mm_set1_ps(y), row1);
+  res.row2 = _mm_mul_ps(_mm_set1_ps(z), row2);
+  return res;
+}
+
+static inline void RotateRows(__m128& row_a, __m128& row_b,
+                              const float radians) noexcept {
+  __m128 cos = _mm_set1_ps(std::cos(radians));
+  __m128 sin = _mm_set1_ps(std::sin(radians));
+  __m128 a = row_a;
+  row_a = _mm_sub_ps(_mm_mul_ps(cos, a), _mm_mul_ps(sin, row_b));
+  row_b = _mm_add_ps(_mm_mul_ps(sin, a), _mm_mul_ps(cos, row_b));
 }
 
 Matrix Matrix::RotateX(float radians) const noexcept {
-  return ::RotateX(radians) * (*this);
+  Matrix res{*this};
+  RotateRows(res.row1, res.row2, radians);
+  return res;
 }
 
 Matrix Matrix::RotateY(float radians) const noexcept {
-  return ::RotateY(radians) * (*this);
+  Matrix res{*this};
+  RotateRows(res.row2, res.row0, radians);
+  return res;
 }
 
 Matrix Matrix::RotateZ(float radians) const noexcept {
-  return ::RotateZ(radians) * (*this);
+  Matrix res{*this};
+  RotateRows(res.row0, res.row1, radians);
+  return res;
 }
 
 Matrix Matrix::Shear(ShearType shear_type) const noexcept {
-  return ::Shear(shear_type) * (*this);
+  Matrix res{*this};
+
+  switch (shear_type) {
+    case XY: {
+      res.row0 = _mm_add_ps(row0, row1);
+      break;
+    }
+    case XZ: {
+      res.row0 = _mm_add_ps(row0, row2);
+      break;
+    }
+    case YX: {
+      res.row1 = _mm_add_ps(row1, row0);
+      break;
+    }
+    case YZ: {
+      res.row1 = _mm_add_ps(row1, row2);
+      break;
+    }
+    case ZX: {
+      res.row2 = _mm_add_ps(row2, row0);
+      break;
+    }
+    case ZY: {
+      res.row2 = _mm_add_ps(row2, row1);
+      break;
+    }
+  }
+
+  return res;
 }
 
 Matrix Identity() noexcept {
@@ -281,28 +755,34 @@ Matrix Scale(float x, float y, float z) noexcept {
 
 Matrix RotateX(float radians) noexcept {
   Matrix matrix{Identity()};
-  matrix.m5 = std::cos(radians);
-  matrix.m6 = -std::sin(radians);
-  matrix.m9 = std::sin(radians);
-  matrix.m10 = std::cos(radians);
+  float cos = std::cos(radians);
+  float sin = std::sin(radians);
+  matrix.m5 = cos;
+  matrix.m6 = -sin;
+  matrix.m9 = sin;
+  matrix.m10 = cos;
   return matrix;
 }
 
 Matrix RotateY(float radians) noexcept {
   Matrix matrix{Identity()};
-  matrix.m0 = std::cos(radians);
-  matrix.m2 = std::sin(radians);
-  matrix.m8 = -std::sin(radians);
-  matrix.m10 = std::cos(radians);
+  float cos = std::cos(radians);
+  float sin = std::sin(radians);
+  matrix.m0 = cos;
+  matrix.m2 = sin;
+  matrix.m8 = -sin;
+  matrix.m10 = cos;
   return matrix;
 }
 
 Matrix RotateZ(float radians) noexcept {
   Matrix matrix{Identity()};
-  matrix.m0 = std::cos(radians);
-  matrix.m1 = -std::sin(radians);
-  matrix.m4 = std::sin(radians);
-  matrix.m5 = std::cos(radians);
+  float cos = std::cos(radians);
+  float sin = std::sin(radians);
+  matrix.m0 = cos;
+  matrix.m1 = -sin;
+  matrix.m4 = sin;
+  matrix.m5 = cos;
   return matrix;
 }
 
@@ -360,3 +840,15 @@ std::ostream& operator<<(std::ostream& os, const Matrix& m) {
   os << std::string(m);
   return os;
 }
+
+AffineTransform::operator std::string() const noexcept {
+  return std::format(
+      "AffineTransform(\n  {:.10f} {:.10f} {:.10f} {:.10f}\n"
+      "  {:.10f} {:.10f} {:.10f} {:.10f}\n  {:.10f} {:.10f} {:.10f} {:.10f})",
+      m0, m1, m2, m3, m4, m5, m6, m7, m8, m9, m10, m11);
+}
+
+std::ostream& operator<<(std::ostream& os, const AffineTransform& transform) {
+  os << std::string(transform);
+  return os;
+}
@@ -65,12 +65,15 @@ struct Matrix {
 
   void Populate(float* elements, size_t element_count) noexcept;
   constexpr bool IsValueInRange(size_t row, size_t col) const noexcept;
-  Matrix Transpose() noexcept;
+  Matrix Transpose() const noexcept;
   float Determinant() const noexcept;
   Matrix SubMatrix(size_t excluded_row, size_t excluded_col) const noexcept;
   float Minor(size_t row, size_t col) const noexcept;
   float Cofactor(size_t row, size_t col) const noexcept;
   Matrix Inverse() const noexcept;
+  Matrix CofactorInverse() const noexcept;
+  Matrix AffineInverse() const noexcept;
+  bool IsAffine() const noexcept;
 
   Matrix Translate(float x, float y, float z) const noexcept;
   Matrix Scale(float x, float y, float z) const noexcept;
@@ -93,6 +96,60 @@ Matrix Multiply(const Matrix& a, const Matrix& b) noexcept;
 
 static inline __m128 TupleMultiply() noexcept;
 
+// NOTE: Row-major 3x4 matrix with an implicit (0, 0, 0, 1) last row.
+struct AffineTransform {
+  union {
+    __m128 row0;
+    struct {
+      float m0, m1, m2, m3;
+    };
+  };
+
+  union {
+    __m128 row1;
+    struct {
+      float m4, m5, m6, m7;
+    };
+  };
+
+  union {
+    __m128 row2;
+    struct {
+      float m8, m9, m10, m11;
+    };
+  };
+
+  AffineTransform() noexcept;
+  AffineTransform(__m128 row0, __m128 row1, __m128 row2) noexcept;
+  explicit AffineTransform(const Matrix& matrix) noexcept;
+  AffineTransform(const AffineTransform& other) noexcept;
+  AffineTransform& operator=(const AffineTransform& other) noexcept;
+
+  AffineTransform operator*(const AffineTransform& other) const noexcept;
+  Vector operator*(const Vector& vector) const noexcept;
+  Point operator*(const Point& point) const noexcept;
+
+  bool operator==(const AffineTransform& other) const noexcept;
+  bool operator!=(const AffineTransform& other) const noexcept;
+
+  AffineTransform Inverse() const noexcept;
+  AffineTransform LinearTranspose() const noexcept;
+  Matrix ToMatrix() const noexcept;
+
+  operator std::string() const noexcept;
+};
+
+std::ostream& operator<<(std::ostream& os, const AffineTransform& transform);
+
+// NOTE: Transform `count` SoA points/vectors. Output arrays may alias the
+// input arrays exactly (in-place), but must not partially overlap them.
+void TransformPoints(const Matrix& matrix, const float* xs, const float* ys,
+                     const float* zs, float* out_xs, float* out_ys,
+                     float* out_zs, size_t count) noexcept;
+void TransformVectors(const Matrix& matrix, const float* xs, const float* ys,
+                      const float* zs, float* out_xs, float* out_ys,
+                      float* out_zs, size_t count) noexcept;
+
 Matrix Translate(float x, float y, float z) noexcept;
 Matrix Scale(float x, float y, float z) noexcept;
 Matrix RotateX(float radians) noexcept;
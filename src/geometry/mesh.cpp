@@ -0,0 +1,530 @@
+#include <core/arr.h>
+#include <core/cpu.h>
+#include <core/utils.h>
+#include <geometry/aabb.h>
+#include <geometry/bvh.h>
+#include <geometry/mesh.h>
+#include <geometry/point.h>
+#include <geometry/ray.h>
+#include <geometry/vector.h>
+#include <immintrin.h>
+
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <format>
+#include <string>
+#include <utility>
+
+TriangleMesh::TriangleMesh() noexcept : lane_stride(0) {}
+
+TriangleMesh::TriangleMesh(const TriangleMesh& other) noexcept
+    : vertex_xs(other.vertex_xs),
+      vertex_ys(other.vertex_ys),
+      vertex_zs(other.vertex_zs),
+      triangle_indices(other.triangle_indices),
+      material(other.material),
+      bvh(other.bvh),
+      lanes(other.lanes),
+      lane_stride(other.lane_stride) {}
+
+TriangleMesh& TriangleMesh::operator=(const TriangleMesh& other) noexcept {
+  if (this != &other) {
+    vertex_xs = other.vertex_xs;
+    vertex_ys = other.vertex_ys;
+    vertex_zs = other.vertex_zs;
+    triangle_indices = other.triangle_indices;
+    material = other.material;
+    bvh = other.bvh;
+    lanes = other.lanes;
+    lane_stride = other.lane_stride;
+  }
+  return *this;
+}
+
+size_t TriangleMesh::VertexCount() const noexcept { return vertex_xs.size; }
+
+size_t TriangleMesh::TriangleCount() const noexcept {
+  return triangle_indices.size / 3;
+}
+
+static inline void DropLayout(TriangleMesh* mesh) noexcept {
+  mesh->bvh.Clear();
+  mesh->lanes = DyArray<float>{};
+  mesh->lane_stride = 0;
+}
+
+uint32_t TriangleMesh::AddVertex(const Point& vertex) noexcept {
+  vertex_xs.Push(vertex.x);
+  vertex_ys.Push(vertex.y);
+  vertex_zs.Push(vertex.z);
+  DropLayout(this);
+  return static_cast<uint32_t>(vertex_xs.size - 1);
+}
+
+uint32_t TriangleMesh::AddTriangle(const uint32_t a, const uint32_t b,
+                                   const uint32_t c) noexcept {
+  triangle_indices.Push(a);
+  triangle_indices.Push(b);
+  triangle_indices.Push(c);
+  DropLayout(this);
+  return static_cast<uint32_t>(TriangleCount() - 1);
+}
+
+Point TriangleMesh::Vertex(const uint32_t vertex_id) const noexcept {
+  return {vertex_xs[vertex_id], vertex_ys[vertex_id], vertex_zs[vertex_id]};
+}
+
+Aabb TriangleMesh::TriangleBounds(const uint32_t triangle_id) const noexcept {
+  Aabb bounds;
+  for (size_t corner = 0; corner < 3; ++corner) {
+    bounds.Grow(Vertex(triangle_indices[3 * triangle_id + corner]));
+  }
+  return bounds;
+}
+
+static inline float* LaneRow(TriangleMesh* mesh,
+                             const TriangleLane row) noexcept {
+  return mesh->lanes.data.get() + row * mesh->lane_stride;
+}
+
+static inline const float* LaneRow(const TriangleMesh& mesh,
+                                   const TriangleLane row) noexcept {
+  return mesh.lanes.data.get() + row * mesh.lane_stride;
+}
+
+void TriangleMesh::Build() noexcept {
+  size_t count = TriangleCount();
+  bvh.Clear();
+  if (count > MESH_FLAT_TRIANGLE_COUNT) {
+    DyArray<Aabb> bounds{count};
+    for (size_t i = 0; i < count; ++i) {
+      bounds[i] = TriangleBounds(static_cast<uint32_t>(i));
+    }
+    bvh.Build(bounds.data.get(), count);
+  }
+
+  lane_stride = count + MESH_LANE_PADDING;
+  lanes = DyArray<float>{LANE_COUNT * lane_stride};
+  float* rows[LANE_COUNT];
+  for (size_t row = 0; row < LANE_COUNT; ++row) {
+    rows[row] = LaneRow(this, static_cast<TriangleLane>(row));
+  }
+
+  for (size_t lane = 0; lane < count; ++lane) {
+    uint32_t triangle_id =
+        bvh.IsBuilt() ? bvh.indices[lane] : static_cast<uint32_t>(lane);
+    Point a{Vertex(triangle_indices[3 * triangle_id])};
+    Point b{Vertex(triangle_indices[3 * triangle_id + 1])};
+    Point c{Vertex(triangle_indices[3 * triangle_id + 2])};
+    rows[LANE_V0_X][lane] = a.x;
+    rows[LANE_V0_Y][lane] = a.y;
+    rows[LANE_V0_Z][lane] = a.z;
+    rows[LANE_EDGE1_X][lane] = b.x - a.x;
+    rows[LANE_EDGE1_Y][lane] = b.y - a.y;
+    rows[LANE_EDGE1_Z][lane] = b.z - a.z;
+    rows[LANE_EDGE2_X][lane] = c.x - a.x;
+    rows[LANE_EDGE2_Y][lane] = c.y - a.y;
+    rows[LANE_EDGE2_Z][lane] = c.z - a.z;
+  }
+}
+
+void TriangleMesh::Clear() noexcept {
+  vertex_xs = DyArray<float>{};
+  vertex_ys = DyArray<float>{};
+  vertex_zs = DyArray<float>{};
+  triangle_indices = DyArray<uint32_t>{};
+  DropLayout(this);
+}
+
+bool TriangleMesh::IsBuilt() const noexcept { return lanes.size > 0; }
+
+size_t TriangleMesh::MemoryUsage() const noexcept {
+  return (vertex_xs.capacity + vertex_ys.capacity + vertex_zs.capacity +
+          lanes.capacity) *
+             sizeof(float) +
+         triangle_indices.capacity * sizeof(uint32_t) + bvh.MemoryUsage();
+}
+
+// NOTE: The ray broadcast to every lane, once per query.
+struct TriangleRaySSE {
+  __m128 origin_x;
+  __m128 origin_y;
+  __m128 origin_z;
+  __m128 direction_x;
+  __m128 direction_y;
+  __m128 direction_z;
+};
+
+struct TriangleRayAVX2 {
+  __m256 origin_x;
+  __m256 origin_y;
+  __m256 origin_z;
+  __m256 direction_x;
+  __m256 direction_y;
+  __m256 direction_z;
+};
+
+// NOTE: Row pointers of a lane layout, resolved once per query.
+struct TriangleLaneRows {
+  const float* rows[LANE_COUNT];
+};
+
+static inline TriangleLaneRows MakeLaneRows(
+    const TriangleMesh& mesh) noexcept {
+  TriangleLaneRows rows;
+  for (size_t row = 0; row < LANE_COUNT; ++row) {
+    rows.rows[row] = LaneRow(mesh, static_cast<TriangleLane>(row));
+  }
+  return rows;
+}
+
+// NOTE: Ray registers for whichever kernels the active ISA level runs;
+// the AVX2 ones are only set up when is_wide.
+struct TriangleRays {
+  TriangleRaySSE sse;
+  TriangleRayAVX2 avx2;
+  bool is_wide;
+};
+
+static inline TriangleRays MakeTriangleRays(const Ray& ray) noexcept {
+  TriangleRays rays;
+  rays.sse = {_mm_set1_ps(ray.origin.x),    _mm_set1_ps(ray.origin.y),
+              _mm_set1_ps(ray.origin.z),    _mm_set1_ps(ray.direction.x),
+              _mm_set1_ps(ray.direction.y), _mm_set1_ps(ray.direction.z)};
+  rays.is_wide = GetIsaLevel() >= ISA_AVX2;
+  if (rays.is_wide) {
+    rays.avx2 = {_mm256_set1_ps(ray.origin.x),
+                 _mm256_set1_ps(ray.origin.y),
+                 _mm256_set1_ps(ray.origin.z),
+                 _mm256_set1_ps(ray.direction.x),
+                 _mm256_set1_ps(ray.direction.y),
+                 _mm256_set1_ps(ray.direction.z)};
+  }
+  return rays;
+}
+
+// NOTE: Moller-Trumbore on the 4 lanes from first. Only multiplies, adds
+// and subtracts in a fixed order, never fused, so every kernel width gives
+// the same result. Returns the mask of hit lanes, with their distances in
+// ts.
+static inline uint32_t IntersectBlockSSE(const TriangleLaneRows& lanes,
+                                         const TriangleRaySSE& ray,
+                                         const size_t first, const float tmin,
+                                         const float tmax,
+                                         float* ts) noexcept {
+  __m128 v0x = _mm_loadu_ps(lanes.rows[LANE_V0_X] + first);
+  __m128 v0y = _mm_loadu_ps(lanes.rows[LANE_V0_Y] + first);
+  __m128 v0z = _mm_loadu_ps(lanes.rows[LANE_V0_Z] + first);
+  __m128 e1x = _mm_loadu_ps(lanes.rows[LANE_EDGE1_X] + first);
+  __m128 e1y = _mm_loadu_ps(lanes.rows[LANE_EDGE1_Y] + first);
+  __m128 e1z = _mm_loadu_ps(lanes.rows[LANE_EDGE1_Z] + first);
+  __m128 e2x = _mm_loadu_ps(lanes.rows[LANE_EDGE2_X] + first);
+  __m128 e2y = _mm_loadu_ps(lanes.rows[LANE_EDGE2_Y] + first);
+  __m128 e2z = _mm_loadu_ps(lanes.rows[LANE_EDGE2_Z] + first);
+  const __m128& dx = ray.direction_x;
+  const __m128& dy = ray.direction_y;
+  const __m128& dz = ray.direction_z;
+
+  __m128 px = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+  __m128 py = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+  __m128 pz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+  __m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)),
+                          _mm_mul_ps(e1z, pz));
+  __m128 abs_det = _mm_andnot_ps(_mm_set1_ps(-0.F), det);
+  __m128 inverse_det = _mm_div_ps(_mm_set1_ps(1.F), det);
+
+  __m128 tx = _mm_sub_ps(ray.origin_x, v0x);
+  __m128 ty = _mm_sub_ps(ray.origin_y, v0y);
+  __m128 tz = _mm_sub_ps(ray.origin_z, v0z);
+  __m128 u = _mm_mul_ps(
+      _mm_add_ps(_mm_add_ps(_mm_mul_ps(tx, px), _mm_mul_ps(ty, py)),
+                 _mm_mul_ps(tz, pz)),
+      inverse_det);
+
+  __m128 qx = _mm_sub_ps(_mm_mul_ps(ty, e1z), _mm_mul_ps(tz, e1y));
+  __m128 qy = _mm_sub_ps(_mm_mul_ps(tz, e1x), _mm_mul_ps(tx, e1z));
+  __m128 qz = _mm_sub_ps(_mm_mul_ps(tx, e1y), _mm_mul_ps(ty, e1x));
+  __m128 v = _mm_mul_ps(
+      _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)),
+                 _mm_mul_ps(dz, qz)),
+      inverse_det);
+  __m128 t = _mm_mul_ps(
+      _mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)),
+                 _mm_mul_ps(e2z, qz)),
+      inverse_det);
+
+  __m128 zero = _mm_setzero_ps();
+  __m128 hit = _mm_cmpgt_ps(abs_det, _mm_set1_ps(TRIANGLE_EPSILON));
+  hit = _mm_and_ps(hit, _mm_cmpge_ps(u, zero));
+  hit = _mm_and_ps(hit, _mm_cmpge_ps(v, zero));
+  hit = _mm_and_ps(hit, _mm_cmple_ps(_mm_add_ps(u, v), _mm_set1_ps(1.F)));
+  hit = _mm_and_ps(hit, _mm_cmpge_ps(t, _mm_set1_ps(tmin)));
+  hit = _mm_and_ps(hit, _mm_cmplt_ps(t, _mm_set1_ps(tmax)));
+
+  _mm_storeu_ps(ts, t);
+  return static_cast<uint32_t>(_mm_movemask_ps(hit));
+}
+
+static inline uint32_t IntersectBlockAVX2(const TriangleLaneRows& lanes,
+                                          const TriangleRayAVX2& ray,
+                                          const size_t first, const float tmin,
+                                          const float tmax,
+                                          float* ts) noexcept {
+  __m256 v0x = _mm256_loadu_ps(lanes.rows[LANE_V0_X] + first);
+  __m256 v0y = _mm256_loadu_ps(lanes.rows[LANE_V0_Y] + first);
+  __m256 v0z = _mm256_loadu_ps(lanes.rows[LANE_V0_Z] + first);
+  __m256 e1x = _mm256_loadu_ps(lanes.rows[LANE_EDGE1_X] + first);
+  __m256 e1y = _mm256_loadu_ps(lanes.rows[LANE_EDGE1_Y] + first);
+  __m256 e1z = _mm256_loadu_ps(lanes.rows[LANE_EDGE1_Z] + first);
+  __m256 e2x = _mm256_loadu_ps(lanes.rows[LANE_EDGE2_X] + first);
+  __m256 e2y = _mm256_loadu_ps(lanes.rows[LANE_EDGE2_Y] + first);
+  __m256 e2z = _mm256_loadu_ps(lanes.rows[LANE_EDGE2_Z] + first);
+  const __m256& dx = ray.direction_x;
+  const __m256& dy = ray.direction_y;
+  const __m256& dz = ray.direction_z;
+
+  __m256 px = _mm256_sub_ps(_mm256_mul_ps(dy, e2z), _mm256_mul_ps(dz, e2y));
+  __m256 py = _mm256_sub_ps(_mm256_mul_ps(dz, e2x), _mm256_mul_ps(dx, e2z));
+  __m256 pz = _mm256_sub_ps(_mm256_mul_ps(dx, e2y), _mm256_mul_ps(dy, e2x));
+  __m256 det = _mm256_add_ps(
+      _mm256_add_ps(_mm256_mul_ps(e1x, px), _mm256_mul_ps(e1y, py)),
+      _mm256_mul_ps(e1z, pz));
+  __m256 abs_det = _mm256_andnot_ps(_mm256_set1_ps(-0.F), det);
+  __m256 inverse_det = _mm256_div_ps(_mm256_set1_ps(1.F), det);
+
+  __m256 tx = _mm256_sub_ps(ray.origin_x, v0x);
+  __m256 ty = _mm256_sub_ps(ray.origin_y, v0y);
+  __m256 tz = _mm256_sub_ps(ray.origin_z, v0z);
+  __m256 u = _mm256_mul_ps(
+      _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(tx, px), _mm256_mul_ps(ty, py)),
+                    _mm256_mul_ps(tz, pz)),
+      inverse_det);
+
+  __m256 qx = _mm256_sub_ps(_mm256_mul_ps(ty, e1z), _mm256_mul_ps(tz, e1y));
+  __m256 qy = _mm256_sub_ps(_mm256_mul_ps(tz, e1x), _mm256_mul_ps(tx, e1z));
+  __m256 qz = _mm256_sub_ps(_mm256_mul_ps(tx, e1y), _mm256_mul_ps(ty, e1x));
+  __m256 v = _mm256_mul_ps(
+      _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, qx), _mm256_mul_ps(dy, qy)),
+                    _mm256_mul_ps(dz, qz)),
+      inverse_det);
+  __m256 t = _mm256_mul_ps(
+      _mm256_add_ps(
+          _mm256_add_ps(_mm256_mul_ps(e2x, qx), _mm256_mul_ps(e2y, qy)),
+          _mm256_mul_ps(e2z, qz)),
+      inverse_det);
+
+  __m256 zero = _mm256_setzero_ps();
+  __m256 hit =
+      _mm256_cmp_ps(abs_det, _mm256_set1_ps(TRIANGLE_EPSILON), _CMP_GT_OQ);
+  hit = _mm256_and_ps(hit, _mm256_cmp_ps(u, zero, _CMP_GE_OQ));
+  hit = _mm256_and_ps(hit, _mm256_cmp_ps(v, zero, _CMP_GE_OQ));
+  hit = _mm256_and_ps(hit, _mm256_cmp_ps(_mm256_add_ps(u, v),
+                                         _mm256_set1_ps(1.F), _CMP_LE_OQ));
+  hit = _mm256_and_ps(hit,
+                      _mm256_cmp_ps(t, _mm256_set1_ps(tmin), _CMP_GE_OQ));
+  hit = _mm256_and_ps(hit,
+                      _mm256_cmp_ps(t, _mm256_set1_ps(tmax), _CMP_LT_OQ));
+
+  _mm256_storeu_ps(ts, t);
+  return static_cast<uint32_t>(_mm256_movemask_ps(hit));
+}
+
+// NOTE: Runs the triangle through lane 0 of the SSE kernel rather than a
+// scalar copy of it, which the compiler would be free to contract into
+// fused multiply-adds and so round differently.
+bool IntersectTriangle(const Ray& ray, const Point& a, const Point& b,
+                       const Point& c, const float tmin,
+                       float* tmax) noexcept {
+  float corners[LANE_COUNT] = {a.x,       a.y,       a.z,
+                               b.x - a.x, b.y - a.y, b.z - a.z,
+                               c.x - a.x, c.y - a.y, c.z - a.z};
+  float lane_rows[LANE_COUNT][4] = {};
+  TriangleLaneRows lanes;
+  for (size_t row = 0; row < LANE_COUNT; ++row) {
+    lane_rows[row][0] = corners[row];
+    lanes.rows[row] = lane_rows[row];
+  }
+
+  TriangleRaySSE rays{
+      _mm_set1_ps(ray.origin.x),    _mm_set1_ps(ray.origin.y),
+      _mm_set1_ps(ray.origin.z),    _mm_set1_ps(ray.direction.x),
+      _mm_set1_ps(ray.direction.y), _mm_set1_ps(ray.direction.z)};
+  float ts[4];
+  if ((IntersectBlockSSE(lanes, rays, 0, tmin, *tmax, ts) & 1) == 0) {
+    return false;
+  }
+  *tmax = ts[0];
+  return true;
+}
+
+// NOTE: Keeps the nearest of the hit lanes in mask; the lowest lane wins a
+// tie, as in a scalar loop over the same lanes.
+static inline uint32_t NearestLane(uint32_t mask, const float* ts,
+                                   float* tmax) noexcept {
+  uint32_t nearest = NO_HIT_ID;
+  while (mask != 0) {
+    uint32_t lane = static_cast<uint32_t>(std::countr_zero(mask));
+    mask &= mask - 1;
+    if (ts[lane] < *tmax) {
+      *tmax = ts[lane];
+      nearest = lane;
+    }
+  }
+  return nearest;
+}
+
+// NOTE: Tests lanes [first, first + count): 8 at a time while more than 4
+// remain on AVX2 and up, then 4 at a time. Returns the lane of the nearest
+// hit that shrank *tmax, or NO_HIT_ID.
+static inline uint32_t IntersectLanes(const TriangleLaneRows& lanes,
+                                      const TriangleRays& rays,
+                                      const size_t first, const size_t count,
+                                      const float tmin, float* tmax) noexcept {
+  uint32_t nearest = NO_HIT_ID;
+  float ts[8];
+  size_t i = 0;
+  if (rays.is_wide) {
+    for (; i + 4 < count; i += 8) {
+      uint32_t lane_mask = (1U << Min(count - i, 8)) - 1;
+      uint32_t mask =
+          IntersectBlockAVX2(lanes, rays.avx2, first + i, tmin, *tmax, ts) &
+          lane_mask;
+      uint32_t lane = NearestLane(mask, ts, tmax);
+      if (lane != NO_HIT_ID) {
+        nearest = static_cast<uint32_t>(first + i + lane);
+      }
+    }
+  }
+  for (; i < count; i += 4) {
+    uint32_t lane_mask = (1U << Min(count - i, 4)) - 1;
+    uint32_t mask =
+        IntersectBlockSSE(lanes, rays.sse, first + i, tmin, *tmax, ts) &
+        lane_mask;
+    uint32_t lane = NearestLane(mask, ts, tmax);
+    if (lane != NO_HIT_ID) {
+      nearest = static_cast<uint32_t>(first + i + lane);
+    }
+  }
+  return nearest;
+}
+
+static inline bool IsLaneRangeOccluded(const TriangleLaneRows& lanes,
+                                       const TriangleRays& rays,
+                                       const size_t first, const size_t count,
+                                       const float tmin,
+                                       const float tmax) noexcept {
+  float ts[8];
+  size_t i = 0;
+  if (rays.is_wide) {
+    for (; i + 4 < count; i += 8) {
+      uint32_t lane_mask = (1U << Min(count - i, 8)) - 1;
+      if ((IntersectBlockAVX2(lanes, rays.avx2, first + i, tmin, tmax, ts) &
+           lane_mask) != 0) {
+        return true;
+      }
+    }
+  }
+  for (; i < count; i += 4) {
+    uint32_t lane_mask = (1U << Min(count - i, 4)) - 1;
+    if ((IntersectBlockSSE(lanes, rays.sse, first + i, tmin, tmax, ts) &
+         lane_mask) != 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static inline uint32_t LaneTriangle(const TriangleMesh& mesh,
+                                    const uint32_t lane) noexcept {
+  return mesh.bvh.IsBuilt() ? mesh.bvh.indices[lane] : lane;
+}
+
+static inline bool IntersectMeshTriangle(const TriangleMesh& mesh,
+                                         const Ray& ray,
+                                         const uint32_t triangle_id,
+                                         const float tmin,
+                                         float* tmax) noexcept {
+  const uint32_t* corners = &mesh.triangle_indices[3 * triangle_id];
+  return IntersectTriangle(ray, mesh.Vertex(corners[0]),
+                           mesh.Vertex(corners[1]), mesh.Vertex(corners[2]),
+                           tmin, tmax);
+}
+
+// NOTE: Bvh::Traverse with every leaf handed to the SIMD kernel as one run
+// of lanes.
+HitRecord TriangleMesh::ClosestHit(const Ray& ray, const float tmin,
+                                   const float tmax) const noexcept {
+  HitRecord record{NO_HIT_ID, tmax};
+  if (!IsBuilt()) {
+    for (size_t i = 0; i < TriangleCount(); ++i) {
+      uint32_t triangle_id = static_cast<uint32_t>(i);
+      if (IntersectMeshTriangle(*this, ray, triangle_id, tmin, &record.t)) {
+        record.object_id = triangle_id;
+      }
+    }
+    return record;
+  }
+
+  TriangleRays rays{MakeTriangleRays(ray)};
+  TriangleLaneRows lanes{MakeLaneRows(*this)};
+  if (!bvh.IsBuilt()) {
+    uint32_t lane =
+        IntersectLanes(lanes, rays, 0, TriangleCount(), tmin, &record.t);
+    record.object_id = lane;
+    return record;
+  }
+
+  bvh.Traverse(ray, tmin, &record.t,
+               [&](uint32_t first, uint32_t count, float* t_hit) {
+                 uint32_t lane =
+                     IntersectLanes(lanes, rays, first, count, tmin, t_hit);
+                 if (lane != NO_HIT_ID) {
+                   record.object_id = LaneTriangle(*this, lane);
+                 }
+               });
+  return record;
+}
+
+bool TriangleMesh::IsOccluded(const Ray& ray, const float tmin,
+                              const float tmax) const noexcept {
+  if (!IsBuilt()) {
+    for (size_t i = 0; i < TriangleCount(); ++i) {
+      float t_hit = tmax;
+      if (IntersectMeshTriangle(*this, ray, static_cast<uint32_t>(i), tmin,
+                                &t_hit)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  TriangleRays rays{MakeTriangleRays(ray)};
+  TriangleLaneRows lanes{MakeLaneRows(*this)};
+  if (!bvh.IsBuilt()) {
+    return IsLaneRangeOccluded(lanes, rays, 0, TriangleCount(), tmin, tmax);
+  }
+
+  return bvh.AnyLeaf(ray, tmin, tmax, [&](uint32_t first, uint32_t count) {
+    return IsLaneRangeOccluded(lanes, rays, first, count, tmin, tmax);
+  });
+}
+
+Vector TriangleMesh::NormalAt(const uint32_t triangle_id) const noexcept {
+  Point a{Vertex(triangle_indices[3 * triangle_id])};
+  Point b{Vertex(triangle_indices[3 * triangle_id + 1])};
+  Point c{Vertex(triangle_indices[3 * triangle_id + 2])};
+  return CrossProduct(b - a, c - a).Normalize();
+}
+
+TriangleMesh::operator std::string() const noexcept {
+  return std::format("TriangleMesh(vertices={}, triangles={}, bvh={}, "
+                     "bytes={})",
+                     VertexCount(), TriangleCount(), std::string(bvh),
+                     MemoryUsage());
+}
+
+std::ostream& operator<<(std::ostream& os, const TriangleMesh& mesh) {
+  os << std::string(mesh);
+  return os;
+}
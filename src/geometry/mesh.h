@@ -0,0 +1,94 @@
+#ifndef SRC_GEOMETRY_MESH_H_
+#define SRC_GEOMETRY_MESH_H_
+
+#include <core/arr.h>
+#include <geometry/aabb.h>
+#include <geometry/bvh.h>
+#include <geometry/point.h>
+#include <geometry/ray.h>
+#include <geometry/vector.h>
+#include <render/material.h>
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+
+// NOTE: Each lane row is padded by this many zeroed lanes so the 8-wide
+// kernel can always load a whole register past the last triangle.
+#define MESH_LANE_PADDING 8
+// NOTE: Meshes of up to this many triangles skip the hierarchy and test
+// every triangle with the wide kernel, which is cheaper at that size.
+#define MESH_FLAT_TRIANGLE_COUNT 32
+// NOTE: Rays whose determinant is within this of zero run parallel to the
+// triangle plane and miss.
+#define TRIANGLE_EPSILON 1e-12F
+
+// NOTE: Rows of TriangleMesh::lanes: per triangle the first vertex and the
+// two edges leaving it, as Moller-Trumbore consumes them.
+enum TriangleLane {
+  LANE_V0_X,
+  LANE_V0_Y,
+  LANE_V0_Z,
+  LANE_EDGE1_X,
+  LANE_EDGE1_Y,
+  LANE_EDGE1_Z,
+  LANE_EDGE2_X,
+  LANE_EDGE2_Y,
+  LANE_EDGE2_Z,
+  LANE_COUNT
+};
+
+// NOTE: Indexed triangle mesh in world space. Vertex positions live in SoA
+// buffers and every triangle names three of them, counter-clockwise when
+// seen from the front; both sides are hit. Build prepares the query layout:
+// a Bvh over the triangle bounds, and lanes, the triangles in leaf order so
+// each leaf is one contiguous run the SIMD kernel tests at once. Adding
+// vertices or triangles drops that layout until the next Build, and until
+// then queries fall back to testing every triangle one at a time.
+struct TriangleMesh {
+  DyArray<float> vertex_xs;
+  DyArray<float> vertex_ys;
+  DyArray<float> vertex_zs;
+  DyArray<uint32_t> triangle_indices;
+  Material material;
+  Bvh bvh;
+  // NOTE: LANE_COUNT rows of lane_stride floats; empty until Build.
+  DyArray<float> lanes;
+  size_t lane_stride;
+
+  TriangleMesh() noexcept;
+  TriangleMesh(const TriangleMesh& other) noexcept;
+  TriangleMesh& operator=(const TriangleMesh& other) noexcept;
+
+  size_t VertexCount() const noexcept;
+  size_t TriangleCount() const noexcept;
+  uint32_t AddVertex(const Point& vertex) noexcept;
+  uint32_t AddTriangle(uint32_t a, uint32_t b, uint32_t c) noexcept;
+  Point Vertex(uint32_t vertex_id) const noexcept;
+  Aabb TriangleBounds(uint32_t triangle_id) const noexcept;
+
+  void Build() noexcept;
+  void Clear() noexcept;
+  bool IsBuilt() const noexcept;
+  size_t MemoryUsage() const noexcept;
+
+  // NOTE: object_id of the result is the triangle id, the position of its
+  // three indices in triangle_indices divided by three.
+  HitRecord ClosestHit(const Ray& ray, float tmin, float tmax) const noexcept;
+  bool IsOccluded(const Ray& ray, float tmin, float tmax) const noexcept;
+  // NOTE: Geometric normal, facing the side the triangle winds
+  // counter-clockwise on.
+  Vector NormalAt(uint32_t triangle_id) const noexcept;
+
+  operator std::string() const noexcept;
+};
+
+std::ostream& operator<<(std::ostream& os, const TriangleMesh& mesh);
+
+// NOTE: Single-triangle Moller-Trumbore test with tmin <= t < tmax; on a hit
+// *tmax becomes the hit distance. Runs the same kernel as a built mesh, so
+// both agree bit for bit.
+bool IntersectTriangle(const Ray& ray, const Point& a, const Point& b,
+                       const Point& c, float tmin, float* tmax) noexcept;
+
+#endif  // SRC_GEOMETRY_MESH_H_
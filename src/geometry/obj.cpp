@@ -0,0 +1,264 @@
+#include <core/arr.h>
+#include <core/file_io.h>
+#include <core/thread_pool.h>
+#include <core/utils.h>
+#include <geometry/mesh.h>
+#include <geometry/obj.h>
+
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <system_error>
+
+struct ObjChunk {
+  const char* begin;
+  const char* end;
+  size_t vertex_count;
+  size_t triangle_count;
+  // NOTE: Where the chunk's output starts, once the counts are prefixed.
+  size_t first_vertex;
+  size_t first_triangle;
+  bool is_valid;
+};
+
+struct ObjParseContext {
+  TriangleMesh* mesh;
+  ObjChunk* chunks;
+  size_t chunk_count;
+  size_t vertex_count;
+  bool is_valid;
+};
+
+static inline bool IsBlank(const char c) noexcept {
+  return c == ' ' || c == '\t' || c == '\r';
+}
+
+static inline const char* SkipBlanks(const char* p, const char* end) noexcept {
+  while (p < end && IsBlank(*p)) {
+    ++p;
+  }
+  return p;
+}
+
+static inline const char* SkipToken(const char* p, const char* end) noexcept {
+  while (p < end && !IsBlank(*p)) {
+    ++p;
+  }
+  return p;
+}
+
+static inline const char* LineEnd(const char* p, const char* end) noexcept {
+  const char* newline =
+      static_cast<const char*>(memchr(p, '\n', static_cast<size_t>(end - p)));
+  return newline != nullptr ? newline : end;
+}
+
+// NOTE: True when the line at p starts with the one-letter statement
+// keyword, such as "v" but not "vt" or "vn".
+static inline bool IsStatement(const char* p, const char* line_end,
+                               const char keyword) noexcept {
+  return line_end - p >= 2 && p[0] == keyword && IsBlank(p[1]);
+}
+
+static inline size_t CountTokens(const char* p, const char* line_end) noexcept {
+  size_t token_count = 0;
+  p = SkipBlanks(p, line_end);
+  while (p < line_end) {
+    ++token_count;
+    p = SkipBlanks(SkipToken(p, line_end), line_end);
+  }
+  return token_count;
+}
+
+static void CountChunk(ObjChunk* chunk) noexcept {
+  for (const char* line = chunk->begin; line < chunk->end;) {
+    const char* line_end = LineEnd(line, chunk->end);
+    const char* p = SkipBlanks(line, line_end);
+    if (IsStatement(p, line_end, 'v')) {
+      ++chunk->vertex_count;
+    } else if (IsStatement(p, line_end, 'f')) {
+      size_t corner_count = CountTokens(p + 1, line_end);
+      if (corner_count >= 3) {
+        chunk->triangle_count += corner_count - 2;
+      }
+    }
+    line = line_end + 1;
+  }
+}
+
+static inline const char* ParseFloat(const char* p, const char* line_end,
+                                     float* value) noexcept {
+  p = SkipBlanks(p, line_end);
+  if (p < line_end && *p == '+') {
+    ++p;
+  }
+  std::from_chars_result result = std::from_chars(p, line_end, *value);
+  return result.ec == std::errc{} ? result.ptr : nullptr;
+}
+
+// NOTE: Resolves one face corner, "v", "v/vt", "v//vn" or "v/vt/vn", to a
+// vertex id. Negative indices count back from the last vertex defined so
+// far; zero and indices past the whole vertex list are invalid.
+static inline const char* ParseCorner(const char* p, const char* line_end,
+                                      const size_t vertices_so_far,
+                                      const size_t vertex_count,
+                                      uint32_t* vertex_id) noexcept {
+  int64_t index = 0;
+  std::from_chars_result result = std::from_chars(p, line_end, index);
+  if (result.ec != std::errc{} ||
+      (result.ptr < line_end && !IsBlank(*result.ptr) && *result.ptr != '/')) {
+    return nullptr;
+  }
+
+  int64_t resolved = index > 0
+                         ? index - 1
+                         : static_cast<int64_t>(vertices_so_far) + index;
+  if (index == 0 || resolved < 0 ||
+      resolved >= static_cast<int64_t>(vertex_count)) {
+    return nullptr;
+  }
+  *vertex_id = static_cast<uint32_t>(resolved);
+  return SkipToken(result.ptr, line_end);
+}
+
+static void ParseChunk(ObjParseContext* context, ObjChunk* chunk) noexcept {
+  TriangleMesh* mesh = context->mesh;
+  size_t vertex_idx = chunk->first_vertex;
+  uint32_t* indices = mesh->triangle_indices.data.get() +
+                      3 * chunk->first_triangle;
+
+  for (const char* line = chunk->begin; line < chunk->end;) {
+    const char* line_end = LineEnd(line, chunk->end);
+    const char* p = SkipBlanks(line, line_end);
+
+    if (IsStatement(p, line_end, 'v')) {
+      float x = 0;
+      float y = 0;
+      float z = 0;
+      p = ParseFloat(p + 1, line_end, &x);
+      p = p != nullptr ? ParseFloat(p, line_end, &y) : nullptr;
+      p = p != nullptr ? ParseFloat(p, line_end, &z) : nullptr;
+      if (p == nullptr) {
+        chunk->is_valid = false;
+        return;
+      }
+      mesh->vertex_xs[vertex_idx] = x;
+      mesh->vertex_ys[vertex_idx] = y;
+      mesh->vertex_zs[vertex_idx] = z;
+      ++vertex_idx;
+    } else if (IsStatement(p, line_end, 'f')) {
+      // NOTE: Fans the face around its first corner: (0, 1, 2), (0, 2, 3)...
+      uint32_t first_corner = 0;
+      uint32_t previous_corner = 0;
+      size_t corner_idx = 0;
+      p = SkipBlanks(p + 1, line_end);
+      while (p < line_end) {
+        uint32_t corner = 0;
+        p = ParseCorner(p, line_end, vertex_idx, context->vertex_count,
+                        &corner);
+        if (p == nullptr) {
+          chunk->is_valid = false;
+          return;
+        }
+        if (corner_idx == 0) {
+          first_corner = corner;
+        } else if (corner_idx >= 2) {
+          indices[0] = first_corner;
+          indices[1] = previous_corner;
+          indices[2] = corner;
+          indices += 3;
+        }
+        previous_corner = corner;
+        ++corner_idx;
+        p = SkipBlanks(p, line_end);
+      }
+    }
+    line = line_end + 1;
+  }
+}
+
+// NOTE: Runs between the counting and parsing passes, on the calling
+// thread.
+static void PlaceChunks(ObjParseContext* context) {
+  size_t vertex_count = 0;
+  size_t triangle_count = 0;
+  for (size_t i = 0; i < context->chunk_count; ++i) {
+    context->chunks[i].first_vertex = vertex_count;
+    context->chunks[i].first_triangle = triangle_count;
+    vertex_count += context->chunks[i].vertex_count;
+    triangle_count += context->chunks[i].triangle_count;
+  }
+
+  // NOTE: Vertex ids are 32-bit, and so must the count of them be.
+  context->vertex_count = vertex_count;
+  context->is_valid = vertex_count <= UINT32_MAX;
+  if (context->is_valid) {
+    TriangleMesh* mesh = context->mesh;
+    mesh->vertex_xs = DyArray<float>{vertex_count};
+    mesh->vertex_ys = DyArray<float>{vertex_count};
+    mesh->vertex_zs = DyArray<float>{vertex_count};
+    mesh->triangle_indices = DyArray<uint32_t>{3 * triangle_count};
+  }
+}
+
+bool ParseObj(const char* source, const size_t size, size_t thread_count,
+              TriangleMesh* mesh) noexcept {
+  mesh->Clear();
+
+  ThreadPool* pool = RenderPool();
+  if (thread_count == 0) {
+    thread_count = pool->thread_count;
+  }
+  size_t chunk_count = Clamp(size / OBJ_MIN_CHUNK_SIZE, 1, thread_count);
+
+  // NOTE: Chunk boundaries move forward to the next line start, so no line
+  // is split between two workers.
+  std::unique_ptr<ObjChunk[]> chunks =
+      std::make_unique<ObjChunk[]>(chunk_count);
+  const char* end = source + size;
+  const char* begin = source;
+  for (size_t i = 0; i < chunk_count; ++i) {
+    const char* chunk_end = end;
+    if (i + 1 < chunk_count) {
+      chunk_end = source + size * (i + 1) / chunk_count;
+      chunk_end = chunk_end > begin ? chunk_end : begin;
+      chunk_end = chunk_end < end ? LineEnd(chunk_end, end) + 1 : end;
+      chunk_end = chunk_end < end ? chunk_end : end;
+    }
+    chunks[i] = {begin, chunk_end, 0, 0, 0, 0, true};
+    begin = chunk_end;
+  }
+
+  ObjParseContext context{mesh, chunks.get(), chunk_count, 0, true};
+  pool->Run(
+      [&context](size_t chunk_idx) { CountChunk(&context.chunks[chunk_idx]); },
+      chunk_count);
+  PlaceChunks(&context);
+  if (context.is_valid) {
+    pool->Run(
+        [&context](size_t chunk_idx) {
+          ParseChunk(&context, &context.chunks[chunk_idx]);
+        },
+        chunk_count);
+  }
+
+  bool is_valid = context.is_valid;
+  for (size_t i = 0; i < chunk_count; ++i) {
+    is_valid = is_valid && chunks[i].is_valid;
+  }
+  if (!is_valid) {
+    mesh->Clear();
+  }
+  return is_valid;
+}
+
+bool LoadObj(const char* file_path, const size_t thread_count,
+             TriangleMesh* mesh) noexcept {
+  MappedFile file{file_path};
+  if (!file.IsOpen()) {
+    mesh->Clear();
+    return false;
+  }
+  return ParseObj(file.data, file.size, thread_count, mesh);
+}
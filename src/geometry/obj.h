@@ -0,0 +1,30 @@
+#ifndef SRC_GEOMETRY_OBJ_H_
+#define SRC_GEOMETRY_OBJ_H_
+
+#include <geometry/mesh.h>
+
+#include <cstddef>
+
+// NOTE: Each parse task gets at least this many bytes, so small files are
+// not split into tasks that would cost more to hand out than they save.
+#define OBJ_MIN_CHUNK_SIZE (1 << 20)
+
+// NOTE: Parses the vertex positions and faces of Wavefront OBJ text into
+// mesh, replacing its geometry. The text is split at line boundaries into
+// chunks that thread_count render pool tasks parse in place, 0 using one
+// per pool thread: one pass counts vertices and triangles per chunk so
+// every chunk knows where its output starts, the second writes it. It waits
+// on the pool, so it must not run inside a pool task. Faces with more than
+// three corners are fanned into triangles, negative (relative) indices are
+// resolved, and texture and normal references, like every other statement,
+// are skipped. Returns false on malformed numbers or on indices outside
+// the vertex list, leaving mesh empty. The mesh still needs Build.
+bool ParseObj(const char* source, size_t size, size_t thread_count,
+              TriangleMesh* mesh) noexcept;
+
+// NOTE: Maps the file rather than reading it into memory and parses the
+// mapping with ParseObj, so files past 4 GB load as well.
+bool LoadObj(const char* file_path, size_t thread_count,
+             TriangleMesh* mesh) noexcept;
+
+#endif  // SRC_GEOMETRY_OBJ_H_
@@ -0,0 +1,461 @@
+#include <core/arr.h>
+#include <core/cpu.h>
+#include <core/test_suite.h>
+#include <core/utils.h>
+#include <geometry/matrix.h>
+#include <geometry/primitive.h>
+#include <geometry/ray.h>
+#include <immintrin.h>
+
+#include <bit>
+#include <cassert>
+#include <cstdint>
+#include <format>
+#include <string>
+
+SphereStore::SphereStore() noexcept : count(0) { Clear(); }
+
+SphereStore::SphereStore(const SphereStore& other) noexcept
+    : count(other.count) {
+  for (size_t row = 0; row < SPHERE_ROW_COUNT; ++row) {
+    rows[row] = other.rows[row];
+  }
+}
+
+SphereStore& SphereStore::operator=(const SphereStore& other) noexcept {
+  if (this != &other) {
+    for (size_t row = 0; row < SPHERE_ROW_COUNT; ++row) {
+      rows[row] = other.rows[row];
+    }
+    count = other.count;
+  }
+  return *this;
+}
+
+size_t SphereStore::Count() const noexcept { return count; }
+
+static inline void SphereValues(const Sphere& sphere,
+                                float* values) noexcept {
+  const AffineTransform& inverse = sphere.inverse_transform;
+  const float matrix[] = {inverse.m0, inverse.m1, inverse.m2,  inverse.m3,
+                          inverse.m4, inverse.m5, inverse.m6,  inverse.m7,
+                          inverse.m8, inverse.m9, inverse.m10, inverse.m11};
+  for (size_t row = SPHERE_M0; row <= SPHERE_M11; ++row) {
+    values[row] = matrix[row];
+  }
+  values[SPHERE_CENTER_X] = sphere.origin.x;
+  values[SPHERE_CENTER_Y] = sphere.origin.y;
+  values[SPHERE_CENTER_Z] = sphere.origin.z;
+}
+
+// NOTE: The new sphere takes the first padding float, and a zero is pushed
+// to keep the padding whole.
+uint32_t SphereStore::Add(const Sphere& sphere) noexcept {
+  float values[SPHERE_ROW_COUNT];
+  SphereValues(sphere, values);
+  for (size_t row = 0; row < SPHERE_ROW_COUNT; ++row) {
+    rows[row][count] = values[row];
+    rows[row].Push(0.F);
+  }
+  return static_cast<uint32_t>(count++);
+}
+
+void SphereStore::Build(const Sphere* spheres, const uint32_t* order,
+                        const size_t length) noexcept {
+  for (size_t row = 0; row < SPHERE_ROW_COUNT; ++row) {
+    rows[row] = DyArray<float>(length + SPHERE_ROW_PADDING);
+  }
+  count = length;
+
+  float values[SPHERE_ROW_COUNT];
+  for (size_t i = 0; i < length; ++i) {
+    SphereValues(spheres[order == nullptr ? i : order[i]], values);
+    for (size_t row = 0; row < SPHERE_ROW_COUNT; ++row) {
+      rows[row][i] = values[row];
+    }
+  }
+}
+
+void SphereStore::Set(const uint32_t index, const Sphere& sphere) noexcept {
+  assert(index < count);
+  float values[SPHERE_ROW_COUNT];
+  SphereValues(sphere, values);
+  for (size_t row = 0; row < SPHERE_ROW_COUNT; ++row) {
+    rows[row][index] = values[row];
+  }
+}
+
+void SphereStore::Clear() noexcept {
+  for (size_t row = 0; row < SPHERE_ROW_COUNT; ++row) {
+    rows[row] = DyArray<float>(SPHERE_ROW_PADDING);
+  }
+  count = 0;
+}
+
+size_t SphereStore::MemoryUsage() const noexcept {
+  return SPHERE_ROW_COUNT * rows[0].capacity * sizeof(float);
+}
+
+// NOTE: The quadratic of Ray::IntersectClosest for 4 spheres: the ray in
+// each sphere's object space, then a, b and c. The sums run in the order
+// the dot products of Ray::Transform and DotProduct take, and nothing is
+// fused, so the AVX2 kernels below give the same result lane for lane.
+struct SphereQuadratic {
+  __m128 a;
+  __m128 b;
+  __m128 c;
+};
+
+static inline SphereQuadratic SphereQuadraticSSE(
+    const SphereStore& store, const size_t first,
+    const SphereRaySSE& ray) noexcept {
+  __m128 m[SPHERE_ROW_COUNT];
+  for (size_t row = 0; row < SPHERE_ROW_COUNT; ++row) {
+    m[row] = _mm_loadu_ps(store.rows[row].data.get() + first);
+  }
+
+  __m128 origin[3];
+  __m128 direction[3];
+  for (size_t axis = 0; axis < 3; ++axis) {
+    const __m128* r = m + 4 * axis;
+    origin[axis] = _mm_add_ps(
+        _mm_add_ps(r[3], _mm_mul_ps(r[2], ray.origin_z)),
+        _mm_add_ps(_mm_mul_ps(r[1], ray.origin_y),
+                   _mm_mul_ps(r[0], ray.origin_x)));
+    direction[axis] = _mm_add_ps(
+        _mm_mul_ps(r[2], ray.direction_z),
+        _mm_add_ps(_mm_mul_ps(r[1], ray.direction_y),
+                   _mm_mul_ps(r[0], ray.direction_x)));
+  }
+
+  __m128 sx = _mm_sub_ps(origin[0], m[SPHERE_CENTER_X]);
+  __m128 sy = _mm_sub_ps(origin[1], m[SPHERE_CENTER_Y]);
+  __m128 sz = _mm_sub_ps(origin[2], m[SPHERE_CENTER_Z]);
+
+  SphereQuadratic quadratic;
+  quadratic.a = _mm_add_ps(
+      _mm_mul_ps(direction[2], direction[2]),
+      _mm_add_ps(_mm_mul_ps(direction[1], direction[1]),
+                 _mm_mul_ps(direction[0], direction[0])));
+  quadratic.b = _mm_mul_ps(
+      _mm_set1_ps(2.F),
+      _mm_add_ps(_mm_mul_ps(direction[2], sz),
+                 _mm_add_ps(_mm_mul_ps(direction[1], sy),
+                            _mm_mul_ps(direction[0], sx))));
+  quadratic.c = _mm_sub_ps(
+      _mm_add_ps(_mm_mul_ps(sz, sz),
+                 _mm_add_ps(_mm_mul_ps(sy, sy), _mm_mul_ps(sx, sx))),
+      _mm_set1_ps(1.F));
+  return quadratic;
+}
+
+static inline __m128 SelectSSE(const __m128 mask, const __m128 if_true,
+                               const __m128 if_false) noexcept {
+  return _mm_or_ps(_mm_and_ps(mask, if_true), _mm_andnot_ps(mask, if_false));
+}
+
+// NOTE: Returns the mask of the 4 spheres from first hit within
+// [tmin, tmax), with their nearest distances in ts.
+static inline uint32_t IntersectSpheresSSE(const SphereStore& store,
+                                           const size_t first,
+                                           const SphereRaySSE& ray,
+                                           const float tmin, const float tmax,
+                                           float* ts) noexcept {
+  SphereQuadratic q{SphereQuadraticSSE(store, first, ray)};
+  __m128 zero = _mm_setzero_ps();
+  __m128 discriminant = _mm_sub_ps(
+      _mm_mul_ps(q.b, q.b), _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(4.F), q.a), q.c));
+  __m128 sign_mask = _mm_set1_ps(-0.F);
+  __m128 is_tangent =
+      _mm_cmple_ps(_mm_andnot_ps(sign_mask, discriminant),
+                   _mm_set1_ps(static_cast<float>(ABSOLUTE_TOLERANCE)));
+  __m128 is_valid =
+      _mm_or_ps(is_tangent, _mm_cmpge_ps(discriminant, zero));
+
+  __m128 root =
+      _mm_andnot_ps(is_tangent, _mm_sqrt_ps(_mm_max_ps(discriminant, zero)));
+  __m128 minus_b = _mm_xor_ps(q.b, sign_mask);
+  __m128 two_a = _mm_mul_ps(_mm_set1_ps(2.F), q.a);
+  __m128 near_t = _mm_div_ps(_mm_sub_ps(minus_b, root), two_a);
+  __m128 far_t = _mm_div_ps(_mm_add_ps(minus_b, root), two_a);
+  __m128 vmin = _mm_set1_ps(tmin);
+  __m128 t = SelectSSE(_mm_cmplt_ps(near_t, vmin), far_t, near_t);
+
+  __m128 hit = _mm_and_ps(is_valid, _mm_cmpge_ps(t, vmin));
+  hit = _mm_and_ps(hit, _mm_cmplt_ps(t, _mm_set1_ps(tmax)));
+  _mm_storeu_ps(ts, t);
+  return static_cast<uint32_t>(_mm_movemask_ps(hit));
+}
+
+// NOTE: The sign test of Ray::IntersectAny for 4 spheres.
+static inline uint32_t OccludedSpheresSSE(const SphereStore& store,
+                                          const size_t first,
+                                          const SphereRaySSE& ray,
+                                          const float tmin,
+                                          const float tmax) noexcept {
+  SphereQuadratic q{SphereQuadraticSSE(store, first, ray)};
+  __m128 zero = _mm_setzero_ps();
+  __m128 vmin = _mm_set1_ps(tmin);
+  __m128 vmax = _mm_set1_ps(tmax);
+  __m128 is_min_outside = _mm_cmpgt_ps(
+      _mm_add_ps(_mm_mul_ps(_mm_add_ps(_mm_mul_ps(q.a, vmin), q.b), vmin),
+                 q.c),
+      zero);
+  __m128 is_max_outside = _mm_cmpgt_ps(
+      _mm_add_ps(_mm_mul_ps(_mm_add_ps(_mm_mul_ps(q.a, vmax), q.b), vmax),
+                 q.c),
+      zero);
+  __m128 is_crossing = _mm_xor_ps(is_min_outside, is_max_outside);
+
+  __m128 discriminant = _mm_sub_ps(
+      _mm_mul_ps(q.b, q.b), _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(4.F), q.a), q.c));
+  __m128 minus_b = _mm_xor_ps(q.b, _mm_set1_ps(-0.F));
+  __m128 two_a = _mm_mul_ps(_mm_set1_ps(2.F), q.a);
+  __m128 is_grazing = _mm_and_ps(
+      _mm_and_ps(is_min_outside, is_max_outside),
+      _mm_and_ps(_mm_cmpgt_ps(discriminant, zero),
+                 _mm_and_ps(_mm_cmpgt_ps(minus_b, _mm_mul_ps(two_a, vmin)),
+                            _mm_cmplt_ps(minus_b, _mm_mul_ps(two_a, vmax)))));
+  return static_cast<uint32_t>(
+      _mm_movemask_ps(_mm_or_ps(is_crossing, is_grazing)));
+}
+
+struct WideSphereQuadratic {
+  __m256 a;
+  __m256 b;
+  __m256 c;
+};
+
+// NOTE: SphereQuadraticSSE on 8 spheres.
+static inline WideSphereQuadratic SphereQuadraticAVX2(
+    const SphereStore& store, const size_t first,
+    const SphereRayAVX2& ray) noexcept {
+  __m256 m[SPHERE_ROW_COUNT];
+  for (size_t row = 0; row < SPHERE_ROW_COUNT; ++row) {
+    m[row] = _mm256_loadu_ps(store.rows[row].data.get() + first);
+  }
+
+  __m256 origin[3];
+  __m256 direction[3];
+  for (size_t axis = 0; axis < 3; ++axis) {
+    const __m256* r = m + 4 * axis;
+    origin[axis] = _mm256_add_ps(
+        _mm256_add_ps(r[3], _mm256_mul_ps(r[2], ray.origin_z)),
+        _mm256_add_ps(_mm256_mul_ps(r[1], ray.origin_y),
+                      _mm256_mul_ps(r[0], ray.origin_x)));
+    direction[axis] = _mm256_add_ps(
+        _mm256_mul_ps(r[2], ray.direction_z),
+        _mm256_add_ps(_mm256_mul_ps(r[1], ray.direction_y),
+                      _mm256_mul_ps(r[0], ray.direction_x)));
+  }
+
+  __m256 sx = _mm256_sub_ps(origin[0], m[SPHERE_CENTER_X]);
+  __m256 sy = _mm256_sub_ps(origin[1], m[SPHERE_CENTER_Y]);
+  __m256 sz = _mm256_sub_ps(origin[2], m[SPHERE_CENTER_Z]);
+
+  WideSphereQuadratic quadratic;
+  quadratic.a = _mm256_add_ps(
+      _mm256_mul_ps(direction[2], direction[2]),
+      _mm256_add_ps(_mm256_mul_ps(direction[1], direction[1]),
+                    _mm256_mul_ps(direction[0], direction[0])));
+  quadratic.b = _mm256_mul_ps(
+      _mm256_set1_ps(2.F),
+      _mm256_add_ps(_mm256_mul_ps(direction[2], sz),
+                    _mm256_add_ps(_mm256_mul_ps(direction[1], sy),
+                                  _mm256_mul_ps(direction[0], sx))));
+  quadratic.c = _mm256_sub_ps(
+      _mm256_add_ps(_mm256_mul_ps(sz, sz),
+                    _mm256_add_ps(_mm256_mul_ps(sy, sy),
+                                  _mm256_mul_ps(sx, sx))),
+      _mm256_set1_ps(1.F));
+  return quadratic;
+}
+
+// NOTE: IntersectSpheresSSE on the 8 spheres from first.
+static inline uint32_t IntersectSpheresAVX2(const SphereStore& store,
+                                            const size_t first,
+                                            const SphereRayAVX2& ray,
+                                            const float tmin,
+                                            const float tmax,
+                                            float* ts) noexcept {
+  WideSphereQuadratic q{SphereQuadraticAVX2(store, first, ray)};
+  __m256 zero = _mm256_setzero_ps();
+  __m256 discriminant = _mm256_sub_ps(
+      _mm256_mul_ps(q.b, q.b),
+      _mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(4.F), q.a), q.c));
+  __m256 sign_mask = _mm256_set1_ps(-0.F);
+  __m256 is_tangent =
+      _mm256_cmp_ps(_mm256_andnot_ps(sign_mask, discriminant),
+                    _mm256_set1_ps(static_cast<float>(ABSOLUTE_TOLERANCE)),
+                    _CMP_LE_OQ);
+  __m256 is_valid = _mm256_or_ps(
+      is_tangent, _mm256_cmp_ps(discriminant, zero, _CMP_GE_OQ));
+
+  __m256 root = _mm256_andnot_ps(
+      is_tangent, _mm256_sqrt_ps(_mm256_max_ps(discriminant, zero)));
+  __m256 minus_b = _mm256_xor_ps(q.b, sign_mask);
+  __m256 two_a = _mm256_mul_ps(_mm256_set1_ps(2.F), q.a);
+  __m256 near_t = _mm256_div_ps(_mm256_sub_ps(minus_b, root), two_a);
+  __m256 far_t = _mm256_div_ps(_mm256_add_ps(minus_b, root), two_a);
+  __m256 vmin = _mm256_set1_ps(tmin);
+  __m256 t = _mm256_blendv_ps(near_t, far_t,
+                              _mm256_cmp_ps(near_t, vmin, _CMP_LT_OQ));
+
+  __m256 hit =
+      _mm256_and_ps(is_valid, _mm256_cmp_ps(t, vmin, _CMP_GE_OQ));
+  hit = _mm256_and_ps(
+      hit, _mm256_cmp_ps(t, _mm256_set1_ps(tmax), _CMP_LT_OQ));
+  _mm256_storeu_ps(ts, t);
+  return static_cast<uint32_t>(_mm256_movemask_ps(hit));
+}
+
+// NOTE: OccludedSpheresSSE on the 8 spheres from first.
+static inline uint32_t OccludedSpheresAVX2(const SphereStore& store,
+                                           const size_t first,
+                                           const SphereRayAVX2& ray,
+                                           const float tmin,
+                                           const float tmax) noexcept {
+  WideSphereQuadratic q{SphereQuadraticAVX2(store, first, ray)};
+  __m256 zero = _mm256_setzero_ps();
+  __m256 vmin = _mm256_set1_ps(tmin);
+  __m256 vmax = _mm256_set1_ps(tmax);
+  __m256 is_min_outside = _mm256_cmp_ps(
+      _mm256_add_ps(
+          _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(q.a, vmin), q.b), vmin),
+          q.c),
+      zero, _CMP_GT_OQ);
+  __m256 is_max_outside = _mm256_cmp_ps(
+      _mm256_add_ps(
+          _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(q.a, vmax), q.b), vmax),
+          q.c),
+      zero, _CMP_GT_OQ);
+  __m256 is_crossing = _mm256_xor_ps(is_min_outside, is_max_outside);
+
+  __m256 discriminant = _mm256_sub_ps(
+      _mm256_mul_ps(q.b, q.b),
+      _mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(4.F), q.a), q.c));
+  __m256 minus_b = _mm256_xor_ps(q.b, _mm256_set1_ps(-0.F));
+  __m256 two_a = _mm256_mul_ps(_mm256_set1_ps(2.F), q.a);
+  __m256 is_between = _mm256_and_ps(
+      _mm256_cmp_ps(minus_b, _mm256_mul_ps(two_a, vmin), _CMP_GT_OQ),
+      _mm256_cmp_ps(minus_b, _mm256_mul_ps(two_a, vmax), _CMP_LT_OQ));
+  __m256 is_grazing = _mm256_and_ps(
+      _mm256_and_ps(is_min_outside, is_max_outside),
+      _mm256_and_ps(_mm256_cmp_ps(discriminant, zero, _CMP_GT_OQ),
+                    is_between));
+  return static_cast<uint32_t>(
+      _mm256_movemask_ps(_mm256_or_ps(is_crossing, is_grazing)));
+}
+
+SphereRays MakeSphereRays(const Ray& ray) noexcept {
+  SphereRays rays;
+  rays.sse = {_mm_set1_ps(ray.origin.x),    _mm_set1_ps(ray.origin.y),
+              _mm_set1_ps(ray.origin.z),    _mm_set1_ps(ray.direction.x),
+              _mm_set1_ps(ray.direction.y), _mm_set1_ps(ray.direction.z)};
+  rays.is_wide = GetIsaLevel() >= ISA_AVX2;
+  if (rays.is_wide) {
+    rays.avx2 = {_mm256_set1_ps(ray.origin.x),
+                 _mm256_set1_ps(ray.origin.y),
+                 _mm256_set1_ps(ray.origin.z),
+                 _mm256_set1_ps(ray.direction.x),
+                 _mm256_set1_ps(ray.direction.y),
+                 _mm256_set1_ps(ray.direction.z)};
+  }
+  return rays;
+}
+
+// NOTE: Lowers *tmax to the nearest of the hit lanes in mask and returns
+// that lane, or NO_HIT_ID when none is nearer.
+static inline uint32_t NearestLane(uint32_t mask, const float* ts,
+                                   float* tmax) noexcept {
+  uint32_t nearest = NO_HIT_ID;
+  while (mask != 0) {
+    uint32_t lane = static_cast<uint32_t>(std::countr_zero(mask));
+    mask &= mask - 1;
+    if (ts[lane] < *tmax) {
+      *tmax = ts[lane];
+      nearest = lane;
+    }
+  }
+  return nearest;
+}
+
+uint32_t SphereStore::ClosestInRange(const SphereRays& rays,
+                                     const size_t first, const size_t length,
+                                     const float tmin,
+                                     float* tmax) const noexcept {
+  assert(first + length <= count);
+  uint32_t nearest = NO_HIT_ID;
+  float ts[8];
+  size_t i = 0;
+  if (rays.is_wide) {
+    for (; i + 4 < length; i += 8) {
+      uint32_t lane_mask = (1U << Min(length - i, 8)) - 1;
+      uint32_t mask = IntersectSpheresAVX2(*this, first + i, rays.avx2, tmin,
+                                           *tmax, ts) &
+                      lane_mask;
+      uint32_t lane = NearestLane(mask, ts, tmax);
+      if (lane != NO_HIT_ID) {
+        nearest = static_cast<uint32_t>(first + i + lane);
+      }
+    }
+  }
+  for (; i < length; i += 4) {
+    uint32_t lane_mask = (1U << Min(length - i, 4)) - 1;
+    uint32_t mask =
+        IntersectSpheresSSE(*this, first + i, rays.sse, tmin, *tmax, ts) &
+        lane_mask;
+    uint32_t lane = NearestLane(mask, ts, tmax);
+    if (lane != NO_HIT_ID) {
+      nearest = static_cast<uint32_t>(first + i + lane);
+    }
+  }
+  return nearest;
+}
+
+bool SphereStore::IsRangeOccluded(const SphereRays& rays, const size_t first,
+                                  const size_t length, const float tmin,
+                                  const float tmax) const noexcept {
+  assert(first + length <= count);
+  size_t i = 0;
+  if (rays.is_wide) {
+    for (; i + 4 < length; i += 8) {
+      uint32_t lane_mask = (1U << Min(length - i, 8)) - 1;
+      if ((OccludedSpheresAVX2(*this, first + i, rays.avx2, tmin, tmax) &
+           lane_mask) != 0) {
+        return true;
+      }
+    }
+  }
+  for (; i < length; i += 4) {
+    uint32_t lane_mask = (1U << Min(length - i, 4)) - 1;
+    if ((OccludedSpheresSSE(*this, first + i, rays.sse, tmin, tmax) &
+         lane_mask) != 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+HitRecord SphereStore::ClosestHit(const Ray& ray, const float tmin,
+                                  const float tmax) const noexcept {
+  HitRecord record{NO_HIT_ID, tmax};
+  record.object_id =
+      ClosestInRange(MakeSphereRays(ray), 0, count, tmin, &record.t);
+  return record;
+}
+
+bool SphereStore::IsOccluded(const Ray& ray, const float tmin,
+                             const float tmax) const noexcept {
+  return IsRangeOccluded(MakeSphereRays(ray), 0, count, tmin, tmax);
+}
+
+SphereStore::operator std::string() const noexcept {
+  return std::format("SphereStore(count={}, bytes={})", Count(),
+                     MemoryUsage());
+}
+
+std::ostream& operator<<(std::ostream& os, const SphereStore& store) {
+  os << std::string(store);
+  return os;
+}
@@ -0,0 +1,113 @@
+#ifndef SRC_GEOMETRY_PRIMITIVE_H_
+#define SRC_GEOMETRY_PRIMITIVE_H_
+
+#include <core/arr.h>
+#include <geometry/ray.h>
+
+#include <immintrin.h>
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+
+// NOTE: Rows of SphereStore::rows: the inverse transform of each sphere,
+// row-major 3x4, followed by its object-space center.
+enum SphereRow {
+  SPHERE_M0,
+  SPHERE_M1,
+  SPHERE_M2,
+  SPHERE_M3,
+  SPHERE_M4,
+  SPHERE_M5,
+  SPHERE_M6,
+  SPHERE_M7,
+  SPHERE_M8,
+  SPHERE_M9,
+  SPHERE_M10,
+  SPHERE_M11,
+  SPHERE_CENTER_X,
+  SPHERE_CENTER_Y,
+  SPHERE_CENTER_Z,
+  SPHERE_ROW_COUNT
+};
+
+// NOTE: Zeroed floats past the last sphere of every row, so a 4-wide load
+// starting at any sphere stays inside the row. 8-wide loads only start
+// where more than 4 spheres remain, so they need no more.
+#define SPHERE_ROW_PADDING 3
+
+struct SphereRaySSE {
+  __m128 origin_x;
+  __m128 origin_y;
+  __m128 origin_z;
+  __m128 direction_x;
+  __m128 direction_y;
+  __m128 direction_z;
+};
+
+struct SphereRayAVX2 {
+  __m256 origin_x;
+  __m256 origin_y;
+  __m256 origin_z;
+  __m256 direction_x;
+  __m256 direction_y;
+  __m256 direction_z;
+};
+
+// NOTE: The ray broadcast to every lane of whichever kernels the active ISA
+// level runs, made once per query and shared by every range it tests; the
+// AVX2 registers are only set up when is_wide.
+struct SphereRays {
+  SphereRaySSE sse;
+  SphereRayAVX2 avx2;
+  bool is_wide;
+};
+
+SphereRays MakeSphereRays(const Ray& ray) noexcept;
+
+// NOTE: SoA copy of what the sphere intersection reads, one contiguous row
+// per value, so 4 spheres are tested per SSE register with no pointer chase
+// and no branch per sphere. Materials and the forward transform stay with
+// the Sphere records. Rows are either in array order, from Add, or in the
+// order of an accelerator's indices, from Build, so each leaf or cell is one
+// contiguous range of rows; Set has to be called for every sphere changed
+// in place.
+struct SphereStore {
+  DyArray<float> rows[SPHERE_ROW_COUNT];
+  size_t count;
+
+  SphereStore() noexcept;
+  SphereStore(const SphereStore& other) noexcept;
+  SphereStore& operator=(const SphereStore& other) noexcept;
+
+  size_t Count() const noexcept;
+  uint32_t Add(const Sphere& sphere) noexcept;
+  // NOTE: Refills the rows with spheres[order[i]] for i < length, or with
+  // spheres in array order when order is null. The same sphere may appear
+  // in several rows.
+  void Build(const Sphere* spheres, const uint32_t* order,
+             size_t length) noexcept;
+  void Set(uint32_t index, const Sphere& sphere) noexcept;
+  void Clear() noexcept;
+  size_t MemoryUsage() const noexcept;
+
+  // NOTE: Tests rows [first, first + length): 8 at a time while more than 4
+  // remain on AVX2 and up, then 4 at a time. ClosestInRange lowers *tmax to
+  // the nearest hit and returns its row, or NO_HIT_ID when nothing in range
+  // is nearer than *tmax.
+  uint32_t ClosestInRange(const SphereRays& rays, size_t first, size_t length,
+                          float tmin, float* tmax) const noexcept;
+  bool IsRangeOccluded(const SphereRays& rays, size_t first, size_t length,
+                       float tmin, float tmax) const noexcept;
+
+  // NOTE: Same results as ClosestHit and IsOccluded over the Sphere records,
+  // with object_id the row.
+  HitRecord ClosestHit(const Ray& ray, float tmin, float tmax) const noexcept;
+  bool IsOccluded(const Ray& ray, float tmin, float tmax) const noexcept;
+
+  operator std::string() const noexcept;
+};
+
+std::ostream& operator<<(std::ostream& os, const SphereStore& store);
+
+#endif  // SRC_GEOMETRY_PRIMITIVE_H_
@@ -0,0 +1,98 @@
+#include <core/test_suite.h>
+#include <geometry/matrix.h>
+#include <geometry/quaternion.h>
+#include <geometry/vector.h>
+#include <immintrin.h>
+
+#include <cmath>
+#include <format>
+#include <iostream>
+#include <string>
+
+Quaternion::Quaternion() noexcept : quat(_mm_set_ps(1, 0, 0, 0)) {}
+
+Quaternion::Quaternion(const float x, const float y, const float z,
+                       const float w) noexcept
+    : quat(_mm_set_ps(w, z, y, x)) {}
+
+Quaternion::Quaternion(const __m128 quat) noexcept : quat(quat) {}
+
+Quaternion::Quaternion(const Quaternion& other) noexcept : quat(other.quat) {}
+
+Quaternion& Quaternion::operator=(const Quaternion& other) noexcept {
+  if (this != &other) {
+    quat = other.quat;
+  }
+  return *this;
+}
+
+bool Quaternion::operator==(const Quaternion& other) const noexcept {
+  __m128 diff = _mm_sub_ps(quat, other.quat);
+  diff = _mm_andnot_ps(_mm_set1_ps(-0.F), diff);
+
+  __m128 tolerance = _mm_set1_ps(static_cast<float>(ABSOLUTE_TOLERANCE));
+  __m128 cmp = _mm_cmp_ps(diff, tolerance, _CMP_LE_OQ);
+
+  return _mm_testc_ps(cmp, _mm_set1_ps(-1.F)) != 0;
+}
+
+bool Quaternion::operator!=(const Quaternion& other) const noexcept {
+  return !(*this == other);
+}
+
+Quaternion Quaternion::operator*(const Quaternion& other) const noexcept {
+  return {w * other.x + x * other.w + y * other.z - z * other.y,
+          w * other.y - x * other.z + y * other.w + z * other.x,
+          w * other.z + x * other.y - y * other.x + z * other.w,
+          w * other.w - x * other.x - y * other.y - z * other.z};
+}
+
+Quaternion Quaternion::Conjugate() const noexcept {
+  return Quaternion{_mm_xor_ps(quat, _mm_set_ps(0.F, -0.F, -0.F, -0.F))};
+}
+
+Quaternion Quaternion::Normalize() const noexcept {
+  __m128 length = _mm_sqrt_ps(_mm_dp_ps(quat, quat, 0xFF));
+  return Quaternion{_mm_div_ps(quat, length)};
+}
+
+Vector Quaternion::Rotate(const Vector& vector) const noexcept {
+  Quaternion rotated{*this * Quaternion{vector.x, vector.y, vector.z, 0} *
+                     Conjugate()};
+  return {rotated.x, rotated.y, rotated.z};
+}
+
+// NOTE: Assumes a unit quaternion.
+Matrix Quaternion::ToMatrix() const noexcept {
+  float xx = x * x;
+  float yy = y * y;
+  float zz = z * z;
+  float xy = x * y;
+  float xz = x * z;
+  float yz = y * z;
+  float wx = w * x;
+  float wy = w * y;
+  float wz = w * z;
+
+  return {_mm_set_ps(0, 2 * (xz + wy), 2 * (xy - wz), 1 - 2 * (yy + zz)),
+          _mm_set_ps(0, 2 * (yz - wx), 1 - 2 * (xx + zz), 2 * (xy + wz)),
+          _mm_set_ps(0, 1 - 2 * (xx + yy), 2 * (yz + wx), 2 * (xz - wy)),
+          _mm_set_ps(1, 0, 0, 0)};
+}
+
+Quaternion::operator std::string() const noexcept {
+  return std::format("Quaternion(x={:.10f}, y={:.10f}, z={:.10f}, w={:.10f})",
+                     x, y, z, w);
+}
+
+std::ostream& operator<<(std::ostream& os, const Quaternion& quaternion) {
+  os << std::string(quaternion);
+  return os;
+}
+
+Quaternion AxisAngle(const Vector& axis, const float radians) noexcept {
+  Vector unit_axis{axis.Normalize()};
+  float sin = std::sin(radians / 2);
+  return {unit_axis.x * sin, unit_axis.y * sin, unit_axis.z * sin,
+          std::cos(radians / 2)};
+}
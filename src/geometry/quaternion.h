@@ -0,0 +1,44 @@
+#ifndef SRC_GEOMETRY_QUATERNION_H_
+#define SRC_GEOMETRY_QUATERNION_H_
+
+#include <geometry/matrix.h>
+#include <geometry/vector.h>
+#include <immintrin.h>
+
+#include <iostream>
+#include <string>
+
+// NOTE: Rotation quaternion with the vector part in x, y, z and the scalar
+// part in w.
+struct Quaternion {
+  union {
+    __m128 quat;
+    struct {
+      float x, y, z, w;
+    };
+  };
+
+  Quaternion() noexcept;
+  Quaternion(float x, float y, float z, float w) noexcept;
+  explicit Quaternion(__m128 quat) noexcept;
+  Quaternion(const Quaternion& other) noexcept;
+  Quaternion& operator=(const Quaternion& other) noexcept;
+
+  bool operator==(const Quaternion& other) const noexcept;
+  bool operator!=(const Quaternion& other) const noexcept;
+
+  Quaternion operator*(const Quaternion& other) const noexcept;
+
+  Quaternion Conjugate() const noexcept;
+  Quaternion Normalize() const noexcept;
+  Vector Rotate(const Vector& vector) const noexcept;
+  Matrix ToMatrix() const noexcept;
+
+  operator std::string() const noexcept;
+};
+
+std::ostream& operator<<(std::ostream& os, const Quaternion& quaternion);
+
+Quaternion AxisAngle(const Vector& axis, float radians) noexcept;
+
+#endif  // SRC_GEOMETRY_QUATERNION_H_
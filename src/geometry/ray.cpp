@@ -1,14 +1,21 @@
+#include <core/arena.h>
 #include <core/test_suite.h>
+#include <core/thread_pool.h>
 #include <core/utils.h>
 #include <geometry/point.h>
 #include <geometry/ray.h>
+#include <geometry/ray_packet.h>
+#include <geometry/trs_transform.h>
 #include <geometry/vector.h>
 #include <render/light.h>
+#include <render/tile_scheduler.h>
 
+#include <algorithm>
+#include <cmath>
 #include <cstdio>
 #include <format>
+#include <memory>
 #include <string>
-#include <thread>
 
 Ray::Ray(const Point& origin, const Vector& direction) noexcept
     : origin(origin), direction(direction) {}
@@ -36,10 +43,15 @@ Point Ray::Position(float t) const noexcept {
   return origin + direction * t;
 }
 
-Hits Ray::Intersect(Sphere sphere) const noexcept {
+Hits Ray::Intersect(const Sphere& sphere) const noexcept {
+  return Intersect(sphere, MakePrimitiveHandle(PRIMITIVE_SPHERE, 0));
+}
+
+Hits Ray::Intersect(const Sphere& sphere,
+                    const PrimitiveHandle handle) const noexcept {
   Hits hits;
 
-  Ray ray{Transform(sphere.transform_matrix.Inverse())};
+  Ray ray{Transform(sphere.inverse_transform)};
 
   Vector sphere_to_ray{ray.origin - sphere.origin};
 
@@ -49,44 +61,141 @@ Hits Ray::Intersect(Sphere sphere) const noexcept {
 
   float discriminant = (b * b) - (4 * a * c);
 
-  Object object{&sphere, SPHERE};
-
   if (IsEqualFloat(discriminant, 0.0)) {
     float t = -b / (2 * a);
-    hits.Push({object, t});
+    hits.Push({handle, t});
   } else if (discriminant > 0.0) {
     float t1 = (-b - std::sqrt(discriminant)) / (2 * a);
     float t2 = (-b + std::sqrt(discriminant)) / (2 * a);
-    hits.Push({object, t1});
-    hits.Push({object, t2});
+    hits.Push({handle, t1});
+    hits.Push({handle, t2});
   }
 
   return hits;
 }
 
+// NOTE: Same quadratic as Intersect, but only the nearest root inside
+// [tmin, *tmax) is kept. The discriminant is rejected before any sqrt.
+bool Ray::IntersectClosest(const Sphere& sphere, const float tmin,
+                           float* tmax) const noexcept {
+  Ray ray{Transform(sphere.inverse_transform)};
+
+  Vector sphere_to_ray{ray.origin - sphere.origin};
+
+  float a = DotProduct(ray.direction, ray.direction);
+  float b = 2 * DotProduct(ray.direction, sphere_to_ray);
+  float c = DotProduct(sphere_to_ray, sphere_to_ray) - 1;
+
+  float discriminant = (b * b) - (4 * a * c);
+  bool is_tangent = IsEqualFloat(discriminant, 0.0);
+  if (!is_tangent && discriminant < 0.0) {
+    return false;
+  }
+
+  float root = is_tangent ? 0.F : std::sqrt(discriminant);
+  float t = (-b - root) / (2 * a);
+  if (t < tmin) {
+    t = (-b + root) / (2 * a);
+  }
+  if (t < tmin || t >= *tmax) {
+    return false;
+  }
+
+  *tmax = t;
+  return true;
+}
+
+// NOTE: With f(t) = a*t^2 + b*t + c (negative inside the sphere), the ray
+// crosses the surface in (tmin, tmax) if f changes sign over the interval,
+// or if both ends are outside and the vertex of f lies inside the interval
+// with a positive discriminant.
+bool Ray::IntersectAny(const Sphere& sphere, const float tmin,
+                       const float tmax) const noexcept {
+  Ray ray{Transform(sphere.inverse_transform)};
+
+  Vector sphere_to_ray{ray.origin - sphere.origin};
+
+  float a = DotProduct(ray.direction, ray.direction);
+  float b = 2 * DotProduct(ray.direction, sphere_to_ray);
+  float c = DotProduct(sphere_to_ray, sphere_to_ray) - 1;
+
+  bool is_min_outside = (a * tmin + b) * tmin + c > 0.F;
+  bool is_max_outside = (a * tmax + b) * tmax + c > 0.F;
+  if (is_min_outside != is_max_outside) {
+    return true;
+  }
+  if (!is_min_outside) {
+    return false;
+  }
+
+  float discriminant = (b * b) - (4 * a * c);
+  return discriminant > 0.F && -b > 2 * a * tmin && -b < 2 * a * tmax;
+}
+
+bool IsOccluded(const Ray& ray, const Sphere* spheres, const size_t count,
+                const float tmin, const float tmax) noexcept {
+  for (size_t i = 0; i < count; ++i) {
+    if (ray.IntersectAny(spheres[i], tmin, tmax)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool HitRecord::IsHit() const noexcept { return object_id != NO_HIT_ID; }
+
+HitRecord ClosestHit(const Ray& ray, const Sphere* spheres, const size_t count,
+                     const float tmin, const float tmax) noexcept {
+  HitRecord record{NO_HIT_ID, tmax};
+  for (size_t i = 0; i < count; ++i) {
+    if (ray.IntersectClosest(spheres[i], tmin, &record.t)) {
+      record.object_id = static_cast<uint32_t>(i);
+    }
+  }
+  return record;
+}
+
+HitRecord ClosestHit(const Ray& ray, const Sphere& sphere, const float tmin,
+                     const float tmax) noexcept {
+  return ClosestHit(ray, &sphere, 1, tmin, tmax);
+}
+
 Ray Ray::Transform(Matrix transform) const noexcept {
   return {transform * origin, transform * direction};
 }
 
+Ray Ray::Transform(const AffineTransform& transform) const noexcept {
+  return {transform * origin, transform * direction};
+}
+
 Sphere::Sphere() noexcept
-    : origin({0, 0, 0}), transform_matrix(Identity()), radius(1.0) {}
+    : origin({0, 0, 0}),
+      transform_matrix(Identity()),
+      radius(1.0) {}
 
 Sphere::Sphere(const Point& origin, const Matrix& transform,
                const float radius) noexcept
-    : origin(origin), transform_matrix(transform), radius(radius) {}
+    : origin(origin), radius(radius) {
+  SetTransform(transform);
+}
 
 Sphere::Sphere(const Point& origin, const Matrix& transform, const float radius,
                const Material& material) noexcept
-    : origin(origin),
-      transform_matrix(transform),
-      material(material),
-      radius(radius) {}
+    : origin(origin), material(material), radius(radius) {
+  SetTransform(transform);
+}
 
-Sphere::Sphere(const Material& material) noexcept : material(material) {}
+Sphere::Sphere(const Material& material) noexcept
+    : origin({0, 0, 0}),
+      transform_matrix(Identity()),
+      material(material),
+      radius(1.0) {}
 
 Sphere::Sphere(const Sphere& other) noexcept
     : origin(other.origin),
       transform_matrix(other.transform_matrix),
+      inverse_transform(other.inverse_transform),
+      inverse_transpose(other.inverse_transpose),
       material(other.material),
       radius(other.radius) {}
 
@@ -94,12 +203,26 @@ Sphere& Sphere::operator=(const Sphere& other) noexcept {
   if (this != &other) {
     origin = other.origin;
     transform_matrix = other.transform_matrix;
+    inverse_transform = other.inverse_transform;
+    inverse_transpose = other.inverse_transpose;
     radius = other.radius;
     material = other.material;
   }
   return *this;
 }
 
+void Sphere::SetTransform(const Matrix& transform) noexcept {
+  transform_matrix = transform;
+  inverse_transform = AffineTransform{transform}.Inverse();
+  inverse_transpose = inverse_transform.LinearTranspose();
+}
+
+void Sphere::SetTransform(const TrsTransform& transform) noexcept {
+  transform_matrix = transform.GetMatrix();
+  inverse_transform = transform.Inverse();
+  inverse_transpose = transform.InverseTranspose();
+}
+
 bool Sphere::operator==(const Sphere& other) const noexcept {
   return origin == other.origin && transform_matrix == other.transform_matrix &&
          radius == other.radius && material == other.material;
@@ -110,51 +233,59 @@ bool Sphere::operator!=(const Sphere& other) const noexcept {
 }
 
 Vector Sphere::NormalAt(const Point& world_point) const noexcept {
-  Point object_point{transform_matrix.Inverse() * world_point};
+  Point object_point{inverse_transform * world_point};
   Vector object_normal{object_point - origin};
-  Vector world_normal{
-      (transform_matrix.Inverse().Transpose() * object_normal).Normalize()};
+  Vector world_normal{(inverse_transpose * object_normal).Normalize()};
   world_normal.w = 0.0;
   return world_normal;
 }
 
-Object::Object() noexcept : data(nullptr), type(SPHERE) {}
-Object::Object(void* data, ObjectType type) noexcept : data(data), type(type) {}
-Object::Object(const Object& other) noexcept
-    : data(other.data), type(other.type) {}
+PrimitiveHandle MakePrimitiveHandle(const PrimitiveType type,
+                                    const uint32_t index) noexcept {
+  return (static_cast<uint32_t>(type) << PRIMITIVE_INDEX_BITS) |
+         (index & PRIMITIVE_INDEX_MASK);
+}
 
-Object& Object::operator=(const Object& other) noexcept {
-  if (this != &other) {
-    type = other.type;
-    data = other.data;
-  }
-  return *this;
+PrimitiveType HandleType(const PrimitiveHandle handle) noexcept {
+  return static_cast<PrimitiveType>(handle >> PRIMITIVE_INDEX_BITS);
 }
 
-bool Object::operator==(const Object& other) const {
-  return type == other.type && data == other.data;
+uint32_t HandleIndex(const PrimitiveHandle handle) noexcept {
+  return handle & PRIMITIVE_INDEX_MASK;
 }
 
-bool Object::operator!=(const Object& other) const {
-  return !(*this == other);
+std::string HandleString(const PrimitiveHandle handle) noexcept {
+  switch (HandleType(handle)) {
+    case PRIMITIVE_SPHERE: {
+      return std::format("sphere {}", HandleIndex(handle));
+    }
+    case PRIMITIVE_TRIANGLE: {
+      return std::format("triangle {}", HandleIndex(handle));
+    }
+    default: {
+      return handle == NO_HIT_ID ? "none" : "unknown";
+    }
+  }
 }
 
-Hit::Hit() noexcept : t(0.0) {}
+Hit::Hit() noexcept : primitive(NO_HIT_ID), t(0.0) {}
 
-Hit::Hit(const Object& object, float t) noexcept : object(object), t(t) {}
+Hit::Hit(const PrimitiveHandle primitive, float t) noexcept
+    : primitive(primitive), t(t) {}
 
-Hit::Hit(const Hit& other) noexcept : object(other.object), t(other.t) {}
+Hit::Hit(const Hit& other) noexcept
+    : primitive(other.primitive), t(other.t) {}
 
 Hit& Hit::operator=(const Hit& other) noexcept {
   if (this != &other) {
-    object = other.object;
+    primitive = other.primitive;
     t = other.t;
   }
   return *this;
 }
 
 bool Hit::operator==(const Hit& other) const {
-  return IsEqualFloat(t, other.t) && object == other.object;
+  return IsEqualFloat(t, other.t) && primitive == other.primitive;
 }
 
 bool Hit::operator!=(const Hit& other) const {
@@ -177,28 +308,113 @@ bool Hit::operator>=(const Hit& other) const {
   return t >= other.t;
 }
 
-Hits::Hits() noexcept : count(0) {}
+Hits::Hits() noexcept : Hits(static_cast<ScratchArena*>(nullptr)) {}
 
-Hits::Hits(size_t count) noexcept : hits(DyArray<Hit>(count)), count(count) {}
+Hits::Hits(ScratchArena* arena) noexcept
+    : data(inline_hits),
+      arena(arena),
+      data_arena(nullptr),
+      storage(HITS_INLINE),
+      capacity(HITS_INLINE_CAPACITY),
+      count(0) {}
 
-Hits::Hits(const Hits& other) noexcept : hits(other.hits), count(other.count) {}
+Hits::Hits(size_t count) noexcept : Hits() {
+  Reserve(count);
+  this->count = count;
+}
+
+Hits::Hits(const Hits& other) noexcept : Hits(other.arena) {
+  Reserve(other.count);
+  std::copy(other.data, other.data + other.count, data);
+  count = other.count;
+}
 
 Hits& Hits::operator=(const Hits& other) noexcept {
   if (this != &other) {
-    hits = other.hits;
+    count = 0;
+    Reserve(other.count);
+    std::copy(other.data, other.data + other.count, data);
     count = other.count;
   }
   return *this;
 }
 
+Hits::~Hits() noexcept { ReleaseStorage(); }
+
+ScratchArena* ThreadHitsArena() noexcept {
+  thread_local ScratchArena arena{HITS_BUFFER_SIZE * sizeof(Hit)};
+  return &arena;
+}
+
+void Hits::Reserve(size_t new_capacity) noexcept {
+  if (new_capacity <= capacity) {
+    return;
+  }
+  new_capacity = Max(new_capacity, capacity * 2);
+
+  if (storage == HITS_ARENA &&
+      data_arena->Extend(data, capacity * sizeof(Hit),
+                         new_capacity * sizeof(Hit))) {
+    std::uninitialized_fill_n(data + capacity, new_capacity - capacity, Hit{});
+    capacity = new_capacity;
+    return;
+  }
+
+  // NOTE: Outside a scope nothing would rewind the thread's arena, so the
+  // spill goes to the heap.
+  ScratchArena* spill_arena = arena;
+  if (spill_arena == nullptr && ThreadHitsArena()->scope_count > 0) {
+    spill_arena = ThreadHitsArena();
+  }
+  Hit* new_data = nullptr;
+  if (spill_arena != nullptr) {
+    new_data = static_cast<Hit*>(
+        spill_arena->Allocate(new_capacity * sizeof(Hit), alignof(Hit)));
+  }
+  HitsStorage new_storage = HITS_ARENA;
+  if (new_data == nullptr) {
+    new_data = static_cast<Hit*>(::operator new(new_capacity * sizeof(Hit)));
+    new_storage = HITS_HEAP;
+  }
+
+  // NOTE: Hit has a trivial destructor, so spilled storage is released
+  // without destroying the elements constructed here.
+  std::uninitialized_fill_n(new_data, new_capacity, Hit{});
+  std::copy(data, data + count, new_data);
+
+  ReleaseStorage();
+  data = new_data;
+  data_arena = new_storage == HITS_ARENA ? spill_arena : nullptr;
+  storage = new_storage;
+  capacity = new_capacity;
+}
+
+void Hits::ReleaseStorage() noexcept {
+  switch (storage) {
+    case HITS_HEAP: {
+      ::operator delete(data);
+      break;
+    }
+    case HITS_ARENA:
+    case HITS_INLINE: {
+      break;
+    }
+  }
+
+  data = inline_hits;
+  data_arena = nullptr;
+  storage = HITS_INLINE;
+  capacity = HITS_INLINE_CAPACITY;
+}
+
 Hit& Hits::operator[](size_t index) noexcept {
   assert(index < count);
-  return hits[index];
+  return data[index];
 }
 
 const Hit& Hits::operator[](size_t index) const noexcept {
   assert(index < count);
-  return hits[index];
+  return data[index];
 }
 
 bool Hits::operator==(const Hits& other) const {
@@ -207,7 +423,7 @@ bool Hits::operator==(const Hits& other) const {
   }
 
   for (size_t i = 0; i < count; ++i) {
-    if (hits[i] != other.hits[i]) {
+    if (data[i] != other.data[i]) {
       return false;
     }
   }
@@ -220,26 +436,38 @@ bool Hits::operator!=(const Hits& other) const {
 }
 
 void Hits::Push(const Hit& hit) noexcept {
-  if (count == 0) {
-    hits.Push(hit);
-    count++;
-    return;
+  if (count == capacity) {
+    Reserve(count + 1);
   }
 
-  size_t idx = 0;
-  while (idx < count && hits[idx] < hit) {
-    idx++;
-  }
-
-  hits.Insert(idx, hit);
+  Hit* position = std::lower_bound(data, data + count, hit);
+  std::copy_backward(position, data + count, data + count + 1);
+  *position = hit;
   count++;
 }
 
+void Hits::Append(const Hits& other) noexcept {
+  Reserve(count + other.count);
+  std::copy(other.data, other.data + other.count, data + count);
+  count += other.count;
+}
+
+void Hits::Append(const Hit& hit) noexcept {
+  if (count == capacity) {
+    Reserve(count + 1);
+  }
+  data[count++] = hit;
+}
+
+void Hits::Sort() noexcept { std::sort(data, data + count); }
+
+void Hits::Clear() noexcept { count = 0; }
+
 int32_t Hits::FirstHitIdx() noexcept {
   assert(count > 0);
 
   for (int32_t i = 0; i < count; i++) {
-    if (hits[i].t >= 0.0) {
+    if (data[i].t >= 0.0) {
       return i;
     }
   }
@@ -253,15 +481,14 @@ struct DrawRegionUnshadedContext {
   float wall_z;
   float pixel_size;
   float half_wall_size;
-  size_t start;
-  size_t end;
+  Tile tile;
 };
 
 static inline void DrawRegionUnshaded(
     Canvas* canvas, const DrawRegionUnshadedContext& context) {
-  for (size_t y = context.start; y < context.end; ++y) {
+  for (size_t y = context.tile.y0; y < context.tile.y1; ++y) {
     float world_y = context.half_wall_size - context.pixel_size * y;
-    for (size_t x = 0; x < canvas->width; ++x) {
+    for (size_t x = context.tile.x0; x < context.tile.x1; ++x) {
       float world_x = -context.half_wall_size + context.pixel_size * x;
 
       Point position{world_x, world_y, context.wall_z};
@@ -281,24 +508,15 @@ void CastShapeUnshaded(Canvas* canvas, const Point& ray_origin,
   float pixel_size = wall_size / static_cast<float>(canvas->width);
   float half_wall_size = wall_size / 2;
 
-  std::thread workers[10];
-  size_t workers_count = ArraySize(workers);
-  size_t chunk_size = canvas->height / workers_count;
-
-  for (size_t worker_idx = 0; worker_idx < workers_count; ++worker_idx) {
-    size_t start = chunk_size * worker_idx;
-    size_t end =
-        (worker_idx == workers_count - 1) ? canvas->height : start + chunk_size;
-
-    DrawRegionUnshadedContext context = {
-        ray_origin, shape, wall_z, pixel_size, half_wall_size, start, end};
-
-    workers[worker_idx] = std::thread(DrawRegionUnshaded, canvas, context);
-  }
-
-  for (size_t worker_idx = 0; worker_idx < workers_count; ++worker_idx) {
-    workers[worker_idx].join();
-  }
+  TileScheduler scheduler;
+  scheduler.Start(RenderPool(), canvas->width, canvas->height,
+                  [&](const Tile& tile) {
+                    DrawRegionUnshadedContext context = {
+                        ray_origin,     shape, wall_z, pixel_size,
+                        half_wall_size, tile};
+                    DrawRegionUnshaded(canvas, context);
+                  });
+  scheduler.Wait();
 }
 
 struct DrawRegionShadedContext {
@@ -308,62 +526,128 @@ struct DrawRegionShadedContext {
   float wall_z;
   float pixel_size;
   float half_wall_size;
-  size_t start;
-  size_t end;
+  Tile tile;
+  CastMode mode;
 };
 
-static inline void DrawRegionShaded(Canvas* canvas,
-                                    const DrawRegionShadedContext& context) {
-  for (size_t y = context.start; y < context.end; ++y) {
-    float world_y = context.half_wall_size - context.pixel_size * y;
-    for (size_t x = 0; x < canvas->width; ++x) {
-      float world_x = -context.half_wall_size + context.pixel_size * x;
+static inline Ray ShadowRay(const DrawRegionShadedContext& context,
+                            const Point& point, const Vector& normal) {
+  Point over_point{point + normal * SHADOW_EPSILON};
+  return {over_point, context.light.position - over_point};
+}
+
+static inline void ShadePixel(Canvas* canvas,
+                              const DrawRegionShadedContext& context, size_t x,
+                              size_t y, const Point& point,
+                              const Vector& normal, const Vector& eye,
+                              float visibility) {
+  Color color = Lighting(context.shape.material, context.light, point, eye,
+                         normal, visibility);
+  canvas->WriteColor(x, y, color);
+}
+
+static inline void DrawRowShaded(Canvas* canvas,
+                                 const DrawRegionShadedContext& context,
+                                 size_t y, float world_y) {
+  for (size_t x = context.tile.x0; x < context.tile.x1; ++x) {
+    float world_x = -context.half_wall_size + context.pixel_size * x;
+
+    Point position{world_x, world_y, context.wall_z};
+    Ray ray{context.ray_origin, (position - context.ray_origin).Normalize()};
+    HitRecord hit{ClosestHit(ray, context.shape, 0.F, INFINITY)};
+
+    if (hit.IsHit()) {
+      Point point{ray.Position(hit.t)};
+      Vector normal{context.shape.NormalAt(point)};
+      bool is_shadowed = IsOccluded(ShadowRay(context, point, normal),
+                                    &context.shape, 1, 0.F, 1.F);
+
+      ShadePixel(canvas, context, x, y, point, normal, -ray.direction,
+                 is_shadowed ? 0.F : 1.F);
+    }
+  }
+}
+
+static inline void DrawRowShadedPacket(Canvas* canvas,
+                                       const DrawRegionShadedContext& context,
+                                       size_t y, float world_y) {
+  size_t packet_width = RayPacketWidth();
+  Point points[RAY_PACKET_MAX_WIDTH];
+  Vector normals[RAY_PACKET_MAX_WIDTH];
+
+  for (size_t x0 = context.tile.x0; x0 < context.tile.x1;
+       x0 += packet_width) {
+    size_t lanes = Min(packet_width, context.tile.x1 - x0);
+
+    RayPacket packet{packet_width};
+    for (size_t lane = 0; lane < lanes; ++lane) {
+      float world_x =
+          -context.half_wall_size + context.pixel_size * (x0 + lane);
 
       Point position{world_x, world_y, context.wall_z};
-      Ray ray{context.ray_origin, (position - context.ray_origin).Normalize()};
-      Hits hits{ray.Intersect(context.shape)};
+      packet.SetRay(lane, {context.ray_origin,
+                           (position - context.ray_origin).Normalize()});
+    }
 
-      if (hits.count > 0) {
-        Hit hit{hits[0]};
-        Sphere* object = reinterpret_cast<Sphere*>(hit.object.data);
+    PacketHits hits{packet.Intersect(context.shape)};
 
-        Point point{ray.Position(hit.t)};
-        Vector normal{object->NormalAt(point)};
-        Vector eye{-ray.direction};
+    RayPacket shadow_packet{packet_width};
+    for (size_t lane = 0; lane < lanes; ++lane) {
+      float t = hits.t_near[lane] >= 0.F ? hits.t_near[lane] : hits.t_far[lane];
+      if (hits.IsHit(lane) && t >= 0.F) {
+        points[lane] = packet.GetRay(lane).Position(t);
+        normals[lane] = context.shape.NormalAt(points[lane]);
+        shadow_packet.SetRay(lane,
+                             ShadowRay(context, points[lane], normals[lane]));
+      }
+    }
 
-        Color color =
-            Lighting(object->material, context.light, point, eye, normal);
-        canvas->WriteColor(x, y, color);
+    uint32_t shadowed_mask =
+        shadow_packet.Occluded(&context.shape, 1, 0.F, 1.F);
+    for (size_t lane = 0; lane < lanes; ++lane) {
+      if (shadow_packet.IsActive(lane)) {
+        bool is_shadowed = (shadowed_mask & (1U << lane)) != 0;
+        ShadePixel(canvas, context, x0 + lane, y, points[lane], normals[lane],
+                   -packet.GetRay(lane).direction, is_shadowed ? 0.F : 1.F);
       }
     }
   }
 }
 
+static inline void DrawRegionShaded(Canvas* canvas,
+                                    const DrawRegionShadedContext& context) {
+  for (size_t y = context.tile.y0; y < context.tile.y1; ++y) {
+    float world_y = context.half_wall_size - context.pixel_size * y;
+    if (context.mode == CAST_RAY_PACKET) {
+      DrawRowShadedPacket(canvas, context, y, world_y);
+    } else {
+      DrawRowShaded(canvas, context, y, world_y);
+    }
+  }
+}
+
 void CastShapeShaded(Canvas* canvas, const Point& ray_origin,
                      const Sphere& shape, const PointLight& light, float wall_z,
                      float wall_size) noexcept {
+  CastShapeShaded(canvas, ray_origin, shape, light, wall_z, wall_size,
+                  CAST_SINGLE_RAY);
+}
+
+void CastShapeShaded(Canvas* canvas, const Point& ray_origin,
+                     const Sphere& shape, const PointLight& light, float wall_z,
+                     float wall_size, CastMode mode) noexcept {
   float pixel_size = wall_size / static_cast<float>(canvas->width);
   float half_wall_size = wall_size / 2;
 
-  std::thread workers[20];
-  size_t workers_count = ArraySize(workers);
-  size_t chunk_size = canvas->height / workers_count;
-
-  for (size_t worker_idx = 0; worker_idx < workers_count; ++worker_idx) {
-    size_t start = chunk_size * worker_idx;
-    size_t end =
-        (worker_idx == workers_count - 1) ? canvas->height : start + chunk_size;
-
-    DrawRegionShadedContext context = {ray_origin, shape,      light,
-                                       wall_z,     pixel_size, half_wall_size,
-                                       start,      end};
-
-    workers[worker_idx] = std::thread(DrawRegionShaded, canvas, context);
-  }
-
-  for (size_t worker_idx = 0; worker_idx < workers_count; ++worker_idx) {
-    workers[worker_idx].join();
-  }
+  TileScheduler scheduler;
+  scheduler.Start(RenderPool(), canvas->width, canvas->height,
+                  [&](const Tile& tile) {
+                    DrawRegionShadedContext context = {
+                        ray_origin, shape,          light, wall_z,
+                        pixel_size, half_wall_size, tile,  mode};
+                    DrawRegionShaded(canvas, context);
+                  });
+  scheduler.Wait();
 }
 
 Ray::operator std::string() const noexcept {
@@ -388,25 +672,9 @@ std::ostream& operator<<(std::ostream& os, const Sphere& sphere) {
   return os;
 }
 
-Object::operator std::string() const noexcept {
-  switch (type) {
-    case (1): {
-      Sphere sphere = *reinterpret_cast<Sphere*>(data);
-      return std::format("Object(type=SPHERE, data={})", std::string(sphere));
-    }
-    default: {
-      return "Object(type=UNKNOWN)";
-    }
-  }
-}
-
-std::ostream& operator<<(std::ostream& os, const Object& object) {
-  os << std::string(object);
-  return os;
-}
-
 Hit::operator std::string() const noexcept {
-  return std::format("Hit(t={:.10f}, object={})", t, std::string(object));
+  return std::format("Hit(t={:.10f}, primitive={})", t,
+                     HandleString(primitive));
 }
 
 std::ostream& operator<<(std::ostream& os, const Hit& hit) {
@@ -425,7 +693,7 @@ Hits::operator std::string() const noexcept {
   str += ", ";
 
   for (size_t i = 0; i < count; ++i) {
-    str += std::string(hits[i]);
+    str += std::string(data[i]);
     if (i < count - 1) {
       str += ", ";
     }
@@ -440,3 +708,15 @@ std::ostream& operator<<(std::ostream& os, const Hits& hits) {
   os << std::string(hits);
   return os;
 }
+
+HitRecord::operator std::string() const noexcept {
+  if (!IsHit()) {
+    return "HitRecord(miss)";
+  }
+  return std::format("HitRecord(object_id={}, t={:.10f})", object_id, t);
+}
+
+std::ostream& operator<<(std::ostream& os, const HitRecord& record) {
+  os << std::string(record);
+  return os;
+}
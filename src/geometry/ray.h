@@ -1,25 +1,61 @@
 #ifndef SRC_GEOMETRY_RAY_H_
 #define SRC_GEOMETRY_RAY_H_
 
-#include <core/arr.h>
+#include <core/arena.h>
 #include <geometry/matrix.h>
 #include <geometry/point.h>
+#include <geometry/trs_transform.h>
 #include <geometry/vector.h>
 #include <render/canvas.h>
 #include <render/light.h>
 #include <render/material.h>
 
+#include <cstdint>
 #include <string>
 
+// NOTE: Hits keeps up to HITS_INLINE_CAPACITY hits inline and spills into a
+// ScratchArena beyond that: the one it was given, or the calling thread's
+// while a ScratchScope is open on it, and the heap otherwise or once the
+// arena is exhausted. The per-thread spill arena holds HITS_BUFFER_SIZE
+// hits.
+#define HITS_INLINE_CAPACITY 4
 #define HITS_BUFFER_SIZE 10240
 
 typedef struct Hits Hits;
 
-enum ObjectType { SPHERE = 1 };
+// NOTE: A PrimitiveHandle packs the type of a primitive into its top
+// PRIMITIVE_TYPE_BITS bits and its index into that type's storage into the
+// rest. Spheres are type 0, so a sphere's handle is its index, and
+// NO_HIT_ID has an invalid type.
+#define PRIMITIVE_TYPE_BITS 4
+#define PRIMITIVE_INDEX_BITS (32 - PRIMITIVE_TYPE_BITS)
+#define PRIMITIVE_INDEX_MASK ((1U << PRIMITIVE_INDEX_BITS) - 1)
+
+enum PrimitiveType {
+  PRIMITIVE_SPHERE,
+  PRIMITIVE_TRIANGLE,
+  PRIMITIVE_TYPE_COUNT
+};
+
+typedef uint32_t PrimitiveHandle;
+
+PrimitiveHandle MakePrimitiveHandle(PrimitiveType type,
+                                    uint32_t index) noexcept;
+PrimitiveType HandleType(PrimitiveHandle handle) noexcept;
+uint32_t HandleIndex(PrimitiveHandle handle) noexcept;
+std::string HandleString(PrimitiveHandle handle) noexcept;
+
+// NOTE: How CastShapeShaded traces primary rays: one ray at a time, or in
+// RayPackets of RayPacketWidth() lanes.
+enum CastMode { CAST_SINGLE_RAY, CAST_RAY_PACKET };
 
 struct Sphere {
   Point origin;
+  // NOTE: Write through SetTransform so the cached inverse and
+  // inverse-transpose stay in sync.
   Matrix transform_matrix;
+  AffineTransform inverse_transform;
+  AffineTransform inverse_transpose;
   Material material;
   float radius;
 
@@ -34,6 +70,8 @@ struct Sphere {
   bool operator==(const Sphere& other) const noexcept;
   bool operator!=(const Sphere& other) const noexcept;
 
+  void SetTransform(const Matrix& transform) noexcept;
+  void SetTransform(const TrsTransform& transform) noexcept;
   Vector NormalAt(const Point& point) const noexcept;
 
   operator std::string() const noexcept;
@@ -41,23 +79,6 @@ struct Sphere {
 
 std::ostream& operator<<(std::ostream& os, const Sphere& sphere);
 
-struct Object {
-  void* data;
-  ObjectType type;
-
-  Object() noexcept;
-  Object(void* data, ObjectType type) noexcept;
-  Object(const Object& other) noexcept;
-  Object& operator=(const Object& other) noexcept;
-
-  bool operator==(const Object& other) const;
-  bool operator!=(const Object& other) const;
-
-  operator std::string() const noexcept;
-};
-
-std::ostream& operator<<(std::ostream& os, const Object& object);
-
 struct Ray {
   Point origin;
   Vector direction;
@@ -71,8 +92,16 @@ struct Ray {
   bool operator!=(const Ray& other) const noexcept;
 
   Point Position(float t) const noexcept;
-  Hits Intersect(Sphere sphere) const noexcept;
+  // NOTE: Hits of a lone sphere refer to it as sphere 0; pass its handle
+  // when it is part of a larger scene.
+  Hits Intersect(const Sphere& sphere) const noexcept;
+  Hits Intersect(const Sphere& sphere, PrimitiveHandle handle) const noexcept;
+  bool IntersectClosest(const Sphere& sphere, float tmin,
+                        float* tmax) const noexcept;
+  bool IntersectAny(const Sphere& sphere, float tmin,
+                    float tmax) const noexcept;
   Ray Transform(Matrix transform) const noexcept;
+  Ray Transform(const AffineTransform& transform) const noexcept;
 
   operator std::string() const noexcept;
 };
@@ -80,11 +109,11 @@ struct Ray {
 std::ostream& operator<<(std::ostream& os, const Ray& ray);
 
 struct Hit {
-  Object object;
+  PrimitiveHandle primitive;
   float t;
 
   Hit() noexcept;
-  Hit(const Object& object, float t) noexcept;
+  Hit(PrimitiveHandle primitive, float t) noexcept;
   Hit(const Hit& other) noexcept;
   Hit& operator=(const Hit& other) noexcept;
 
@@ -100,20 +129,34 @@ struct Hit {
 
 std::ostream& operator<<(std::ostream& os, const Hit& hit);
 
+enum HitsStorage { HITS_INLINE, HITS_ARENA, HITS_HEAP };
+
 struct Hits {
-  DyArray<Hit> hits;
+  Hit inline_hits[HITS_INLINE_CAPACITY];
+  Hit* data;
+  // NOTE: Arena to spill into; nullptr selects the calling thread's arena.
+  // data_arena is the arena that owns data while it is spilled. Spilled
+  // storage is not given back to the arena when released; the arena's
+  // owner reclaims it, so a spilled Hits must not outlive the ScratchScope
+  // it spilled in.
+  ScratchArena* arena;
+  ScratchArena* data_arena;
+  HitsStorage storage;
+  size_t capacity;
   size_t count;
 
   Hits() noexcept;
+  explicit Hits(ScratchArena* arena) noexcept;
   explicit Hits(size_t count) noexcept;
   Hits(const Hits& other) noexcept;
 
-  Hits(std::initializer_list<Hit> hit_list) noexcept : count(0) {
+  Hits(std::initializer_list<Hit> hit_list) noexcept : Hits() {
     for (const auto& hit : hit_list) {
       Push(hit);
     }
   }
   Hits& operator=(const Hits& other) noexcept;
+  ~Hits() noexcept;
 
   Hit& operator[](size_t index) noexcept;
   const Hit& operator[](size_t index) const noexcept;
@@ -122,13 +165,65 @@ struct Hits {
   bool operator!=(const Hits& other) const;
 
   void Push(const Hit& hit) noexcept;
+  // NOTE: Append adds hits past the end without keeping them ordered, so
+  // many per-object runs can be gathered and then merged or ordered by one
+  // Sort instead of one Push each. Call Sort before reading appended hits
+  // in order, unless they were appended in order.
+  void Append(const Hits& other) noexcept;
+  void Append(const Hit& hit) noexcept;
+  void Sort() noexcept;
+  void Clear() noexcept;
   int32_t FirstHitIdx() noexcept;
 
   operator std::string() const noexcept;
+
+ private:
+  void Reserve(size_t new_capacity) noexcept;
+  void ReleaseStorage() noexcept;
 };
 
+// NOTE: Spill arena for Hits created without an explicit arena on the
+// calling thread, used only inside a ScratchScope on it; render loops open
+// one per tile. Its buffer is allocated on first use per thread.
+ScratchArena* ThreadHitsArena() noexcept;
+
 std::ostream& operator<<(std::ostream& os, const Hits& hits);
 
+#define NO_HIT_ID UINT32_MAX
+
+// NOTE: Nearest hit of a ray against a set of objects. object_id indexes
+// the queried objects and is NO_HIT_ID when nothing was hit; queries over
+// more than one primitive type return a PrimitiveHandle in it instead.
+struct HitRecord {
+  uint32_t object_id;
+  float t;
+
+  bool IsHit() const noexcept;
+
+  operator std::string() const noexcept;
+};
+
+std::ostream& operator<<(std::ostream& os, const HitRecord& record);
+
+// NOTE: Finds the nearest hit with tmin <= t < tmax. tmax shrinks to each
+// accepted hit, so objects behind the current nearest hit are rejected
+// before their roots are taken.
+HitRecord ClosestHit(const Ray& ray, const Sphere* spheres, size_t count,
+                     float tmin, float tmax) noexcept;
+HitRecord ClosestHit(const Ray& ray, const Sphere& sphere, float tmin,
+                     float tmax) noexcept;
+
+// NOTE: Any-hit query for shadow rays: true as soon as one sphere has a
+// surface crossing with tmin < t < tmax. Roots are never computed. Shadow
+// rays can use the unnormalized direction to the light with (0, 1) so no
+// normalization is needed either.
+bool IsOccluded(const Ray& ray, const Sphere* spheres, size_t count,
+                float tmin, float tmax) noexcept;
+
+// NOTE: Offset along the surface normal for shadow ray origins, so a
+// surface does not shadow itself through rounding.
+#define SHADOW_EPSILON 1e-3F
+
 void CastShapeUnshaded(Canvas* canvas, const Point& ray_origin,
                        const Sphere& shape, float wall_z,
                        float wall_size) noexcept;
@@ -136,5 +231,8 @@ void CastShapeUnshaded(Canvas* canvas, const Point& ray_origin,
 void CastShapeShaded(Canvas* canvas, const Point& ray_origin,
                      const Sphere& shape, const PointLight& light, float wall_z,
                      float wall_size) noexcept;
+void CastShapeShaded(Canvas* canvas, const Point& ray_origin,
+                     const Sphere& shape, const PointLight& light, float wall_z,
+                     float wall_size, CastMode mode) noexcept;
 
 #endif  // SRC_GEOMETRY_RAY_H_
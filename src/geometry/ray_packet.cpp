@@ -0,0 +1,603 @@
+#include <core/cpu.h>
+#include <core/test_suite.h>
+#include <geometry/ray.h>
+#include <geometry/ray_packet.h>
+#include <immintrin.h>
+
+#include <cassert>
+#include <cstdint>
+#include <format>
+#include <iostream>
+#include <string>
+
+RayPacket::RayPacket() noexcept : RayPacket(RayPacketWidth()) {}
+
+RayPacket::RayPacket(const size_t width) noexcept
+    : active_mask(0), width(width) {
+  assert(width > 0 && width <= RAY_PACKET_MAX_WIDTH);
+  for (size_t lane = 0; lane < RAY_PACKET_MAX_WIDTH; ++lane) {
+    origin_xs[lane] = 0;
+    origin_ys[lane] = 0;
+    origin_zs[lane] = 0;
+    direction_xs[lane] = 0;
+    direction_ys[lane] = 0;
+    direction_zs[lane] = 0;
+  }
+}
+
+RayPacket::RayPacket(const RayPacket& other) noexcept
+    : active_mask(other.active_mask), width(other.width) {
+  for (size_t lane = 0; lane < RAY_PACKET_MAX_WIDTH; ++lane) {
+    origin_xs[lane] = other.origin_xs[lane];
+    origin_ys[lane] = other.origin_ys[lane];
+    origin_zs[lane] = other.origin_zs[lane];
+    direction_xs[lane] = other.direction_xs[lane];
+    direction_ys[lane] = other.direction_ys[lane];
+    direction_zs[lane] = other.direction_zs[lane];
+  }
+}
+
+RayPacket& RayPacket::operator=(const RayPacket& other) noexcept {
+  if (this != &other) {
+    for (size_t lane = 0; lane < RAY_PACKET_MAX_WIDTH; ++lane) {
+      origin_xs[lane] = other.origin_xs[lane];
+      origin_ys[lane] = other.origin_ys[lane];
+      origin_zs[lane] = other.origin_zs[lane];
+      direction_xs[lane] = other.direction_xs[lane];
+      direction_ys[lane] = other.direction_ys[lane];
+      direction_zs[lane] = other.direction_zs[lane];
+    }
+    active_mask = other.active_mask;
+    width = other.width;
+  }
+  return *this;
+}
+
+void RayPacket::SetRay(const size_t lane, const Ray& ray) noexcept {
+  assert(lane < width);
+  origin_xs[lane] = ray.origin.x;
+  origin_ys[lane] = ray.origin.y;
+  origin_zs[lane] = ray.origin.z;
+  direction_xs[lane] = ray.direction.x;
+  direction_ys[lane] = ray.direction.y;
+  direction_zs[lane] = ray.direction.z;
+  active_mask |= 1U << lane;
+}
+
+Ray RayPacket::GetRay(const size_t lane) const noexcept {
+  assert(lane < width);
+  return {{origin_xs[lane], origin_ys[lane], origin_zs[lane]},
+          {direction_xs[lane], direction_ys[lane], direction_zs[lane]}};
+}
+
+bool RayPacket::IsActive(const size_t lane) const noexcept {
+  return (active_mask & (1U << lane)) != 0;
+}
+
+PacketHits::PacketHits() noexcept : hit_mask(0) {
+  for (size_t lane = 0; lane < RAY_PACKET_MAX_WIDTH; ++lane) {
+    t_near[lane] = 0;
+    t_far[lane] = 0;
+  }
+}
+
+bool PacketHits::IsHit(const size_t lane) const noexcept {
+  return (hit_mask & (1U << lane)) != 0;
+}
+
+size_t RayPacketWidth() noexcept {
+  switch (GetIsaLevel()) {
+    case ISA_AVX512:
+      return 16;
+    case ISA_AVX2:
+      return 8;
+    default:
+      return 4;
+  }
+}
+
+// NOTE: The kernels mirror Ray::Intersect lane-wise: rays are moved into
+// object space with the sphere's cached inverse and the quadratic
+// a*t^2 + b*t + c is set up per lane. Intersect treats a discriminant within
+// ABSOLUTE_TOLERANCE of zero as a tangent hit with one root.
+struct PacketSphere {
+  float m[12];
+  float origin_x;
+  float origin_y;
+  float origin_z;
+};
+
+static inline PacketSphere MakePacketSphere(const Sphere& sphere) noexcept {
+  const AffineTransform& inverse = sphere.inverse_transform;
+  return {{inverse.m0, inverse.m1, inverse.m2, inverse.m3, inverse.m4,
+           inverse.m5, inverse.m6, inverse.m7, inverse.m8, inverse.m9,
+           inverse.m10, inverse.m11},
+          sphere.origin.x,
+          sphere.origin.y,
+          sphere.origin.z};
+}
+
+struct SphereSSE {
+  __m128 m[12];
+  __m128 origin_x;
+  __m128 origin_y;
+  __m128 origin_z;
+};
+
+static inline SphereSSE LoadSphereSSE(const PacketSphere& sphere) noexcept {
+  SphereSSE res;
+  for (size_t k = 0; k < 12; ++k) {
+    res.m[k] = _mm_set1_ps(sphere.m[k]);
+  }
+  res.origin_x = _mm_set1_ps(sphere.origin_x);
+  res.origin_y = _mm_set1_ps(sphere.origin_y);
+  res.origin_z = _mm_set1_ps(sphere.origin_z);
+  return res;
+}
+
+static inline void QuadraticSSE(const SphereSSE& sphere,
+                                const RayPacket& packet, size_t i, __m128* a,
+                                __m128* b, __m128* c) noexcept {
+  const __m128* m = sphere.m;
+  __m128 ox = _mm_load_ps(packet.origin_xs + i);
+  __m128 oy = _mm_load_ps(packet.origin_ys + i);
+  __m128 oz = _mm_load_ps(packet.origin_zs + i);
+  __m128 dx = _mm_load_ps(packet.direction_xs + i);
+  __m128 dy = _mm_load_ps(packet.direction_ys + i);
+  __m128 dz = _mm_load_ps(packet.direction_zs + i);
+
+  __m128 ocx = _mm_sub_ps(
+      _mm_add_ps(_mm_add_ps(_mm_mul_ps(m[0], ox), _mm_mul_ps(m[1], oy)),
+                 _mm_add_ps(_mm_mul_ps(m[2], oz), m[3])),
+      sphere.origin_x);
+  __m128 ocy = _mm_sub_ps(
+      _mm_add_ps(_mm_add_ps(_mm_mul_ps(m[4], ox), _mm_mul_ps(m[5], oy)),
+                 _mm_add_ps(_mm_mul_ps(m[6], oz), m[7])),
+      sphere.origin_y);
+  __m128 ocz = _mm_sub_ps(
+      _mm_add_ps(_mm_add_ps(_mm_mul_ps(m[8], ox), _mm_mul_ps(m[9], oy)),
+                 _mm_add_ps(_mm_mul_ps(m[10], oz), m[11])),
+      sphere.origin_z);
+  __m128 tdx = _mm_add_ps(
+      _mm_add_ps(_mm_mul_ps(m[0], dx), _mm_mul_ps(m[1], dy)),
+      _mm_mul_ps(m[2], dz));
+  __m128 tdy = _mm_add_ps(
+      _mm_add_ps(_mm_mul_ps(m[4], dx), _mm_mul_ps(m[5], dy)),
+      _mm_mul_ps(m[6], dz));
+  __m128 tdz = _mm_add_ps(
+      _mm_add_ps(_mm_mul_ps(m[8], dx), _mm_mul_ps(m[9], dy)),
+      _mm_mul_ps(m[10], dz));
+
+  *a = _mm_add_ps(_mm_add_ps(_mm_mul_ps(tdx, tdx), _mm_mul_ps(tdy, tdy)),
+                  _mm_mul_ps(tdz, tdz));
+  __m128 half_b = _mm_add_ps(
+      _mm_add_ps(_mm_mul_ps(tdx, ocx), _mm_mul_ps(tdy, ocy)),
+      _mm_mul_ps(tdz, ocz));
+  *b = _mm_add_ps(half_b, half_b);
+  *c = _mm_sub_ps(
+      _mm_add_ps(_mm_add_ps(_mm_mul_ps(ocx, ocx), _mm_mul_ps(ocy, ocy)),
+                 _mm_mul_ps(ocz, ocz)),
+      _mm_set1_ps(1.F));
+}
+
+struct SphereAVX2 {
+  __m256 m[12];
+  __m256 origin_x;
+  __m256 origin_y;
+  __m256 origin_z;
+};
+
+static inline SphereAVX2 LoadSphereAVX2(const PacketSphere& sphere) noexcept {
+  SphereAVX2 res;
+  for (size_t k = 0; k < 12; ++k) {
+    res.m[k] = _mm256_set1_ps(sphere.m[k]);
+  }
+  res.origin_x = _mm256_set1_ps(sphere.origin_x);
+  res.origin_y = _mm256_set1_ps(sphere.origin_y);
+  res.origin_z = _mm256_set1_ps(sphere.origin_z);
+  return res;
+}
+
+static inline void QuadraticAVX2(const SphereAVX2& sphere,
+                                 const RayPacket& packet, size_t i, __m256* a,
+                                 __m256* b, __m256* c) noexcept {
+  const __m256* m = sphere.m;
+  __m256 ox = _mm256_load_ps(packet.origin_xs + i);
+  __m256 oy = _mm256_load_ps(packet.origin_ys + i);
+  __m256 oz = _mm256_load_ps(packet.origin_zs + i);
+  __m256 dx = _mm256_load_ps(packet.direction_xs + i);
+  __m256 dy = _mm256_load_ps(packet.direction_ys + i);
+  __m256 dz = _mm256_load_ps(packet.direction_zs + i);
+
+  __m256 ocx = _mm256_fmadd_ps(
+      m[0], ox,
+      _mm256_fmadd_ps(m[1], oy,
+                      _mm256_fmadd_ps(m[2], oz,
+                                      _mm256_sub_ps(m[3], sphere.origin_x))));
+  __m256 ocy = _mm256_fmadd_ps(
+      m[4], ox,
+      _mm256_fmadd_ps(m[5], oy,
+                      _mm256_fmadd_ps(m[6], oz,
+                                      _mm256_sub_ps(m[7], sphere.origin_y))));
+  __m256 ocz = _mm256_fmadd_ps(
+      m[8], ox,
+      _mm256_fmadd_ps(m[9], oy,
+                      _mm256_fmadd_ps(m[10], oz,
+                                      _mm256_sub_ps(m[11], sphere.origin_z))));
+  __m256 tdx = _mm256_fmadd_ps(
+      m[0], dx, _mm256_fmadd_ps(m[1], dy, _mm256_mul_ps(m[2], dz)));
+  __m256 tdy = _mm256_fmadd_ps(
+      m[4], dx, _mm256_fmadd_ps(m[5], dy, _mm256_mul_ps(m[6], dz)));
+  __m256 tdz = _mm256_fmadd_ps(
+      m[8], dx, _mm256_fmadd_ps(m[9], dy, _mm256_mul_ps(m[10], dz)));
+
+  *a = _mm256_fmadd_ps(tdx, tdx,
+                       _mm256_fmadd_ps(tdy, tdy, _mm256_mul_ps(tdz, tdz)));
+  __m256 half_b = _mm256_fmadd_ps(
+      tdx, ocx, _mm256_fmadd_ps(tdy, ocy, _mm256_mul_ps(tdz, ocz)));
+  *b = _mm256_add_ps(half_b, half_b);
+  *c = _mm256_fmadd_ps(
+      ocx, ocx,
+      _mm256_fmadd_ps(ocy, ocy,
+                      _mm256_fmsub_ps(ocz, ocz, _mm256_set1_ps(1.F))));
+}
+
+struct SphereAVX512 {
+  __m512 m[12];
+  __m512 origin_x;
+  __m512 origin_y;
+  __m512 origin_z;
+};
+
+static inline SphereAVX512 LoadSphereAVX512(
+    const PacketSphere& sphere) noexcept {
+  SphereAVX512 res;
+  for (size_t k = 0; k < 12; ++k) {
+    res.m[k] = _mm512_set1_ps(sphere.m[k]);
+  }
+  res.origin_x = _mm512_set1_ps(sphere.origin_x);
+  res.origin_y = _mm512_set1_ps(sphere.origin_y);
+  res.origin_z = _mm512_set1_ps(sphere.origin_z);
+  return res;
+}
+
+static inline void QuadraticAVX512(const SphereAVX512& sphere,
+                                   const RayPacket& packet, size_t i,
+                                   __m512* a, __m512* b, __m512* c) noexcept {
+  const __m512* m = sphere.m;
+  __m512 ox = _mm512_load_ps(packet.origin_xs + i);
+  __m512 oy = _mm512_load_ps(packet.origin_ys + i);
+  __m512 oz = _mm512_load_ps(packet.origin_zs + i);
+  __m512 dx = _mm512_load_ps(packet.direction_xs + i);
+  __m512 dy = _mm512_load_ps(packet.direction_ys + i);
+  __m512 dz = _mm512_load_ps(packet.direction_zs + i);
+
+  __m512 ocx = _mm512_fmadd_ps(
+      m[0], ox,
+      _mm512_fmadd_ps(m[1], oy,
+                      _mm512_fmadd_ps(m[2], oz,
+                                      _mm512_sub_ps(m[3], sphere.origin_x))));
+  __m512 ocy = _mm512_fmadd_ps(
+      m[4], ox,
+      _mm512_fmadd_ps(m[5], oy,
+                      _mm512_fmadd_ps(m[6], oz,
+                                      _mm512_sub_ps(m[7], sphere.origin_y))));
+  __m512 ocz = _mm512_fmadd_ps(
+      m[8], ox,
+      _mm512_fmadd_ps(m[9], oy,
+                      _mm512_fmadd_ps(m[10], oz,
+                                      _mm512_sub_ps(m[11], sphere.origin_z))));
+  __m512 tdx = _mm512_fmadd_ps(
+      m[0], dx, _mm512_fmadd_ps(m[1], dy, _mm512_mul_ps(m[2], dz)));
+  __m512 tdy = _mm512_fmadd_ps(
+      m[4], dx, _mm512_fmadd_ps(m[5], dy, _mm512_mul_ps(m[6], dz)));
+  __m512 tdz = _mm512_fmadd_ps(
+      m[8], dx, _mm512_fmadd_ps(m[9], dy, _mm512_mul_ps(m[10], dz)));
+
+  *a = _mm512_fmadd_ps(tdx, tdx,
+                       _mm512_fmadd_ps(tdy, tdy, _mm512_mul_ps(tdz, tdz)));
+  __m512 half_b = _mm512_fmadd_ps(
+      tdx, ocx, _mm512_fmadd_ps(tdy, ocy, _mm512_mul_ps(tdz, ocz)));
+  *b = _mm512_add_ps(half_b, half_b);
+  *c = _mm512_fmadd_ps(
+      ocx, ocx,
+      _mm512_fmadd_ps(ocy, ocy,
+                      _mm512_fmsub_ps(ocz, ocz, _mm512_set1_ps(1.F))));
+}
+
+static inline uint32_t IntersectPacketSSE(const RayPacket& packet,
+                                          const PacketSphere& packet_sphere,
+                                          PacketHits* hits) noexcept {
+  SphereSSE sphere{LoadSphereSSE(packet_sphere)};
+  __m128 tolerance = _mm_set1_ps(static_cast<float>(ABSOLUTE_TOLERANCE));
+  __m128 abs_mask = _mm_set1_ps(-0.F);
+
+  uint32_t hit_mask = 0;
+  for (size_t i = 0; i < packet.width; i += 4) {
+    __m128 a;
+    __m128 b;
+    __m128 c;
+    QuadraticSSE(sphere, packet, i, &a, &b, &c);
+
+    __m128 discriminant = _mm_sub_ps(
+        _mm_mul_ps(b, b), _mm_mul_ps(_mm_set1_ps(4.F), _mm_mul_ps(a, c)));
+    __m128 is_tangent =
+        _mm_cmple_ps(_mm_andnot_ps(abs_mask, discriminant), tolerance);
+    __m128 is_hit = _mm_or_ps(
+        is_tangent, _mm_cmpgt_ps(discriminant, _mm_setzero_ps()));
+    __m128 root = _mm_sqrt_ps(_mm_andnot_ps(
+        is_tangent, _mm_max_ps(discriminant, _mm_setzero_ps())));
+
+    __m128 neg_b = _mm_xor_ps(b, abs_mask);
+    __m128 two_a = _mm_add_ps(a, a);
+    _mm_store_ps(hits->t_near + i,
+                 _mm_div_ps(_mm_sub_ps(neg_b, root), two_a));
+    _mm_store_ps(hits->t_far + i, _mm_div_ps(_mm_add_ps(neg_b, root), two_a));
+
+    hit_mask |= static_cast<uint32_t>(_mm_movemask_ps(is_hit)) << i;
+  }
+  return hit_mask;
+}
+
+static inline uint32_t IntersectPacketAVX2(const RayPacket& packet,
+                                           const PacketSphere& packet_sphere,
+                                           PacketHits* hits) noexcept {
+  SphereAVX2 sphere{LoadSphereAVX2(packet_sphere)};
+  __m256 tolerance = _mm256_set1_ps(static_cast<float>(ABSOLUTE_TOLERANCE));
+  __m256 abs_mask = _mm256_set1_ps(-0.F);
+
+  uint32_t hit_mask = 0;
+  for (size_t i = 0; i < packet.width; i += 8) {
+    __m256 a;
+    __m256 b;
+    __m256 c;
+    QuadraticAVX2(sphere, packet, i, &a, &b, &c);
+
+    __m256 discriminant = _mm256_fnmadd_ps(
+        _mm256_set1_ps(4.F), _mm256_mul_ps(a, c), _mm256_mul_ps(b, b));
+    __m256 is_tangent = _mm256_cmp_ps(
+        _mm256_andnot_ps(abs_mask, discriminant), tolerance, _CMP_LE_OQ);
+    __m256 is_hit = _mm256_or_ps(
+        is_tangent,
+        _mm256_cmp_ps(discriminant, _mm256_setzero_ps(), _CMP_GT_OQ));
+    __m256 root = _mm256_sqrt_ps(_mm256_andnot_ps(
+        is_tangent, _mm256_max_ps(discriminant, _mm256_setzero_ps())));
+
+    __m256 neg_b = _mm256_xor_ps(b, abs_mask);
+    __m256 two_a = _mm256_add_ps(a, a);
+    _mm256_store_ps(hits->t_near + i,
+                    _mm256_div_ps(_mm256_sub_ps(neg_b, root), two_a));
+    _mm256_store_ps(hits->t_far + i,
+                    _mm256_div_ps(_mm256_add_ps(neg_b, root), two_a));
+
+    hit_mask |= static_cast<uint32_t>(_mm256_movemask_ps(is_hit)) << i;
+  }
+  _mm256_zeroupper();
+  return hit_mask;
+}
+
+static inline uint32_t IntersectPacketAVX512(
+    const RayPacket& packet, const PacketSphere& packet_sphere,
+    PacketHits* hits) noexcept {
+  SphereAVX512 sphere{LoadSphereAVX512(packet_sphere)};
+  __m512 tolerance = _mm512_set1_ps(static_cast<float>(ABSOLUTE_TOLERANCE));
+
+  uint32_t hit_mask = 0;
+  for (size_t i = 0; i < packet.width; i += 16) {
+    __m512 a;
+    __m512 b;
+    __m512 c;
+    QuadraticAVX512(sphere, packet, i, &a, &b, &c);
+
+    __m512 discriminant = _mm512_fnmadd_ps(
+        _mm512_set1_ps(4.F), _mm512_mul_ps(a, c), _mm512_mul_ps(b, b));
+    __mmask16 is_tangent = _mm512_cmp_ps_mask(
+        _mm512_abs_ps(discriminant), tolerance, _CMP_LE_OQ);
+    __mmask16 is_hit = is_tangent | _mm512_cmp_ps_mask(
+        discriminant, _mm512_setzero_ps(), _CMP_GT_OQ);
+    __m512 root = _mm512_maskz_sqrt_ps(
+        static_cast<__mmask16>(~is_tangent),
+        _mm512_max_ps(discriminant, _mm512_setzero_ps()));
+
+    __m512 neg_b = _mm512_sub_ps(_mm512_setzero_ps(), b);
+    __m512 two_a = _mm512_add_ps(a, a);
+    _mm512_store_ps(hits->t_near + i,
+                    _mm512_div_ps(_mm512_sub_ps(neg_b, root), two_a));
+    _mm512_store_ps(hits->t_far + i,
+                    _mm512_div_ps(_mm512_add_ps(neg_b, root), two_a));
+
+    hit_mask |= static_cast<uint32_t>(is_hit) << i;
+  }
+  _mm256_zeroupper();
+  return hit_mask;
+}
+
+PacketHits RayPacket::Intersect(const Sphere& sphere) const noexcept {
+  PacketHits hits;
+  PacketSphere packet_sphere{MakePacketSphere(sphere)};
+
+  uint32_t hit_mask = 0;
+  switch (GetIsaLevel()) {
+    case ISA_AVX512: {
+      hit_mask = IntersectPacketAVX512(*this, packet_sphere, &hits);
+      break;
+    }
+    case ISA_AVX2: {
+      hit_mask = IntersectPacketAVX2(*this, packet_sphere, &hits);
+      break;
+    }
+    default: {
+      hit_mask = IntersectPacketSSE(*this, packet_sphere, &hits);
+      break;
+    }
+  }
+
+  hits.hit_mask = hit_mask & active_mask;
+  return hits;
+}
+
+// NOTE: Same sign test as Ray::IntersectAny, without roots or divisions.
+static inline uint32_t OccludedPacketSSE(const RayPacket& packet,
+                                         const PacketSphere& packet_sphere,
+                                         const float tmin,
+                                         const float tmax) noexcept {
+  SphereSSE sphere{LoadSphereSSE(packet_sphere)};
+  __m128 t_min = _mm_set1_ps(tmin);
+  __m128 t_max = _mm_set1_ps(tmax);
+  __m128 zero = _mm_setzero_ps();
+
+  uint32_t occluded_mask = 0;
+  for (size_t i = 0; i < packet.width; i += 4) {
+    __m128 a;
+    __m128 b;
+    __m128 c;
+    QuadraticSSE(sphere, packet, i, &a, &b, &c);
+
+    __m128 f_min = _mm_add_ps(
+        _mm_mul_ps(_mm_add_ps(_mm_mul_ps(a, t_min), b), t_min), c);
+    __m128 f_max = _mm_add_ps(
+        _mm_mul_ps(_mm_add_ps(_mm_mul_ps(a, t_max), b), t_max), c);
+    __m128 is_min_outside = _mm_cmpgt_ps(f_min, zero);
+    __m128 is_max_outside = _mm_cmpgt_ps(f_max, zero);
+
+    __m128 discriminant = _mm_sub_ps(
+        _mm_mul_ps(b, b), _mm_mul_ps(_mm_set1_ps(4.F), _mm_mul_ps(a, c)));
+    __m128 neg_b = _mm_sub_ps(zero, b);
+    __m128 two_a = _mm_add_ps(a, a);
+    __m128 is_grazing = _mm_and_ps(
+        _mm_and_ps(_mm_and_ps(is_min_outside, is_max_outside),
+                   _mm_cmpgt_ps(discriminant, zero)),
+        _mm_and_ps(_mm_cmpgt_ps(neg_b, _mm_mul_ps(two_a, t_min)),
+                   _mm_cmplt_ps(neg_b, _mm_mul_ps(two_a, t_max))));
+    __m128 is_occluded =
+        _mm_or_ps(_mm_xor_ps(is_min_outside, is_max_outside), is_grazing);
+
+    occluded_mask |= static_cast<uint32_t>(_mm_movemask_ps(is_occluded)) << i;
+  }
+  return occluded_mask;
+}
+
+static inline uint32_t OccludedPacketAVX2(const RayPacket& packet,
+                                          const PacketSphere& packet_sphere,
+                                          const float tmin,
+                                          const float tmax) noexcept {
+  SphereAVX2 sphere{LoadSphereAVX2(packet_sphere)};
+  __m256 t_min = _mm256_set1_ps(tmin);
+  __m256 t_max = _mm256_set1_ps(tmax);
+  __m256 zero = _mm256_setzero_ps();
+
+  uint32_t occluded_mask = 0;
+  for (size_t i = 0; i < packet.width; i += 8) {
+    __m256 a;
+    __m256 b;
+    __m256 c;
+    QuadraticAVX2(sphere, packet, i, &a, &b, &c);
+
+    __m256 f_min = _mm256_fmadd_ps(_mm256_fmadd_ps(a, t_min, b), t_min, c);
+    __m256 f_max = _mm256_fmadd_ps(_mm256_fmadd_ps(a, t_max, b), t_max, c);
+    __m256 is_min_outside = _mm256_cmp_ps(f_min, zero, _CMP_GT_OQ);
+    __m256 is_max_outside = _mm256_cmp_ps(f_max, zero, _CMP_GT_OQ);
+
+    __m256 discriminant = _mm256_fnmadd_ps(
+        _mm256_set1_ps(4.F), _mm256_mul_ps(a, c), _mm256_mul_ps(b, b));
+    __m256 neg_b = _mm256_sub_ps(zero, b);
+    __m256 two_a = _mm256_add_ps(a, a);
+    __m256 is_grazing = _mm256_and_ps(
+        _mm256_and_ps(_mm256_and_ps(is_min_outside, is_max_outside),
+                      _mm256_cmp_ps(discriminant, zero, _CMP_GT_OQ)),
+        _mm256_and_ps(
+            _mm256_cmp_ps(neg_b, _mm256_mul_ps(two_a, t_min), _CMP_GT_OQ),
+            _mm256_cmp_ps(neg_b, _mm256_mul_ps(two_a, t_max), _CMP_LT_OQ)));
+    __m256 is_occluded = _mm256_or_ps(
+        _mm256_xor_ps(is_min_outside, is_max_outside), is_grazing);
+
+    occluded_mask |= static_cast<uint32_t>(_mm256_movemask_ps(is_occluded))
+                     << i;
+  }
+  _mm256_zeroupper();
+  return occluded_mask;
+}
+
+static inline uint32_t OccludedPacketAVX512(const RayPacket& packet,
+                                            const PacketSphere& packet_sphere,
+                                            const float tmin,
+                                            const float tmax) noexcept {
+  SphereAVX512 sphere{LoadSphereAVX512(packet_sphere)};
+  __m512 t_min = _mm512_set1_ps(tmin);
+  __m512 t_max = _mm512_set1_ps(tmax);
+  __m512 zero = _mm512_setzero_ps();
+
+  uint32_t occluded_mask = 0;
+  for (size_t i = 0; i < packet.width; i += 16) {
+    __m512 a;
+    __m512 b;
+    __m512 c;
+    QuadraticAVX512(sphere, packet, i, &a, &b, &c);
+
+    __m512 f_min = _mm512_fmadd_ps(_mm512_fmadd_ps(a, t_min, b), t_min, c);
+    __m512 f_max = _mm512_fmadd_ps(_mm512_fmadd_ps(a, t_max, b), t_max, c);
+    __mmask16 is_min_outside = _mm512_cmp_ps_mask(f_min, zero, _CMP_GT_OQ);
+    __mmask16 is_max_outside = _mm512_cmp_ps_mask(f_max, zero, _CMP_GT_OQ);
+
+    __m512 discriminant = _mm512_fnmadd_ps(
+        _mm512_set1_ps(4.F), _mm512_mul_ps(a, c), _mm512_mul_ps(b, b));
+    __m512 neg_b = _mm512_sub_ps(zero, b);
+    __m512 two_a = _mm512_add_ps(a, a);
+    __mmask16 is_grazing =
+        is_min_outside & is_max_outside &
+        _mm512_cmp_ps_mask(discriminant, zero, _CMP_GT_OQ) &
+        _mm512_cmp_ps_mask(neg_b, _mm512_mul_ps(two_a, t_min), _CMP_GT_OQ) &
+        _mm512_cmp_ps_mask(neg_b, _mm512_mul_ps(two_a, t_max), _CMP_LT_OQ);
+    __mmask16 is_occluded = (is_min_outside ^ is_max_outside) | is_grazing;
+
+    occluded_mask |= static_cast<uint32_t>(is_occluded) << i;
+  }
+  _mm256_zeroupper();
+  return occluded_mask;
+}
+
+uint32_t RayPacket::Occluded(const Sphere* spheres, const size_t count,
+                             const float tmin,
+                             const float tmax) const noexcept {
+  IsaLevel level = GetIsaLevel();
+
+  uint32_t occluded_mask = 0;
+  for (size_t i = 0; i < count && occluded_mask != active_mask; ++i) {
+    PacketSphere packet_sphere{MakePacketSphere(spheres[i])};
+    switch (level) {
+      case ISA_AVX512: {
+        occluded_mask |=
+            OccludedPacketAVX512(*this, packet_sphere, tmin, tmax);
+        break;
+      }
+      case ISA_AVX2: {
+        occluded_mask |= OccludedPacketAVX2(*this, packet_sphere, tmin, tmax);
+        break;
+      }
+      default: {
+        occluded_mask |= OccludedPacketSSE(*this, packet_sphere, tmin, tmax);
+        break;
+      }
+    }
+    occluded_mask &= active_mask;
+  }
+
+  return occluded_mask;
+}
+
+RayPacket::operator std::string() const noexcept {
+  std::string str = std::format("RayPacket(width={}, active_mask={:#x}",
+                                width, active_mask);
+  for (size_t lane = 0; lane < width; ++lane) {
+    if (IsActive(lane)) {
+      str += std::format(", {}={}", lane, std::string(GetRay(lane)));
+    }
+  }
+  str += ')';
+  return str;
+}
+
+std::ostream& operator<<(std::ostream& os, const RayPacket& packet) {
+  os << std::string(packet);
+  return os;
+}
@@ -0,0 +1,64 @@
+#ifndef SRC_GEOMETRY_RAY_PACKET_H_
+#define SRC_GEOMETRY_RAY_PACKET_H_
+
+#include <geometry/ray.h>
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+
+#define RAY_PACKET_MAX_WIDTH 16
+
+typedef struct PacketHits PacketHits;
+
+// NOTE: SoA bundle of up to RAY_PACKET_MAX_WIDTH rays. Bit i of active_mask
+// marks lane i as holding a ray; lanes past width are kept zeroed so the
+// wide kernels can always read whole registers.
+struct RayPacket {
+  alignas(64) float origin_xs[RAY_PACKET_MAX_WIDTH];
+  alignas(64) float origin_ys[RAY_PACKET_MAX_WIDTH];
+  alignas(64) float origin_zs[RAY_PACKET_MAX_WIDTH];
+  alignas(64) float direction_xs[RAY_PACKET_MAX_WIDTH];
+  alignas(64) float direction_ys[RAY_PACKET_MAX_WIDTH];
+  alignas(64) float direction_zs[RAY_PACKET_MAX_WIDTH];
+  uint32_t active_mask;
+  size_t width;
+
+  RayPacket() noexcept;
+  explicit RayPacket(size_t width) noexcept;
+  RayPacket(const RayPacket& other) noexcept;
+  RayPacket& operator=(const RayPacket& other) noexcept;
+
+  void SetRay(size_t lane, const Ray& ray) noexcept;
+  Ray GetRay(size_t lane) const noexcept;
+  bool IsActive(size_t lane) const noexcept;
+
+  PacketHits Intersect(const Sphere& sphere) const noexcept;
+  // NOTE: Packet form of IsOccluded; returns the mask of active lanes with a
+  // surface crossing in (tmin, tmax), stopping once every lane is occluded.
+  uint32_t Occluded(const Sphere* spheres, size_t count, float tmin,
+                    float tmax) const noexcept;
+
+  operator std::string() const noexcept;
+};
+
+std::ostream& operator<<(std::ostream& os, const RayPacket& packet);
+
+// NOTE: Per-lane hits of a packet against one sphere. For lanes in hit_mask,
+// t_near <= t_far are the two roots (equal for tangent rays), matching the
+// order Ray::Intersect reports them in.
+struct PacketHits {
+  alignas(64) float t_near[RAY_PACKET_MAX_WIDTH];
+  alignas(64) float t_far[RAY_PACKET_MAX_WIDTH];
+  uint32_t hit_mask;
+
+  PacketHits() noexcept;
+
+  bool IsHit(size_t lane) const noexcept;
+};
+
+// NOTE: Lanes per packet for the active ISA level: 16 for AVX-512, 8 for
+// AVX2 and 4 otherwise.
+size_t RayPacketWidth() noexcept;
+
+#endif  // SRC_GEOMETRY_RAY_PACKET_H_
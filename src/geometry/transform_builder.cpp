@@ -0,0 +1,11 @@
+#include <geometry/matrix.h>
+#include <geometry/transform_builder.h>
+#include <immintrin.h>
+
+Matrix TransformBuilder::ToMatrix() const noexcept {
+  return ToAffineTransform().ToMatrix();
+}
+
+AffineTransform TransformBuilder::ToAffineTransform() const noexcept {
+  return {_mm_loadu_ps(&m[0]), _mm_loadu_ps(&m[4]), _mm_loadu_ps(&m[8])};
+}
@@ -0,0 +1,153 @@
+#ifndef SRC_GEOMETRY_TRANSFORM_BUILDER_H_
+#define SRC_GEOMETRY_TRANSFORM_BUILDER_H_
+
+#include <geometry/matrix.h>
+
+#include <cmath>
+#include <numbers>
+#include <type_traits>
+
+// NOTE: Folds Translate/Scale/Rotate/Shear chains into a single affine
+// matrix. Every step is applied as row operations on the accumulated 3x4
+// matrix instead of a full 4x4 product, so a chain declared constexpr is
+// evaluated entirely at compile time. Steps compose like the fluent Matrix
+// API: the first call is applied to points first.
+struct TransformBuilder {
+  float m[12];
+
+  constexpr TransformBuilder() noexcept
+      : m{1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0} {}
+
+  constexpr TransformBuilder Translate(float x, float y,
+                                       float z) const noexcept;
+  constexpr TransformBuilder Scale(float x, float y, float z) const noexcept;
+  constexpr TransformBuilder RotateX(float radians) const noexcept;
+  constexpr TransformBuilder RotateY(float radians) const noexcept;
+  constexpr TransformBuilder RotateZ(float radians) const noexcept;
+  constexpr TransformBuilder Shear(ShearType shear_type) const noexcept;
+
+  constexpr float At(size_t row, size_t col) const noexcept;
+
+  Matrix ToMatrix() const noexcept;
+  AffineTransform ToAffineTransform() const noexcept;
+
+ private:
+  constexpr TransformBuilder Rotate(size_t row_a, size_t row_b, float cos,
+                                    float sin) const noexcept;
+  constexpr TransformBuilder AddRow(size_t dest_row,
+                                    size_t src_row) const noexcept;
+};
+
+// NOTE: std::sin/std::cos are not constexpr, so constant evaluation falls
+// back to a Taylor series over the range-reduced angle.
+constexpr float ConstexprSin(float radians) noexcept {
+  if (!std::is_constant_evaluated()) {
+    return std::sin(radians);
+  }
+
+  double x = radians;
+  while (x > std::numbers::pi) {
+    x -= 2 * std::numbers::pi;
+  }
+  while (x < -std::numbers::pi) {
+    x += 2 * std::numbers::pi;
+  }
+
+  double term = x;
+  double sum = x;
+  for (int i = 1; i < 12; ++i) {
+    term *= -x * x / ((2 * i) * (2 * i + 1));
+    sum += term;
+  }
+  return static_cast<float>(sum);
+}
+
+constexpr float ConstexprCos(float radians) noexcept {
+  if (!std::is_constant_evaluated()) {
+    return std::cos(radians);
+  }
+  return ConstexprSin(radians + static_cast<float>(std::numbers::pi / 2));
+}
+
+constexpr float TransformBuilder::At(const size_t row,
+                                     const size_t col) const noexcept {
+  return m[row * 4 + col];
+}
+
+constexpr TransformBuilder TransformBuilder::Translate(
+    const float x, const float y, const float z) const noexcept {
+  TransformBuilder res{*this};
+  res.m[3] += x;
+  res.m[7] += y;
+  res.m[11] += z;
+  return res;
+}
+
+constexpr TransformBuilder TransformBuilder::Scale(
+    const float x, const float y, const float z) const noexcept {
+  TransformBuilder res{*this};
+  for (size_t col = 0; col < 4; ++col) {
+    res.m[col] *= x;
+    res.m[4 + col] *= y;
+    res.m[8 + col] *= z;
+  }
+  return res;
+}
+
+constexpr TransformBuilder TransformBuilder::Rotate(
+    const size_t row_a, const size_t row_b, const float cos,
+    const float sin) const noexcept {
+  TransformBuilder res{*this};
+  for (size_t col = 0; col < 4; ++col) {
+    float a = At(row_a, col);
+    float b = At(row_b, col);
+    res.m[row_a * 4 + col] = cos * a - sin * b;
+    res.m[row_b * 4 + col] = sin * a + cos * b;
+  }
+  return res;
+}
+
+constexpr TransformBuilder TransformBuilder::RotateX(
+    const float radians) const noexcept {
+  return Rotate(1, 2, ConstexprCos(radians), ConstexprSin(radians));
+}
+
+constexpr TransformBuilder TransformBuilder::RotateY(
+    const float radians) const noexcept {
+  return Rotate(2, 0, ConstexprCos(radians), ConstexprSin(radians));
+}
+
+constexpr TransformBuilder TransformBuilder::RotateZ(
+    const float radians) const noexcept {
+  return Rotate(0, 1, ConstexprCos(radians), ConstexprSin(radians));
+}
+
+constexpr TransformBuilder TransformBuilder::AddRow(
+    const size_t dest_row, const size_t src_row) const noexcept {
+  TransformBuilder res{*this};
+  for (size_t col = 0; col < 4; ++col) {
+    res.m[dest_row * 4 + col] += At(src_row, col);
+  }
+  return res;
+}
+
+constexpr TransformBuilder TransformBuilder::Shear(
+    const ShearType shear_type) const noexcept {
+  switch (shear_type) {
+    case XY:
+      return AddRow(0, 1);
+    case XZ:
+      return AddRow(0, 2);
+    case YX:
+      return AddRow(1, 0);
+    case YZ:
+      return AddRow(1, 2);
+    case ZX:
+      return AddRow(2, 0);
+    case ZY:
+      return AddRow(2, 1);
+  }
+  return *this;
+}
+
+#endif  // SRC_GEOMETRY_TRANSFORM_BUILDER_H_
@@ -0,0 +1,143 @@
+#include <geometry/matrix.h>
+#include <geometry/quaternion.h>
+#include <geometry/trs_transform.h>
+#include <geometry/vector.h>
+#include <immintrin.h>
+
+#include <cassert>
+#include <format>
+#include <iostream>
+#include <string>
+
+TrsTransform::TrsTransform() noexcept
+    : translation(0, 0, 0),
+      scale(1, 1, 1),
+      matrix(Identity()),
+      is_dirty(false) {}
+
+TrsTransform::TrsTransform(const Vector& translation,
+                           const Quaternion& rotation,
+                           const Vector& scale) noexcept
+    : translation(translation),
+      rotation(rotation),
+      scale(scale),
+      matrix(4, 4),
+      is_dirty(true) {
+  Update();
+}
+
+TrsTransform::TrsTransform(const TrsTransform& other) noexcept
+    : translation(other.translation),
+      rotation(other.rotation),
+      scale(other.scale),
+      matrix(other.matrix),
+      inverse(other.inverse),
+      inverse_transpose(other.inverse_transpose),
+      is_dirty(other.is_dirty) {}
+
+TrsTransform& TrsTransform::operator=(const TrsTransform& other) noexcept {
+  if (this != &other) {
+    translation = other.translation;
+    rotation = other.rotation;
+    scale = other.scale;
+    matrix = other.matrix;
+    inverse = other.inverse;
+    inverse_transpose = other.inverse_transpose;
+    is_dirty = other.is_dirty;
+  }
+  return *this;
+}
+
+bool TrsTransform::operator==(const TrsTransform& other) const noexcept {
+  return translation == other.translation && rotation == other.rotation &&
+         scale == other.scale;
+}
+
+bool TrsTransform::operator!=(const TrsTransform& other) const noexcept {
+  return !(*this == other);
+}
+
+void TrsTransform::SetTranslation(const Vector& translation) noexcept {
+  this->translation = translation;
+  is_dirty = true;
+}
+
+void TrsTransform::SetRotation(const Quaternion& rotation) noexcept {
+  this->rotation = rotation;
+  is_dirty = true;
+}
+
+void TrsTransform::SetScale(const Vector& scale) noexcept {
+  this->scale = scale;
+  is_dirty = true;
+}
+
+// NOTE: The matrix holds the columns of R scaled by S, with T in the last
+// column. Its linear part is R * S, and the inverse-transpose of that is
+// R * S^-1, i.e. the matrix rows scaled by 1 / S^2. The inverse linear part
+// S^-1 * R^T is its transpose, and the inverse translation is that applied
+// to -T.
+void TrsTransform::Update() noexcept {
+  if (!is_dirty) {
+    return;
+  }
+  assert(scale.x != 0.F && scale.y != 0.F && scale.z != 0.F);
+
+  Matrix rotation_matrix{rotation.ToMatrix()};
+  __m128 scale_row = _mm_blend_ps(scale.vec, _mm_set1_ps(1.F), 0x8);
+
+  matrix.row0 = _mm_blend_ps(_mm_mul_ps(rotation_matrix.row0, scale_row),
+                             _mm_set1_ps(translation.x), 0x8);
+  matrix.row1 = _mm_blend_ps(_mm_mul_ps(rotation_matrix.row1, scale_row),
+                             _mm_set1_ps(translation.y), 0x8);
+  matrix.row2 = _mm_blend_ps(_mm_mul_ps(rotation_matrix.row2, scale_row),
+                             _mm_set1_ps(translation.z), 0x8);
+  matrix.row3 = _mm_set_ps(1, 0, 0, 0);
+
+  __m128 scale_sq = _mm_mul_ps(scale.vec, scale.vec);
+  __m128 inverse_scale_sq = _mm_div_ps(
+      _mm_set_ps(0, 1, 1, 1), _mm_blend_ps(scale_sq, _mm_set1_ps(1.F), 0x8));
+  __m128 row0 = _mm_mul_ps(matrix.row0, inverse_scale_sq);
+  __m128 row1 = _mm_mul_ps(matrix.row1, inverse_scale_sq);
+  __m128 row2 = _mm_mul_ps(matrix.row2, inverse_scale_sq);
+  __m128 row3 = _mm_setzero_ps();
+  inverse_transpose = {row0, row1, row2};
+
+  _MM_TRANSPOSE4_PS(row0, row1, row2, row3);
+
+  __m128 t = translation.vec;
+  inverse.row0 = _mm_blend_ps(
+      row0, _mm_sub_ps(_mm_setzero_ps(), _mm_dp_ps(row0, t, 0x7F)), 0x8);
+  inverse.row1 = _mm_blend_ps(
+      row1, _mm_sub_ps(_mm_setzero_ps(), _mm_dp_ps(row1, t, 0x7F)), 0x8);
+  inverse.row2 = _mm_blend_ps(
+      row2, _mm_sub_ps(_mm_setzero_ps(), _mm_dp_ps(row2, t, 0x7F)), 0x8);
+  is_dirty = false;
+}
+
+const Matrix& TrsTransform::GetMatrix() const noexcept {
+  assert(!is_dirty);
+  return matrix;
+}
+
+const AffineTransform& TrsTransform::Inverse() const noexcept {
+  assert(!is_dirty);
+  return inverse;
+}
+
+const AffineTransform& TrsTransform::InverseTranspose() const noexcept {
+  assert(!is_dirty);
+  return inverse_transpose;
+}
+
+TrsTransform::operator std::string() const noexcept {
+  return std::format("TrsTransform(\n  translation={},\n  rotation={},\n"
+                     "  scale={})",
+                     std::string(translation), std::string(rotation),
+                     std::string(scale));
+}
+
+std::ostream& operator<<(std::ostream& os, const TrsTransform& transform) {
+  os << std::string(transform);
+  return os;
+}
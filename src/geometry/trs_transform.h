@@ -0,0 +1,53 @@
+#ifndef SRC_GEOMETRY_TRS_TRANSFORM_H_
+#define SRC_GEOMETRY_TRS_TRANSFORM_H_
+
+#include <geometry/matrix.h>
+#include <geometry/quaternion.h>
+#include <geometry/vector.h>
+
+#include <iostream>
+#include <string>
+
+// NOTE: Transform stored as translation * rotation * scale. The setters
+// only mark the matrix, the inverse and the inverse-transpose dirty; Update
+// rebuilds them once, and must run before the transform is read, in
+// particular before render threads share it, so the getters stay read-only.
+// Writing the parts directly needs is_dirty set as well. The inverse is
+// built from the TRS parts (S^-1 * R^T * T^-1), so it never needs a general
+// 4x4 inversion. The rotation must be a unit quaternion and the scale must
+// be non-zero.
+struct TrsTransform {
+  Vector translation;
+  Quaternion rotation;
+  Vector scale;
+  Matrix matrix;
+  AffineTransform inverse;
+  AffineTransform inverse_transpose;
+  bool is_dirty;
+
+  TrsTransform() noexcept;
+  TrsTransform(const Vector& translation, const Quaternion& rotation,
+               const Vector& scale) noexcept;
+  TrsTransform(const TrsTransform& other) noexcept;
+  TrsTransform& operator=(const TrsTransform& other) noexcept;
+
+  bool operator==(const TrsTransform& other) const noexcept;
+  bool operator!=(const TrsTransform& other) const noexcept;
+
+  void SetTranslation(const Vector& translation) noexcept;
+  void SetRotation(const Quaternion& rotation) noexcept;
+  void SetScale(const Vector& scale) noexcept;
+
+  const Matrix& GetMatrix() const noexcept;
+  const AffineTransform& Inverse() const noexcept;
+  const AffineTransform& InverseTranspose() const noexcept;
+
+  // NOTE: Rebuilds the matrices from the parts when they are dirty.
+  void Update() noexcept;
+
+  operator std::string() const noexcept;
+};
+
+std::ostream& operator<<(std::ostream& os, const TrsTransform& transform);
+
+#endif  // SRC_GEOMETRY_TRS_TRANSFORM_H_
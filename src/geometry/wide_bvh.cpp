@@ -0,0 +1,570 @@
+#include <core/arr.h>
+#include <core/utils.h>
+#include <geometry/aabb.h>
+#include <geometry/bvh.h>
+#include <geometry/point.h>
+#include <geometry/primitive.h>
+#include <geometry/ray.h>
+#include <geometry/vector.h>
+#include <geometry/wide_bvh.h>
+#include <immintrin.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <format>
+#include <memory>
+#include <string>
+#include <utility>
+
+// NOTE: Empty slots span [+inf, +inf] on every axis, which any finite
+// interval rejects. With tmax = inf the slab test can still pass them, so
+// traversal also skips slots whose child is WIDE_BVH_EMPTY.
+WideBvhNode::WideBvhNode() noexcept {
+  for (size_t slot = 0; slot < WIDE_BVH_WIDTH; ++slot) {
+    min_xs[slot] = INFINITY;
+    min_ys[slot] = INFINITY;
+    min_zs[slot] = INFINITY;
+    max_xs[slot] = INFINITY;
+    max_ys[slot] = INFINITY;
+    max_zs[slot] = INFINITY;
+    children[slot] = WIDE_BVH_EMPTY;
+    counts[slot] = 0;
+  }
+}
+
+WideBvhNode::WideBvhNode(const WideBvhNode& other) noexcept {
+  *this = other;
+}
+
+WideBvhNode& WideBvhNode::operator=(const WideBvhNode& other) noexcept {
+  if (this != &other) {
+    std::copy_n(other.min_xs, WIDE_BVH_WIDTH, min_xs);
+    std::copy_n(other.min_ys, WIDE_BVH_WIDTH, min_ys);
+    std::copy_n(other.min_zs, WIDE_BVH_WIDTH, min_zs);
+    std::copy_n(other.max_xs, WIDE_BVH_WIDTH, max_xs);
+    std::copy_n(other.max_ys, WIDE_BVH_WIDTH, max_ys);
+    std::copy_n(other.max_zs, WIDE_BVH_WIDTH, max_zs);
+    std::copy_n(other.children, WIDE_BVH_WIDTH, children);
+    std::copy_n(other.counts, WIDE_BVH_WIDTH, counts);
+  }
+  return *this;
+}
+
+void WideBvhNode::SetChild(const size_t slot, const Aabb& bounds,
+                           const uint32_t child,
+                           const uint32_t count) noexcept {
+  min_xs[slot] = bounds.min.x;
+  min_ys[slot] = bounds.min.y;
+  min_zs[slot] = bounds.min.z;
+  max_xs[slot] = bounds.max.x;
+  max_ys[slot] = bounds.max.y;
+  max_zs[slot] = bounds.max.z;
+  children[slot] = child;
+  counts[slot] = count;
+}
+
+Aabb WideBvhNode::ChildBounds(const size_t slot) const noexcept {
+  return {{min_xs[slot], min_ys[slot], min_zs[slot]},
+          {max_xs[slot], max_ys[slot], max_zs[slot]}};
+}
+
+bool WideBvhNode::IsEmpty(const size_t slot) const noexcept {
+  return children[slot] == WIDE_BVH_EMPTY;
+}
+
+bool WideBvhNode::IsLeaf(const size_t slot) const noexcept {
+  return counts[slot] > 0;
+}
+
+WideBvh::WideBvh() noexcept : node_count(0), build_cost(0.F), cost(0.F) {}
+
+WideBvh::WideBvh(const Bvh& bvh) noexcept : WideBvh() { Build(bvh); }
+
+WideBvh::WideBvh(const Sphere* spheres, const size_t count) noexcept
+    : WideBvh() {
+  Build(spheres, count);
+}
+
+WideBvh::WideBvh(const WideBvh& other) noexcept
+    : nodes(other.nodes),
+      indices(other.indices),
+      node_count(other.node_count),
+      build_cost(other.build_cost),
+      cost(other.cost) {}
+
+WideBvh& WideBvh::operator=(const WideBvh& other) noexcept {
+  if (this != &other) {
+    nodes = other.nodes;
+    indices = other.indices;
+    node_count = other.node_count;
+    build_cost = other.build_cost;
+    cost = other.cost;
+  }
+  return *this;
+}
+
+void WideBvh::Clear() noexcept {
+  nodes = DyArray<WideBvhNode>{};
+  indices = DyArray<uint32_t>{};
+  node_count = 0;
+  build_cost = 0.F;
+  cost = 0.F;
+}
+
+bool WideBvh::IsBuilt() const noexcept { return node_count > 0; }
+
+size_t WideBvh::MemoryUsage() const noexcept {
+  return nodes.capacity * sizeof(WideBvhNode) +
+         indices.capacity * sizeof(uint32_t);
+}
+
+void WideBvh::Build(const Sphere* spheres, const size_t count) noexcept {
+  Build(Bvh{spheres, count});
+}
+
+struct WideBvhBuildTask {
+  uint32_t binary_node;
+  uint32_t wide_node;
+};
+
+// NOTE: Gathers up to WIDE_BVH_WIDTH binary descendants of an interior node
+// by repeatedly opening the interior candidate with the largest surface
+// area, which is the one most rays would have to test anyway.
+static size_t CollectChildren(const Bvh& bvh, const BvhNode& node,
+                              uint32_t* candidates) noexcept {
+  candidates[0] = node.first;
+  candidates[1] = node.first + 1;
+  size_t candidate_count = 2;
+
+  while (candidate_count < WIDE_BVH_WIDTH) {
+    size_t best = candidate_count;
+    float best_area = -1.F;
+    for (size_t i = 0; i < candidate_count; ++i) {
+      const BvhNode& candidate = bvh.nodes[candidates[i]];
+      float area = candidate.bounds.SurfaceArea();
+      if (!candidate.IsLeaf() && area > best_area) {
+        best = i;
+        best_area = area;
+      }
+    }
+    if (best == candidate_count) {
+      break;
+    }
+
+    uint32_t opened = bvh.nodes[candidates[best]].first;
+    candidates[best] = opened;
+    candidates[candidate_count++] = opened + 1;
+  }
+
+  return candidate_count;
+}
+
+void WideBvh::Build(const Bvh& bvh) noexcept {
+  Clear();
+  if (!bvh.IsBuilt()) {
+    return;
+  }
+
+  indices = bvh.indices;
+
+  // NOTE: Every wide node consumes at least one binary interior node, and a
+  // binary tree of n nodes has (n - 1) / 2 of them.
+  DyArray<WideBvhNode> build_nodes{Max((bvh.node_count - 1) / 2, 1)};
+  node_count = 1;
+
+  const BvhNode& root = bvh.nodes[0];
+  if (root.IsLeaf()) {
+    build_nodes[0].SetChild(0, root.bounds, root.first, root.count);
+    nodes = DyArray<WideBvhNode>{build_nodes.data.get(), node_count};
+    build_cost = SahCost();
+    cost = build_cost;
+    return;
+  }
+
+  DyArray<WideBvhBuildTask> tasks;
+  tasks.Push({0, 0});
+
+  while (tasks.size > 0) {
+    WideBvhBuildTask task = tasks[tasks.size - 1];
+    tasks.Pop();
+
+    uint32_t candidates[WIDE_BVH_WIDTH];
+    size_t candidate_count =
+        CollectChildren(bvh, bvh.nodes[task.binary_node], candidates);
+
+    for (size_t slot = 0; slot < candidate_count; ++slot) {
+      const BvhNode& child = bvh.nodes[candidates[slot]];
+      if (child.IsLeaf()) {
+        build_nodes[task.wide_node].SetChild(slot, child.bounds, child.first,
+                                             child.count);
+        continue;
+      }
+
+      auto wide_child = static_cast<uint32_t>(node_count++);
+      build_nodes[task.wide_node].SetChild(slot, child.bounds, wide_child, 0);
+      tasks.Push({candidates[slot], wide_child});
+    }
+  }
+
+  nodes = DyArray<WideBvhNode>{build_nodes.data.get(), node_count};
+  build_cost = SahCost();
+  cost = build_cost;
+}
+
+static inline Aabb NodeBounds(const WideBvhNode& node) noexcept {
+  Aabb bounds;
+  for (size_t slot = 0; slot < WIDE_BVH_WIDTH; ++slot) {
+    if (!node.IsEmpty(slot)) {
+      bounds.Grow(node.ChildBounds(slot));
+    }
+  }
+  return bounds;
+}
+
+static inline double SlotCost(const WideBvhNode& node,
+                              const size_t slot) noexcept {
+  double tests =
+      node.IsLeaf(slot) ? static_cast<double>(node.counts[slot]) : 1.;
+  return tests * node.ChildBounds(slot).SurfaceArea();
+}
+
+static inline float RelativeCost(const double cost, const Aabb& root) {
+  double area = root.SurfaceArea();
+  return area > 0. ? static_cast<float>(cost / area) : 0.F;
+}
+
+// NOTE: The root visit costs one test; every other visit is paid for by
+// the slot that points at the node.
+float WideBvh::SahCost() const noexcept {
+  if (!IsBuilt()) {
+    return 0.F;
+  }
+
+  Aabb root{NodeBounds(nodes[0])};
+  double total = root.SurfaceArea();
+  for (size_t i = 0; i < node_count; ++i) {
+    for (size_t slot = 0; slot < WIDE_BVH_WIDTH; ++slot) {
+      if (!nodes[i].IsEmpty(slot)) {
+        total += SlotCost(nodes[i], slot);
+      }
+    }
+  }
+  return RelativeCost(total, root);
+}
+
+// NOTE: Refits the leaf slots of a node and the slots of children that are
+// already refit, returning the cost of the node's slots.
+static double RefitSlots(WideBvhNode* nodes, const Aabb* leaf_bounds,
+                         const uint32_t node_idx) noexcept {
+  WideBvhNode& node = nodes[node_idx];
+  double slots_cost = 0.;
+  for (size_t slot = 0; slot < WIDE_BVH_WIDTH; ++slot) {
+    if (node.IsEmpty(slot)) {
+      continue;
+    }
+
+    uint32_t child = node.children[slot];
+    Aabb bounds;
+    if (node.IsLeaf(slot)) {
+      for (uint32_t i = 0; i < node.counts[slot]; ++i) {
+        bounds.Grow(leaf_bounds[child + i]);
+      }
+    } else {
+      bounds = NodeBounds(nodes[child]);
+    }
+    node.SetChild(slot, bounds, child, node.counts[slot]);
+    slots_cost += SlotCost(node, slot);
+  }
+  return slots_cost;
+}
+
+// NOTE: Post-order refit of one subtree; the depth is bounded like the
+// binary tree it was collapsed from.
+static double RefitNode(WideBvhNode* nodes, const Aabb* leaf_bounds,
+                        const uint32_t node_idx) noexcept {
+  const WideBvhNode& node = nodes[node_idx];
+  double subtree_cost = 0.;
+  for (size_t slot = 0; slot < WIDE_BVH_WIDTH; ++slot) {
+    if (!node.IsEmpty(slot) && !node.IsLeaf(slot)) {
+      subtree_cost += RefitNode(nodes, leaf_bounds, node.children[slot]);
+    }
+  }
+  return subtree_cost + RefitSlots(nodes, leaf_bounds, node_idx);
+}
+
+bool WideBvh::Refit(const Sphere* spheres, const size_t count,
+                    const float rebuild_threshold,
+                    const size_t thread_count) noexcept {
+  if (!IsBuilt() || indices.size != count) {
+    Build(spheres, count);
+    return true;
+  }
+
+  WideBvhNode* wide_nodes = nodes.data.get();
+  double total = RefitHierarchy(
+      indices.data.get(), spheres, nullptr, count, thread_count,
+      [wide_nodes](uint32_t node_idx, DyArray<uint32_t>* children) {
+        const WideBvhNode& node = wide_nodes[node_idx];
+        for (size_t slot = 0; slot < WIDE_BVH_WIDTH; ++slot) {
+          if (!node.IsEmpty(slot) && !node.IsLeaf(slot)) {
+            children->Push(node.children[slot]);
+          }
+        }
+      },
+      [wide_nodes](uint32_t node_idx, const Aabb* leaf_bounds) {
+        return RefitNode(wide_nodes, leaf_bounds, node_idx);
+      },
+      [wide_nodes](uint32_t node_idx, const Aabb* leaf_bounds) {
+        return RefitSlots(wide_nodes, leaf_bounds, node_idx);
+      });
+  Aabb root{NodeBounds(nodes[0])};
+  cost = RelativeCost(total + root.SurfaceArea(), root);
+
+  if (IsPastRebuildThreshold(cost, build_cost, rebuild_threshold)) {
+    Build(spheres, count);
+    return true;
+  }
+  return false;
+}
+
+struct WideBvhStackEntry {
+  uint32_t child;
+  uint32_t count;
+  float t;
+};
+
+// NOTE: Slab test of one ray against all children of a node. Returns the
+// mask of children whose [entry, exit] overlaps [tmin, tmax] and stores
+// the entry distances.
+static inline uint32_t IntersectChildren(
+    const WideBvhNode& node, const __m128 origin_x, const __m128 origin_y,
+    const __m128 origin_z, const __m128 inverse_x, const __m128 inverse_y,
+    const __m128 inverse_z, const float tmin, const float tmax,
+    float* t_entries) noexcept {
+  __m128 t0_x = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.min_xs), origin_x),
+                           inverse_x);
+  __m128 t1_x = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.max_xs), origin_x),
+                           inverse_x);
+  __m128 t0_y = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.min_ys), origin_y),
+                           inverse_y);
+  __m128 t1_y = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.max_ys), origin_y),
+                           inverse_y);
+  __m128 t0_z = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.min_zs), origin_z),
+                           inverse_z);
+  __m128 t1_z = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.max_zs), origin_z),
+                           inverse_z);
+
+  // NOTE: _mm_max_ps and _mm_min_ps return their second operand when either
+  // is NaN, so the running tmin and tmax go second and a NaN from a ray
+  // lying in a slab plane never replaces them.
+  __m128 entry = _mm_max_ps(_mm_min_ps(t0_x, t1_x), _mm_set1_ps(tmin));
+  entry = _mm_max_ps(_mm_min_ps(t0_y, t1_y), entry);
+  entry = _mm_max_ps(_mm_min_ps(t0_z, t1_z), entry);
+  __m128 exit = _mm_min_ps(_mm_max_ps(t0_x, t1_x), _mm_set1_ps(tmax));
+  exit = _mm_min_ps(_mm_max_ps(t0_y, t1_y), exit);
+  exit = _mm_min_ps(_mm_max_ps(t0_z, t1_z), exit);
+
+  _mm_storeu_ps(t_entries, entry);
+  return static_cast<uint32_t>(_mm_movemask_ps(_mm_cmple_ps(entry, exit)));
+}
+
+// NOTE: The front-to-back traversal behind both ClosestHit overloads, the
+// wide counterpart of Bvh::Traverse. leaf(first, count, tmax) tests the
+// leaf's objects, indices[first] onwards, and lowers *tmax on a nearer hit.
+template <typename LeafFunction>
+static void TraverseWide(const WideBvh& bvh, const Ray& ray,
+                         const float tmin, float* tmax,
+                         LeafFunction leaf) noexcept {
+  if (!bvh.IsBuilt()) {
+    return;
+  }
+
+  Vector inverse_direction{InverseDirection(ray)};
+  __m128 origin_x = _mm_set1_ps(ray.origin.x);
+  __m128 origin_y = _mm_set1_ps(ray.origin.y);
+  __m128 origin_z = _mm_set1_ps(ray.origin.z);
+  __m128 inverse_x = _mm_set1_ps(inverse_direction.x);
+  __m128 inverse_y = _mm_set1_ps(inverse_direction.y);
+  __m128 inverse_z = _mm_set1_ps(inverse_direction.z);
+
+  WideBvhStackEntry stack[WIDE_BVH_STACK_SIZE];
+  size_t top = 0;
+  stack[top++] = {0, 0, tmin};
+
+  while (top > 0) {
+    WideBvhStackEntry entry = stack[--top];
+    if (entry.t >= *tmax) {
+      continue;
+    }
+
+    if (entry.count > 0) {
+      leaf(entry.child, entry.count, tmax);
+      continue;
+    }
+
+    const WideBvhNode& node = bvh.nodes[entry.child];
+    float t_entries[WIDE_BVH_WIDTH];
+    uint32_t hit_mask =
+        IntersectChildren(node, origin_x, origin_y, origin_z, inverse_x,
+                          inverse_y, inverse_z, tmin, *tmax, t_entries);
+
+    // NOTE: Hit children are pushed far to near so the nearest is popped
+    // first. The insertion keeps the at most WIDE_BVH_WIDTH new entries
+    // sorted by descending entry distance.
+    size_t first_new = top;
+    for (size_t slot = 0; slot < WIDE_BVH_WIDTH; ++slot) {
+      if ((hit_mask & (1U << slot)) == 0 || node.IsEmpty(slot)) {
+        continue;
+      }
+
+      WideBvhStackEntry child{node.children[slot], node.counts[slot],
+                              t_entries[slot]};
+      size_t position = top++;
+      while (position > first_new && stack[position - 1].t < child.t) {
+        stack[position] = stack[position - 1];
+        --position;
+      }
+      stack[position] = child;
+    }
+  }
+}
+
+// NOTE: The any-order traversal behind both IsOccluded overloads; stops as
+// soon as leaf(first, count) returns true.
+template <typename LeafFunction>
+static bool AnyWideLeaf(const WideBvh& bvh, const Ray& ray, const float tmin,
+                        const float tmax, LeafFunction leaf) noexcept {
+  if (!bvh.IsBuilt()) {
+    return false;
+  }
+
+  Vector inverse_direction{InverseDirection(ray)};
+  __m128 origin_x = _mm_set1_ps(ray.origin.x);
+  __m128 origin_y = _mm_set1_ps(ray.origin.y);
+  __m128 origin_z = _mm_set1_ps(ray.origin.z);
+  __m128 inverse_x = _mm_set1_ps(inverse_direction.x);
+  __m128 inverse_y = _mm_set1_ps(inverse_direction.y);
+  __m128 inverse_z = _mm_set1_ps(inverse_direction.z);
+
+  uint32_t stack[WIDE_BVH_STACK_SIZE];
+  size_t top = 0;
+  stack[top++] = 0;
+
+  while (top > 0) {
+    const WideBvhNode& node = bvh.nodes[stack[--top]];
+    float t_entries[WIDE_BVH_WIDTH];
+    uint32_t hit_mask =
+        IntersectChildren(node, origin_x, origin_y, origin_z, inverse_x,
+                          inverse_y, inverse_z, tmin, tmax, t_entries);
+
+    for (size_t slot = 0; slot < WIDE_BVH_WIDTH; ++slot) {
+      if ((hit_mask & (1U << slot)) == 0 || node.IsEmpty(slot)) {
+        continue;
+      }
+
+      if (!node.IsLeaf(slot)) {
+        stack[top++] = node.children[slot];
+        continue;
+      }
+
+      if (leaf(node.children[slot], node.counts[slot])) {
+        return true;
+      }
+    }
+  }
+
+  return false;
+}
+
+HitRecord WideBvh::ClosestHit(const Ray& ray, const Sphere* spheres,
+                              const float tmin,
+                              const float tmax) const noexcept {
+  HitRecord record{NO_HIT_ID, tmax};
+  TraverseWide(*this, ray, tmin, &record.t,
+               [&](uint32_t first, uint32_t count, float* t_hit) {
+                 for (uint32_t i = first; i < first + count; ++i) {
+                   if (ray.IntersectClosest(spheres[indices[i]], tmin,
+                                            t_hit)) {
+                     record.object_id = indices[i];
+                   }
+                 }
+               });
+  return record;
+}
+
+bool WideBvh::IsOccluded(const Ray& ray, const Sphere* spheres,
+                         const float tmin, const float tmax) const noexcept {
+  return AnyWideLeaf(*this, ray, tmin, tmax,
+                     [&](uint32_t first, uint32_t count) {
+                       for (uint32_t i = first; i < first + count; ++i) {
+                         if (ray.IntersectAny(spheres[indices[i]], tmin,
+                                              tmax)) {
+                           return true;
+                         }
+                       }
+                       return false;
+                     });
+}
+
+HitRecord WideBvh::ClosestHit(const Ray& ray, const SphereStore& store,
+                              const float tmin,
+                              const float tmax) const noexcept {
+  assert(store.Count() == indices.size);
+  HitRecord record{NO_HIT_ID, tmax};
+  SphereRays rays{MakeSphereRays(ray)};
+  TraverseWide(*this, ray, tmin, &record.t,
+               [&](uint32_t first, uint32_t count, float* t_hit) {
+                 uint32_t row =
+                     store.ClosestInRange(rays, first, count, tmin, t_hit);
+                 if (row != NO_HIT_ID) {
+                   record.object_id = indices[row];
+                 }
+               });
+  return record;
+}
+
+bool WideBvh::IsOccluded(const Ray& ray, const SphereStore& store,
+                         const float tmin, const float tmax) const noexcept {
+  assert(store.Count() == indices.size);
+  SphereRays rays{MakeSphereRays(ray)};
+  return AnyWideLeaf(*this, ray, tmin, tmax,
+                     [&](uint32_t first, uint32_t count) {
+                       return store.IsRangeOccluded(rays, first, count, tmin,
+                                                    tmax);
+                     });
+}
+
+WideBvhNode::operator std::string() const noexcept {
+  std::string str = "WideBvhNode(";
+  for (size_t slot = 0; slot < WIDE_BVH_WIDTH; ++slot) {
+    if (slot > 0) {
+      str += ", ";
+    }
+    if (IsEmpty(slot)) {
+      str += "empty";
+    } else if (IsLeaf(slot)) {
+      str += std::format("leaf(first={}, count={})", children[slot],
+                         counts[slot]);
+    } else {
+      str += std::format("node({})", children[slot]);
+    }
+  }
+  str += ')';
+  return str;
+}
+
+std::ostream& operator<<(std::ostream& os, const WideBvhNode& node) {
+  os << std::string(node);
+  return os;
+}
+
+WideBvh::operator std::string() const noexcept {
+  return std::format("WideBvh(nodes={}, objects={}, bytes={})", node_count,
+                     indices.size, MemoryUsage());
+}
+
+std::ostream& operator<<(std::ostream& os, const WideBvh& bvh) {
+  os << std::string(bvh);
+  return os;
+}
@@ -0,0 +1,98 @@
+#ifndef SRC_GEOMETRY_WIDE_BVH_H_
+#define SRC_GEOMETRY_WIDE_BVH_H_
+
+#include <core/arr.h>
+#include <geometry/aabb.h>
+#include <geometry/bvh.h>
+#include <geometry/primitive.h>
+#include <geometry/ray.h>
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+
+// NOTE: Children per node. Four float lanes fill one __m128, so a node
+// visit is a single SSE slab test on every ISA level.
+#define WIDE_BVH_WIDTH 4
+#define WIDE_BVH_EMPTY UINT32_MAX
+// NOTE: Each visited node leaves at most WIDE_BVH_WIDTH - 1 siblings on the
+// stack per level, plus the children of the last node.
+#define WIDE_BVH_STACK_SIZE ((WIDE_BVH_WIDTH - 1) * BVH_MAX_DEPTH + 1)
+
+// NOTE: Child bounds in SoA form: lane i of each array belongs to child i.
+// A child with count == 0 is the interior node nodes[children[i]]; with
+// count > 0 it is a leaf of count object indices from
+// WideBvh::indices[children[i]]. Empty slots have children[i] ==
+// WIDE_BVH_EMPTY. The node is two cache lines.
+struct alignas(64) WideBvhNode {
+  float min_xs[WIDE_BVH_WIDTH];
+  float min_ys[WIDE_BVH_WIDTH];
+  float min_zs[WIDE_BVH_WIDTH];
+  float max_xs[WIDE_BVH_WIDTH];
+  float max_ys[WIDE_BVH_WIDTH];
+  float max_zs[WIDE_BVH_WIDTH];
+  uint32_t children[WIDE_BVH_WIDTH];
+  uint32_t counts[WIDE_BVH_WIDTH];
+
+  WideBvhNode() noexcept;
+  WideBvhNode(const WideBvhNode& other) noexcept;
+  WideBvhNode& operator=(const WideBvhNode& other) noexcept;
+
+  void SetChild(size_t slot, const Aabb& bounds, uint32_t child,
+                uint32_t count) noexcept;
+  Aabb ChildBounds(size_t slot) const noexcept;
+  bool IsEmpty(size_t slot) const noexcept;
+  bool IsLeaf(size_t slot) const noexcept;
+
+  operator std::string() const noexcept;
+};
+
+std::ostream& operator<<(std::ostream& os, const WideBvhNode& node);
+
+// NOTE: WIDE_BVH_WIDTH-ary hierarchy collapsed from a binary Bvh. It answers
+// the same queries as Bvh over the same sphere array.
+struct WideBvh {
+  DyArray<WideBvhNode> nodes;
+  DyArray<uint32_t> indices;
+  size_t node_count;
+  // NOTE: SahCost() right after the last build, and after the last refit.
+  float build_cost;
+  float cost;
+
+  WideBvh() noexcept;
+  explicit WideBvh(const Bvh& bvh) noexcept;
+  WideBvh(const Sphere* spheres, size_t count) noexcept;
+  WideBvh(const WideBvh& other) noexcept;
+  WideBvh& operator=(const WideBvh& other) noexcept;
+
+  void Build(const Bvh& bvh) noexcept;
+  void Build(const Sphere* spheres, size_t count) noexcept;
+  void Clear() noexcept;
+  bool IsBuilt() const noexcept;
+  size_t MemoryUsage() const noexcept;
+
+  // NOTE: Same measure as Bvh::SahCost, where a node visit is one test of
+  // all its child boxes at once.
+  float SahCost() const noexcept;
+  // NOTE: Same contract as Bvh::Refit. A rebuild runs the binned SAH build
+  // and collapses it again.
+  bool Refit(const Sphere* spheres, size_t count, float rebuild_threshold,
+             size_t thread_count) noexcept;
+
+  HitRecord ClosestHit(const Ray& ray, const Sphere* spheres, float tmin,
+                       float tmax) const noexcept;
+  bool IsOccluded(const Ray& ray, const Sphere* spheres, float tmin,
+                  float tmax) const noexcept;
+  // NOTE: Same contract as the Bvh overloads: the store is built in
+  // indices order and every leaf is one range of its rows.
+  HitRecord ClosestHit(const Ray& ray, const SphereStore& store, float tmin,
+                       float tmax) const noexcept;
+  bool IsOccluded(const Ray& ray, const SphereStore& store, float tmin,
+                  float tmax) const noexcept;
+
+  operator std::string() const noexcept;
+};
+
+std::ostream& operator<<(std::ostream& os, const WideBvh& bvh);
+
+#endif  // SRC_GEOMETRY_WIDE_BVH_H_
@@ -1,5 +1,6 @@
 #include <direct.h>
 #include <src/main.h>
+#include <tests/benchmarks.h>
 #include <tests/tests.h>
 #include <windows.h>
 
@@ -9,17 +10,17 @@
 
 int main(int argc, char* argv[]) {
   if (argc < 3 || argc > 4 || strcmp(argv[1], "--root") != 0) {
-    printf("\nUsage: raytracer [--root --test]\n");
+    printf("\nUsage: raytracer [--root --test | --bench]\n");
     return EXIT_FAILURE;
   }
 
   if (GetFileAttributesA(argv[2]) == INVALID_FILE_ATTRIBUTES) {
-    printf("\nUsage: raytracer [--root --test]\n");
+    printf("\nUsage: raytracer [--root --test | --bench]\n");
     printf("\nInvalid root folder path: %s\n", argv[2]);
     return EXIT_FAILURE;
   }
 
-  if (argc == 4 && strcmp(argv[3], "--test") == 0) {
+  if (argc == 4) {
     char* root = argv[2];
     if (strcmp(root, ".") == 0) {
       char* cwd = _getcwd(NULL, 0);
@@ -27,7 +28,11 @@ int main(int argc, char* argv[]) {
       root = cwd;
     }
 
-    RunTests(root);
+    if (strcmp(argv[3], "--test") == 0) {
+      RunTests(root);
+    } else if (strcmp(argv[3], "--bench") == 0) {
+      RunBenchmarks(root);
+    }
   }
 
   return EXIT_SUCCESS;
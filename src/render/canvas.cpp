@@ -1,4 +1,5 @@
 #include <core/file_io.h>
+#include <core/numa.h>
 #include <core/utils.h>
 #include <render/canvas.h>
 #include <string.h>
@@ -12,26 +13,41 @@
 #include <memory>
 #include <string>
 
+static inline Color* AllocateColors(const size_t count) noexcept {
+  return static_cast<Color*>(AllocatePages(count * sizeof(Color)));
+}
+
 Canvas::Canvas() noexcept : width(0), height(0), colors(nullptr) {}
 
 Canvas::Canvas(const size_t width, const size_t height) noexcept
-    : width(width),
-      height(height),
-      colors(std::make_unique<Color[]>(width * height)) {}
+    : Canvas(width, height, true) {}
+
+Canvas::Canvas(const size_t width, const size_t height,
+               const bool is_cleared) noexcept
+    : width(width), height(height), colors(AllocateColors(width * height)) {
+  if (is_cleared) {
+    std::uninitialized_fill(colors.get(), colors.get() + width * height,
+                            Color());
+  }
+}
 
 Canvas::Canvas(const Canvas& other) noexcept
     : width(other.width),
       height(other.height),
-      colors(std::make_unique<Color[]>(other.width * other.height)) {
-  std::copy(other.colors.get(), other.colors.get() + other.width * other.height,
-            colors.get());
+      colors(AllocateColors(other.width * other.height)) {
+  std::uninitialized_copy(other.colors.get(),
+                          other.colors.get() + other.width * other.height,
+                          colors.get());
 }
 
 Canvas& Canvas::operator=(const Canvas& other) noexcept {
   if (this != &other) {
-    colors = std::make_unique<Color[]>(other.width * other.height);
-    std::copy(other.colors.get(),
-              other.colors.get() + other.width * other.height, colors.get());
+    width = other.width;
+    height = other.height;
+    colors.reset(AllocateColors(other.width * other.height));
+    std::uninitialized_copy(other.colors.get(),
+                            other.colors.get() + other.width * other.height,
+                            colors.get());
   }
   return *this;
 }
@@ -70,13 +86,15 @@ bool Canvas::SaveToPPM(const Path& file_path) const noexcept {
 
   const size_t buffer_size = width * (3 * 4 + 1);
   auto buffer = std::make_unique<char[]>(buffer_size);
+  auto rgb_row = std::make_unique<ColorRGB[]>(width);
 
   for (size_t row = 0; row < height; ++row) {
     size_t buffer_pos = 0;
 
+    NormalizedToRGB(&colors[row * width], rgb_row.get(), width);
+
     for (size_t col = 0; col < width; ++col) {
-      Color* color = &colors[row * width + col];
-      ColorRGB rgb{NormalizedToRGB(*color)};
+      const ColorRGB& rgb = rgb_row[col];
 
       int written =
           snprintf(buffer.get() + buffer_pos, buffer_size - buffer_pos,
@@ -161,7 +179,9 @@ bool Canvas::LoadFromPPM(const Path& file_path) noexcept {
 
   start = current;
 
-  colors = std::make_unique<Color[]>(width * height);
+  colors.reset(AllocateColors(width * height));
+  std::uninitialized_fill(colors.get(), colors.get() + width * height,
+                          Color());
   for (size_t row = 0; row < height; ++row) {
     size_t col = 0;
     ColorRGB rgb_color = {};
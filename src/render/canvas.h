@@ -1,6 +1,7 @@
 #ifndef SRC_RENDER_CANVAS_H_
 #define SRC_RENDER_CANVAS_H_
 
+#include <core/numa.h>
 #include <core/utils.h>
 #include <render/color.h>
 
@@ -8,13 +9,18 @@
 #include <memory>
 #include <string>
 
+// NOTE: colors is page-allocated, so a canvas created without clearing has
+// no pages placed yet; FirstTouchCanvas then lets the render threads place
+// each tile's pages on their own NUMA node.
 struct Canvas {
   size_t width;
   size_t height;
-  std::unique_ptr<Color[]> colors;
+  std::unique_ptr<Color[], PageDeleter> colors;
 
   Canvas() noexcept;
   Canvas(size_t width, size_t height) noexcept;
+  // NOTE: Without clearing, every pixel must be written before it is read.
+  Canvas(size_t width, size_t height, bool is_cleared) noexcept;
   Canvas(const Canvas &other) noexcept;
   Canvas &operator=(const Canvas &other) noexcept;
 
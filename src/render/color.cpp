@@ -1,3 +1,4 @@
+#include <core/cpu.h>
 #include <core/test_suite.h>
 #include <core/utils.h>
 #include <immintrin.h>
@@ -108,3 +109,63 @@ ColorRGB NormalizedToRGB(const Color& color) noexcept {
   ColorRGB rgb{i32_vec};
   return rgb;
 }
+
+static inline size_t NormalizedToRGBAVX2(const Color* colors, ColorRGB* rgbs,
+                                         const size_t count) noexcept {
+  __m256 scale = _mm256_set1_ps(255.F);
+  __m256 lower = _mm256_setzero_ps();
+  __m256 upper = _mm256_set1_ps(255.F);
+
+  size_t i = 0;
+  for (; i + 2 <= count; i += 2) {
+    __m256 color_vec = _mm256_loadu_ps(&colors[i].r);
+    color_vec = _mm256_blend_ps(color_vec, lower, 0x88);
+    color_vec = _mm256_mul_ps(color_vec, scale);
+    color_vec = _mm256_min_ps(_mm256_max_ps(color_vec, lower), upper);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(&rgbs[i].r),
+                        _mm256_cvtps_epi32(color_vec));
+  }
+  _mm256_zeroupper();
+  return i;
+}
+
+static inline size_t NormalizedToRGBAVX512(const Color* colors,
+                                           ColorRGB* rgbs,
+                                           const size_t count) noexcept {
+  __m512 scale = _mm512_set1_ps(255.F);
+  __m512 lower = _mm512_setzero_ps();
+  __m512 upper = _mm512_set1_ps(255.F);
+
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    __m512 color_vec = _mm512_loadu_ps(&colors[i].r);
+    color_vec = _mm512_mask_blend_ps(0x8888, color_vec, lower);
+    color_vec = _mm512_mul_ps(color_vec, scale);
+    color_vec = _mm512_min_ps(_mm512_max_ps(color_vec, lower), upper);
+    _mm512_storeu_si512(&rgbs[i].r, _mm512_cvtps_epi32(color_vec));
+  }
+  _mm256_zeroupper();
+  return i;
+}
+
+void NormalizedToRGB(const Color* colors, ColorRGB* rgbs,
+                     const size_t count) noexcept {
+  size_t processed = 0;
+  switch (GetIsaLevel()) {
+    case ISA_AVX512: {
+      processed = NormalizedToRGBAVX512(colors, rgbs, count);
+      break;
+    }
+    case ISA_AVX2: {
+      processed = NormalizedToRGBAVX2(colors, rgbs, count);
+      break;
+    }
+    default: {
+      break;
+    }
+  }
+
+  for (size_t i = processed; i < count; ++i) {
+    rgbs[i] = NormalizedToRGB(colors[i]);
+  }
+}
@@ -56,5 +56,7 @@ struct ColorRGB {
 };
 
 ColorRGB NormalizedToRGB(const Color& color) noexcept;
+void NormalizedToRGB(const Color* colors, ColorRGB* rgbs,
+                     size_t count) noexcept;
 
 #endif  // SRC_RENDER_COLOR_H_
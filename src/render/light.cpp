@@ -33,10 +33,20 @@ bool PointLight::operator!=(const PointLight &other) const noexcept {
 Color Lighting(const Material &material, const PointLight &light,
                const Point &position, const Vector &eye_vector,
                const Vector &normal_vector) noexcept {
+  return Lighting(material, light, position, eye_vector, normal_vector, 1.F);
+}
+
+Color Lighting(const Material &material, const PointLight &light,
+               const Point &position, const Vector &eye_vector,
+               const Vector &normal_vector, const float visibility) noexcept {
   Color effective_color{material.color * light.intensity};
-  Vector light_vector{(light.position - position).Normalize()};
   Color ambient_color{effective_color * material.ambient};
 
+  if (visibility <= 0.F) {
+    return ambient_color;
+  }
+
+  Vector light_vector{(light.position - position).Normalize()};
   float light_dot_normal = DotProduct(light_vector, normal_vector);
 
   Color diffuse_color{0, 0, 0};
@@ -54,7 +64,7 @@ Color Lighting(const Material &material, const PointLight &light,
     }
   }
 
-  return ambient_color + diffuse_color + specular_color;
+  return ambient_color + (diffuse_color + specular_color) * visibility;
 }
 
 PointLight::operator std::string() const noexcept {
@@ -28,4 +28,10 @@ Color Lighting(const Material &material, const PointLight &light,
                const Point &position, const Vector &eye_vector,
                const Vector &normal_vector) noexcept;
 
+// NOTE: visibility is the fraction of the light that reaches position, 0 when
+// a shadow ray is occluded; it scales the diffuse and specular terms.
+Color Lighting(const Material &material, const PointLight &light,
+               const Point &position, const Vector &eye_vector,
+               const Vector &normal_vector, float visibility) noexcept;
+
 #endif  // SRC_RENDER_LIGHT_H_
@@ -0,0 +1,269 @@
+#include <core/arr.h>
+#include <core/thread_pool.h>
+#include <core/utils.h>
+#include <geometry/point.h>
+#include <geometry/ray.h>
+#include <render/canvas.h>
+#include <render/color.h>
+#include <render/progressive.h>
+#include <render/tile_scheduler.h>
+#include <render/world.h>
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <format>
+#include <mutex>
+#include <string>
+
+static inline size_t CoarsePassCount() noexcept {
+  return std::bit_width(static_cast<size_t>(PROGRESSIVE_BLOCK_SIZE));
+}
+
+size_t ProgressivePassCount(const size_t max_samples) noexcept {
+  return CoarsePassCount() + Max(max_samples, 1) - 1;
+}
+
+static inline size_t PassBlockSize(const size_t pass_idx) noexcept {
+  return pass_idx < CoarsePassCount() ? PROGRESSIVE_BLOCK_SIZE >> pass_idx
+                                      : 1;
+}
+
+static inline size_t BlockCount(const Canvas& canvas,
+                                const size_t block_size) noexcept {
+  return ((canvas.width + block_size - 1) / block_size) *
+         ((canvas.height + block_size - 1) / block_size);
+}
+
+static inline size_t PassSampleCount(const Canvas& canvas,
+                                     const size_t pass_idx) noexcept {
+  size_t block_size = PassBlockSize(pass_idx);
+  if (pass_idx == 0 || pass_idx >= CoarsePassCount()) {
+    return BlockCount(canvas, block_size);
+  }
+  return BlockCount(canvas, block_size) - BlockCount(canvas, block_size * 2);
+}
+
+// NOTE: Radical inverse of index in base, the Halton sequence; index 0 is
+// 0, so the first sample of a pixel is where a plain render puts it.
+static inline float Halton(size_t index, const size_t base) noexcept {
+  float result = 0;
+  float fraction = 1;
+  while (index > 0) {
+    fraction /= static_cast<float>(base);
+    result += fraction * static_cast<float>(index % base);
+    index /= base;
+  }
+  return result;
+}
+
+static inline Color SamplePixel(const ProgressiveRender& render,
+                                const float x, const float y) noexcept {
+  float world_x = -render.half_wall_size + render.pixel_size * x;
+  float world_y = render.half_wall_size - render.pixel_size * y;
+  Point position{world_x, world_y, render.wall_z};
+  Ray ray{render.ray_origin, (position - render.ray_origin).Normalize()};
+  return ColorAt(*render.world, ray);
+}
+
+static inline bool IsOverBudget(const ProgressiveRender& render) noexcept {
+  if (render.budget_ms <= 0) {
+    return false;
+  }
+  std::chrono::duration<double, std::milli> elapsed =
+      std::chrono::steady_clock::now() - render.start_time;
+  return elapsed.count() >= render.budget_ms;
+}
+
+static void DrawCoarseTile(ProgressiveRender* render, const Tile& tile,
+                           const size_t pass_idx) noexcept {
+  Canvas* canvas = render->canvas;
+  size_t block_size = PassBlockSize(pass_idx);
+  for (size_t y = tile.y0; y < tile.y1; y += block_size) {
+    for (size_t x = tile.x0; x < tile.x1; x += block_size) {
+      // NOTE: Shaded by an earlier pass, whose blocks were twice as large.
+      if (pass_idx > 0 && x % (block_size * 2) == 0 &&
+          y % (block_size * 2) == 0) {
+        continue;
+      }
+
+      Color color{SamplePixel(*render, static_cast<float>(x),
+                              static_cast<float>(y))};
+      size_t pixel_idx = y * canvas->width + x;
+      render->sums[pixel_idx] = color;
+      render->sample_counts[pixel_idx] = 1;
+      for (size_t block_y = y; block_y < Min(y + block_size, tile.y1);
+           ++block_y) {
+        for (size_t block_x = x; block_x < Min(x + block_size, tile.x1);
+             ++block_x) {
+          canvas->WriteColor(block_x, block_y, color);
+        }
+      }
+    }
+  }
+}
+
+static void DrawSampleTile(ProgressiveRender* render, const Tile& tile,
+                           const size_t pass_idx) noexcept {
+  Canvas* canvas = render->canvas;
+  size_t sample_idx = pass_idx - CoarsePassCount() + 1;
+  float jitter_x = Halton(sample_idx, 2);
+  float jitter_y = Halton(sample_idx, 3);
+  for (size_t y = tile.y0; y < tile.y1; ++y) {
+    for (size_t x = tile.x0; x < tile.x1; ++x) {
+      size_t pixel_idx = y * canvas->width + x;
+      render->sums[pixel_idx] =
+          render->sums[pixel_idx] +
+          SamplePixel(*render, static_cast<float>(x) + jitter_x,
+                      static_cast<float>(y) + jitter_y);
+      ++render->sample_counts[pixel_idx];
+      canvas->WriteColor(
+          x, y,
+          render->sums[pixel_idx] /
+              static_cast<float>(render->sample_counts[pixel_idx]));
+    }
+  }
+}
+
+static void StartPass(ProgressiveRender* render,
+                      const size_t pass_idx) noexcept {
+  render->pass_idx = pass_idx;
+  render->is_pass_cut = false;
+  render->pass_start_time = std::chrono::steady_clock::now();
+  render->frame.Start(
+      RenderPool(), render->canvas->width, render->canvas->height,
+      [render, pass_idx](const Tile& tile) {
+        // NOTE: A tile left out keeps the previous pass, which is still a
+        // whole image; the passes after it are not started.
+        if (render->is_cancelled || (pass_idx > 0 && IsOverBudget(*render))) {
+          render->is_pass_cut = true;
+          return;
+        }
+        if (pass_idx < CoarsePassCount()) {
+          DrawCoarseTile(render, tile, pass_idx);
+        } else {
+          DrawSampleTile(render, tile, pass_idx);
+        }
+      });
+}
+
+// NOTE: Estimates the next pass from the time per sample of the last one.
+static bool IsNextPassInBudget(const ProgressiveRender& render) noexcept {
+  if (render.budget_ms <= 0) {
+    return true;
+  }
+  std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+  double elapsed_ms =
+      std::chrono::duration<double, std::milli>(now - render.start_time)
+          .count();
+  double pass_ms =
+      std::chrono::duration<double, std::milli>(now - render.pass_start_time)
+          .count();
+  size_t pass_samples = PassSampleCount(*render.canvas, render.pass_idx);
+  size_t next_samples = PassSampleCount(*render.canvas, render.pass_idx + 1);
+  double next_ms = pass_ms * static_cast<double>(next_samples) /
+                   static_cast<double>(Max(pass_samples, 1));
+  return elapsed_ms + next_ms <= render.budget_ms;
+}
+
+static void FinishPass(ProgressiveRender* render) noexcept {
+  bool is_complete = !render->is_pass_cut && !render->is_cancelled;
+  if (is_complete) {
+    ++render->completed_passes;
+    size_t next_idx = render->pass_idx + 1;
+    if (next_idx < ProgressivePassCount(render->max_samples) &&
+        IsNextPassInBudget(*render)) {
+      StartPass(render, next_idx);
+      return;
+    }
+  }
+
+  std::lock_guard<std::mutex> lock{render->mutex};
+  render->is_done = true;
+  render->render_done.notify_all();
+}
+
+ProgressiveRender::ProgressiveRender() noexcept
+    : budget_ms(0),
+      max_samples(1),
+      canvas(nullptr),
+      world(nullptr),
+      wall_z(0),
+      pixel_size(0),
+      half_wall_size(0),
+      pass_idx(0),
+      completed_passes(0),
+      is_pass_cut(false),
+      is_cancelled(false),
+      is_done(true) {
+  frame.group.on_done = [this]() { FinishPass(this); };
+}
+
+ProgressiveRender::~ProgressiveRender() noexcept {
+  Cancel();
+  Wait();
+}
+
+void ProgressiveRender::Wait() noexcept {
+  std::unique_lock<std::mutex> lock{mutex};
+  render_done.wait(lock, [this]() { return is_done; });
+}
+
+void ProgressiveRender::Cancel() noexcept {
+  is_cancelled = true;
+  frame.Cancel();
+}
+
+bool ProgressiveRender::IsDone() noexcept {
+  std::lock_guard<std::mutex> lock{mutex};
+  return is_done;
+}
+
+size_t ProgressiveRender::CompletedPasses() const noexcept {
+  return completed_passes;
+}
+
+ProgressiveRender::operator std::string() const noexcept {
+  return std::format("ProgressiveRender(passes={}/{}, budget={}ms)",
+                     CompletedPasses(), ProgressivePassCount(max_samples),
+                     budget_ms);
+}
+
+std::ostream& operator<<(std::ostream& os, const ProgressiveRender& render) {
+  os << std::string(render);
+  return os;
+}
+
+void StartProgressiveWorld(Canvas* canvas, const Point& ray_origin,
+                           const World& world, const float wall_z,
+                           const float wall_size,
+                           ProgressiveRender* render) noexcept {
+  assert(render->IsDone());
+  assert(render->frame.tile_size % PROGRESSIVE_BLOCK_SIZE == 0);
+  render->canvas = canvas;
+  render->world = &world;
+  render->ray_origin = ray_origin;
+  render->wall_z = wall_z;
+  render->pixel_size = wall_size / static_cast<float>(canvas->width);
+  render->half_wall_size = wall_size / 2;
+
+  size_t pixel_count = canvas->width * canvas->height;
+  if (render->sums.size != pixel_count) {
+    render->sums = DyArray<Color>{pixel_count};
+    render->sample_counts = DyArray<uint32_t>{pixel_count};
+  }
+  std::fill(render->sample_counts.data.get(),
+            render->sample_counts.data.get() + pixel_count, 0);
+
+  render->completed_passes = 0;
+  render->is_cancelled = false;
+  {
+    std::lock_guard<std::mutex> lock{render->mutex};
+    render->is_done = false;
+  }
+  render->start_time = std::chrono::steady_clock::now();
+  StartPass(render, 0);
+}
@@ -0,0 +1,91 @@
+#ifndef SRC_RENDER_PROGRESSIVE_H_
+#define SRC_RENDER_PROGRESSIVE_H_
+
+#include <core/arr.h>
+#include <geometry/point.h>
+#include <render/canvas.h>
+#include <render/color.h>
+#include <render/tile_scheduler.h>
+#include <render/world.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <iostream>
+#include <mutex>
+#include <string>
+
+// NOTE: Side of the blocks the first pass shades one pixel of. Must divide
+// the tile size, so no block is split between two tiles.
+#define PROGRESSIVE_BLOCK_SIZE 8
+
+// NOTE: A frame rendered in passes, each leaving the canvas a better image
+// than the last. The first passes shade one pixel per 8x8, 4x4, 2x2 block
+// and fill the block with it, each shading only the pixels the passes
+// before skipped, so full resolution costs one sample per pixel as a plain
+// render does. Every later pass adds a jittered sample per pixel to the
+// running average, up to max_samples. A pass is drawn tile by tile, and a
+// tile cut short by Cancel or the budget keeps its previous pass, so the
+// canvas always holds the best image so far.
+//
+// With budget_ms above 0, a pass only starts when the time the last one
+// took per sample says it fits in what is left of the budget, and tiles
+// stop being drawn once the budget is spent; the first pass always runs.
+// budget_ms and max_samples apply from the next start; tile_size of frame
+// must be a multiple of PROGRESSIVE_BLOCK_SIZE.
+struct ProgressiveRender {
+  double budget_ms;
+  size_t max_samples;
+  TileScheduler frame;
+
+  Canvas* canvas;
+  const World* world;
+  Point ray_origin;
+  float wall_z;
+  float pixel_size;
+  float half_wall_size;
+  // NOTE: Sum and count of the samples of each pixel once the passes reach
+  // full resolution.
+  DyArray<Color> sums;
+  DyArray<uint32_t> sample_counts;
+  size_t pass_idx;
+  std::chrono::steady_clock::time_point start_time;
+  std::chrono::steady_clock::time_point pass_start_time;
+  std::atomic<size_t> completed_passes;
+  std::atomic<bool> is_pass_cut;
+  std::atomic<bool> is_cancelled;
+  std::mutex mutex;
+  std::condition_variable render_done;
+  bool is_done;
+
+  ProgressiveRender() noexcept;
+  ProgressiveRender(const ProgressiveRender& other) = delete;
+  ProgressiveRender& operator=(const ProgressiveRender& other) = delete;
+  // NOTE: Cancels and waits for a render still running.
+  ~ProgressiveRender() noexcept;
+
+  void Wait() noexcept;
+  // NOTE: Stops at the next tile; Wait still has to be called for the tiles
+  // being drawn.
+  void Cancel() noexcept;
+  bool IsDone() noexcept;
+  // NOTE: Passes drawn completely; all of them is PassCount(max_samples).
+  size_t CompletedPasses() const noexcept;
+
+  operator std::string() const noexcept;
+};
+
+std::ostream& operator<<(std::ostream& os, const ProgressiveRender& render);
+
+// NOTE: Number of passes of a progressive render up to max_samples samples
+// per pixel.
+size_t ProgressivePassCount(size_t max_samples) noexcept;
+
+// NOTE: Starts the passes on the render pool and returns at once; canvas
+// and world must outlive the render. The previous render must be done.
+void StartProgressiveWorld(Canvas* canvas, const Point& ray_origin,
+                           const World& world, float wall_z, float wall_size,
+                           ProgressiveRender* render) noexcept;
+
+#endif  // SRC_RENDER_PROGRESSIVE_H_
@@ -0,0 +1,139 @@
+#include <core/thread_pool.h>
+#include <geometry/point.h>
+#include <render/canvas.h>
+#include <render/render_job.h>
+#include <render/tile_scheduler.h>
+#include <render/world.h>
+
+#include <cassert>
+#include <format>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+
+RenderJobStats::RenderJobStats() noexcept
+    : queued_seconds(0),
+      render_seconds(0),
+      busy_seconds(0),
+      tile_count(0),
+      steal_count(0),
+      thread_count(0) {}
+
+RenderJobStats::operator std::string() const noexcept {
+  return std::format("RenderJobStats(queued={:.3f}ms, render={:.3f}ms, "
+                     "busy={:.3f}ms, tiles={}, steals={}, threads={})",
+                     queued_seconds * 1e3, render_seconds * 1e3,
+                     busy_seconds * 1e3, tile_count, steal_count,
+                     thread_count);
+}
+
+std::ostream& operator<<(std::ostream& os, const RenderJobStats& stats) {
+  os << std::string(stats);
+  return os;
+}
+
+static RenderJobStats FrameStats(const TileScheduler& frame) noexcept {
+  RenderJobStats stats;
+  stats.queued_seconds = frame.FirstTileSeconds();
+  stats.render_seconds = frame.FrameSeconds() - stats.queued_seconds;
+  for (size_t worker_idx = 0; worker_idx < frame.worker_count; ++worker_idx) {
+    const TileWorker& worker = frame.workers[worker_idx];
+    stats.busy_seconds += worker.busy_seconds;
+    stats.tile_count += worker.tile_count;
+    stats.steal_count += worker.steal_count;
+    if (worker.tile_count > 0) {
+      ++stats.thread_count;
+    }
+  }
+  return stats;
+}
+
+static void FinishJob(RenderJob* job) noexcept {
+  // NOTE: Holds the job until the end of this call, which may be the last
+  // reference to it once the handles are gone.
+  std::shared_ptr<RenderJob> self = std::move(job->self);
+  job->stats = FrameStats(job->frame);
+  if (job->on_complete) {
+    job->on_complete(job);
+  }
+
+  std::lock_guard<std::mutex> lock{job->mutex};
+  job->is_done = true;
+  job->job_done.notify_all();
+}
+
+RenderJob::RenderJob() noexcept
+    : wall_z(0),
+      wall_size(0),
+      priority(TASK_PRIORITY_NORMAL),
+      is_done(true) {
+  frame.group.on_done = [this]() { FinishJob(this); };
+}
+
+void RenderJob::Wait() noexcept {
+  std::unique_lock<std::mutex> lock{mutex};
+  job_done.wait(lock, [this]() { return is_done; });
+}
+
+void RenderJob::Cancel() noexcept { frame.Cancel(); }
+
+bool RenderJob::IsDone() noexcept {
+  std::lock_guard<std::mutex> lock{mutex};
+  return is_done;
+}
+
+bool RenderJob::IsCancelled() const noexcept { return frame.IsCancelled(); }
+
+static const char* PriorityName(const TaskPriority priority) noexcept {
+  switch (priority) {
+    case TASK_PRIORITY_BATCH:
+      return "batch";
+    case TASK_PRIORITY_INTERACTIVE:
+      return "interactive";
+    default:
+      return "normal";
+  }
+}
+
+RenderJob::operator std::string() const noexcept {
+  return std::format("RenderJob({}x{}, priority={}, {})", canvas.width,
+                     canvas.height, PriorityName(priority),
+                     std::string(stats));
+}
+
+std::ostream& operator<<(std::ostream& os, const RenderJob& job) {
+  os << std::string(job);
+  return os;
+}
+
+std::shared_ptr<RenderJob> SubmitRenderJob(
+    std::shared_ptr<const World> world, const size_t width,
+    const size_t height, const Point& ray_origin, const float wall_z,
+    const float wall_size, const TaskPriority priority) noexcept {
+  return SubmitRenderJob(std::move(world), width, height, ray_origin, wall_z,
+                         wall_size, priority, nullptr);
+}
+
+std::shared_ptr<RenderJob> SubmitRenderJob(
+    std::shared_ptr<const World> world, const size_t width,
+    const size_t height, const Point& ray_origin, const float wall_z,
+    const float wall_size, const TaskPriority priority,
+    RenderJobCallback on_complete) noexcept {
+  assert(world != nullptr);
+  std::shared_ptr<RenderJob> job = std::make_shared<RenderJob>();
+  job->canvas = Canvas{width, height};
+  job->world = std::move(world);
+  job->ray_origin = ray_origin;
+  job->wall_z = wall_z;
+  job->wall_size = wall_size;
+  job->priority = priority;
+  job->on_complete = std::move(on_complete);
+  job->frame.group.priority = priority;
+  job->self = job;
+  job->is_done = false;
+
+  StartCastWorldShaded(&job->canvas, ray_origin, *job->world, wall_z,
+                       wall_size, &job->frame);
+  return job;
+}
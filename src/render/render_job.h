@@ -0,0 +1,92 @@
+#ifndef SRC_RENDER_RENDER_JOB_H_
+#define SRC_RENDER_RENDER_JOB_H_
+
+#include <core/thread_pool.h>
+#include <geometry/point.h>
+#include <render/canvas.h>
+#include <render/tile_scheduler.h>
+#include <render/world.h>
+
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+
+// NOTE: Where the time of a job went, filled in once its frame is done.
+// queued is submission to the first tile, the wait behind other frames;
+// render is the first tile to the last; busy is the tile time summed over
+// threads, which drew tile_count tiles, steal_count of them stolen.
+struct RenderJobStats {
+  double queued_seconds;
+  double render_seconds;
+  double busy_seconds;
+  size_t tile_count;
+  size_t steal_count;
+  size_t thread_count;
+
+  RenderJobStats() noexcept;
+
+  operator std::string() const noexcept;
+};
+
+std::ostream& operator<<(std::ostream& os, const RenderJobStats& stats);
+
+struct RenderJob;
+
+typedef std::function<void(RenderJob*)> RenderJobCallback;
+
+// NOTE: One frame rendered on the render pool into a canvas of its own, so
+// several jobs can be in flight at once, each holding on to its world. The
+// job keeps itself alive until it is done, so a handle may be dropped right
+// after submitting and the result taken in on_complete. on_complete runs on
+// the pool thread that finished the frame, cancelled or not, before Wait
+// returns; it can encode the canvas there while the pool draws later jobs,
+// but must not wait on other jobs.
+struct RenderJob {
+  Canvas canvas;
+  std::shared_ptr<const World> world;
+  Point ray_origin;
+  float wall_z;
+  float wall_size;
+  TaskPriority priority;
+  RenderJobCallback on_complete;
+  TileScheduler frame;
+  RenderJobStats stats;
+  // NOTE: Released once the job is done.
+  std::shared_ptr<RenderJob> self;
+  std::mutex mutex;
+  std::condition_variable job_done;
+  bool is_done;
+
+  RenderJob() noexcept;
+  RenderJob(const RenderJob& other) = delete;
+  RenderJob& operator=(const RenderJob& other) = delete;
+
+  void Wait() noexcept;
+  // NOTE: Stops at the next tile; on_complete still runs.
+  void Cancel() noexcept;
+  bool IsDone() noexcept;
+  bool IsCancelled() const noexcept;
+
+  operator std::string() const noexcept;
+};
+
+std::ostream& operator<<(std::ostream& os, const RenderJob& job);
+
+// NOTE: Submits world seen from ray_origin to the render pool as a width x
+// height frame and returns at once. Interactive jobs are drawn ahead of
+// queued batch ones, and batch frames already being drawn give way to them
+// between tiles; jobs of one priority start in submission order.
+std::shared_ptr<RenderJob> SubmitRenderJob(
+    std::shared_ptr<const World> world, size_t width, size_t height,
+    const Point& ray_origin, float wall_z, float wall_size,
+    TaskPriority priority) noexcept;
+std::shared_ptr<RenderJob> SubmitRenderJob(
+    std::shared_ptr<const World> world, size_t width, size_t height,
+    const Point& ray_origin, float wall_z, float wall_size,
+    TaskPriority priority, RenderJobCallback on_complete) noexcept;
+
+#endif  // SRC_RENDER_RENDER_JOB_H_
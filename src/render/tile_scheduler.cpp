@@ -0,0 +1,325 @@
+#include <core/arena.h>
+#include <core/arr.h>
+#include <core/thread_pool.h>
+#include <core/utils.h>
+#include <geometry/ray.h>
+#include <render/canvas.h>
+#include <render/color.h>
+#include <render/tile_scheduler.h>
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <format>
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+
+Tile::operator std::string() const noexcept {
+  return std::format("Tile(x=[{}, {}), y=[{}, {}))", x0, x1, y0, y1);
+}
+
+std::ostream& operator<<(std::ostream& os, const Tile& tile) {
+  os << std::string(tile);
+  return os;
+}
+
+static inline uint32_t SpreadBits(uint32_t value) noexcept {
+  value &= 0x0000FFFF;
+  value = (value | (value << 8)) & 0x00FF00FF;
+  value = (value | (value << 4)) & 0x0F0F0F0F;
+  value = (value | (value << 2)) & 0x33333333;
+  value = (value | (value << 1)) & 0x55555555;
+  return value;
+}
+
+uint32_t MortonIndex(const uint32_t x, const uint32_t y) noexcept {
+  return SpreadBits(x) | (SpreadBits(y) << 1);
+}
+
+uint32_t HilbertIndex(const uint32_t side, uint32_t x, uint32_t y) noexcept {
+  assert(std::has_single_bit(side));
+  uint32_t index = 0;
+  for (uint32_t half = side / 2; half > 0; half /= 2) {
+    uint32_t rx = (x & half) > 0 ? 1 : 0;
+    uint32_t ry = (y & half) > 0 ? 1 : 0;
+    index += half * half * ((3 * rx) ^ ry);
+
+    // NOTE: Rotates the quadrant so the curve below it starts where the
+    // curve above it entered.
+    if (ry == 0) {
+      if (rx == 1) {
+        x = side - 1 - x;
+        y = side - 1 - y;
+      }
+      std::swap(x, y);
+    }
+  }
+  return index;
+}
+
+DyArray<Tile> MakeTiles(const size_t width, const size_t height,
+                        const size_t tile_size,
+                        const TileOrder order) noexcept {
+  assert(tile_size > 0);
+  size_t tiles_x = (width + tile_size - 1) / tile_size;
+  size_t tiles_y = (height + tile_size - 1) / tile_size;
+  size_t tile_count = tiles_x * tiles_y;
+  assert(tile_count <= UINT32_MAX);
+
+  uint32_t side = std::bit_ceil(static_cast<uint32_t>(Max(tiles_x, tiles_y)));
+  DyArray<uint64_t> keys{tile_count};
+  for (size_t tile_y = 0; tile_y < tiles_y; ++tile_y) {
+    for (size_t tile_x = 0; tile_x < tiles_x; ++tile_x) {
+      uint32_t x = static_cast<uint32_t>(tile_x);
+      uint32_t y = static_cast<uint32_t>(tile_y);
+      uint64_t linear = tile_y * tiles_x + tile_x;
+      uint64_t curve = 0;
+      if (order == TILE_ORDER_MORTON) {
+        curve = MortonIndex(x, y);
+      } else if (order == TILE_ORDER_HILBERT) {
+        curve = HilbertIndex(side, x, y);
+      }
+      keys[linear] = curve << 32 | linear;
+    }
+  }
+  std::sort(keys.data.get(), keys.data.get() + tile_count);
+
+  DyArray<Tile> tiles{tile_count};
+  for (size_t i = 0; i < tile_count; ++i) {
+    size_t linear = static_cast<size_t>(keys[i] & UINT32_MAX);
+    size_t x0 = linear % tiles_x * tile_size;
+    size_t y0 = linear / tiles_x * tile_size;
+    tiles[i] = {static_cast<uint32_t>(x0), static_cast<uint32_t>(y0),
+                static_cast<uint32_t>(Min(x0 + tile_size, width)),
+                static_cast<uint32_t>(Min(y0 + tile_size, height))};
+  }
+  return tiles;
+}
+
+static inline uint64_t PackRange(const uint32_t begin,
+                                 const uint32_t end) noexcept {
+  return static_cast<uint64_t>(begin) | static_cast<uint64_t>(end) << 32;
+}
+
+static inline bool PopTile(TileWorker* worker, uint32_t* tile_idx) noexcept {
+  uint64_t range = worker->range.load(std::memory_order_acquire);
+  while (true) {
+    uint32_t begin = static_cast<uint32_t>(range);
+    uint32_t end = static_cast<uint32_t>(range >> 32);
+    if (begin >= end) {
+      return false;
+    }
+    if (worker->range.compare_exchange_weak(range, PackRange(begin + 1, end),
+                                            std::memory_order_acq_rel,
+                                            std::memory_order_acquire)) {
+      *tile_idx = begin;
+      return true;
+    }
+  }
+}
+
+static inline bool StealTiles(TileScheduler* scheduler, const size_t thief_idx,
+                              uint32_t* tile_idx) noexcept {
+  for (size_t offset = 1; offset < scheduler->worker_count; ++offset) {
+    TileWorker* victim =
+        &scheduler->workers[(thief_idx + offset) % scheduler->worker_count];
+    uint64_t range = victim->range.load(std::memory_order_acquire);
+    while (true) {
+      uint32_t begin = static_cast<uint32_t>(range);
+      uint32_t end = static_cast<uint32_t>(range >> 32);
+      if (begin >= end) {
+        break;
+      }
+
+      uint32_t split = end - (end - begin + 1) / 2;
+      if (victim->range.compare_exchange_weak(range, PackRange(begin, split),
+                                              std::memory_order_acq_rel,
+                                              std::memory_order_acquire)) {
+        // NOTE: Only the owner refills its own empty range, and thieves
+        // skip empty ranges, so a plain store is enough.
+        scheduler->workers[thief_idx].range.store(PackRange(split + 1, end),
+                                                  std::memory_order_release);
+        *tile_idx = split;
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+static void RunTileWorker(TileScheduler* scheduler,
+                          const bool is_stealing) noexcept {
+  // NOTE: Workers are pool threads rather than tasks, so a thread keeps its
+  // run across frames; a thread running a second task of the frame finds
+  // its run empty and only steals.
+  size_t worker_idx = CurrentPoolWorker();
+  assert(worker_idx < scheduler->worker_count);
+  TileWorker* worker = &scheduler->workers[worker_idx];
+  uint32_t tile_idx = 0;
+  while (!scheduler->IsCancelled()) {
+    // NOTE: Between tiles, so an interactive frame submitted behind a batch
+    // one waits for a tile rather than the whole batch frame.
+    scheduler->pool->RunHigherPriorityTasks(scheduler->group.priority);
+    if (!PopTile(worker, &tile_idx)) {
+      if (!is_stealing || !StealTiles(scheduler, worker_idx, &tile_idx)) {
+        break;
+      }
+      ++worker->steal_count;
+    }
+
+    std::chrono::steady_clock::time_point start =
+        std::chrono::steady_clock::now();
+    if (worker->tile_count == 0) {
+      worker->first_tile_seconds =
+          std::chrono::duration<double>(start - scheduler->start_time).count();
+    }
+    {
+      // NOTE: Hits spilled while drawing the tile are released with it.
+      ScratchScope scope{ThreadHitsArena()};
+      scheduler->draw(scheduler->tiles[tile_idx]);
+    }
+    worker->busy_seconds += std::chrono::duration<double>(
+                                std::chrono::steady_clock::now() - start)
+                                .count();
+    ++worker->tile_count;
+  }
+  worker->finished_seconds =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                    scheduler->start_time)
+          .count();
+}
+
+TileScheduler::TileScheduler() noexcept
+    : tile_size(DEFAULT_TILE_SIZE),
+      order(TILE_ORDER_HILBERT),
+      pool(nullptr),
+      worker_count(0) {}
+
+static void PrepareFrame(TileScheduler* scheduler, ThreadPool* pool,
+                         const size_t width, const size_t height,
+                         std::function<void(const Tile&)> draw) noexcept {
+  scheduler->pool = pool;
+  scheduler->draw = std::move(draw);
+  scheduler->tiles =
+      MakeTiles(width, height, scheduler->tile_size, scheduler->order);
+
+  size_t tile_count = scheduler->tiles.size;
+  size_t worker_count = pool->thread_count;
+  if (worker_count != scheduler->worker_count) {
+    scheduler->worker_count = worker_count;
+    scheduler->workers = std::make_unique<TileWorker[]>(worker_count);
+  }
+  for (size_t worker_idx = 0; worker_idx < worker_count; ++worker_idx) {
+    TileWorker* worker = &scheduler->workers[worker_idx];
+    uint32_t begin =
+        static_cast<uint32_t>(tile_count * worker_idx / worker_count);
+    uint32_t end =
+        static_cast<uint32_t>(tile_count * (worker_idx + 1) / worker_count);
+    worker->range.store(PackRange(begin, end), std::memory_order_relaxed);
+    worker->busy_seconds = 0;
+    worker->first_tile_seconds = 0;
+    worker->finished_seconds = 0;
+    worker->tile_count = 0;
+    worker->steal_count = 0;
+  }
+
+  scheduler->start_time = std::chrono::steady_clock::now();
+}
+
+void TileScheduler::Start(ThreadPool* pool, const size_t width,
+                          const size_t height,
+                          std::function<void(const Tile&)> draw) noexcept {
+  PrepareFrame(this, pool, width, height, std::move(draw));
+  size_t task_count = Min(worker_count, tiles.size);
+  pool->Submit(
+      &group, [this](size_t) { RunTileWorker(this, true); }, task_count);
+}
+
+void TileScheduler::StartOwned(ThreadPool* pool, const size_t width,
+                               const size_t height,
+                               std::function<void(const Tile&)> draw) noexcept {
+  PrepareFrame(this, pool, width, height, std::move(draw));
+  pool->SubmitOnEachThread(&group,
+                           [this](size_t) { RunTileWorker(this, false); });
+}
+
+void TileScheduler::Wait() noexcept {
+  if (pool != nullptr) {
+    pool->Wait(&group);
+  }
+}
+
+void TileScheduler::Cancel() noexcept {
+  if (pool != nullptr) {
+    pool->Cancel(&group);
+  }
+}
+
+bool TileScheduler::IsDone() noexcept {
+  return pool == nullptr || pool->IsDone(&group);
+}
+
+bool TileScheduler::IsCancelled() const noexcept {
+  return group.IsCancelled();
+}
+
+double TileScheduler::FrameSeconds() const noexcept {
+  double frame_seconds = 0;
+  for (size_t worker_idx = 0; worker_idx < worker_count; ++worker_idx) {
+    frame_seconds =
+        std::max(frame_seconds, workers[worker_idx].finished_seconds);
+  }
+  return frame_seconds;
+}
+
+double TileScheduler::FirstTileSeconds() const noexcept {
+  double first_tile_seconds = FrameSeconds();
+  for (size_t worker_idx = 0; worker_idx < worker_count; ++worker_idx) {
+    if (workers[worker_idx].tile_count > 0) {
+      first_tile_seconds =
+          std::min(first_tile_seconds, workers[worker_idx].first_tile_seconds);
+    }
+  }
+  return first_tile_seconds;
+}
+
+double TileScheduler::IdleSeconds(const size_t worker_idx) const noexcept {
+  return std::max(FrameSeconds() - workers[worker_idx].busy_seconds, 0.);
+}
+
+TileScheduler::operator std::string() const noexcept {
+  std::string worker_stats;
+  for (size_t worker_idx = 0; worker_idx < worker_count; ++worker_idx) {
+    const TileWorker& worker = workers[worker_idx];
+    worker_stats += std::format(
+        "{}(busy={:.3f}ms, idle={:.3f}ms, tiles={}, steals={})",
+        worker_idx > 0 ? ", " : "", worker.busy_seconds * 1e3,
+        IdleSeconds(worker_idx) * 1e3, worker.tile_count, worker.steal_count);
+  }
+  return std::format("TileScheduler(tiles={}, tile_size={}, frame={:.3f}ms, "
+                     "workers=[{}])",
+                     tiles.size, tile_size, FrameSeconds() * 1e3,
+                     worker_stats);
+}
+
+std::ostream& operator<<(std::ostream& os, const TileScheduler& scheduler) {
+  os << std::string(scheduler);
+  return os;
+}
+
+void FirstTouchCanvas(Canvas* canvas, TileScheduler* scheduler,
+                      ThreadPool* pool) noexcept {
+  scheduler->StartOwned(
+      pool, canvas->width, canvas->height, [canvas](const Tile& tile) {
+        for (size_t y = tile.y0; y < tile.y1; ++y) {
+          Color* row = canvas->colors.get() + y * canvas->width;
+          std::uninitialized_fill(row + tile.x0, row + tile.x1, Color());
+        }
+      });
+  scheduler->Wait();
+}
@@ -0,0 +1,122 @@
+#ifndef SRC_RENDER_TILE_SCHEDULER_H_
+#define SRC_RENDER_TILE_SCHEDULER_H_
+
+#include <core/arr.h>
+#include <core/thread_pool.h>
+#include <render/canvas.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+
+#define DEFAULT_TILE_SIZE 16
+
+// NOTE: Order tiles are handed out in. Morton and Hilbert keep consecutive
+// tiles next to each other on the canvas, so the contiguous run each worker
+// starts with touches a compact block of pixels and scene; Hilbert never
+// jumps between neighbours, Morton is cheaper to compute.
+enum TileOrder { TILE_ORDER_SCANLINE, TILE_ORDER_MORTON, TILE_ORDER_HILBERT };
+
+// NOTE: Pixels [x0, x1) x [y0, y1) of the canvas.
+struct Tile {
+  uint32_t x0;
+  uint32_t y0;
+  uint32_t x1;
+  uint32_t y1;
+
+  operator std::string() const noexcept;
+};
+
+std::ostream& operator<<(std::ostream& os, const Tile& tile);
+
+// NOTE: Interleaves the low 16 bits of x and y, x in the even bits.
+uint32_t MortonIndex(uint32_t x, uint32_t y) noexcept;
+
+// NOTE: Distance of (x, y) along the Hilbert curve filling a side x side
+// square; side must be a power of two.
+uint32_t HilbertIndex(uint32_t side, uint32_t x, uint32_t y) noexcept;
+
+// NOTE: Tiles of tile_size x tile_size covering width x height, clipped at
+// the right and bottom edges, sorted by order.
+DyArray<Tile> MakeTiles(size_t width, size_t height, size_t tile_size,
+                        TileOrder order) noexcept;
+
+// NOTE: One worker's deque and stats, on its own cache line so stealing
+// from a neighbour does not bounce the owner's counters.
+struct alignas(64) TileWorker {
+  // NOTE: Tile indices [begin, end) packed as begin | end << 32, so the
+  // owner popping the front and thieves splitting off the back race on one
+  // compare-exchange. A non-empty value never repeats within a frame, since
+  // a thief runs the first tile it splits off, so there is no ABA.
+  std::atomic<uint64_t> range;
+  double busy_seconds;
+  double first_tile_seconds;
+  double finished_seconds;
+  size_t tile_count;
+  size_t steal_count;
+};
+
+// NOTE: Renders a frame as tiles on a ThreadPool, worker i being pool
+// thread i. Each worker starts on an equal contiguous run of the ordered
+// tiles, the same run every frame of the same size, and once its own run is
+// empty steals the back half of the first non-empty run after it, so uneven
+// tiles even out without a shared counter. Between tiles a worker runs the
+// tasks of higher priority groups waiting in the pool, group.priority being
+// the frame's. tile_size and order apply from the next Start. Per-worker
+// busy time, tiles drawn and steals are kept for the last frame; idle time
+// is the frame time minus busy time.
+struct TileScheduler {
+  size_t tile_size;
+  TileOrder order;
+  ThreadPool* pool;
+  TaskGroup group;
+  DyArray<Tile> tiles;
+  std::unique_ptr<TileWorker[]> workers;
+  size_t worker_count;
+  std::function<void(const Tile&)> draw;
+  std::chrono::steady_clock::time_point start_time;
+
+  TileScheduler() noexcept;
+  TileScheduler(const TileScheduler& other) = delete;
+  TileScheduler& operator=(const TileScheduler& other) = delete;
+
+  // NOTE: Submits draw for every tile of width x height and returns at
+  // once. The previous frame must be done, and the frame must be done before
+  // the scheduler or pool go away.
+  void Start(ThreadPool* pool, size_t width, size_t height,
+             std::function<void(const Tile&)> draw) noexcept;
+  // NOTE: As Start, but every pool thread draws exactly its own run, with
+  // no stealing, for work that has to happen on the owning thread.
+  void StartOwned(ThreadPool* pool, size_t width, size_t height,
+                  std::function<void(const Tile&)> draw) noexcept;
+  void Wait() noexcept;
+  // NOTE: Tiles not yet started are skipped; Wait still has to be called
+  // for the ones being drawn.
+  void Cancel() noexcept;
+  bool IsDone() noexcept;
+  bool IsCancelled() const noexcept;
+
+  // NOTE: Valid once the frame is done.
+  double FrameSeconds() const noexcept;
+  // NOTE: From Start to the first tile drawn, the time the frame sat behind
+  // other work in the pool; FrameSeconds when no tile was drawn.
+  double FirstTileSeconds() const noexcept;
+  double IdleSeconds(size_t worker_idx) const noexcept;
+
+  operator std::string() const noexcept;
+};
+
+std::ostream& operator<<(std::ostream& os, const TileScheduler& scheduler);
+
+// NOTE: Clears a canvas created without clearing, each pool thread writing
+// the tiles it starts every frame with, so on a pinned pool those pages are
+// placed on the node of the thread that keeps drawing them. Frames have to
+// use the same pool, tile_size and order for the placement to match.
+void FirstTouchCanvas(Canvas* canvas, TileScheduler* scheduler,
+                      ThreadPool* pool) noexcept;
+
+#endif  // SRC_RENDER_TILE_SCHEDULER_H_
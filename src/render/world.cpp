@@ -0,0 +1,476 @@
+#include <core/numa.h>
+#include <core/thread_pool.h>
+#include <core/utils.h>
+#include <geometry/lbvh.h>
+#include <geometry/matrix.h>
+#include <geometry/mesh.h>
+#include <geometry/point.h>
+#include <geometry/primitive.h>
+#include <geometry/ray.h>
+#include <geometry/transform_builder.h>
+#include <geometry/vector.h>
+#include <render/color.h>
+#include <render/light.h>
+#include <render/material.h>
+#include <render/tile_scheduler.h>
+#include <render/world.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <format>
+#include <memory>
+#include <string>
+
+World::World() noexcept
+    : bvh_layout(BVH_WIDE), bvh_rebuild_threshold(BVH_REBUILD_THRESHOLD) {}
+
+World::World(const World& other) noexcept
+    : objects(other.objects),
+      spheres(other.spheres),
+      triangles(other.triangles),
+      triangle_mesh_ids(other.triangle_mesh_ids),
+      mesh_materials(other.mesh_materials),
+      lights(other.lights),
+      bvh(other.bvh),
+      wide_bvh(other.wide_bvh),
+      grid(other.grid),
+      bvh_layout(other.bvh_layout),
+      bvh_rebuild_threshold(other.bvh_rebuild_threshold) {}
+
+World& World::operator=(const World& other) noexcept {
+  if (this != &other) {
+    objects = other.objects;
+    spheres = other.spheres;
+    triangles = other.triangles;
+    triangle_mesh_ids = other.triangle_mesh_ids;
+    mesh_materials = other.mesh_materials;
+    lights = other.lights;
+    bvh = other.bvh;
+    wide_bvh = other.wide_bvh;
+    grid = other.grid;
+    bvh_layout = other.bvh_layout;
+    bvh_rebuild_threshold = other.bvh_rebuild_threshold;
+  }
+  return *this;
+}
+
+// NOTE: Refills spheres from objects in the row order of whichever
+// structure ClosestSphereHit queries first, so each leaf or cell is one
+// range of rows, or in array order when none is built. Every path that
+// builds, refits or drops a structure ends here, so the rows never drift
+// from objects or from the indices they follow.
+static void BuildSphereStore(World* world) noexcept {
+  const DyArray<uint32_t>* order = nullptr;
+  if (world->grid.IsBuilt()) {
+    order = &world->grid.indices;
+  } else if (world->wide_bvh.IsBuilt()) {
+    order = &world->wide_bvh.indices;
+  } else if (world->bvh.IsBuilt()) {
+    order = &world->bvh.indices;
+  }
+
+  if (order == nullptr) {
+    world->spheres.Build(world->objects.data.get(), nullptr,
+                         world->objects.size);
+  } else {
+    world->spheres.Build(world->objects.data.get(), order->data.get(),
+                         order->size);
+  }
+}
+
+// NOTE: Without a hierarchy the rows are already in array order and the new
+// sphere is appended; otherwise dropping it puts them back in array order.
+uint32_t World::AddObject(const Sphere& object) noexcept {
+  objects.Push(object);
+  if (!bvh.IsBuilt() && !wide_bvh.IsBuilt() && !grid.IsBuilt()) {
+    spheres.Add(object);
+    return static_cast<uint32_t>(objects.size - 1);
+  }
+
+  bvh.Clear();
+  wide_bvh.Clear();
+  grid.Clear();
+  BuildSphereStore(this);
+  return static_cast<uint32_t>(objects.size - 1);
+}
+
+uint32_t World::AddMesh(const TriangleMesh& mesh) noexcept {
+  uint32_t mesh_id = static_cast<uint32_t>(mesh_materials.size);
+  mesh_materials.Push(mesh.material);
+
+  uint32_t first_vertex = static_cast<uint32_t>(triangles.VertexCount());
+  for (size_t i = 0; i < mesh.VertexCount(); ++i) {
+    triangles.AddVertex(mesh.Vertex(static_cast<uint32_t>(i)));
+  }
+  for (size_t i = 0; i < mesh.TriangleCount(); ++i) {
+    const uint32_t* corners = &mesh.triangle_indices[3 * i];
+    triangles.AddTriangle(first_vertex + corners[0], first_vertex + corners[1],
+                          first_vertex + corners[2]);
+    triangle_mesh_ids.Push(mesh_id);
+  }
+  return mesh_id;
+}
+
+void World::AddLight(const PointLight& light) noexcept { lights.Push(light); }
+
+void World::BuildBvh() noexcept { BuildBvh(BVH_WIDE); }
+
+// NOTE: The wide hierarchy is collapsed from the binary one, which is then
+// dropped so only one of them is kept.
+void World::BuildBvh(const BvhLayout layout) noexcept {
+  bvh_layout = layout;
+  if (layout == BVH_LINEAR) {
+    BuildLinearBvh(objects.data.get(), objects.size, 0, &bvh);
+  } else {
+    bvh.Build(objects.data.get(), objects.size);
+  }
+  wide_bvh.Clear();
+  grid.Clear();
+  if (layout == BVH_WIDE) {
+    wide_bvh.Build(bvh);
+    bvh.Clear();
+  }
+  BuildSphereStore(this);
+  triangles.Build();
+}
+
+void World::BuildGrid() noexcept {
+  grid.Build(objects.data.get(), objects.size, 0);
+  bvh.Clear();
+  wide_bvh.Clear();
+  BuildSphereStore(this);
+  triangles.Build();
+}
+
+// NOTE: A refit keeps indices but moves the spheres, and a rebuild changes
+// both, so the store is refilled either way.
+bool World::RefitBvh() noexcept {
+  bool is_rebuilt = false;
+  if (grid.IsBuilt()) {
+    grid.Build(objects.data.get(), objects.size, 0);
+    is_rebuilt = true;
+  } else if (wide_bvh.IsBuilt()) {
+    is_rebuilt = wide_bvh.Refit(objects.data.get(), objects.size,
+                                bvh_rebuild_threshold, 0);
+  } else if (bvh.IsBuilt() && bvh_layout == BVH_LINEAR) {
+    BuildLinearBvh(objects.data.get(), objects.size, 0, &bvh);
+    is_rebuilt = true;
+  } else if (bvh.IsBuilt()) {
+    is_rebuilt = bvh.Refit(objects.data.get(), objects.size,
+                           bvh_rebuild_threshold, 0);
+  }
+  BuildSphereStore(this);
+  return is_rebuilt;
+}
+
+World DefaultWorld() noexcept {
+  World world;
+  world.AddLight({Color{1, 1, 1}, Point{-10, 10, -10}});
+
+  Sphere outer;
+  outer.material.color = {.8F, 1.F, .6F};
+  outer.material.diffuse = .7F;
+  outer.material.specular = .2F;
+  world.AddObject(outer);
+
+  constexpr TransformBuilder kInnerTransform =
+      TransformBuilder{}.Scale(.5F, .5F, .5F);
+  Sphere inner;
+  inner.SetTransform(kInnerTransform.ToMatrix());
+  world.AddObject(inner);
+
+  return world;
+}
+
+// NOTE: One sorted run of IntersectWorld's gathered hits, [next, end);
+// next advances as the merge consumes it.
+struct HitRun {
+  uint32_t next;
+  uint32_t end;
+};
+
+// NOTE: k-way merge of the sorted runs of runs into hits through a binary
+// min-heap keyed on each run's next hit, so the merge costs
+// O(n log run_count). The heap is built in place over run_heap.
+static void MergeHitRuns(const Hits& runs, HitRun* run_heap,
+                         size_t run_count, Hits* hits) noexcept {
+  auto is_later = [&runs](const HitRun& a, const HitRun& b) {
+    return runs[b.next] < runs[a.next];
+  };
+  std::make_heap(run_heap, run_heap + run_count, is_later);
+  while (run_count > 0) {
+    std::pop_heap(run_heap, run_heap + run_count, is_later);
+    HitRun& run = run_heap[run_count - 1];
+    hits->Append(runs[run.next++]);
+    if (run.next < run.end) {
+      std::push_heap(run_heap, run_heap + run_count, is_later);
+    } else {
+      --run_count;
+    }
+  }
+}
+
+Hits IntersectWorld(const World& world, const Ray& ray) noexcept {
+  const TriangleMesh& triangles = world.triangles;
+  DyArray<HitRun> run_heap(world.objects.size + triangles.TriangleCount());
+  size_t run_count = 0;
+  Hits runs;
+  for (size_t i = 0; i < world.objects.size; ++i) {
+    PrimitiveHandle handle{
+        MakePrimitiveHandle(PRIMITIVE_SPHERE, static_cast<uint32_t>(i))};
+    Hits object_hits{ray.Intersect(world.objects[i], handle)};
+    if (object_hits.count > 0) {
+      uint32_t first = static_cast<uint32_t>(runs.count);
+      runs.Append(object_hits);
+      run_heap[run_count++] = {first, static_cast<uint32_t>(runs.count)};
+    }
+  }
+
+  for (size_t i = 0; i < triangles.TriangleCount(); ++i) {
+    const uint32_t* corners = &triangles.triangle_indices[3 * i];
+    float t = INFINITY;
+    if (IntersectTriangle(ray, triangles.Vertex(corners[0]),
+                          triangles.Vertex(corners[1]),
+                          triangles.Vertex(corners[2]), -INFINITY, &t)) {
+      uint32_t first = static_cast<uint32_t>(runs.count);
+      runs.Append(Hit{
+          MakePrimitiveHandle(PRIMITIVE_TRIANGLE, static_cast<uint32_t>(i)),
+          t});
+      run_heap[run_count++] = {first, first + 1};
+    }
+  }
+
+  Hits hits;
+  MergeHitRuns(runs, run_heap.data.get(), run_count, &hits);
+  return hits;
+}
+
+static inline HitRecord ClosestSphereHit(const World& world, const Ray& ray,
+                                         const float tmin,
+                                         const float tmax) noexcept {
+  if (world.grid.IsBuilt()) {
+    return world.grid.ClosestHit(ray, world.spheres, tmin, tmax);
+  }
+  if (world.wide_bvh.IsBuilt()) {
+    return world.wide_bvh.ClosestHit(ray, world.spheres, tmin, tmax);
+  }
+  if (world.bvh.IsBuilt()) {
+    return world.bvh.ClosestHit(ray, world.spheres, tmin, tmax);
+  }
+  return world.spheres.ClosestHit(ray, tmin, tmax);
+}
+
+// NOTE: Spheres first, so the triangle query starts with tmax already cut
+// down to the nearest sphere.
+HitRecord ClosestHit(const World& world, const Ray& ray, const float tmin,
+                     const float tmax) noexcept {
+  HitRecord record{ClosestSphereHit(world, ray, tmin, tmax)};
+  if (world.triangles.TriangleCount() == 0) {
+    return record;
+  }
+
+  HitRecord triangle_hit{world.triangles.ClosestHit(ray, tmin, record.t)};
+  if (triangle_hit.IsHit()) {
+    record = {MakePrimitiveHandle(PRIMITIVE_TRIANGLE, triangle_hit.object_id),
+              triangle_hit.t};
+  }
+  return record;
+}
+
+static inline bool IsSphereOccluded(const World& world, const Ray& ray,
+                                    const float tmin,
+                                    const float tmax) noexcept {
+  if (world.grid.IsBuilt()) {
+    return world.grid.IsOccluded(ray, world.spheres, tmin, tmax);
+  }
+  if (world.wide_bvh.IsBuilt()) {
+    return world.wide_bvh.IsOccluded(ray, world.spheres, tmin, tmax);
+  }
+  if (world.bvh.IsBuilt()) {
+    return world.bvh.IsOccluded(ray, world.spheres, tmin, tmax);
+  }
+  return world.spheres.IsOccluded(ray, tmin, tmax);
+}
+
+bool IsOccluded(const World& world, const Ray& ray, const float tmin,
+                const float tmax) noexcept {
+  return IsSphereOccluded(world, ray, tmin, tmax) ||
+         (world.triangles.TriangleCount() > 0 &&
+          world.triangles.IsOccluded(ray, tmin, tmax));
+}
+
+Color ShadeHit(const World& world, const Ray& ray,
+               const HitRecord& hit) noexcept {
+  uint32_t index = HandleIndex(hit.object_id);
+  Point point{ray.Position(hit.t)};
+  const Material* material = nullptr;
+  Vector normal;
+  if (HandleType(hit.object_id) == PRIMITIVE_TRIANGLE) {
+    material = &world.mesh_materials[world.triangle_mesh_ids[index]];
+    normal = world.triangles.NormalAt(index);
+    // NOTE: Triangles are hit from both sides; shade the side facing the ray.
+    if (DotProduct(normal, ray.direction) > 0.F) {
+      normal = -normal;
+    }
+  } else {
+    const Sphere& object = world.objects[index];
+    material = &object.material;
+    normal = object.NormalAt(point);
+  }
+  Vector eye{-ray.direction};
+  Point over_point{point + normal * SHADOW_EPSILON};
+
+  Color color{0, 0, 0, 0};
+  for (size_t i = 0; i < world.lights.size; ++i) {
+    const PointLight& light = world.lights[i];
+    Ray shadow_ray{over_point, light.position - over_point};
+    bool is_shadowed = IsOccluded(world, shadow_ray, 0.F, 1.F);
+
+    color = color + Lighting(*material, light, point, eye, normal,
+                             is_shadowed ? 0.F : 1.F);
+  }
+  return color;
+}
+
+Color ColorAt(const World& world, const Ray& ray) noexcept {
+  HitRecord hit{ClosestHit(world, ray, 0.F, INFINITY)};
+  if (!hit.IsHit()) {
+    return {0, 0, 0};
+  }
+  return ShadeHit(world, ray, hit);
+}
+
+struct DrawRegionWorldContext {
+  const Point& ray_origin;
+  const World& world;
+  float wall_z;
+  float pixel_size;
+  float half_wall_size;
+  Tile tile;
+};
+
+static inline void DrawRegionWorld(Canvas* canvas,
+                                   const DrawRegionWorldContext& context) {
+  for (size_t y = context.tile.y0; y < context.tile.y1; ++y) {
+    float world_y = context.half_wall_size - context.pixel_size * y;
+    for (size_t x = context.tile.x0; x < context.tile.x1; ++x) {
+      float world_x = -context.half_wall_size + context.pixel_size * x;
+
+      Point position{world_x, world_y, context.wall_z};
+      Ray ray{context.ray_origin, (position - context.ray_origin).Normalize()};
+      HitRecord hit{ClosestHit(context.world, ray, 0.F, INFINITY)};
+
+      if (hit.IsHit()) {
+        canvas->WriteColor(x, y, ShadeHit(context.world, ray, hit));
+      }
+    }
+  }
+}
+
+void StartCastWorldShaded(Canvas* canvas, const Point& ray_origin,
+                          const World& world, float wall_z, float wall_size,
+                          TileScheduler* frame) noexcept {
+  float pixel_size = wall_size / static_cast<float>(canvas->width);
+  float half_wall_size = wall_size / 2;
+
+  frame->Start(RenderPool(), canvas->width, canvas->height,
+               [canvas, ray_origin, &world, wall_z, pixel_size,
+                half_wall_size](const Tile& tile) {
+                 DrawRegionWorldContext context = {
+                     ray_origin, world,          wall_z,
+                     pixel_size, half_wall_size, tile};
+                 DrawRegionWorld(canvas, context);
+               });
+}
+
+void StartCastWorldShaded(Canvas* canvas, const Point& ray_origin,
+                          const SceneReplicas& scene, float wall_z,
+                          float wall_size, TileScheduler* frame) noexcept {
+  float pixel_size = wall_size / static_cast<float>(canvas->width);
+  float half_wall_size = wall_size / 2;
+
+  frame->Start(RenderPool(), canvas->width, canvas->height,
+               [canvas, ray_origin, &scene, wall_z, pixel_size,
+                half_wall_size](const Tile& tile) {
+                 DrawRegionWorldContext context = {
+                     ray_origin, scene.Local(),  wall_z,
+                     pixel_size, half_wall_size, tile};
+                 DrawRegionWorld(canvas, context);
+               });
+}
+
+void CastWorldShaded(Canvas* canvas, const Point& ray_origin,
+                     const World& world, float wall_z,
+                     float wall_size) noexcept {
+  TileScheduler frame;
+  StartCastWorldShaded(canvas, ray_origin, world, wall_z, wall_size, &frame);
+  frame.Wait();
+}
+
+World::operator std::string() const noexcept {
+  std::string hierarchy{
+      grid.IsBuilt()
+          ? std::format("grid={}", std::string(grid))
+          : std::format("bvh={}", wide_bvh.IsBuilt() ? std::string(wide_bvh)
+                                                     : std::string(bvh))};
+  return std::format("World(objects={}, triangles={}, lights={}, {})",
+                     objects.size, triangles.TriangleCount(), lights.size,
+                     hierarchy);
+}
+
+std::ostream& operator<<(std::ostream& os, const World& world) {
+  os << std::string(world);
+  return os;
+}
+
+SceneReplicas::SceneReplicas() noexcept : shared(nullptr), node_count(0) {}
+
+void SceneReplicas::Place(const World& world, const ScenePlacement placement,
+                          ThreadPool* pool) noexcept {
+  shared = &world;
+  node_count = GetNumaTopology().node_count;
+  node_worlds = std::make_unique<std::unique_ptr<World>[]>(node_count);
+  if (placement == SCENE_SHARED) {
+    return;
+  }
+
+  // NOTE: The first thread to run on a node claims it and copies the scene
+  // there; the rest of the threads on that node have nothing to do.
+  std::unique_ptr<std::atomic<bool>[]> is_claimed =
+      std::make_unique<std::atomic<bool>[]>(node_count);
+  TaskGroup group;
+  pool->SubmitOnEachThread(&group, [&](size_t) {
+    uint32_t node = CurrentNumaNode();
+    if (node < node_count && !is_claimed[node].exchange(true)) {
+      node_worlds[node] = std::make_unique<World>(world);
+    }
+  });
+  pool->Wait(&group);
+}
+
+const World& SceneReplicas::Local() const noexcept {
+  uint32_t node = CurrentNumaNode();
+  if (node < node_count && node_worlds[node]) {
+    return *node_worlds[node];
+  }
+  return *shared;
+}
+
+size_t SceneReplicas::ReplicaCount() const noexcept {
+  size_t count = 0;
+  for (uint32_t node = 0; node < node_count; ++node) {
+    count += node_worlds[node] ? 1 : 0;
+  }
+  return count;
+}
+
+SceneReplicas::operator std::string() const noexcept {
+  return std::format("SceneReplicas(nodes={}, replicas={})", node_count,
+                     ReplicaCount());
+}
+
+std::ostream& operator<<(std::ostream& os, const SceneReplicas& replicas) {
+  os << std::string(replicas);
+  return os;
+}
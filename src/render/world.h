@@ -0,0 +1,151 @@
+#ifndef SRC_RENDER_WORLD_H_
+#define SRC_RENDER_WORLD_H_
+
+#include <core/arr.h>
+#include <core/thread_pool.h>
+#include <geometry/bvh.h>
+#include <geometry/grid.h>
+#include <geometry/mesh.h>
+#include <geometry/point.h>
+#include <geometry/primitive.h>
+#include <geometry/ray.h>
+#include <geometry/wide_bvh.h>
+#include <render/canvas.h>
+#include <render/color.h>
+#include <render/light.h>
+#include <render/material.h>
+#include <render/tile_scheduler.h>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+// NOTE: Which hierarchy World::BuildBvh leaves behind for queries.
+// BVH_LINEAR is the binary layout built by BuildLinearBvh, for scenes that
+// move every frame: it builds in O(n) but traces slower than the SAH trees,
+// so RefitBvh rebuilds it rather than refitting it.
+enum BvhLayout { BVH_BINARY, BVH_WIDE, BVH_LINEAR };
+
+// NOTE: A scene: the objects and lights rendered together. Every primitive
+// type is kept in its own SoA storage and hits refer to primitives by
+// PrimitiveHandle: spheres by their index into objects, triangles by their
+// index into triangles. Sphere queries run the SphereStore kernel of
+// spheres, over the leaves of the hierarchy once BuildBvh has been called
+// and over every row before; objects holds the records shading reads.
+// Building, refitting or dropping the hierarchy refills spheres from
+// objects in leaf order, and AddObject drops the hierarchy until the next
+// BuildBvh. After moving objects in place, RefitBvh brings spheres and the
+// hierarchy up to date.
+// BuildGrid swaps the hierarchy for a uniform grid, which suits dense
+// scenes of similar-sized objects better; the queries stay the same.
+// Triangles keep their own hierarchy, built along with the sphere one.
+struct World {
+  DyArray<Sphere> objects;
+  SphereStore spheres;
+  // NOTE: The triangles of every added mesh, with the mesh each one came
+  // from in triangle_mesh_ids and that mesh's material in mesh_materials.
+  TriangleMesh triangles;
+  DyArray<uint32_t> triangle_mesh_ids;
+  DyArray<Material> mesh_materials;
+  DyArray<PointLight> lights;
+  Bvh bvh;
+  WideBvh wide_bvh;
+  Grid grid;
+  BvhLayout bvh_layout;
+  float bvh_rebuild_threshold;
+
+  World() noexcept;
+  World(const World& other) noexcept;
+  World& operator=(const World& other) noexcept;
+
+  uint32_t AddObject(const Sphere& object) noexcept;
+  // NOTE: Appends the triangles of mesh and returns the mesh id.
+  uint32_t AddMesh(const TriangleMesh& mesh) noexcept;
+  void AddLight(const PointLight& light) noexcept;
+  void BuildBvh() noexcept;
+  void BuildBvh(BvhLayout layout) noexcept;
+  void BuildGrid() noexcept;
+  // NOTE: Refits whichever hierarchy is built on the render pool threads,
+  // rebuilding it in the same layout once its SAH cost has grown past
+  // bvh_rebuild_threshold. Returns whether it was rebuilt. A grid has no
+  // bounds to refit and a linear BVH is cheaper to build again, so both are
+  // always rebuilt.
+  bool RefitBvh() noexcept;
+
+  operator std::string() const noexcept;
+};
+
+std::ostream& operator<<(std::ostream& os, const World& world);
+
+// NOTE: Where render threads read the scene from on a NUMA machine: the
+// one World shared by every node, or a copy of it per node.
+enum ScenePlacement { SCENE_SHARED, SCENE_REPLICATED };
+
+// NOTE: Copies of a World made by a pool thread on each node, so every page
+// of the copy is first touched, and placed, on that node. Threads read the
+// copy of the node they run on, falling back to the original on nodes the
+// pool has no thread on. The pool should be pinned, or its threads may
+// move off the node they copied on. The original must outlive the replicas
+// and not change while they are in use.
+struct SceneReplicas {
+  const World* shared;
+  std::unique_ptr<std::unique_ptr<World>[]> node_worlds;
+  uint32_t node_count;
+
+  SceneReplicas() noexcept;
+  SceneReplicas(const SceneReplicas& other) = delete;
+  SceneReplicas& operator=(const SceneReplicas& other) = delete;
+
+  void Place(const World& world, ScenePlacement placement,
+             ThreadPool* pool) noexcept;
+  const World& Local() const noexcept;
+  size_t ReplicaCount() const noexcept;
+
+  operator std::string() const noexcept;
+};
+
+std::ostream& operator<<(std::ostream& os, const SceneReplicas& replicas);
+
+// NOTE: Two concentric spheres lit from the top left, the usual scene for
+// checking World queries and shading.
+World DefaultWorld() noexcept;
+
+// NOTE: All hits of a ray against every primitive, ordered by t. Each
+// sphere contributes a sorted run and each triangle a run of at most one
+// hit; the runs are gathered unordered and then k-way merged through a
+// min-heap of run heads, rather than inserted one Push at a time.
+Hits IntersectWorld(const World& world, const Ray& ray) noexcept;
+
+// NOTE: Nearest hit with tmin <= t < tmax, without building a hit list.
+// object_id is the PrimitiveHandle of the hit primitive.
+HitRecord ClosestHit(const World& world, const Ray& ray, float tmin,
+                     float tmax) noexcept;
+
+bool IsOccluded(const World& world, const Ray& ray, float tmin,
+                float tmax) noexcept;
+
+// NOTE: Shades a hit with every light in the world. Each light casts its own
+// shadow ray, which any object in the world can block.
+Color ShadeHit(const World& world, const Ray& ray,
+               const HitRecord& hit) noexcept;
+
+// NOTE: Color seen along a ray; black when it hits nothing.
+Color ColorAt(const World& world, const Ray& ray) noexcept;
+
+void CastWorldShaded(Canvas* canvas, const Point& ray_origin,
+                     const World& world, float wall_z,
+                     float wall_size) noexcept;
+
+// NOTE: Submits the frame to the render pool as tiles and returns at once;
+// wait on or cancel it through frame. A cancelled frame stops at the next
+// tile, leaving the tiles not yet drawn untouched. canvas and world must
+// outlive the frame.
+void StartCastWorldShaded(Canvas* canvas, const Point& ray_origin,
+                          const World& world, float wall_z, float wall_size,
+                          TileScheduler* frame) noexcept;
+// NOTE: As above, each tile reading the scene copy local to its thread.
+void StartCastWorldShaded(Canvas* canvas, const Point& ray_origin,
+                          const SceneReplicas& scene, float wall_z,
+                          float wall_size, TileScheduler* frame) noexcept;
+
+#endif  // SRC_RENDER_WORLD_H_
@@ -0,0 +1,1177 @@
+#include <core/arena.h>
+#include <core/bench_suite.h>
+#include <core/cpu.h>
+#include <core/numa.h>
+#include <core/thread_pool.h>
+#include <core/utils.h>
+#include <geometry/bvh.h>
+#include <geometry/grid.h>
+#include <geometry/instance.h>
+#include <geometry/lbvh.h>
+#include <geometry/matrix.h>
+#include <geometry/mesh.h>
+#include <geometry/obj.h>
+#include <geometry/primitive.h>
+#include <geometry/quaternion.h>
+#include <geometry/ray.h>
+#include <geometry/ray_packet.h>
+#include <geometry/trs_transform.h>
+#include <geometry/wide_bvh.h>
+#include <render/canvas.h>
+#include <render/color.h>
+#include <render/light.h>
+#include <render/progressive.h>
+#include <render/render_job.h>
+#include <render/tile_scheduler.h>
+#include <render/world.h>
+#include <tests/benchmarks.h>
+#include <tests/tests.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <format>
+#include <memory>
+#include <random>
+#include <string>
+
+static inline Matrix GeneralMatrix() noexcept {
+  Matrix matrix{4, 4};
+  float elements[] = {-5, 2, 6, -8, 1, -5, 1, 8, 7, 7, -6, -7, 1, -3, 7, 4};
+  matrix.Populate(elements, matrix.rows * matrix.cols);
+  return matrix;
+}
+
+static inline Matrix AffineMatrix() noexcept {
+  return Identity()
+      .Shear(XY)
+      .Scale(2, .5F, 3)
+      .RotateY(static_cast<float>(PI) / 3.F)
+      .Translate(4, -2, 7);
+}
+
+static inline void BenchMatrix(BenchmarkFramework* bf) {
+  const size_t iterations = 1'000'000;
+
+  double cofactor_general = bf->Run(
+      "Inverse (cofactor, general)", "Matrix", iterations / 10,
+      [](size_t n) {
+        Matrix matrix{GeneralMatrix()};
+        for (size_t i = 0; i < n; ++i) {
+          Matrix inverse{matrix.CofactorInverse()};
+          DoNotOptimize(inverse);
+        }
+      });
+
+  double closed_form_general =
+      bf->Run("Inverse (closed-form, general)", "Matrix", iterations,
+              [](size_t n) {
+                Matrix matrix{GeneralMatrix()};
+                for (size_t i = 0; i < n; ++i) {
+                  Matrix inverse{matrix.Inverse()};
+                  DoNotOptimize(inverse);
+                }
+              });
+
+  double cofactor_affine = bf->Run(
+      "Inverse (cofactor, affine)", "Matrix", iterations / 10, [](size_t n) {
+        Matrix matrix{AffineMatrix()};
+        for (size_t i = 0; i < n; ++i) {
+          Matrix inverse{matrix.CofactorInverse()};
+          DoNotOptimize(inverse);
+        }
+      });
+
+  double closed_form_affine = bf->Run(
+      "Inverse (closed-form, affine)", "Matrix", iterations, [](size_t n) {
+        Matrix matrix{AffineMatrix()};
+        for (size_t i = 0; i < n; ++i) {
+          Matrix inverse{matrix.Inverse()};
+          DoNotOptimize(inverse);
+        }
+      });
+
+  printf("  general speedup: %.1fx, affine speedup: %.1fx\n",
+         closed_form_general / cofactor_general,
+         closed_form_affine / cofactor_affine);
+}
+
+static inline void BenchAffineTransform(BenchmarkFramework* bf) {
+  const size_t iterations = 10'000'000;
+
+  bf->Run("Compose (Matrix)", "Affine", iterations, [](size_t n) {
+    Matrix a{AffineMatrix()};
+    Matrix b{Translate(1, 2, 3).RotateX(.5F)};
+    for (size_t i = 0; i < n; ++i) {
+      Matrix product{a * b};
+      DoNotOptimize(product);
+    }
+  });
+
+  bf->Run("Compose (AffineTransform)", "Affine", iterations, [](size_t n) {
+    AffineTransform a{AffineMatrix()};
+    AffineTransform b{Translate(1, 2, 3).RotateX(.5F)};
+    for (size_t i = 0; i < n; ++i) {
+      AffineTransform product{a * b};
+      DoNotOptimize(product);
+    }
+  });
+
+  bf->Run("Inverse (AffineTransform)", "Affine", iterations, [](size_t n) {
+    AffineTransform transform{AffineMatrix()};
+    for (size_t i = 0; i < n; ++i) {
+      AffineTransform inverse{transform.Inverse()};
+      DoNotOptimize(inverse);
+    }
+  });
+
+  bf->Run("Transform point (Matrix)", "Affine", iterations, [](size_t n) {
+    Matrix transform{AffineMatrix()};
+    Point point{1, 2, 3};
+    for (size_t i = 0; i < n; ++i) {
+      point = transform * point;
+      DoNotOptimize(point);
+    }
+  });
+
+  bf->Run("Transform point (AffineTransform)", "Affine", iterations,
+          [](size_t n) {
+            AffineTransform transform{AffineMatrix()};
+            Point point{1, 2, 3};
+            for (size_t i = 0; i < n; ++i) {
+              point = transform * point;
+              DoNotOptimize(point);
+            }
+          });
+}
+
+// NOTE: One "op" is a per-frame update of a single sphere's transform, with
+// the cached inverse and inverse-transpose refreshed. Both variants start
+// from the same per-sphere rotations, so only composition and inversion
+// are measured.
+static inline void BenchTrsTransform(BenchmarkFramework* bf) {
+  const size_t count = 1024;
+  const size_t frames = 1'000;
+
+  std::unique_ptr<Sphere[]> spheres = std::make_unique<Sphere[]>(count);
+  std::unique_ptr<Quaternion[]> rotations =
+      std::make_unique<Quaternion[]>(count);
+  for (size_t i = 0; i < count; ++i) {
+    rotations[i] = AxisAngle({1, 2, 3}, static_cast<float>(i) * 1e-2F);
+  }
+
+  bf->Run("Animate spheres (Matrix chain)", "TRS", count * frames,
+          [&spheres, &rotations](size_t n) {
+            for (size_t i = 0; i < n; ++i) {
+              float t = static_cast<float>(i % count) * 1e-3F;
+              spheres[i % count].SetTransform(
+                  Translate(t, 1, -t) * rotations[i % count].ToMatrix() *
+                  Scale(2, 1, 2));
+            }
+            DoNotOptimize(spheres[0]);
+          });
+
+  bf->Run("Animate spheres (TrsTransform)", "TRS", count * frames,
+          [&spheres, &rotations](size_t n) {
+            TrsTransform transform{{0, 1, 0}, Quaternion{}, {2, 1, 2}};
+            for (size_t i = 0; i < n; ++i) {
+              float t = static_cast<float>(i % count) * 1e-3F;
+              transform.SetTranslation({t, 1, -t});
+              transform.SetRotation(rotations[i % count]);
+              transform.Update();
+              spheres[i % count].SetTransform(transform);
+            }
+            DoNotOptimize(spheres[0]);
+          });
+}
+
+static inline void BenchBatchTransform(BenchmarkFramework* bf) {
+  const size_t count = 1024;
+  const size_t iterations = 10'000;
+
+  std::unique_ptr<float[]> xs = std::make_unique<float[]>(count);
+  std::unique_ptr<float[]> ys = std::make_unique<float[]>(count);
+  std::unique_ptr<float[]> zs = std::make_unique<float[]>(count);
+  std::unique_ptr<float[]> out_xs = std::make_unique<float[]>(count);
+  std::unique_ptr<float[]> out_ys = std::make_unique<float[]>(count);
+  std::unique_ptr<float[]> out_zs = std::make_unique<float[]>(count);
+  std::unique_ptr<Point[]> points = std::make_unique<Point[]>(count);
+  for (size_t i = 0; i < count; ++i) {
+    xs[i] = static_cast<float>(i);
+    ys[i] = static_cast<float>(count - i);
+    zs[i] = static_cast<float>(i % 7);
+    points[i] = {xs[i], ys[i], zs[i]};
+  }
+
+  Matrix transform{AffineMatrix()};
+
+  double per_tuple = bf->Run(
+      "Transform 1024 points (per tuple)", "Batch", iterations, [&](size_t n) {
+        for (size_t k = 0; k < n; ++k) {
+          for (size_t i = 0; i < count; ++i) {
+            Point point{transform * points[i]};
+            DoNotOptimize(point);
+          }
+        }
+      });
+
+  double batched = bf->Run(
+      "Transform 1024 points (SoA batch)", "Batch", iterations, [&](size_t n) {
+        for (size_t k = 0; k < n; ++k) {
+          TransformPoints(transform, xs.get(), ys.get(), zs.get(),
+                          out_xs.get(), out_ys.get(), out_zs.get(), count);
+          DoNotOptimize(out_xs[0]);
+        }
+      });
+
+  printf("  batch speedup: %.1fx\n", batched / per_tuple);
+}
+
+// NOTE: Ops are rays, so the shaded casts report rays/sec for the whole
+// frame including shading and thread startup.
+static inline void BenchRayPacket(BenchmarkFramework* bf) {
+  const size_t rays = 1'000'000;
+
+  Sphere sphere;
+  sphere.SetTransform(Scale(1, .5F, 1).RotateZ(.3F));
+  Point ray_origin{0, 0, -5};
+
+  bf->Run("Intersect (single ray)", "Packet", rays,
+          [&sphere, &ray_origin](size_t n) {
+            for (size_t i = 0; i < n; ++i) {
+              float x = static_cast<float>(i % 256) / 128.F - 1.F;
+              Ray ray{ray_origin, Vector{x, .1F, 5}.Normalize()};
+              Hits hits{ray.Intersect(sphere)};
+              DoNotOptimize(hits);
+            }
+          });
+
+  bf->Run("Intersect (ray packet)", "Packet", rays,
+          [&sphere, &ray_origin](size_t n) {
+            size_t width = RayPacketWidth();
+            for (size_t i = 0; i < n; i += width) {
+              RayPacket packet{width};
+              for (size_t lane = 0; lane < width; ++lane) {
+                float x = static_cast<float>((i + lane) % 256) / 128.F - 1.F;
+                packet.SetRay(lane,
+                              {ray_origin, Vector{x, .1F, 5}.Normalize()});
+              }
+              PacketHits hits{packet.Intersect(sphere)};
+              DoNotOptimize(hits);
+            }
+          });
+
+  const size_t canvas_size = 512;
+  const size_t pixels = canvas_size * canvas_size;
+  const size_t frames = 20;
+  Canvas canvas{canvas_size, canvas_size};
+  PointLight light{Color{1, 1, 1}, Point{-10, 10, -10}};
+
+  double single = bf->Run(
+      "Shaded cast (single ray)", "Packet", pixels * frames,
+      [&](size_t n) {
+        for (size_t i = 0; i < n / pixels; ++i) {
+          CastShapeShaded(&canvas, ray_origin, sphere, light, 10.F, 7.F,
+                          CAST_SINGLE_RAY);
+        }
+      });
+
+  double packet = bf->Run(
+      "Shaded cast (ray packet)", "Packet", pixels * frames,
+      [&](size_t n) {
+        for (size_t i = 0; i < n / pixels; ++i) {
+          CastShapeShaded(&canvas, ray_origin, sphere, light, 10.F, 7.F,
+                          CAST_RAY_PACKET);
+        }
+      });
+
+  printf("  packet width: %zu, shaded cast speedup: %.2fx\n",
+         RayPacketWidth(), packet / single);
+}
+
+static inline void BenchClosestHit(BenchmarkFramework* bf) {
+  const size_t count = 64;
+  const size_t rays = 100'000;
+
+  std::unique_ptr<Sphere[]> spheres = std::make_unique<Sphere[]>(count);
+  for (size_t i = 0; i < count; ++i) {
+    spheres[i].SetTransform(
+        Translate(static_cast<float>(i % 8) * .5F - 2.F, 0,
+                  static_cast<float>(i) * 2.F));
+  }
+
+  bf->Run("Nearest hit (sorted Hits)", "Closest", rays,
+          [&spheres](size_t n) {
+            for (size_t i = 0; i < n; ++i) {
+              float x = static_cast<float>(i % 64) / 16.F - 2.F;
+              Ray ray{{x, 0, -5}, {0, 0, 1}};
+              Hits hits;
+              for (size_t k = 0; k < count; ++k) {
+                Hits object_hits{ray.Intersect(spheres[k])};
+                for (size_t h = 0; h < object_hits.count; ++h) {
+                  hits.Push(object_hits[h]);
+                }
+              }
+              int32_t idx = hits.count > 0 ? hits.FirstHitIdx() : -1;
+              DoNotOptimize(idx);
+            }
+          });
+
+  bf->Run("Nearest hit (ClosestHit)", "Closest", rays,
+          [&spheres](size_t n) {
+            for (size_t i = 0; i < n; ++i) {
+              float x = static_cast<float>(i % 64) / 16.F - 2.F;
+              Ray ray{{x, 0, -5}, {0, 0, 1}};
+              HitRecord hit{
+                  ClosestHit(ray, spheres.get(), count, 0.F, INFINITY)};
+              DoNotOptimize(hit);
+            }
+          });
+
+  SphereStore store;
+  for (size_t i = 0; i < count; ++i) {
+    store.Add(spheres[i]);
+  }
+
+  bf->Run("Nearest hit (SphereStore)", "Closest", rays, [&store](size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+      float x = static_cast<float>(i % 64) / 16.F - 2.F;
+      Ray ray{{x, 0, -5}, {0, 0, 1}};
+      HitRecord hit{store.ClosestHit(ray, 0.F, INFINITY)};
+      DoNotOptimize(hit);
+    }
+  });
+
+  // NOTE: Shadow rays run from behind the spheres towards a light past the
+  // far end, so about half of them are occluded.
+  bf->Run("Any hit (IsOccluded)", "Closest", rays, [&spheres](size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+      float x = static_cast<float>(i % 64) / 16.F - 2.F;
+      Ray ray{{x, 0, -5}, {0, 0, 200}};
+      bool is_occluded = IsOccluded(ray, spheres.get(), count, 0.F, 1.F);
+      DoNotOptimize(is_occluded);
+    }
+  });
+
+  bf->Run("Any hit (SphereStore)", "Closest", rays, [&store](size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+      float x = static_cast<float>(i % 64) / 16.F - 2.F;
+      Ray ray{{x, 0, -5}, {0, 0, 200}};
+      bool is_occluded = store.IsOccluded(ray, 0.F, 1.F);
+      DoNotOptimize(is_occluded);
+    }
+  });
+
+  bf->Run("Any hit (RayPacket::Occluded)", "Closest", rays,
+          [&spheres](size_t n) {
+            size_t width = RayPacketWidth();
+            for (size_t i = 0; i < n; i += width) {
+              RayPacket packet{width};
+              for (size_t lane = 0; lane < width; ++lane) {
+                float x = static_cast<float>((i + lane) % 64) / 16.F - 2.F;
+                packet.SetRay(lane, {{x, 0, -5}, {0, 0, 200}});
+              }
+              uint32_t occluded =
+                  packet.Occluded(spheres.get(), count, 0.F, 1.F);
+              DoNotOptimize(occluded);
+            }
+          });
+}
+
+static inline void BenchWorld(BenchmarkFramework* bf) {
+  const size_t count = 1'000;
+  const size_t rays = 10'000;
+
+  // NOTE: Spheres lined up along the ray so every ray collects about two
+  // thousand hits. They are added in scrambled depth order, as scene files
+  // do not list objects front to back.
+  World world;
+  for (size_t i = 0; i < count; ++i) {
+    float z = static_cast<float>((i * 389) % count) * .5F;
+    Sphere sphere;
+    sphere.SetTransform(
+        Translate(static_cast<float>(i % 4) * .25F - .5F, 0, z));
+    world.AddObject(sphere);
+  }
+
+  bf->Run("World hits (Push per hit)", "World", rays, [&world](size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+      float x = static_cast<float>(i % 16) / 32.F - .25F;
+      Ray ray{{x, 0, -5}, {0, 0, 1}};
+      ScratchScope scope{ThreadHitsArena()};
+      Hits hits;
+      for (size_t k = 0; k < world.objects.size; ++k) {
+        Hits object_hits{ray.Intersect(world.objects[k])};
+        for (size_t h = 0; h < object_hits.count; ++h) {
+          hits.Push(object_hits[h]);
+        }
+      }
+      DoNotOptimize(hits.count);
+    }
+  });
+
+  bf->Run("World hits (IntersectWorld)", "World", rays, [&world](size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+      float x = static_cast<float>(i % 16) / 32.F - .25F;
+      Ray ray{{x, 0, -5}, {0, 0, 1}};
+      ScratchScope scope{ThreadHitsArena()};
+      Hits hits{IntersectWorld(world, ray)};
+      DoNotOptimize(hits.count);
+    }
+  });
+
+  bf->Run("World nearest hit (ClosestHit)", "World", rays,
+          [&world](size_t n) {
+            for (size_t i = 0; i < n; ++i) {
+              float x = static_cast<float>(i % 16) / 32.F - .25F;
+              Ray ray{{x, 0, -5}, {0, 0, 1}};
+              HitRecord hit{ClosestHit(world, ray, 0.F, INFINITY)};
+              DoNotOptimize(hit);
+            }
+          });
+}
+
+// NOTE: Scenes keep the sphere density fixed, so the cube grows with the
+// cube root of the sphere count and rays cross a similar number of spheres
+// per unit length at every size.
+static inline void BenchBvh(BenchmarkFramework* bf) {
+  const size_t counts[] = {1'000, 100'000, 1'000'000};
+  const size_t rays = 100'000;
+
+  for (size_t count : counts) {
+    float size = std::cbrt(static_cast<float>(count));
+    std::unique_ptr<Sphere[]> spheres{RandomSpheres(count, size, 1)};
+    std::string label = std::format("{}k", count / 1'000);
+
+    Bvh bvh;
+    std::string build_name = std::format("BVH build ({} spheres)", label);
+    double builds_per_second =
+        bf->Run(build_name.c_str(), "Bvh", 1, [&](size_t n) {
+          for (size_t i = 0; i < n; ++i) {
+            bvh.Build(spheres.get(), count);
+          }
+        });
+
+    std::string closest_name = std::format("BVH closest hit ({})", label);
+    double closest_per_second =
+        bf->Run(closest_name.c_str(), "Bvh", rays, [&](size_t n) {
+          std::mt19937 rng{2};
+          for (size_t i = 0; i < n; ++i) {
+            Ray ray{RandomRay(&rng, size)};
+            HitRecord hit{bvh.ClosestHit(ray, spheres.get(), 0.F, INFINITY)};
+            DoNotOptimize(hit);
+          }
+        });
+
+    std::string any_name = std::format("BVH any hit ({})", label);
+    bf->Run(any_name.c_str(), "Bvh", rays, [&](size_t n) {
+      std::mt19937 rng{2};
+      for (size_t i = 0; i < n; ++i) {
+        Ray ray{RandomRay(&rng, size)};
+        bool is_occluded = bvh.IsOccluded(ray, spheres.get(), 0.F, INFINITY);
+        DoNotOptimize(is_occluded);
+      }
+    });
+
+    WideBvh wide_bvh;
+    std::string collapse_name = std::format("Wide BVH collapse ({})", label);
+    double collapses_per_second =
+        bf->Run(collapse_name.c_str(), "Bvh", 1, [&](size_t n) {
+          for (size_t i = 0; i < n; ++i) {
+            wide_bvh.Build(bvh);
+          }
+        });
+
+    std::string wide_closest_name =
+        std::format("Wide BVH closest hit ({})", label);
+    double wide_closest_per_second =
+        bf->Run(wide_closest_name.c_str(), "Bvh", rays, [&](size_t n) {
+          std::mt19937 rng{2};
+          for (size_t i = 0; i < n; ++i) {
+            Ray ray{RandomRay(&rng, size)};
+            HitRecord hit{
+                wide_bvh.ClosestHit(ray, spheres.get(), 0.F, INFINITY)};
+            DoNotOptimize(hit);
+          }
+        });
+
+    std::string wide_any_name = std::format("Wide BVH any hit ({})", label);
+    bf->Run(wide_any_name.c_str(), "Bvh", rays, [&](size_t n) {
+      std::mt19937 rng{2};
+      for (size_t i = 0; i < n; ++i) {
+        Ray ray{RandomRay(&rng, size)};
+        bool is_occluded =
+            wide_bvh.IsOccluded(ray, spheres.get(), 0.F, INFINITY);
+        DoNotOptimize(is_occluded);
+      }
+    });
+
+    std::string refit_name = std::format("BVH refit ({})", label);
+    double refits_per_second =
+        bf->Run(refit_name.c_str(), "Bvh", 1, [&](size_t n) {
+          for (size_t i = 0; i < n; ++i) {
+            bool is_rebuilt =
+                bvh.Refit(spheres.get(), count, BVH_REBUILD_THRESHOLD, 0);
+            DoNotOptimize(is_rebuilt);
+          }
+        });
+
+    std::string wide_refit_name = std::format("Wide BVH refit ({})", label);
+    double wide_refits_per_second =
+        bf->Run(wide_refit_name.c_str(), "Bvh", 1, [&](size_t n) {
+          for (size_t i = 0; i < n; ++i) {
+            bool is_rebuilt =
+                wide_bvh.Refit(spheres.get(), count, BVH_REBUILD_THRESHOLD, 0);
+            DoNotOptimize(is_rebuilt);
+          }
+        });
+
+    Bvh linear_bvh;
+    const size_t thread_counts[] = {1, 4, 0};
+    double linear_builds_per_second = 0.;
+    for (size_t thread_count : thread_counts) {
+      std::string linear_name =
+          thread_count == 0
+              ? std::format("Linear BVH build ({}, all threads)", label)
+              : std::format("Linear BVH build ({}, {} threads)", label,
+                            thread_count);
+      linear_builds_per_second =
+          bf->Run(linear_name.c_str(), "Bvh", 1, [&](size_t n) {
+            for (size_t i = 0; i < n; ++i) {
+              BuildLinearBvh(spheres.get(), count, thread_count, &linear_bvh);
+            }
+          });
+    }
+
+    std::string linear_closest_name =
+        std::format("Linear BVH closest hit ({})", label);
+    double linear_closest_per_second =
+        bf->Run(linear_closest_name.c_str(), "Bvh", rays, [&](size_t n) {
+          std::mt19937 rng{2};
+          for (size_t i = 0; i < n; ++i) {
+            Ray ray{RandomRay(&rng, size)};
+            HitRecord hit{
+                linear_bvh.ClosestHit(ray, spheres.get(), 0.F, INFINITY)};
+            DoNotOptimize(hit);
+          }
+        });
+
+    if (count <= 1'000) {
+      double brute_force_per_second =
+          bf->Run("Brute force closest hit (1k)", "Bvh", rays / 10,
+                  [&](size_t n) {
+                    std::mt19937 rng{2};
+                    for (size_t i = 0; i < n; ++i) {
+                      Ray ray{RandomRay(&rng, size)};
+                      HitRecord hit{ClosestHit(ray, spheres.get(), count, 0.F,
+                                               INFINITY)};
+                      DoNotOptimize(hit);
+                    }
+                  });
+      printf("  BVH speedup over brute force: %.1fx\n",
+             closest_per_second / brute_force_per_second);
+    }
+
+    printf("  build: %.2f ms, nodes: %zu, memory: %.2f MB\n",
+           1e3 / builds_per_second, bvh.node_count,
+           static_cast<double>(bvh.MemoryUsage()) / (1024. * 1024.));
+    printf("  wide collapse: %.2f ms, nodes: %zu, memory: %.2f MB, "
+           "closest hit speedup: %.2fx\n",
+           1e3 / collapses_per_second, wide_bvh.node_count,
+           static_cast<double>(wide_bvh.MemoryUsage()) / (1024. * 1024.),
+           wide_closest_per_second / closest_per_second);
+    printf("  refit: %.2f ms (%.1fx faster than build), "
+           "wide refit: %.2f ms\n",
+           1e3 / refits_per_second, refits_per_second / builds_per_second,
+           1e3 / wide_refits_per_second);
+    printf("  linear build: %.2f ms (%.2f ms per million), "
+           "build speedup: %.1fx, closest hit vs SAH: %.2fx\n",
+           1e3 / linear_builds_per_second,
+           1e9 / linear_builds_per_second / static_cast<double>(count),
+           linear_builds_per_second / builds_per_second,
+           linear_closest_per_second / closest_per_second);
+  }
+}
+
+// NOTE: The same spheres as RandomSpheres, packed into GRID_BENCH_CLUSTERS
+// tight clumps scattered through the cube, where most grid cells are empty.
+#define GRID_BENCH_CLUSTERS 16
+
+static inline std::unique_ptr<Sphere[]> ClusteredSpheres(size_t count,
+                                                         float size) {
+  std::unique_ptr<Sphere[]> spheres{RandomSpheres(count, size * .1F, 3)};
+  std::mt19937 rng{5};
+  std::uniform_real_distribution<float> position{-size * .9F, size * .9F};
+  Vector centers[GRID_BENCH_CLUSTERS];
+  for (Vector& center : centers) {
+    center = {position(rng), position(rng), position(rng)};
+  }
+  for (size_t i = 0; i < count; ++i) {
+    const Vector& center = centers[i % GRID_BENCH_CLUSTERS];
+    spheres[i].SetTransform(
+        spheres[i].transform_matrix.Translate(center.x, center.y, center.z));
+  }
+  return spheres;
+}
+
+static inline void BenchGrid(BenchmarkFramework* bf) {
+  const size_t counts[] = {100'000, 1'000'000};
+  const size_t rays = 100'000;
+
+  for (size_t count : counts) {
+    float size = std::cbrt(static_cast<float>(count));
+    std::unique_ptr<Sphere[]> uniform{RandomSpheres(count, size, 1)};
+    std::unique_ptr<Sphere[]> clustered{ClusteredSpheres(count, size)};
+    const Sphere* scenes[] = {uniform.get(), clustered.get()};
+    const char* scene_names[] = {"uniform", "clustered"};
+
+    for (size_t scene = 0; scene < ArraySize(scenes); ++scene) {
+      const Sphere* spheres = scenes[scene];
+      std::string label =
+          std::format("{} {}k", scene_names[scene], count / 1'000);
+
+      Grid grid;
+      std::string grid_build_name = std::format("Grid build ({})", label);
+      double grid_builds_per_second =
+          bf->Run(grid_build_name.c_str(), "Grid", 1, [&](size_t n) {
+            for (size_t i = 0; i < n; ++i) {
+              grid.Build(spheres, count, 0);
+            }
+          });
+
+      std::string grid_closest_name =
+          std::format("Grid closest hit ({})", label);
+      double grid_closest_per_second =
+          bf->Run(grid_closest_name.c_str(), "Grid", rays, [&](size_t n) {
+            std::mt19937 rng{2};
+            for (size_t i = 0; i < n; ++i) {
+              Ray ray{RandomRay(&rng, size)};
+              HitRecord hit{grid.ClosestHit(ray, spheres, 0.F, INFINITY)};
+              DoNotOptimize(hit);
+            }
+          });
+
+      std::string grid_any_name = std::format("Grid any hit ({})", label);
+      bf->Run(grid_any_name.c_str(), "Grid", rays, [&](size_t n) {
+        std::mt19937 rng{2};
+        for (size_t i = 0; i < n; ++i) {
+          Ray ray{RandomRay(&rng, size)};
+          bool is_occluded = grid.IsOccluded(ray, spheres, 0.F, INFINITY);
+          DoNotOptimize(is_occluded);
+        }
+      });
+
+      Bvh bvh;
+      WideBvh wide_bvh;
+      std::string bvh_build_name =
+          std::format("Wide BVH build ({})", label);
+      double bvh_builds_per_second =
+          bf->Run(bvh_build_name.c_str(), "Grid", 1, [&](size_t n) {
+            for (size_t i = 0; i < n; ++i) {
+              bvh.Build(spheres, count);
+              wide_bvh.Build(bvh);
+            }
+          });
+
+      std::string bvh_closest_name =
+          std::format("Wide BVH closest hit ({})", label);
+      double bvh_closest_per_second =
+          bf->Run(bvh_closest_name.c_str(), "Grid", rays, [&](size_t n) {
+            std::mt19937 rng{2};
+            for (size_t i = 0; i < n; ++i) {
+              Ray ray{RandomRay(&rng, size)};
+              HitRecord hit{wide_bvh.ClosestHit(ray, spheres, 0.F, INFINITY)};
+              DoNotOptimize(hit);
+            }
+          });
+
+      printf("  grid: %ux%ux%u cells, %.2f references per object, "
+             "memory: %.2f MB\n",
+             grid.resolution_x, grid.resolution_y, grid.resolution_z,
+             static_cast<double>(grid.indices.size) /
+                 static_cast<double>(count),
+             static_cast<double>(grid.MemoryUsage()) / (1024. * 1024.));
+      printf("  vs wide BVH: build %.1fx, closest hit %.2fx\n",
+             grid_builds_per_second / bvh_builds_per_second,
+             grid_closest_per_second / bvh_closest_per_second);
+    }
+  }
+}
+
+static inline void BenchInstance(BenchmarkFramework* bf) {
+  const size_t blas_count = 1'000;
+  const size_t instance_counts[] = {100, 10'000};
+  const size_t rays = 100'000;
+
+  std::unique_ptr<Sphere[]> spheres{RandomSpheres(blas_count, 10.F, 1)};
+  Blas blas{spheres.get(), blas_count};
+
+  for (size_t instance_count : instance_counts) {
+    float size = 20.F * std::cbrt(static_cast<float>(instance_count));
+    std::mt19937 rng{3};
+    std::uniform_real_distribution<float> position{-size, size};
+    std::uniform_real_distribution<float> angle{0.F, 6.2831853F};
+
+    Tlas tlas;
+    for (size_t i = 0; i < instance_count; ++i) {
+      tlas.AddInstance(&blas, RotateY(angle(rng)).Translate(
+                                  position(rng), position(rng), position(rng)));
+    }
+
+    std::string build_name =
+        std::format("TLAS build ({} instances)", instance_count);
+    double builds_per_second =
+        bf->Run(build_name.c_str(), "Instance", 1, [&](size_t n) {
+          for (size_t i = 0; i < n; ++i) {
+            tlas.Build();
+          }
+        });
+
+    std::string move_name =
+        std::format("TLAS move and refit ({} instances)", instance_count);
+    double moves_per_second =
+        bf->Run(move_name.c_str(), "Instance", 100, [&](size_t n) {
+          for (size_t i = 0; i < n; ++i) {
+            auto instance_id = static_cast<uint32_t>(i % instance_count);
+            Matrix transform{tlas.instances[instance_id].transform_matrix};
+            tlas.SetTransform(instance_id, transform.Translate(.1F, 0, 0));
+            bool is_rebuilt = tlas.Refit(BVH_REBUILD_THRESHOLD, 0);
+            DoNotOptimize(is_rebuilt);
+          }
+        });
+
+    std::string closest_name =
+        std::format("Instanced closest hit ({} x 1k)", instance_count);
+    double instanced_per_second =
+        bf->Run(closest_name.c_str(), "Instance", rays, [&](size_t n) {
+          std::mt19937 ray_rng{2};
+          for (size_t i = 0; i < n; ++i) {
+            Ray ray{RandomRay(&ray_rng, size)};
+            InstanceHitRecord hit{tlas.ClosestHit(ray, 0.F, INFINITY)};
+            DoNotOptimize(hit);
+          }
+        });
+
+    size_t copies_size = instance_count * blas_count * sizeof(Sphere);
+    printf("  build: %.2f ms, move and refit: %.3f ms, "
+           "memory: %.2f MB instanced vs %.2f MB copied\n",
+           1e3 / builds_per_second, 1e3 / moves_per_second,
+           static_cast<double>(tlas.MemoryUsage() + blas.MemoryUsage()) /
+               (1024. * 1024.),
+           static_cast<double>(copies_size) / (1024. * 1024.));
+
+    if (instance_count > 100) {
+      continue;
+    }
+
+    // NOTE: The same scene with every instance copied into one flat tree.
+    size_t flat_count = instance_count * blas_count;
+    std::unique_ptr<Sphere[]> flattened =
+        std::make_unique<Sphere[]>(flat_count);
+    for (size_t i = 0; i < instance_count; ++i) {
+      for (size_t j = 0; j < blas_count; ++j) {
+        flattened[i * blas_count + j].SetTransform(
+            tlas.instances[i].transform_matrix * spheres[j].transform_matrix);
+      }
+    }
+    WideBvh flat_bvh{flattened.get(), flat_count};
+
+    std::string flat_name =
+        std::format("Flattened closest hit ({} x 1k)", instance_count);
+    double flat_per_second =
+        bf->Run(flat_name.c_str(), "Instance", rays, [&](size_t n) {
+          std::mt19937 ray_rng{2};
+          for (size_t i = 0; i < n; ++i) {
+            Ray ray{RandomRay(&ray_rng, size)};
+            HitRecord hit{
+                flat_bvh.ClosestHit(ray, flattened.get(), 0.F, INFINITY)};
+            DoNotOptimize(hit);
+          }
+        });
+    printf("  instanced query speed vs flattened: %.2fx\n",
+           instanced_per_second / flat_per_second);
+  }
+}
+
+static inline void BenchMesh(BenchmarkFramework* bf) {
+  const size_t grid_width = 1'000;
+  const size_t rays = 100'000;
+
+  std::string source{GridObj(grid_width, grid_width)};
+  double megabytes = static_cast<double>(source.size()) / (1024. * 1024.);
+  TriangleMesh parsed;
+  const size_t thread_counts[] = {1, 0};
+  for (size_t thread_count : thread_counts) {
+    std::string parse_name = std::format(
+        "Parse OBJ ({:.0f} MB, {} threads)", megabytes,
+        thread_count == 0 ? "all" : std::to_string(thread_count));
+    double parses_per_second =
+        bf->Run(parse_name.c_str(), "Mesh", 1, [&](size_t n) {
+          for (size_t i = 0; i < n; ++i) {
+            ParseObj(source.c_str(), source.size(), thread_count, &parsed);
+            DoNotOptimize(parsed.vertex_xs[0]);
+          }
+        });
+    double triangles_per_second =
+        parses_per_second * static_cast<double>(parsed.TriangleCount());
+    printf("  %.1f MB/s, 10M triangles in %.2f s\n",
+           megabytes * parses_per_second, 1e7 / triangles_per_second);
+  }
+
+  const size_t counts[] = {MESH_FLAT_TRIANGLE_COUNT, 100'000};
+  IsaLevel detected = DetectIsaLevel();
+  for (size_t count : counts) {
+    float size = std::cbrt(static_cast<float>(count));
+    TriangleMesh mesh{RandomTriangles(count, size, 1)};
+    std::string build_name = std::format("Mesh build ({})", count);
+    bf->Run(build_name.c_str(), "Mesh", 1, [&](size_t n) {
+      for (size_t i = 0; i < n; ++i) {
+        mesh.Build();
+      }
+    });
+
+    for (int level = ISA_SSE2; level <= detected; ++level) {
+      ForceIsaLevel(static_cast<IsaLevel>(level));
+      std::string closest_name = std::format(
+          "Mesh closest hit ({}, {})", count,
+          IsaLevelName(static_cast<IsaLevel>(level)));
+      bf->Run(closest_name.c_str(), "Mesh", rays, [&](size_t n) {
+        std::mt19937 rng{2};
+        for (size_t i = 0; i < n; ++i) {
+          Ray ray{RandomRay(&rng, size)};
+          HitRecord hit{mesh.ClosestHit(ray, 0.F, INFINITY)};
+          DoNotOptimize(hit);
+        }
+      });
+    }
+    ForceIsaLevel(detected);
+    printf("  memory: %.1f KB\n",
+           static_cast<double>(mesh.MemoryUsage()) / 1024.);
+  }
+}
+
+static inline void BenchDispatch(BenchmarkFramework* bf) {
+  const size_t count = 1024;
+  const size_t iterations = 10'000;
+
+  std::unique_ptr<float[]> xs = std::make_unique<float[]>(count);
+  std::unique_ptr<float[]> ys = std::make_unique<float[]>(count);
+  std::unique_ptr<float[]> zs = std::make_unique<float[]>(count);
+  std::unique_ptr<Color[]> colors = std::make_unique<Color[]>(count);
+  std::unique_ptr<ColorRGB[]> rgbs = std::make_unique<ColorRGB[]>(count);
+  for (size_t i = 0; i < count; ++i) {
+    xs[i] = static_cast<float>(i);
+    ys[i] = static_cast<float>(count - i);
+    zs[i] = static_cast<float>(i % 7);
+    colors[i] = {xs[i] / count, ys[i] / count, zs[i] / 7.F};
+  }
+
+  Matrix transform{AffineMatrix()};
+  IsaLevel detected = DetectIsaLevel();
+
+  const size_t sphere_count = 1000;
+  std::unique_ptr<Sphere[]> spheres{RandomSpheres(sphere_count, 10.F, 7)};
+  SphereStore store;
+  store.Build(spheres.get(), nullptr, sphere_count);
+
+  for (int level = ISA_SSE2; level <= detected; ++level) {
+    ForceIsaLevel(static_cast<IsaLevel>(level));
+    const char* tag = IsaLevelName(static_cast<IsaLevel>(level));
+
+    bf->Run("Matrix multiply", tag, iterations * 100, [&](size_t n) {
+      Matrix product{transform};
+      for (size_t i = 0; i < n; ++i) {
+        product = transform * product;
+        DoNotOptimize(product);
+      }
+    });
+
+    bf->Run("Transform 1024 points (SoA batch)", tag, iterations,
+            [&](size_t n) {
+              for (size_t i = 0; i < n; ++i) {
+                TransformPoints(transform, xs.get(), ys.get(), zs.get(),
+                                xs.get(), ys.get(), zs.get(), count);
+                DoNotOptimize(xs[0]);
+              }
+            });
+
+    bf->Run("Convert 1024 colors to RGB", tag, iterations, [&](size_t n) {
+      for (size_t i = 0; i < n; ++i) {
+        NormalizedToRGB(colors.get(), rgbs.get(), count);
+        DoNotOptimize(rgbs[0]);
+      }
+    });
+
+    bf->Run("SphereStore nearest hit (1000 spheres)", tag, iterations,
+            [&](size_t n) {
+              std::mt19937 rng{11};
+              for (size_t i = 0; i < n; ++i) {
+                Ray ray{RandomRay(&rng, 10.F)};
+                HitRecord hit{store.ClosestHit(ray, 0.F, INFINITY)};
+                DoNotOptimize(hit);
+              }
+            });
+  }
+
+  ForceIsaLevel(detected);
+}
+
+static inline void BenchTileScheduler(BenchmarkFramework* bf) {
+  const size_t canvas_size = 256;
+  const size_t frames = 10;
+
+  World world{DefaultWorld()};
+  Point ray_origin{0, 0, -5};
+  Canvas canvas{canvas_size, canvas_size};
+  float pixel_size = 7.F / static_cast<float>(canvas_size);
+  const char* order_names[] = {"scanline", "Morton", "Hilbert"};
+  const size_t thread_counts[] = {1, 2, 4, 0};
+
+  for (size_t thread_count : thread_counts) {
+    ThreadPool pool{thread_count};
+    for (int order = TILE_ORDER_SCANLINE; order <= TILE_ORDER_HILBERT;
+         ++order) {
+      TileScheduler scheduler;
+      scheduler.order = static_cast<TileOrder>(order);
+      std::string name = std::format("Render frame ({} threads, {} tiles)",
+                                     pool.thread_count, order_names[order]);
+      bf->Run(name.c_str(), "Tile", frames, [&](size_t n) {
+        for (size_t i = 0; i < n; ++i) {
+          scheduler.Start(&pool, canvas_size, canvas_size,
+                          [&](const Tile& tile) {
+                            for (size_t y = tile.y0; y < tile.y1; ++y) {
+                              for (size_t x = tile.x0; x < tile.x1; ++x) {
+                                float world_x = static_cast<float>(x);
+                                float world_y = static_cast<float>(y);
+                                Point position{-3.5F + pixel_size * world_x,
+                                               3.5F - pixel_size * world_y,
+                                               10.F};
+                                Ray ray{ray_origin,
+                                        (position - ray_origin).Normalize()};
+                                canvas.WriteColor(x, y, ColorAt(world, ray));
+                              }
+                            }
+                          });
+          scheduler.Wait();
+        }
+      });
+
+      // NOTE: Efficiency is busy time over workers times frame time; near
+      // 1 means the frame scales linearly with the worker count.
+      double busy_seconds = 0;
+      double max_idle_seconds = 0;
+      size_t steal_count = 0;
+      for (size_t i = 0; i < scheduler.worker_count; ++i) {
+        busy_seconds += scheduler.workers[i].busy_seconds;
+        max_idle_seconds =
+            std::max(max_idle_seconds, scheduler.IdleSeconds(i));
+        steal_count += scheduler.workers[i].steal_count;
+      }
+      printf("  last frame: %.2f ms, efficiency: %.1f%%, max idle: %.3f ms, "
+             "steals: %zu\n",
+             scheduler.FrameSeconds() * 1e3,
+             busy_seconds * 100. /
+                 (static_cast<double>(scheduler.worker_count) *
+                  scheduler.FrameSeconds()),
+             max_idle_seconds * 1e3, steal_count);
+    }
+  }
+}
+
+static inline void BenchNuma(BenchmarkFramework* bf) {
+  const size_t canvas_size = 512;
+  const size_t frames = 5;
+
+  // NOTE: A field of spheres in front of the camera, large enough that the
+  // hierarchy and sphere rows span many pages.
+  World world{DefaultWorld()};
+  std::mt19937 rng{5};
+  std::uniform_real_distribution<float> position{-4.F, 4.F};
+  for (size_t i = 0; i < 20'000; ++i) {
+    Sphere sphere;
+    sphere.SetTransform(Translate(position(rng), position(rng),
+                                  position(rng) + 6.F) *
+                        Scale(.1F, .1F, .1F));
+    world.AddObject(sphere);
+  }
+  world.BuildBvh();
+  Point ray_origin{0, 0, -5};
+
+  const bool pinned_flags[] = {false, true};
+  for (bool is_pinned : pinned_flags) {
+    SetRenderThreadCount(0, is_pinned);
+    TileScheduler frame;
+    SceneReplicas scene;
+    scene.Place(world, is_pinned ? SCENE_REPLICATED : SCENE_SHARED,
+                RenderPool());
+    Canvas canvas{canvas_size, canvas_size, !is_pinned};
+    if (is_pinned) {
+      FirstTouchCanvas(&canvas, &frame, RenderPool());
+    }
+
+    std::string name =
+        is_pinned ? "Render frame (pinned, first touch, replicated scene)"
+                  : "Render frame (unpinned, shared canvas and scene)";
+    bf->Run(name.c_str(), "Numa", frames, [&](size_t n) {
+      for (size_t i = 0; i < n; ++i) {
+        StartCastWorldShaded(&canvas, ray_origin, scene, 10.F, 7.F, &frame);
+        frame.Wait();
+      }
+    });
+
+    // NOTE: Stands in for remote traffic counters: the share of tiles whose
+    // first canvas page, or the scene rows they read, sit on another node
+    // than the thread drawing them.
+    std::atomic<size_t> remote_canvas{0};
+    std::atomic<size_t> remote_scene{0};
+    frame.Start(RenderPool(), canvas_size, canvas_size, [&](const Tile& tile) {
+      uint32_t node = CurrentNumaNode();
+      const Color* pixel = &canvas.colors[tile.y0 * canvas_size + tile.x0];
+      const World& local = scene.Local();
+      remote_canvas += PageNumaNode(pixel) != node ? 1 : 0;
+      remote_scene +=
+          PageNumaNode(local.spheres.rows[SPHERE_M0].data.get()) != node ? 1
+                                                                         : 0;
+    });
+    frame.Wait();
+    double tile_count = static_cast<double>(frame.tiles.size);
+    printf("  %s, replicas: %zu, remote canvas tiles: %.1f%%, "
+           "remote scene tiles: %.1f%%\n",
+           std::string(GetNumaTopology()).c_str(), scene.ReplicaCount(),
+           static_cast<double>(remote_canvas) * 100. / tile_count,
+           static_cast<double>(remote_scene) * 100. / tile_count);
+  }
+  SetRenderThreadCount(0);
+}
+
+static inline void BenchProgressive(BenchmarkFramework* bf) {
+  const size_t canvas_size = 512;
+  const size_t frames = 5;
+
+  World world{DefaultWorld()};
+  Point ray_origin{0, 0, -5};
+  Canvas canvas{canvas_size, canvas_size};
+  bf->Run("Render frame (full resolution)", "Progressive", frames,
+          [&](size_t n) {
+            for (size_t i = 0; i < n; ++i) {
+              CastWorldShaded(&canvas, ray_origin, world, 10.F, 7.F);
+            }
+          });
+
+  ProgressiveRender render;
+  render.max_samples = 16;
+  render.budget_ms = 1e-6;
+  bf->Run("First image (8x8 blocks)", "Progressive", frames, [&](size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+      StartProgressiveWorld(&canvas, ray_origin, world, 10.F, 7.F, &render);
+      render.Wait();
+    }
+  });
+
+  const double budgets_ms[] = {16., 33., 100., 500.};
+  for (double budget_ms : budgets_ms) {
+    render.budget_ms = budget_ms;
+    std::chrono::steady_clock::time_point start =
+        std::chrono::steady_clock::now();
+    StartProgressiveWorld(&canvas, ray_origin, world, 10.F, 7.F, &render);
+    render.Wait();
+    double elapsed_ms = std::chrono::duration<double, std::milli>(
+                            std::chrono::steady_clock::now() - start)
+                            .count();
+    printf("  %.0f ms budget: %zu of %zu passes in %.1f ms\n", budget_ms,
+           render.CompletedPasses(), ProgressivePassCount(render.max_samples),
+           elapsed_ms);
+  }
+}
+
+// NOTE: A frame of a batch: DefaultWorld and count random spheres, with the
+// hierarchy built, as the batch service sets up each scene before drawing.
+static inline std::shared_ptr<const World> BatchFrameWorld(
+    const size_t count, const uint32_t seed) {
+  std::shared_ptr<World> world = std::make_shared<World>(DefaultWorld());
+  std::unique_ptr<Sphere[]> spheres{RandomSpheres(count, 4.F, seed)};
+  for (size_t i = 0; i < count; ++i) {
+    world->AddObject(spheres[i]);
+  }
+  world->BuildBvh();
+  return world;
+}
+
+static inline void BenchRenderJob(BenchmarkFramework* bf) {
+  const size_t canvas_size = 256;
+  const size_t sphere_count = 20'000;
+  const size_t frames = 8;
+  Point ray_origin{0, 0, -5};
+  Path output_path = Join(bf->root, "/data/render_job.ppm");
+
+  bf->Run("Batch frames, blocking", "RenderJob", frames, [&](size_t n) {
+    Canvas canvas{canvas_size, canvas_size};
+    for (size_t i = 0; i < n; ++i) {
+      std::shared_ptr<const World> world =
+          BatchFrameWorld(sphere_count, static_cast<uint32_t>(i));
+      CastWorldShaded(&canvas, ray_origin, *world, 10.F, 7.F);
+      canvas.SaveToPPM(output_path);
+    }
+  });
+
+  // NOTE: The next scene is built while the pool draws the last one, and
+  // each frame is encoded on the pool thread that finishes it.
+  bf->Run("Batch frames, in flight", "RenderJob", frames, [&](size_t n) {
+    std::unique_ptr<std::shared_ptr<RenderJob>[]> jobs =
+        std::make_unique<std::shared_ptr<RenderJob>[]>(n);
+    for (size_t i = 0; i < n; ++i) {
+      jobs[i] = SubmitRenderJob(
+          BatchFrameWorld(sphere_count, static_cast<uint32_t>(i)),
+          canvas_size, canvas_size, ray_origin, 10.F, 7.F, TASK_PRIORITY_BATCH,
+          [&output_path](RenderJob* job) {
+            job->canvas.SaveToPPM(output_path);
+          });
+    }
+    for (size_t i = 0; i < n; ++i) {
+      jobs[i]->Wait();
+    }
+  });
+
+  std::shared_ptr<const World> world = BatchFrameWorld(sphere_count, 0);
+  std::shared_ptr<RenderJob> batch[frames];
+  for (std::shared_ptr<RenderJob>& job : batch) {
+    job = SubmitRenderJob(world, canvas_size, canvas_size, ray_origin, 10.F,
+                          7.F, TASK_PRIORITY_BATCH);
+  }
+  std::shared_ptr<RenderJob> interactive =
+      SubmitRenderJob(world, canvas_size, canvas_size, ray_origin, 10.F, 7.F,
+                      TASK_PRIORITY_INTERACTIVE);
+  interactive->Wait();
+  for (std::shared_ptr<RenderJob>& job : batch) {
+    job->Wait();
+  }
+  printf("  interactive behind %zu batch frames: %s\n", frames,
+         std::string(interactive->stats).c_str());
+  printf("  last batch frame: %s\n",
+         std::string(batch[frames - 1]->stats).c_str());
+}
+
+void RunBenchmarks(const char* root) {
+  BenchmarkFramework bf = BenchmarkFramework{root};
+
+  BenchMatrix(&bf);
+  BenchAffineTransform(&bf);
+  BenchTrsTransform(&bf);
+  BenchBatchTransform(&bf);
+  BenchRayPacket(&bf);
+  BenchClosestHit(&bf);
+  BenchWorld(&bf);
+  BenchBvh(&bf);
+  BenchInstance(&bf);
+  BenchGrid(&bf);
+  BenchMesh(&bf);
+  BenchDispatch(&bf);
+  BenchTileScheduler(&bf);
+  BenchNuma(&bf);
+  BenchProgressive(&bf);
+  BenchRenderJob(&bf);
+
+  bf.Summary();
+}
@@ -0,0 +1,6 @@
+#ifndef TESTS_BENCHMARKS_H_
+#define TESTS_BENCHMARKS_H_
+
+void RunBenchmarks(const char* root);
+
+#endif  // TESTS_BENCHMARKS_H_
@@ -1,17 +1,81 @@
+#include <core/arena.h>
 #include <core/arr.h>
+#include <core/cpu.h>
 #include <core/file_io.h>
+#include <core/numa.h>
 #include <core/test_suite.h>
+#include <core/thread_pool.h>
 #include <core/utils.h>
+#include <geometry/aabb.h>
+#include <geometry/bvh.h>
+#include <geometry/grid.h>
+#include <geometry/instance.h>
+#include <geometry/lbvh.h>
 #include <geometry/matrix.h>
+#include <geometry/mesh.h>
+#include <geometry/obj.h>
+#include <geometry/primitive.h>
+#include <geometry/quaternion.h>
 #include <geometry/ray.h>
+#include <geometry/ray_packet.h>
+#include <geometry/transform_builder.h>
+#include <geometry/trs_transform.h>
 #include <geometry/vector.h>
+#include <geometry/wide_bvh.h>
 #include <render/canvas.h>
 #include <render/color.h>
 #include <render/light.h>
 #include <render/material.h>
+#include <render/progressive.h>
+#include <render/render_job.h>
+#include <render/tile_scheduler.h>
+#include <render/world.h>
 #include <tests/tests.h>
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <format>
+#include <future>
 #include <memory>
+#include <new>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+// NOTE: Global allocation counter for the allocation tests. Replacing
+// operator new affects the whole binary, but the counter only moves while a
+// test has switched counting on.
+static std::atomic<bool> is_counting_allocations{false};
+static std::atomic<size_t> allocation_count{0};
+
+void* operator new(size_t size) {
+  if (is_counting_allocations.load(std::memory_order_relaxed)) {
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  void* block = std::malloc(size == 0 ? 1 : size);
+  if (block == nullptr) {
+    throw std::bad_alloc{};
+  }
+  return block;
+}
+
+void operator delete(void* block) noexcept { std::free(block); }
+
+void operator delete(void* block, size_t) noexcept { std::free(block); }
+
+static inline void StartCountingAllocations() noexcept {
+  allocation_count.store(0);
+  is_counting_allocations.store(true);
+}
+
+static inline size_t StopCountingAllocations() noexcept {
+  is_counting_allocations.store(false);
+  return allocation_count.load();
+}
 
 static inline void TestArray(TestFramework* fw) {
   fw->Run("Initialize array", "Arrays", []() -> bool {
@@ -797,6 +861,115 @@ static inline void TestMatrix(TestFramework* fw) {
             return ASSERT_EQUAL(Matrix, inverse_transpose, transpose_inverse);
           });
 
+  fw->Run("Detect affine matrices", "Matrix", []() -> bool {
+    Matrix affine{Translate(1, 2, 3).RotateX(.5F).Shear(XY)};
+
+    Matrix projective{4, 4};
+    float elements[] = {9, 3, 0, 9, -5, -2, -6, -3, -4, 9, 6, 4, -7, 6, 6, 2};
+    projective.Populate(elements, projective.rows * projective.cols);
+
+    return ASSERT_EQUAL(bool, Identity().IsAffine(), true) &&
+           ASSERT_EQUAL(bool, affine.IsAffine(), true) &&
+           ASSERT_EQUAL(bool, projective.IsAffine(), false);
+  });
+
+  fw->Run("Closed-form inverse matches cofactor inverse", "Matrix",
+          []() -> bool {
+            Matrix matrix{4, 4};
+            float elements[] = {-5, 2, 6, -8, 1, -5, 1, 8,
+                                7,  7, -6, -7, 1, -3, 7, 4};
+            matrix.Populate(elements, matrix.rows * matrix.cols);
+
+            return ASSERT_EQUAL(Matrix, matrix.Inverse(),
+                                matrix.CofactorInverse());
+          });
+
+  fw->Run("Affine inverse matches cofactor inverse", "Matrix", []() -> bool {
+    Matrix matrix{Identity()
+                      .Shear(ZX)
+                      .Scale(2, .5F, 3)
+                      .RotateY(static_cast<float>(PI) / 3.F)
+                      .Translate(4, -2, 7)};
+
+    Matrix actual{matrix.AffineInverse()};
+
+    return ASSERT_EQUAL(Matrix, actual, matrix.CofactorInverse()) &&
+           ASSERT_EQUAL(Matrix, matrix * actual, Identity());
+  });
+
+  fw->Run("Convert affine transform to and from matrix", "Matrix",
+          []() -> bool {
+            Matrix matrix{Translate(1, 2, 3).RotateZ(.7F).Shear(YZ)};
+            AffineTransform transform{matrix};
+
+            return ASSERT_EQUAL(Matrix, transform.ToMatrix(), matrix);
+          });
+
+  fw->Run("Compose affine transforms", "Matrix", []() -> bool {
+    Matrix a{Scale(2, 3, 4).RotateY(.4F)};
+    Matrix b{Translate(-1, 5, 2).Shear(XZ)};
+
+    AffineTransform actual{AffineTransform{a} * AffineTransform{b}};
+
+    return ASSERT_EQUAL(Matrix, actual.ToMatrix(), a * b);
+  });
+
+  fw->Run("Apply affine transform to point and vector", "Matrix",
+          []() -> bool {
+            Matrix matrix{Scale(2, 3, 4).RotateX(.4F).Translate(1, 2, 3)};
+            AffineTransform transform{matrix};
+            Point p{-3, 4, 5};
+            Vector v{-3, 4, 5};
+
+            return ASSERT_EQUAL(Point, transform * p, matrix * p) &&
+                   ASSERT_EQUAL(Vector, transform * v, matrix * v);
+          });
+
+  fw->Run("Inverse of affine transform", "Matrix", []() -> bool {
+    Matrix matrix{Shear(YX).Scale(2, .5F, 3).RotateZ(1.1F).Translate(4, 0, 1)};
+    AffineTransform transform{matrix};
+
+    return ASSERT_EQUAL(Matrix, transform.Inverse().ToMatrix(),
+                        matrix.CofactorInverse()) &&
+           ASSERT_EQUAL(AffineTransform, transform * transform.Inverse(),
+                        AffineTransform{});
+  });
+
+  fw->Run("Batch transform SoA points and vectors", "Matrix", []() -> bool {
+    Matrix transform{Scale(2, 3, 4).RotateY(.3F).Translate(1, -2, 3)};
+
+    const size_t count = 37;
+    float xs[count];
+    float ys[count];
+    float zs[count];
+    float out_xs[count];
+    float out_ys[count];
+    float out_zs[count];
+    for (size_t i = 0; i < count; ++i) {
+      xs[i] = static_cast<float>(i) * .1F;
+      ys[i] = static_cast<float>(i) * -.05F;
+      zs[i] = 3.F - static_cast<float>(i) * .1F;
+    }
+
+    bool res = true;
+
+    TransformPoints(transform, xs, ys, zs, out_xs, out_ys, out_zs, count);
+    for (size_t i = 0; i < count; ++i) {
+      Point actual{out_xs[i], out_ys[i], out_zs[i]};
+      Point expected{transform * Point{xs[i], ys[i], zs[i]}};
+      res = res && ASSERT_EQUAL(Point, actual, expected);
+    }
+
+    TransformVectors(transform, xs, ys, zs, out_xs, out_ys, out_zs, count);
+    for (size_t i = 0; i < count; ++i) {
+      Vector actual{out_xs[i], out_ys[i], out_zs[i]};
+      Vector expected{transform * Vector{xs[i], ys[i], zs[i]}};
+      res = res && ASSERT_EQUAL(Vector, actual, expected);
+    }
+
+    return res;
+  });
+
   fw->Run("Product of point and translation matrix", "Matrix", []() -> bool {
     Matrix transform = Translate(5, -3, 2);
     Point p = {-3, 4, 5};
@@ -1050,6 +1223,137 @@ static inline void TestMatrix(TestFramework* fw) {
     return ASSERT_EQUAL(Point, actual, expected);
   });
 
+  fw->Run("Tranformation chain (builder)", "Matrix", []() -> bool {
+    Point p{1, 0, 1};
+
+    constexpr TransformBuilder kTransform =
+        TransformBuilder{}
+            .RotateX(static_cast<float>(PI) / 2)
+            .Scale(5, 5, 5)
+            .Translate(10, 5, 7);
+    static_assert(kTransform.At(0, 3) == 10.F && kTransform.At(1, 1) < 1e-6F);
+
+    Point actual = kTransform.ToMatrix() * p;
+    Point expected{15, 0, 7};
+
+    return ASSERT_EQUAL(Point, actual, expected);
+  });
+
+  fw->Run("Compile-time sine and cosine", "Matrix", []() -> bool {
+    constexpr float kAngles[] = {0.F, .5F, -1.2F, 2.5F, 4.F, -7.F};
+    constexpr float kSin[] = {
+        ConstexprSin(kAngles[0]), ConstexprSin(kAngles[1]),
+        ConstexprSin(kAngles[2]), ConstexprSin(kAngles[3]),
+        ConstexprSin(kAngles[4]), ConstexprSin(kAngles[5])};
+    constexpr float kCos[] = {
+        ConstexprCos(kAngles[0]), ConstexprCos(kAngles[1]),
+        ConstexprCos(kAngles[2]), ConstexprCos(kAngles[3]),
+        ConstexprCos(kAngles[4]), ConstexprCos(kAngles[5])};
+
+    bool result = true;
+    for (size_t i = 0; i < 6; ++i) {
+      result = result &&
+               ASSERT_EQUAL_FLOAT(kSin[i], std::sin(kAngles[i])) &&
+               ASSERT_EQUAL_FLOAT(kCos[i], std::cos(kAngles[i]));
+    }
+    return result;
+  });
+
+  fw->Run("Builder matches fluent matrix chain", "Matrix", []() -> bool {
+    constexpr TransformBuilder kTransform =
+        TransformBuilder{}
+            .Shear(XY)
+            .Scale(2, .5F, 3)
+            .RotateY(static_cast<float>(PI) / 3)
+            .Shear(ZX)
+            .RotateZ(-.7F)
+            .RotateX(1.3F)
+            .Translate(4, -2, 7);
+    Matrix expected = Identity()
+                          .Shear(XY)
+                          .Scale(2, .5F, 3)
+                          .RotateY(static_cast<float>(PI) / 3)
+                          .Shear(ZX)
+                          .RotateZ(-.7F)
+                          .RotateX(1.3F)
+                          .Translate(4, -2, 7);
+    Matrix expected_product = Translate(4, -2, 7) * RotateX(1.3F) *
+                              RotateZ(-.7F) * Shear(ZX) *
+                              RotateY(static_cast<float>(PI) / 3) *
+                              Scale(2, .5F, 3) * Shear(XY);
+    TransformBuilder runtime_transform =
+        TransformBuilder{}.Shear(XY).Scale(2, .5F, 3).RotateY(
+            static_cast<float>(PI) / 3);
+
+    return ASSERT_EQUAL(Matrix, kTransform.ToMatrix(), expected) &&
+           ASSERT_EQUAL(Matrix, expected, expected_product) &&
+           ASSERT_EQUAL(AffineTransform, kTransform.ToAffineTransform(),
+                        AffineTransform{expected}) &&
+           ASSERT_EQUAL(Matrix, runtime_transform.ToMatrix(),
+                        Identity()
+                            .Shear(XY)
+                            .Scale(2, .5F, 3)
+                            .RotateY(static_cast<float>(PI) / 3));
+  });
+
+  fw->Run("Quaternion rotation matches rotation matrices", "Matrix",
+          []() -> bool {
+            float angle = static_cast<float>(PI) / 3;
+            Quaternion rotation_x{AxisAngle({1, 0, 0}, angle)};
+            Quaternion rotation_y{AxisAngle({0, 1, 0}, angle)};
+            Quaternion rotation_z{AxisAngle({0, 0, 1}, angle)};
+            Vector v{1, -2, 3};
+
+            return ASSERT_EQUAL(Matrix, rotation_x.ToMatrix(),
+                                RotateX(angle)) &&
+                   ASSERT_EQUAL(Matrix, rotation_y.ToMatrix(),
+                                RotateY(angle)) &&
+                   ASSERT_EQUAL(Matrix, rotation_z.ToMatrix(),
+                                RotateZ(angle)) &&
+                   ASSERT_EQUAL(Vector, rotation_x.Rotate(v),
+                                RotateX(angle) * v) &&
+                   ASSERT_EQUAL(Matrix, (rotation_z * rotation_x).ToMatrix(),
+                                RotateZ(angle) * RotateX(angle));
+          });
+
+  fw->Run("TRS transform matches matrix chain", "Matrix", []() -> bool {
+    Quaternion rotation{AxisAngle({1, 2, -1}, .8F)};
+    TrsTransform transform{{4, -2, 7}, rotation, {2, .5F, 3}};
+    Matrix expected{Translate(4, -2, 7) * rotation.ToMatrix() *
+                    Scale(2, .5F, 3)};
+
+    return ASSERT_EQUAL(Matrix, transform.GetMatrix(), expected) &&
+           ASSERT_EQUAL(Matrix, transform.Inverse().ToMatrix(),
+                        expected.Inverse()) &&
+           ASSERT_EQUAL(AffineTransform, transform.InverseTranspose(),
+                        AffineTransform{expected}.Inverse().LinearTranspose());
+  });
+
+  fw->Run("TRS transform rebuilds matrices only when dirty", "Matrix",
+          []() -> bool {
+            TrsTransform transform;
+            bool is_identity = transform.GetMatrix() == Identity() &&
+                               transform.Inverse().ToMatrix() == Identity();
+
+            transform.SetTranslation({1, 2, 3});
+            bool is_marked = transform.is_dirty;
+            transform.Update();
+            Matrix translated{transform.GetMatrix()};
+            transform.SetScale({2, 2, 2});
+            transform.SetRotation(AxisAngle({0, 1, 0}, .5F));
+            transform.Update();
+            Matrix expected{Translate(1, 2, 3) * RotateY(.5F) *
+                            Scale(2, 2, 2)};
+
+            return ASSERT_EQUAL(bool, is_identity, true) &&
+                   ASSERT_EQUAL(bool, is_marked, true) &&
+                   ASSERT_EQUAL(bool, transform.is_dirty, false) &&
+                   ASSERT_EQUAL(Matrix, translated, Translate(1, 2, 3)) &&
+                   ASSERT_EQUAL(Matrix, transform.GetMatrix(), expected) &&
+                   ASSERT_EQUAL(Matrix, transform.Inverse().ToMatrix(),
+                                expected.Inverse());
+          });
+
   fw->Run("Clock", "Matrix", [fw]() -> bool {
     Canvas canvas{600, 600};
     size_t radius = (canvas.width - 100) / 2;
@@ -1164,8 +1468,8 @@ static inline void TestRay(TestFramework* fw) {
   });
 
   fw->Run("Initialize hit and hits", "Rays", []() -> bool {
-    Sphere sphere;
-    Hit hit{{&sphere, SPHERE}, 3.5};
+    PrimitiveHandle sphere_handle{MakePrimitiveHandle(PRIMITIVE_SPHERE, 0)};
+    Hit hit{sphere_handle, 3.5};
 
     Hits hits{Hits{1}};
     hits[0] = hit;
@@ -1173,19 +1477,18 @@ static inline void TestRay(TestFramework* fw) {
     Hits hits_copy{Hits{hits}};
 
     return ASSERT_EQUAL_FLOAT(hit.t, 3.5F) &&
-           ASSERT_EQUAL(Sphere, *reinterpret_cast<Sphere*>(hit.object.data),
-                        sphere) &&
+           ASSERT_EQUAL(uint32_t, hit.primitive, sphere_handle) &&
            ASSERT_EQUAL(Hits, hits, hits_copy) &&
            ASSERT_EQUAL(size_t, hits.count, 1) &&
            ASSERT_EQUAL_FLOAT(hits[0].t, 3.5F);
   });
 
   fw->Run("The hit with all positive t intersections", "Rays", []() -> bool {
-    Sphere sphere;
+    PrimitiveHandle sphere_handle{MakePrimitiveHandle(PRIMITIVE_SPHERE, 0)};
 
     Hits hits{Hits{
-        {{&sphere, SPHERE}, 1},
-        {{&sphere, SPHERE}, 2},
+        {sphere_handle, 1},
+        {sphere_handle, 2},
     }};
 
     int32_t idx = hits.FirstHitIdx();
@@ -1197,11 +1500,11 @@ static inline void TestRay(TestFramework* fw) {
   });
 
   fw->Run("The hit with some negative t intersections", "Rays", []() -> bool {
-    Sphere sphere;
+    PrimitiveHandle sphere_handle{MakePrimitiveHandle(PRIMITIVE_SPHERE, 0)};
 
     Hits hits{Hits{
-        {{&sphere, SPHERE}, -1},
-        {{&sphere, SPHERE}, 1},
+        {sphere_handle, -1},
+        {sphere_handle, 1},
     }};
 
     int32_t idx = hits.FirstHitIdx();
@@ -1213,11 +1516,11 @@ static inline void TestRay(TestFramework* fw) {
   });
 
   fw->Run("The hit with all negative t intersections", "Rays", []() -> bool {
-    Sphere sphere;
+    PrimitiveHandle sphere_handle{MakePrimitiveHandle(PRIMITIVE_SPHERE, 0)};
 
     Hits hits{Hits{
-        {{&sphere, SPHERE}, -2},
-        {{&sphere, SPHERE}, -1},
+        {sphere_handle, -2},
+        {sphere_handle, -1},
     }};
 
     int32_t idx = hits.FirstHitIdx();
@@ -1227,13 +1530,13 @@ static inline void TestRay(TestFramework* fw) {
   });
 
   fw->Run("The hit with various t intersections", "Rays", []() -> bool {
-    Sphere sphere;
+    PrimitiveHandle sphere_handle{MakePrimitiveHandle(PRIMITIVE_SPHERE, 0)};
 
     Hits hits{Hits{
-        {{&sphere, SPHERE}, 5},
-        {{&sphere, SPHERE}, 7},
-        {{&sphere, SPHERE}, -3},
-        {{&sphere, SPHERE}, 2},
+        {sphere_handle, 5},
+        {sphere_handle, 7},
+        {sphere_handle, -3},
+        {sphere_handle, 2},
     }};
 
     int32_t idx = hits.FirstHitIdx();
@@ -1244,6 +1547,231 @@ static inline void TestRay(TestFramework* fw) {
            ASSERT_EQUAL_FLOAT(intersection.t, 2);
   });
 
+  fw->Run("Intersect does not allocate", "Rays", []() -> bool {
+    Sphere sphere;
+    sphere.SetTransform(Scale(2, 1, 1));
+
+    StartCountingAllocations();
+    size_t hit_count = 0;
+    for (size_t i = 0; i < 1000; ++i) {
+      float x = static_cast<float>(i) * .005F - 2.5F;
+      Ray ray{{x, 0, -5}, {0, 0, 1}};
+      Hits hits{ray.Intersect(sphere)};
+      Hits hits_copy{hits};
+      hit_count += hits_copy.count;
+    }
+    size_t allocations = StopCountingAllocations();
+
+    return ASSERT_EQUAL(size_t, allocations, 0) &&
+           ASSERT_NOT_EQUAL(size_t, hit_count, 0);
+  });
+
+  fw->Run("Hits spill into a scratch arena", "Rays", []() -> bool {
+    PrimitiveHandle sphere_handle{MakePrimitiveHandle(PRIMITIVE_SPHERE, 0)};
+    ScratchArena arena{64 * sizeof(Hit)};
+
+    StartCountingAllocations();
+    bool res = true;
+    {
+      ScratchScope scope{&arena};
+      Hits hits{&arena};
+      for (size_t i = 0; i < 10; ++i) {
+        hits.Push({sphere_handle, static_cast<float>((i * 7) % 10)});
+      }
+
+      res = res && ASSERT_EQUAL(int, hits.storage, HITS_ARENA) &&
+            ASSERT_EQUAL(size_t, hits.count, 10) &&
+            ASSERT_NOT_EQUAL(size_t, arena.used, 0);
+      for (size_t i = 0; i < hits.count; ++i) {
+        res = res && ASSERT_EQUAL_FLOAT(hits[i].t, static_cast<float>(i));
+      }
+    }
+    size_t allocations = StopCountingAllocations();
+
+    return res && ASSERT_EQUAL(size_t, allocations, 0) &&
+           ASSERT_EQUAL(size_t, arena.used, 0);
+  });
+
+  fw->Run("Hits released out of order rewind with their scope", "Rays",
+          []() -> bool {
+            PrimitiveHandle sphere_handle{
+                MakePrimitiveHandle(PRIMITIVE_SPHERE, 0)};
+            ScratchArena arena{64 * sizeof(Hit)};
+
+            // NOTE: The copy spills after its source, and the source goes
+            // first; enough rounds to fill the arena if that leaked.
+            bool res = true;
+            for (size_t round = 0; round < 2'000; ++round) {
+              ScratchScope scope{&arena};
+              Hits copy{&arena};
+              {
+                Hits source{&arena};
+                for (size_t i = 0; i < 8; ++i) {
+                  source.Push({sphere_handle, static_cast<float>(i)});
+                }
+                copy = source;
+              }
+              res = res && copy.storage == HITS_ARENA && copy.count == 8;
+            }
+            size_t arena_used = arena.used;
+
+            ScratchArena* thread_arena = ThreadHitsArena();
+            size_t thread_used = thread_arena->used;
+            Hits unscoped;
+            for (size_t i = 0; i < 8; ++i) {
+              unscoped.Push({sphere_handle, static_cast<float>(i)});
+            }
+            HitsStorage scoped_storage = HITS_INLINE;
+            {
+              ScratchScope scope{thread_arena};
+              Hits scoped{unscoped};
+              scoped_storage = scoped.storage;
+            }
+
+            return ASSERT_EQUAL(bool, res, true) &&
+                   ASSERT_EQUAL(size_t, arena_used, 0) &&
+                   ASSERT_EQUAL(int, unscoped.storage, HITS_HEAP) &&
+                   ASSERT_EQUAL(int, scoped_storage, HITS_ARENA) &&
+                   ASSERT_EQUAL(size_t, thread_arena->used, thread_used);
+          });
+
+  fw->Run("Hits fall back to the heap when the arena is full", "Rays",
+          []() -> bool {
+            PrimitiveHandle sphere_handle{
+                MakePrimitiveHandle(PRIMITIVE_SPHERE, 0)};
+            ScratchArena arena{6 * sizeof(Hit)};
+
+            Hits hits{&arena};
+            for (size_t i = 0; i < 20; ++i) {
+              hits.Push({sphere_handle, static_cast<float>(20 - i)});
+            }
+            Hits hits_copy{hits};
+
+            return ASSERT_EQUAL(int, hits.storage, HITS_HEAP) &&
+                   ASSERT_EQUAL(size_t, hits.count, 20) &&
+                   ASSERT_EQUAL_FLOAT(hits[0].t, 1.F) &&
+                   ASSERT_EQUAL_FLOAT(hits[19].t, 20.F) &&
+                   ASSERT_EQUAL(Hits, hits_copy, hits);
+          });
+
+  fw->Run("Closest hit picks the nearest object in front", "Rays",
+          []() -> bool {
+            Sphere spheres[3];
+            spheres[1].SetTransform(Translate(0, 0, 5));
+            spheres[2].SetTransform(Translate(0, 0, -10));
+            Ray ray{{0, 0, -5}, {0, 0, 1}};
+
+            HitRecord hit{ClosestHit(ray, spheres, 3, 0.F, INFINITY)};
+            HitRecord reversed{ClosestHit(
+                {{0, 0, 15}, {0, 0, -1}}, spheres, 3, 0.F, INFINITY)};
+
+            return ASSERT_EQUAL(bool, hit.IsHit(), true) &&
+                   ASSERT_EQUAL(uint32_t, hit.object_id, 0) &&
+                   ASSERT_EQUAL_FLOAT(hit.t, 4.F) &&
+                   ASSERT_EQUAL(uint32_t, reversed.object_id, 1) &&
+                   ASSERT_EQUAL_FLOAT(reversed.t, 9.F);
+          });
+
+  fw->Run("Closest hit respects the [tmin, tmax) interval", "Rays",
+          []() -> bool {
+            Sphere spheres[2];
+            spheres[1].SetTransform(Translate(0, 0, 5));
+            Ray ray{{0, 0, -5}, {0, 0, 1}};
+
+            HitRecord after_near{ClosestHit(ray, spheres, 2, 5.F, INFINITY)};
+            HitRecord past_first{ClosestHit(ray, spheres, 2, 6.5F, INFINITY)};
+            HitRecord before_all{ClosestHit(ray, spheres, 2, 0.F, 3.9F)};
+
+            return ASSERT_EQUAL(uint32_t, after_near.object_id, 0) &&
+                   ASSERT_EQUAL_FLOAT(after_near.t, 6.F) &&
+                   ASSERT_EQUAL(uint32_t, past_first.object_id, 1) &&
+                   ASSERT_EQUAL_FLOAT(past_first.t, 9.F) &&
+                   ASSERT_EQUAL(bool, before_all.IsHit(), false) &&
+                   ASSERT_EQUAL(uint32_t, before_all.object_id, NO_HIT_ID);
+          });
+
+  fw->Run("Closest hit skips roots behind the ray origin", "Rays",
+          []() -> bool {
+            Sphere sphere;
+            HitRecord inside{
+                ClosestHit({{0, 0, 0}, {0, 0, 1}}, sphere, 0.F, INFINITY)};
+            HitRecord behind{
+                ClosestHit({{0, 0, 5}, {0, 0, 1}}, sphere, 0.F, INFINITY)};
+
+            return ASSERT_EQUAL(uint32_t, inside.object_id, 0) &&
+                   ASSERT_EQUAL_FLOAT(inside.t, 1.F) &&
+                   ASSERT_EQUAL(bool, behind.IsHit(), false);
+          });
+
+  fw->Run("Occlusion query finds any crossing in the interval", "Rays",
+          []() -> bool {
+            Sphere spheres[2];
+            spheres[0].SetTransform(Translate(0, 0, 5));
+            spheres[1].SetTransform(Translate(3, 0, 5).Scale(.5F, .5F, .5F));
+
+            Point point{0, 0, 0};
+            Point light{0, 0, 10};
+            Ray shadow_ray{point, light - point};
+
+            return ASSERT_EQUAL(
+                       bool, IsOccluded(shadow_ray, spheres, 2, 0.F, 1.F),
+                       true) &&
+                   ASSERT_EQUAL(
+                       bool, IsOccluded(shadow_ray, spheres, 2, 0.F, .35F),
+                       false) &&
+                   ASSERT_EQUAL(
+                       bool, IsOccluded(shadow_ray, spheres, 2, .65F, 1.F),
+                       false) &&
+                   ASSERT_EQUAL(
+                       bool, IsOccluded(shadow_ray, spheres, 2, .5F, 1.F),
+                       true) &&
+                   ASSERT_EQUAL(bool,
+                                IsOccluded({{0, 2, 0}, {0, 0, 10}}, spheres, 2,
+                                           0.F, 1.F),
+                                false) &&
+                   ASSERT_EQUAL(bool,
+                                IsOccluded({{1.5F, 0, 0}, {0, 0, 10}}, spheres,
+                                           2, 0.F, 1.F),
+                                true);
+          });
+
+  fw->Run("Packet occlusion matches scalar occlusion", "Rays", []() -> bool {
+    IsaLevel detected = DetectIsaLevel();
+
+    Sphere spheres[3];
+    spheres[0].SetTransform(Translate(-1, 0, 4));
+    spheres[1].SetTransform(Scale(.5F, 2, .5F).Translate(1.5F, 0, 6));
+    spheres[2].SetTransform(Translate(0, 0, 12));
+
+    Ray rays[RAY_PACKET_MAX_WIDTH];
+    for (size_t i = 0; i < RAY_PACKET_MAX_WIDTH; ++i) {
+      float x = -2.5F + static_cast<float>(i) * .33F;
+      rays[i] = {{x, .2F, 0}, Vector{0, 0, 8}};
+    }
+
+    bool res = true;
+    for (int level = ISA_SSE2; level <= detected; ++level) {
+      ForceIsaLevel(static_cast<IsaLevel>(level));
+
+      RayPacket packet{RAY_PACKET_MAX_WIDTH};
+      for (size_t i = 0; i < RAY_PACKET_MAX_WIDTH; i += 2) {
+        packet.SetRay(i, rays[i]);
+        packet.SetRay(i + 1, rays[i + 1]);
+      }
+      packet.active_mask &= ~(1U << 5);
+
+      uint32_t occluded = packet.Occluded(spheres, 3, 0.F, 1.F);
+      for (size_t i = 0; i < RAY_PACKET_MAX_WIDTH; ++i) {
+        bool expected = i != 5 && IsOccluded(rays[i], spheres, 3, 0.F, 1.F);
+        res = res && ASSERT_EQUAL(bool, (occluded & (1U << i)) != 0, expected);
+      }
+    }
+
+    ForceIsaLevel(detected);
+
+    return res;
+  });
+
   fw->Run("Translate a ray", "Rays", []() -> bool {
     Ray ray{{1, 2, 3}, {0, 1, 0}};
     Matrix transform{Translate(3, 4, 5)};
@@ -1272,16 +1800,48 @@ static inline void TestRay(TestFramework* fw) {
   fw->Run("Change sphere transformation", "Rays", []() -> bool {
     Sphere sphere;
     Matrix transform{Translate(2, 3, 4)};
-    sphere.transform_matrix = transform;
+    sphere.SetTransform(transform);
 
     return ASSERT_EQUAL(Matrix, sphere.transform_matrix, transform);
   });
 
+  fw->Run("Sphere caches inverse of its transformation", "Rays", []() -> bool {
+    Sphere sphere;
+    Matrix transform{Scale(2, 3, 4).RotateX(.3F).Translate(1, 2, 3)};
+    sphere.SetTransform(transform);
+
+    Vector normal{1, -2, 3};
+    Vector expected_normal{transform.Inverse().Transpose() * normal};
+    expected_normal.w = 0;
+
+    return ASSERT_EQUAL(Matrix, sphere.transform_matrix, transform) &&
+           ASSERT_EQUAL(Matrix, sphere.inverse_transform.ToMatrix(),
+                        transform.Inverse()) &&
+           ASSERT_EQUAL(Vector, sphere.inverse_transpose * normal,
+                        expected_normal);
+  });
+
+  fw->Run("Sphere takes a TRS transformation", "Rays", []() -> bool {
+    TrsTransform transform{{1, 2, 3}, AxisAngle({1, 0, 0}, .3F), {2, 3, 4}};
+    Sphere trs_sphere;
+    trs_sphere.SetTransform(transform);
+    Sphere matrix_sphere;
+    matrix_sphere.SetTransform(transform.GetMatrix());
+
+    Point point{1, 2, -1};
+
+    return ASSERT_EQUAL(Sphere, trs_sphere, matrix_sphere) &&
+           ASSERT_EQUAL(AffineTransform, trs_sphere.inverse_transform,
+                        matrix_sphere.inverse_transform) &&
+           ASSERT_EQUAL(Vector, trs_sphere.NormalAt(point),
+                        matrix_sphere.NormalAt(point));
+  });
+
   fw->Run("Intersect a scaled sphere with a ray", "Rays", []() -> bool {
     Ray ray{{0, 0, -5}, {0, 0, 1}};
 
     Sphere sphere;
-    sphere.transform_matrix = Scale(2, 2, 2);
+    sphere.SetTransform(Scale(2, 2, 2));
 
     Hits hits{ray.Intersect(sphere)};
 
@@ -1294,7 +1854,7 @@ static inline void TestRay(TestFramework* fw) {
     Ray ray{{0, 0, -5}, {0, 0, 1}};
 
     Sphere sphere;
-    sphere.transform_matrix = Translate(5, 0, 0);
+    sphere.SetTransform(Translate(5, 0, 0));
 
     Hits hits{ray.Intersect(sphere)};
 
@@ -1326,7 +1886,7 @@ static inline void TestRay(TestFramework* fw) {
     Point ray_origin{0, 0, -5};
     Sphere shape;
     shape.material.color = {.26F, .96F, .53F};
-    shape.transform_matrix = Scale(1, .5F, 1);
+    shape.SetTransform(Scale(1, .5F, 1));
 
     float wall_z = 10.F;
     float wall_size = 7.F;
@@ -1345,7 +1905,7 @@ static inline void TestRay(TestFramework* fw) {
     Point ray_origin{0, 0, -5};
     Sphere shape;
     shape.material.color = {.26F, .96F, .53F};
-    shape.transform_matrix = Scale(.5F, 1, 1);
+    shape.SetTransform(Scale(.5F, 1, 1));
 
     float wall_z = 10.F;
     float wall_size = 7.F;
@@ -1364,8 +1924,7 @@ static inline void TestRay(TestFramework* fw) {
     Point ray_origin{0, 0, -5};
     Sphere shape;
     shape.material.color = {.26F, .96F, .53F};
-    shape.transform_matrix =
-        Scale(.5F, 1, 1).RotateZ(static_cast<float>(PI) / 4.F);
+    shape.SetTransform(Scale(.5F, 1, 1).RotateZ(static_cast<float>(PI) / 4.F));
 
     float wall_z = 10.F;
     float wall_size = 7.F;
@@ -1384,7 +1943,7 @@ static inline void TestRay(TestFramework* fw) {
     Point ray_origin{0, 0, -5};
     Sphere shape;
     shape.material.color = {.26F, .96F, .53F};
-    shape.transform_matrix = Shear(XY).Scale(.5F, 1, 1);
+    shape.SetTransform(Shear(XY).Scale(.5F, 1, 1));
 
     float wall_z = 10.F;
     float wall_size = 7.F;
@@ -1395,6 +1954,60 @@ static inline void TestRay(TestFramework* fw) {
 
     return ASSERT_EQUAL(bool, true, true);
   });
+
+  fw->Run("Packet hits match single-ray hits", "Rays", []() -> bool {
+    IsaLevel detected = DetectIsaLevel();
+
+    Sphere sphere;
+    sphere.SetTransform(Identity().Scale(2, 1, 1).RotateZ(.4F).Translate(
+        .5F, 0, 0));
+
+    Ray rays[RAY_PACKET_MAX_WIDTH];
+    for (size_t i = 0; i < RAY_PACKET_MAX_WIDTH; ++i) {
+      float x = -3.F + static_cast<float>(i) * .4F;
+      rays[i] = {{x, .1F, -5}, Vector{0, 0, 1}};
+    }
+    rays[1] = {{0, 1, -5}, Vector{0, 0, 1}};
+    rays[2] = {{0, 0, 0}, Vector{0, 0, 1}};
+
+    bool res = true;
+    for (int level = ISA_SSE2; level <= detected; ++level) {
+      ForceIsaLevel(static_cast<IsaLevel>(level));
+
+      RayPacket packet{RAY_PACKET_MAX_WIDTH};
+      for (size_t i = 0; i < RAY_PACKET_MAX_WIDTH; ++i) {
+        packet.SetRay(i, rays[i]);
+      }
+      PacketHits packet_hits{packet.Intersect(sphere)};
+
+      for (size_t i = 0; i < RAY_PACKET_MAX_WIDTH; ++i) {
+        Hits hits{rays[i].Intersect(sphere)};
+        res = res && ASSERT_EQUAL(bool, packet_hits.IsHit(i), hits.count > 0);
+        if (hits.count > 0) {
+          res = res && ASSERT_EQUAL_FLOAT(packet_hits.t_near[i], hits[0].t) &&
+                ASSERT_EQUAL_FLOAT(packet_hits.t_far[i],
+                                   hits[hits.count - 1].t);
+        }
+      }
+    }
+
+    ForceIsaLevel(detected);
+
+    return res;
+  });
+
+  fw->Run("Inactive packet lanes never hit", "Rays", []() -> bool {
+    Sphere sphere;
+    RayPacket packet{RayPacketWidth()};
+    packet.SetRay(1, {{0, 0, -5}, Vector{0, 0, 1}});
+
+    PacketHits hits{packet.Intersect(sphere)};
+
+    return ASSERT_EQUAL(uint32_t, packet.active_mask, 2U) &&
+           ASSERT_EQUAL(uint32_t, hits.hit_mask, 2U) &&
+           ASSERT_EQUAL_FLOAT(hits.t_near[1], 4.F) &&
+           ASSERT_EQUAL_FLOAT(hits.t_far[1], 6.F);
+  });
 }
 
 static inline void TestShading(TestFramework* fw) {
@@ -1446,7 +2059,7 @@ static inline void TestShading(TestFramework* fw) {
 
   fw->Run("Compute the normal on translated sphere", "Shading", []() -> bool {
     Sphere sphere;
-    sphere.transform_matrix = Translate(0, 1, 0);
+    sphere.SetTransform(Translate(0, 1, 0));
 
     Vector actual{
         sphere.NormalAt({0, 1 + std::sqrt(2.F) / 2.F, -std::sqrt(2.F) / 2.F})};
@@ -1457,8 +2070,8 @@ static inline void TestShading(TestFramework* fw) {
 
   fw->Run("Compute the normal on transformed sphere", "Shading", []() -> bool {
     Sphere sphere;
-    sphere.transform_matrix =
-        RotateZ(static_cast<float>(PI) / 5.F).Scale(1, 0.5F, 1);
+    sphere.SetTransform(
+        RotateZ(static_cast<float>(PI) / 5.F).Scale(1, 0.5F, 1));
 
     Vector actual{
         sphere.NormalAt({0, std::sqrt(2.F) / 2.F, -std::sqrt(2.F) / 2.F})};
@@ -1599,6 +2212,23 @@ static inline void TestShading(TestFramework* fw) {
     return ASSERT_EQUAL(Color, actual, expected);
   });
 
+  fw->Run("Lighting with the surface in shadow", "Shading", []() -> bool {
+    Material material;
+    Point position = {0, 0, 0};
+
+    Vector eye_vector{0, 0, -1};
+    Vector normal_vector{0, 0, -1};
+    PointLight light{Color(1, 1, 1), Point{0, 0, -10}};
+
+    Color shadowed = Lighting(material, light, position, eye_vector,
+                              normal_vector, 0.F);
+    Color half_lit = Lighting(material, light, position, eye_vector,
+                              normal_vector, .5F);
+
+    return ASSERT_EQUAL(Color, shadowed, Color(.1F, .1F, .1F)) &&
+           ASSERT_EQUAL(Color, half_lit, Color(1.F, 1.F, 1.F));
+  });
+
   fw->Run("Cast rays at a sphere (shaded)", "Shading", [fw]() -> bool {
     size_t canvas_size = 100;
     Canvas canvas{canvas_size, canvas_size};
@@ -1618,6 +2248,2091 @@ static inline void TestShading(TestFramework* fw) {
 
     return ASSERT_EQUAL(bool, true, true);
   });
+
+  fw->Run("Packet cast matches single-ray cast", "Shading", []() -> bool {
+    size_t canvas_size = 61;
+    Canvas single_canvas{canvas_size, canvas_size};
+    Canvas packet_canvas{canvas_size, canvas_size};
+
+    Point ray_origin{0, 0, -5};
+    Sphere shape;
+    shape.material.color = {1, .2F, 1};
+    constexpr TransformBuilder kTransform =
+        TransformBuilder{}.Scale(1, .5F, 1).RotateZ(.3F);
+    shape.SetTransform(kTransform.ToMatrix());
+
+    PointLight light{Color{1, 1, 1}, Point{-10, 10, -10}};
+
+    CastShapeShaded(&single_canvas, ray_origin, shape, light, 10.F, 7.F,
+                    CAST_SINGLE_RAY);
+    CastShapeShaded(&packet_canvas, ray_origin, shape, light, 10.F, 7.F,
+                    CAST_RAY_PACKET);
+
+    // NOTE: The packet kernels fuse multiply-adds, and the specular term
+    // amplifies that rounding, so shaded colors are compared loosely.
+    float max_diff = 0;
+    for (size_t y = 0; y < canvas_size; ++y) {
+      for (size_t x = 0; x < canvas_size; ++x) {
+        Color diff{packet_canvas.ColorAt(x, y) - single_canvas.ColorAt(x, y)};
+        max_diff = std::max({max_diff, std::abs(diff.r), std::abs(diff.g),
+                             std::abs(diff.b)});
+      }
+    }
+    return ASSERT_EQUAL(bool, max_diff < 1e-3F, true);
+  });
+
+  fw->Run("Shaded cast from inside a sphere shades the hit in front",
+          "Shading", []() -> bool {
+            size_t canvas_size = 9;
+            Canvas single_canvas{canvas_size, canvas_size};
+            Canvas packet_canvas{canvas_size, canvas_size};
+
+            // NOTE: The camera sits at the center of a radius 10 sphere, so
+            // every ray hits it at t = 10 with the normal along the ray.
+            Point ray_origin{0, 0, 0};
+            constexpr TransformBuilder kTransform =
+                TransformBuilder{}.Scale(10, 10, 10);
+            Sphere shape;
+            shape.SetTransform(kTransform.ToMatrix());
+            PointLight light{Color{1, 1, 1}, Point{-5, 5, 5}};
+
+            CastShapeShaded(&single_canvas, ray_origin, shape, light, 10.F,
+                            7.F, CAST_SINGLE_RAY);
+            CastShapeShaded(&packet_canvas, ray_origin, shape, light, 10.F,
+                            7.F, CAST_RAY_PACKET);
+
+            size_t x = 2;
+            size_t y = 6;
+            float pixel_size = 7.F / static_cast<float>(canvas_size);
+            Point position{-3.5F + pixel_size * x, 3.5F - pixel_size * y, 10};
+            Vector direction{(position - ray_origin).Normalize()};
+            Point point{ray_origin + direction * 10.F};
+            Color expected{
+                Lighting(shape.material, light, point, -direction, direction)};
+
+            return ASSERT_EQUAL(Color, single_canvas.ColorAt(x, y), expected) &&
+                   ASSERT_EQUAL(Color, packet_canvas.ColorAt(x, y), expected);
+          });
+
+  fw->Run("Shaded cast allocations do not scale with pixels", "Shading",
+          []() -> bool {
+            Point ray_origin{0, 0, -5};
+            Sphere shape;
+            PointLight light{Color{1, 1, 1}, Point{-10, 10, -10}};
+            Canvas small_canvas{16, 16};
+            Canvas large_canvas{128, 128};
+
+            // NOTE: What remains is per-frame worker startup, which is the
+            // same for both canvas sizes.
+            StartCountingAllocations();
+            CastShapeShaded(&small_canvas, ray_origin, shape, light, 10.F,
+                            7.F);
+            size_t small_allocations = StopCountingAllocations();
+
+            StartCountingAllocations();
+            CastShapeShaded(&large_canvas, ray_origin, shape, light, 10.F,
+                            7.F);
+            size_t large_allocations = StopCountingAllocations();
+
+            StartCountingAllocations();
+            CastShapeShaded(&large_canvas, ray_origin, shape, light, 10.F,
+                            7.F, CAST_RAY_PACKET);
+            size_t packet_allocations = StopCountingAllocations();
+
+            return ASSERT_EQUAL(size_t, large_allocations,
+                                small_allocations) &&
+                   ASSERT_EQUAL(size_t, packet_allocations,
+                                small_allocations);
+          });
+}
+
+static inline void TestWorld(TestFramework* fw) {
+  fw->Run("Intersect a world with a ray", "World", []() -> bool {
+    World world{DefaultWorld()};
+    Ray ray{{0, 0, -5}, {0, 0, 1}};
+
+    Hits hits{IntersectWorld(world, ray)};
+    PrimitiveHandle outer{MakePrimitiveHandle(PRIMITIVE_SPHERE, 0)};
+    PrimitiveHandle inner{MakePrimitiveHandle(PRIMITIVE_SPHERE, 1)};
+    Hits expected{{outer, 4.F}, {inner, 4.5F}, {inner, 5.5F}, {outer, 6.F}};
+
+    return ASSERT_EQUAL(Hits, hits, expected);
+  });
+
+  fw->Run("Merged world hits match pushed hits", "World", []() -> bool {
+    World world;
+    for (size_t i = 0; i < 40; ++i) {
+      Sphere sphere;
+      sphere.SetTransform(Translate(static_cast<float>(i % 3) * .4F - .4F, 0,
+                                    static_cast<float>(i) * .7F));
+      world.AddObject(sphere);
+    }
+    Ray ray{{0, 0, -5}, {0, 0, 1}};
+
+    Hits pushed;
+    for (size_t i = 0; i < world.objects.size; ++i) {
+      Hits object_hits{ray.Intersect(world.objects[i])};
+      for (size_t h = 0; h < object_hits.count; ++h) {
+        pushed.Push(object_hits[h]);
+      }
+    }
+    Hits merged{IntersectWorld(world, ray)};
+
+    bool is_ordered = true;
+    for (size_t i = 1; i < merged.count; ++i) {
+      is_ordered = is_ordered && merged[i - 1].t <= merged[i].t;
+    }
+    bool is_equal = merged.count == pushed.count;
+    for (size_t i = 0; is_equal && i < merged.count; ++i) {
+      is_equal = merged[i].t == pushed[i].t;
+    }
+
+    return ASSERT_EQUAL(size_t, merged.count, 80) &&
+           ASSERT_EQUAL(bool, is_ordered, true) &&
+           ASSERT_EQUAL(bool, is_equal, true);
+  });
+
+  fw->Run("Closest hit in a world", "World", []() -> bool {
+    World world{DefaultWorld()};
+
+    HitRecord front{
+        ClosestHit(world, Ray{{0, 0, -5}, {0, 0, 1}}, 0.F, INFINITY)};
+    HitRecord inside{
+        ClosestHit(world, Ray{{0, 0, .75F}, {0, 0, 1}}, 0.F, INFINITY)};
+    HitRecord miss{
+        ClosestHit(world, Ray{{0, 0, -5}, {0, 1, 0}}, 0.F, INFINITY)};
+
+    return ASSERT_EQUAL(uint32_t, front.object_id, 0) &&
+           ASSERT_EQUAL_FLOAT(front.t, 4.F) &&
+           ASSERT_EQUAL(uint32_t, inside.object_id, 0) &&
+           ASSERT_EQUAL_FLOAT(inside.t, .25F) &&
+           ASSERT_EQUAL(bool, miss.IsHit(), false);
+  });
+
+  fw->Run("Shading a world hit", "World", []() -> bool {
+    World world{DefaultWorld()};
+    Ray ray{{0, 0, -5}, {0, 0, 1}};
+
+    Color shaded{ShadeHit(world, ray, {0, 4.F})};
+    Color expected{.38066F, .47583F, .2855F};
+
+    return ASSERT_EQUAL(Color, shaded, expected) &&
+           ASSERT_EQUAL(Color, ColorAt(world, ray), expected) &&
+           ASSERT_EQUAL(Color, ColorAt(world, Ray{{0, 0, -5}, {0, 1, 0}}),
+                        Color(0, 0, 0));
+  });
+
+  fw->Run("Objects in a world shadow each other", "World", []() -> bool {
+    World world;
+    world.AddLight({Color{1, 1, 1}, Point{0, 0, -10}});
+    world.AddObject(Sphere{});
+    constexpr TransformBuilder kShadowedTransform =
+        TransformBuilder{}.Translate(0, 0, 10);
+    Sphere shadowed;
+    shadowed.SetTransform(kShadowedTransform.ToMatrix());
+    uint32_t shadowed_id = world.AddObject(shadowed);
+
+    Ray ray{{0, 0, 5}, {0, 0, 1}};
+    HitRecord hit{ClosestHit(world, ray, 0.F, INFINITY)};
+
+    return ASSERT_EQUAL(uint32_t, hit.object_id, shadowed_id) &&
+           ASSERT_EQUAL(Color, ShadeHit(world, ray, hit), Color(.1F, .1F, .1F));
+  });
+
+  fw->Run("Each light in a world adds its contribution", "World", []() -> bool {
+    World world{DefaultWorld()};
+    Ray ray{{0, 0, -5}, {0, 0, 1}};
+    Color single{ColorAt(world, ray)};
+
+    PointLight light{world.lights[0]};
+    world.AddLight(light);
+
+    return ASSERT_EQUAL(Color, ColorAt(world, ray), single * 2.F);
+  });
+
+  fw->Run("World cast matches single-shape cast", "World", []() -> bool {
+    size_t canvas_size = 41;
+    Canvas shape_canvas{canvas_size, canvas_size};
+    Canvas world_canvas{canvas_size, canvas_size};
+
+    Point ray_origin{0, 0, -5};
+    Sphere shape;
+    shape.material.color = {1, .2F, 1};
+    PointLight light{Color{1, 1, 1}, Point{-10, 10, -10}};
+
+    World world;
+    world.AddObject(shape);
+    world.AddLight(light);
+
+    CastShapeShaded(&shape_canvas, ray_origin, shape, light, 10.F, 7.F);
+    CastWorldShaded(&world_canvas, ray_origin, world, 10.F, 7.F);
+
+    bool is_equal = true;
+    for (size_t y = 0; y < canvas_size; ++y) {
+      for (size_t x = 0; x < canvas_size; ++x) {
+        Color shape_color{shape_canvas.ColorAt(x, y)};
+        is_equal = is_equal && shape_color == world_canvas.ColorAt(x, y);
+      }
+    }
+    return ASSERT_EQUAL(bool, is_equal, true);
+  });
+
+  fw->Run("Primitive handles pack type and index", "World", []() -> bool {
+    PrimitiveHandle sphere{MakePrimitiveHandle(PRIMITIVE_SPHERE, 42)};
+    PrimitiveHandle triangle{
+        MakePrimitiveHandle(PRIMITIVE_TRIANGLE, PRIMITIVE_INDEX_MASK)};
+
+    return ASSERT_EQUAL(uint32_t, sphere, 42) &&
+           ASSERT_EQUAL(int, HandleType(sphere), PRIMITIVE_SPHERE) &&
+           ASSERT_EQUAL(int, HandleType(triangle), PRIMITIVE_TRIANGLE) &&
+           ASSERT_EQUAL(uint32_t, HandleIndex(triangle),
+                        PRIMITIVE_INDEX_MASK) &&
+           ASSERT_EQUAL(bool, HandleType(NO_HIT_ID) >= PRIMITIVE_TYPE_COUNT,
+                        true);
+  });
+
+  fw->Run("Sphere store queries match the sphere records", "World",
+          []() -> bool {
+            // NOTE: Not a multiple of 4, so the last block is partial.
+            size_t count = 301;
+            std::unique_ptr<Sphere[]> spheres{RandomSpheres(count, 6.F, 71)};
+            SphereStore store;
+            for (size_t i = 0; i < count; ++i) {
+              store.Add(spheres[i]);
+            }
+
+            std::mt19937 rng{73};
+            bool is_equal = true;
+            size_t hit_count = 0;
+            for (size_t i = 0; i < 400; ++i) {
+              Ray ray{RandomRay(&rng, 6.F)};
+              HitRecord expected{
+                  ClosestHit(ray, spheres.get(), count, 0.F, INFINITY)};
+              HitRecord actual{store.ClosestHit(ray, 0.F, INFINITY)};
+              hit_count += expected.IsHit() ? 1 : 0;
+              is_equal = is_equal && actual.object_id == expected.object_id &&
+                         (actual.t == expected.t ||
+                          std::abs(actual.t - expected.t) <=
+                              1e-5F * std::max(expected.t, 1.F));
+              is_equal = is_equal &&
+                         store.IsOccluded(ray, 0.F, 8.F) ==
+                             IsOccluded(ray, spheres.get(), count, 0.F, 8.F);
+            }
+
+            return ASSERT_EQUAL(size_t, store.Count(), count) &&
+                   ASSERT_EQUAL(bool, hit_count > 100, true) &&
+                   ASSERT_EQUAL(bool, is_equal, true);
+          });
+
+  fw->Run("Meshes in a world are hit, shaded and cast shadows", "World",
+          []() -> bool {
+            World world{DefaultWorld()};
+            Ray ray{{0, 0, -5}, {0, 0, 1}};
+            Color unshadowed{ColorAt(world, ray)};
+
+            // NOTE: A quad off to the side of the ray, between the spot it
+            // hits on the outer sphere and the light.
+            TriangleMesh quad;
+            quad.material.color = {1, 0, 0};
+            quad.AddVertex({-3, 1.5F, -3});
+            quad.AddVertex({-1.5F, 1.5F, -3});
+            quad.AddVertex({-1.5F, 3, -3});
+            quad.AddVertex({-3, 3, -3});
+            quad.AddTriangle(0, 1, 2);
+            quad.AddTriangle(0, 2, 3);
+            uint32_t mesh_id = world.AddMesh(quad);
+            Color shadowed{ColorAt(world, ray)};
+
+            Ray quad_ray{{-2.25F, 2.F, -5}, {0, 0, 1}};
+            HitRecord hit{ClosestHit(world, quad_ray, 0.F, INFINITY)};
+            Point point{quad_ray.Position(hit.t)};
+            Color expected{Lighting(quad.material, world.lights[0], point,
+                                    {0, 0, -1}, {0, 0, -1}, 1.F)};
+            Color shaded{ShadeHit(world, quad_ray, hit)};
+
+            world.BuildBvh();
+            HitRecord built_hit{ClosestHit(world, quad_ray, 0.F, INFINITY)};
+
+            return ASSERT_EQUAL(uint32_t, mesh_id, 0) &&
+                   ASSERT_EQUAL(size_t, world.triangles.TriangleCount(), 2) &&
+                   ASSERT_EQUAL(Color, unshadowed,
+                                Color(.38066F, .47583F, .2855F)) &&
+                   ASSERT_EQUAL(Color, shadowed, Color(.08F, .1F, .06F)) &&
+                   ASSERT_EQUAL(int, HandleType(hit.object_id),
+                                PRIMITIVE_TRIANGLE) &&
+                   ASSERT_EQUAL_FLOAT(hit.t, 2.F) &&
+                   ASSERT_EQUAL(Color, shaded, expected) &&
+                   ASSERT_EQUAL(uint32_t, built_hit.object_id, hit.object_id) &&
+                   ASSERT_EQUAL(size_t, IntersectWorld(world, quad_ray).count,
+                                1);
+          });
+}
+
+std::unique_ptr<Sphere[]> RandomSpheres(size_t count, float size,
+                                        uint32_t seed) {
+  std::mt19937 rng{seed};
+  std::uniform_real_distribution<float> position{-size, size};
+  std::uniform_real_distribution<float> scale{.1F, .6F};
+  std::uniform_real_distribution<float> angle{0.F, 6.2831853F};
+
+  ShearType shears[] = {XY, XZ, YX, YZ, ZX, ZY};
+
+  std::unique_ptr<Sphere[]> spheres = std::make_unique<Sphere[]>(count);
+  for (size_t i = 0; i < count; ++i) {
+    float x = position(rng);
+    float y = position(rng);
+    float z = position(rng);
+    spheres[i].SetTransform(Translate(x, y, z)
+                                .RotateY(angle(rng))
+                                .Shear(shears[i % ArraySize(shears)])
+                                .Scale(scale(rng), scale(rng), scale(rng)));
+  }
+  return spheres;
+}
+
+Ray RandomRay(std::mt19937* rng, float size) {
+  std::uniform_real_distribution<float> position{-size, size};
+  Point origin{position(*rng), position(*rng), -2.F * size};
+  Point target{position(*rng), position(*rng), 2.F * size};
+  return {origin, (target - origin).Normalize()};
+}
+
+// NOTE: The objects and lights of world with nothing built, so its queries
+// test every sphere.
+static World BruteForceWorld(const World& world) {
+  World brute_force;
+  brute_force.lights = world.lights;
+  for (size_t i = 0; i < world.objects.size; ++i) {
+    brute_force.AddObject(world.objects[i]);
+  }
+  return brute_force;
+}
+
+static inline void TestBvh(TestFramework* fw) {
+  fw->Run("Bounds of a scaled and translated sphere", "Bvh", []() -> bool {
+    constexpr TransformBuilder kTransform =
+        TransformBuilder{}.Scale(2, 1, .5F).Translate(1, 2, 3);
+    Sphere sphere;
+    sphere.SetTransform(kTransform.ToMatrix());
+
+    Aabb expected{{-1, 1, 2.5F}, {3, 3, 3.5F}};
+    return ASSERT_EQUAL(Aabb, SphereBounds(sphere), expected);
+  });
+
+  fw->Run("Bounds of a sheared sphere are tight", "Bvh", []() -> bool {
+    constexpr TransformBuilder kTransform = TransformBuilder{}.Shear(XY);
+    Sphere sphere;
+    sphere.SetTransform(kTransform.ToMatrix());
+    Aabb bounds{SphereBounds(sphere)};
+
+    // NOTE: x = ox + oy over the unit sphere peaks at sqrt(2), on the
+    // object-space point (1, 1, 0) / sqrt(2).
+    float half = std::sqrt(2.F) / 2.F;
+    Point extreme{sphere.transform_matrix * Point{half, half, 0}};
+
+    return ASSERT_EQUAL(Aabb, bounds,
+                        Aabb({-std::sqrt(2.F), -1, -1},
+                             {std::sqrt(2.F), 1, 1})) &&
+           ASSERT_EQUAL_FLOAT(extreme.x, bounds.max.x);
+  });
+
+  fw->Run("Ray misses a box beside it", "Bvh", []() -> bool {
+    Aabb box{{-1, -1, -1}, {1, 1, 1}};
+    Ray hit_ray{{0, 0, -5}, {0, 0, 1}};
+    Ray miss_ray{{2, 0, -5}, {0, 0, 1}};
+
+    float t_entry = 0;
+    bool is_hit = box.Intersect(hit_ray, InverseDirection(hit_ray), 0.F,
+                                INFINITY, &t_entry);
+    float hit_entry = t_entry;
+    bool is_miss_hit = box.Intersect(miss_ray, InverseDirection(miss_ray), 0.F,
+                                     INFINITY, &t_entry);
+
+    return ASSERT_EQUAL(bool, is_hit, true) &&
+           ASSERT_EQUAL_FLOAT(hit_entry, 4.F) &&
+           ASSERT_EQUAL(bool, is_miss_hit, false);
+  });
+
+  fw->Run("Bvh leaves hold every object once", "Bvh", []() -> bool {
+    size_t count = 1000;
+    std::unique_ptr<Sphere[]> spheres{RandomSpheres(count, 10.F, 7)};
+    Bvh bvh{spheres.get(), count};
+
+    size_t leaf_objects = 0;
+    bool is_contained = true;
+    for (size_t i = 0; i < bvh.node_count; ++i) {
+      const BvhNode& node = bvh.nodes[i];
+      if (!node.IsLeaf()) {
+        continue;
+      }
+      leaf_objects += node.count;
+      for (uint32_t k = 0; k < node.count; ++k) {
+        Aabb bounds{SphereBounds(spheres[bvh.indices[node.first + k]])};
+        is_contained =
+            is_contained && Union(node.bounds, bounds) == node.bounds;
+      }
+    }
+
+    std::vector<uint32_t> sorted(bvh.indices.data.get(),
+                                 bvh.indices.data.get() + bvh.indices.size);
+    std::sort(sorted.begin(), sorted.end());
+    bool is_permutation = true;
+    for (size_t i = 0; i < count; ++i) {
+      is_permutation = is_permutation && sorted[i] == i;
+    }
+
+    return ASSERT_EQUAL(size_t, leaf_objects, count) &&
+           ASSERT_EQUAL(bool, is_contained, true) &&
+           ASSERT_EQUAL(bool, is_permutation, true);
+  });
+
+  fw->Run("Bvh closest hit matches brute force", "Bvh", []() -> bool {
+    size_t count = 2000;
+    std::unique_ptr<Sphere[]> spheres{RandomSpheres(count, 10.F, 11)};
+    Bvh bvh{spheres.get(), count};
+
+    std::mt19937 rng{3};
+    bool is_equal = true;
+    size_t hit_count = 0;
+    for (size_t i = 0; i < 500; ++i) {
+      Ray ray{RandomRay(&rng, 10.F)};
+      HitRecord expected{ClosestHit(ray, spheres.get(), count, 0.F, INFINITY)};
+      HitRecord actual{bvh.ClosestHit(ray, spheres.get(), 0.F, INFINITY)};
+      hit_count += expected.IsHit() ? 1 : 0;
+      is_equal = is_equal && actual.object_id == expected.object_id &&
+                 actual.t == expected.t;
+    }
+
+    return ASSERT_EQUAL(bool, is_equal, true) &&
+           ASSERT_EQUAL(bool, hit_count > 100, true);
+  });
+
+  fw->Run("Bvh any hit matches brute force", "Bvh", []() -> bool {
+    size_t count = 2000;
+    std::unique_ptr<Sphere[]> spheres{RandomSpheres(count, 10.F, 13)};
+    Bvh bvh{spheres.get(), count};
+
+    std::mt19937 rng{5};
+    bool is_equal = true;
+    size_t occluded_count = 0;
+    for (size_t i = 0; i < 500; ++i) {
+      Ray ray{RandomRay(&rng, 10.F)};
+      float tmax = static_cast<float>(i % 40);
+      bool expected = IsOccluded(ray, spheres.get(), count, 0.F, tmax);
+      occluded_count += expected ? 1 : 0;
+      is_equal = is_equal &&
+                 bvh.IsOccluded(ray, spheres.get(), 0.F, tmax) == expected;
+    }
+
+    return ASSERT_EQUAL(bool, is_equal, true) &&
+           ASSERT_EQUAL(bool, occluded_count > 50, true);
+  });
+
+  fw->Run("Bvh over coincident spheres stays shallow", "Bvh", []() -> bool {
+    size_t count = 300;
+    std::unique_ptr<Sphere[]> spheres = std::make_unique<Sphere[]>(count);
+    Bvh bvh{spheres.get(), count};
+
+    Ray ray{{0, 0, -5}, {0, 0, 1}};
+    HitRecord hit{bvh.ClosestHit(ray, spheres.get(), 0.F, INFINITY)};
+
+    return ASSERT_EQUAL(bool, bvh.node_count < 2 * count, true) &&
+           ASSERT_EQUAL_FLOAT(hit.t, 4.F);
+  });
+
+  fw->Run("World queries go through its Bvh", "Bvh", []() -> bool {
+    size_t count = 500;
+    std::unique_ptr<Sphere[]> spheres{RandomSpheres(count, 6.F, 17)};
+    World world;
+    world.AddLight({Color{1, 1, 1}, Point{-20, 20, -20}});
+    for (size_t i = 0; i < count; ++i) {
+      world.AddObject(spheres[i]);
+    }
+    World brute_force{world};
+    world.BuildBvh();
+
+    std::mt19937 rng{9};
+    bool is_equal = true;
+    for (size_t i = 0; i < 200; ++i) {
+      Ray ray{RandomRay(&rng, 6.F)};
+      is_equal =
+          is_equal && ColorAt(world, ray) == ColorAt(brute_force, ray);
+    }
+
+    world.AddObject(Sphere{});
+    bool is_dropped = !world.bvh.IsBuilt() && !world.wide_bvh.IsBuilt();
+
+    return ASSERT_EQUAL(bool, brute_force.bvh.IsBuilt(), false) &&
+           ASSERT_EQUAL(bool, is_equal, true) &&
+           ASSERT_EQUAL(bool, is_dropped, true);
+  });
+
+  fw->Run("Wide BVH nodes are aligned and hold every object once", "Bvh",
+          []() -> bool {
+            size_t count = 1000;
+            std::unique_ptr<Sphere[]> spheres{RandomSpheres(count, 10.F, 7)};
+            WideBvh bvh{spheres.get(), count};
+
+            bool is_aligned =
+                reinterpret_cast<uintptr_t>(bvh.nodes.data.get()) % 64 == 0 &&
+                sizeof(WideBvhNode) % 64 == 0;
+
+            size_t leaf_objects = 0;
+            size_t referenced_nodes = 1;
+            for (size_t i = 0; i < bvh.node_count; ++i) {
+              const WideBvhNode& node = bvh.nodes[i];
+              for (size_t slot = 0; slot < WIDE_BVH_WIDTH; ++slot) {
+                if (node.IsEmpty(slot)) {
+                  continue;
+                }
+                if (node.IsLeaf(slot)) {
+                  leaf_objects += node.counts[slot];
+                } else {
+                  referenced_nodes++;
+                }
+              }
+            }
+
+            return ASSERT_EQUAL(bool, is_aligned, true) &&
+                   ASSERT_EQUAL(size_t, leaf_objects, count) &&
+                   ASSERT_EQUAL(size_t, referenced_nodes, bvh.node_count);
+          });
+
+  fw->Run("Wide BVH queries match the binary BVH", "Bvh", []() -> bool {
+    size_t count = 2000;
+    std::unique_ptr<Sphere[]> spheres{RandomSpheres(count, 10.F, 19)};
+    Bvh binary{spheres.get(), count};
+    WideBvh wide{binary};
+
+    std::mt19937 rng{21};
+    bool is_closest_equal = true;
+    bool is_any_equal = true;
+    for (size_t i = 0; i < 500; ++i) {
+      Ray ray{RandomRay(&rng, 10.F)};
+      HitRecord expected{binary.ClosestHit(ray, spheres.get(), 0.F, INFINITY)};
+      HitRecord actual{wide.ClosestHit(ray, spheres.get(), 0.F, INFINITY)};
+      is_closest_equal = is_closest_equal &&
+                         actual.object_id == expected.object_id &&
+                         actual.t == expected.t;
+
+      float tmax = static_cast<float>(i % 40);
+      is_any_equal = is_any_equal &&
+                     wide.IsOccluded(ray, spheres.get(), 0.F, tmax) ==
+                         binary.IsOccluded(ray, spheres.get(), 0.F, tmax);
+    }
+
+    return ASSERT_EQUAL(bool, is_closest_equal, true) &&
+           ASSERT_EQUAL(bool, is_any_equal, true);
+  });
+
+  fw->Run("Wide BVH over a single sphere", "Bvh", []() -> bool {
+    Sphere sphere;
+    WideBvh bvh{&sphere, 1};
+
+    HitRecord hit{
+        bvh.ClosestHit(Ray{{0, 0, -5}, {0, 0, 1}}, &sphere, 0.F, INFINITY)};
+    HitRecord miss{
+        bvh.ClosestHit(Ray{{0, 0, -5}, {0, 1, 0}}, &sphere, 0.F, INFINITY)};
+
+    return ASSERT_EQUAL(size_t, bvh.node_count, 1) &&
+           ASSERT_EQUAL_FLOAT(hit.t, 4.F) &&
+           ASSERT_EQUAL(bool, miss.IsHit(), false) &&
+           ASSERT_EQUAL(bool,
+                        bvh.IsOccluded(Ray{{0, 0, -5}, {0, 0, 10}}, &sphere,
+                                       0.F, 1.F),
+                        true);
+  });
+
+  fw->Run("World renders the same with either BVH layout", "Bvh",
+          []() -> bool {
+            size_t count = 300;
+            std::unique_ptr<Sphere[]> spheres{RandomSpheres(count, 4.F, 23)};
+            World binary;
+            binary.AddLight({Color{1, 1, 1}, Point{-20, 20, -20}});
+            for (size_t i = 0; i < count; ++i) {
+              binary.AddObject(spheres[i]);
+            }
+            World wide{binary};
+            binary.BuildBvh(BVH_BINARY);
+            wide.BuildBvh(BVH_WIDE);
+
+            size_t canvas_size = 32;
+            Canvas binary_canvas{canvas_size, canvas_size};
+            Canvas wide_canvas{canvas_size, canvas_size};
+            CastWorldShaded(&binary_canvas, {0, 0, -10}, binary, 10.F, 10.F);
+            CastWorldShaded(&wide_canvas, {0, 0, -10}, wide, 10.F, 10.F);
+
+            bool is_equal = true;
+            for (size_t y = 0; y < canvas_size; ++y) {
+              for (size_t x = 0; x < canvas_size; ++x) {
+                Color wide_color{wide_canvas.ColorAt(x, y)};
+                is_equal =
+                    is_equal && binary_canvas.ColorAt(x, y) == wide_color;
+              }
+            }
+
+            return ASSERT_EQUAL(bool, binary.bvh.IsBuilt(), true) &&
+                   ASSERT_EQUAL(bool, wide.wide_bvh.IsBuilt(), true) &&
+                   ASSERT_EQUAL(bool, wide.bvh.IsBuilt(), false) &&
+                   ASSERT_EQUAL(bool, is_equal, true);
+          });
+
+  fw->Run("Morton codes interleave the axes", "Bvh", []() -> bool {
+    return ASSERT_EQUAL(uint32_t, MortonCode(0.F, 0.F, 0.F), 0) &&
+           ASSERT_EQUAL(uint32_t, MortonCode(1.F, 1.F, 1.F), 0x3FFFFFFFU) &&
+           ASSERT_EQUAL(uint32_t, MortonCode(1.F, 0.F, 0.F), 0x24924924U) &&
+           ASSERT_EQUAL(uint32_t, MortonCode(0.F, 0.F, 1.F), 0x09249249U) &&
+           ASSERT_EQUAL(uint32_t, MortonCode(-1.F, 0.F, 2.F), 0x09249249U);
+  });
+
+  fw->Run("Linear BVH queries match brute force", "Bvh", []() -> bool {
+    size_t count = 2000;
+    std::unique_ptr<Sphere[]> spheres{RandomSpheres(count, 10.F, 29)};
+    Bvh bvh;
+    BuildLinearBvh(spheres.get(), count, 3, &bvh);
+
+    std::mt19937 rng{31};
+    bool is_closest_equal = true;
+    bool is_any_equal = true;
+    for (size_t i = 0; i < 500; ++i) {
+      Ray ray{RandomRay(&rng, 10.F)};
+      HitRecord expected{
+          ClosestHit(ray, spheres.get(), count, 0.F, INFINITY)};
+      HitRecord actual{bvh.ClosestHit(ray, spheres.get(), 0.F, INFINITY)};
+      is_closest_equal = is_closest_equal &&
+                         actual.object_id == expected.object_id &&
+                         actual.t == expected.t;
+
+      float tmax = static_cast<float>(i % 40);
+      is_any_equal = is_any_equal &&
+                     bvh.IsOccluded(ray, spheres.get(), 0.F, tmax) ==
+                         IsOccluded(ray, spheres.get(), count, 0.F, tmax);
+    }
+
+    return ASSERT_EQUAL(size_t, bvh.node_count, 2 * count - 1) &&
+           ASSERT_EQUAL(bool, is_closest_equal, true) &&
+           ASSERT_EQUAL(bool, is_any_equal, true);
+  });
+
+  fw->Run("Linear BVH layout does not depend on the thread count", "Bvh",
+          []() -> bool {
+            size_t count = 5000;
+            std::unique_ptr<Sphere[]> spheres{RandomSpheres(count, 12.F, 37)};
+            Bvh serial;
+            BuildLinearBvh(spheres.get(), count, 1, &serial);
+
+            bool is_equal = true;
+            for (size_t thread_count : {2, 4, 7}) {
+              Bvh parallel;
+              BuildLinearBvh(spheres.get(), count, thread_count, &parallel);
+              is_equal = is_equal && parallel.node_count == serial.node_count;
+              for (size_t i = 0; i < serial.node_count; ++i) {
+                const BvhNode& a = serial.nodes[i];
+                const BvhNode& b = parallel.nodes[i];
+                is_equal = is_equal && a.bounds == b.bounds &&
+                           a.first == b.first && a.count == b.count;
+              }
+              for (size_t i = 0; i < count; ++i) {
+                is_equal = is_equal && serial.indices[i] == parallel.indices[i];
+              }
+            }
+
+            return ASSERT_EQUAL(bool, is_equal, true);
+          });
+
+  fw->Run("Linear BVH over coincident and tiny inputs", "Bvh", []() -> bool {
+    size_t count = 300;
+    std::unique_ptr<Sphere[]> spheres = std::make_unique<Sphere[]>(count);
+    Bvh coincident;
+    BuildLinearBvh(spheres.get(), count, 4, &coincident);
+    Ray ray{{0, 0, -5}, {0, 0, 1}};
+    HitRecord hit{coincident.ClosestHit(ray, spheres.get(), 0.F, INFINITY)};
+
+    Bvh single;
+    BuildLinearBvh(spheres.get(), 1, 4, &single);
+    HitRecord single_hit{single.ClosestHit(ray, spheres.get(), 0.F, INFINITY)};
+
+    constexpr TransformBuilder kPairTransform =
+        TransformBuilder{}.Translate(0, 0, 3);
+    Sphere pair[2];
+    pair[1].SetTransform(kPairTransform.ToMatrix());
+    Bvh two;
+    BuildLinearBvh(pair, 2, 0, &two);
+    WideBvh wide{two};
+    HitRecord wide_hit{wide.ClosestHit(ray, pair, 0.F, INFINITY)};
+
+    Bvh empty;
+    BuildLinearBvh(spheres.get(), 0, 4, &empty);
+
+    return ASSERT_EQUAL_FLOAT(hit.t, 4.F) &&
+           ASSERT_EQUAL(size_t, single.node_count, 1) &&
+           ASSERT_EQUAL_FLOAT(single_hit.t, 4.F) &&
+           ASSERT_EQUAL(size_t, two.node_count, 3) &&
+           ASSERT_EQUAL(uint32_t, wide_hit.object_id, 0) &&
+           ASSERT_EQUAL_FLOAT(wide_hit.t, 4.F) &&
+           ASSERT_EQUAL(bool, empty.IsBuilt(), false);
+  });
+
+  fw->Run("Refit keeps the tree exact after small motions", "Bvh",
+          []() -> bool {
+            size_t count = 2000;
+            std::unique_ptr<Sphere[]> spheres{RandomSpheres(count, 10.F, 41)};
+            Bvh bvh{spheres.get(), count};
+            WideBvh wide{spheres.get(), count};
+
+            std::mt19937 rng{43};
+            std::uniform_real_distribution<float> offset{-.3F, .3F};
+            for (size_t i = 0; i < count; ++i) {
+              spheres[i].SetTransform(spheres[i].transform_matrix.Translate(
+                  offset(rng), offset(rng), offset(rng)));
+            }
+            bool is_rebuilt =
+                bvh.Refit(spheres.get(), count, BVH_REBUILD_THRESHOLD, 3) ||
+                wide.Refit(spheres.get(), count, BVH_REBUILD_THRESHOLD, 3);
+
+            bool is_equal = true;
+            for (size_t i = 0; i < 500; ++i) {
+              Ray ray{RandomRay(&rng, 10.F)};
+              HitRecord expected{
+                  ClosestHit(ray, spheres.get(), count, 0.F, INFINITY)};
+              HitRecord binary_hit{
+                  bvh.ClosestHit(ray, spheres.get(), 0.F, INFINITY)};
+              HitRecord wide_hit{
+                  wide.ClosestHit(ray, spheres.get(), 0.F, INFINITY)};
+              float tmax = static_cast<float>(i % 40);
+              bool is_occluded =
+                  IsOccluded(ray, spheres.get(), count, 0.F, tmax);
+              is_equal = is_equal && binary_hit.t == expected.t &&
+                         wide_hit.t == expected.t &&
+                         bvh.IsOccluded(ray, spheres.get(), 0.F, tmax) ==
+                             is_occluded &&
+                         wide.IsOccluded(ray, spheres.get(), 0.F, tmax) ==
+                             is_occluded;
+            }
+
+            return ASSERT_EQUAL(bool, is_rebuilt, false) &&
+                   ASSERT_EQUAL(bool, bvh.cost >= bvh.build_cost, true) &&
+                   ASSERT_EQUAL(bool, is_equal, true);
+          });
+
+  fw->Run("Refit bounds do not depend on the thread count", "Bvh",
+          []() -> bool {
+            size_t count = 3000;
+            std::unique_ptr<Sphere[]> spheres{RandomSpheres(count, 12.F, 47)};
+            Bvh fresh{spheres.get(), count};
+            Bvh serial{fresh};
+            Bvh parallel{fresh};
+            bool is_rebuilt =
+                serial.Refit(spheres.get(), count, BVH_REBUILD_THRESHOLD, 1) ||
+                parallel.Refit(spheres.get(), count, BVH_REBUILD_THRESHOLD, 4);
+
+            bool is_equal = true;
+            for (size_t i = 0; i < fresh.node_count; ++i) {
+              is_equal = is_equal &&
+                         serial.nodes[i].bounds == fresh.nodes[i].bounds &&
+                         parallel.nodes[i].bounds == fresh.nodes[i].bounds;
+            }
+
+            return ASSERT_EQUAL(bool, is_rebuilt, false) &&
+                   ASSERT_EQUAL(bool, is_equal, true) &&
+                   ASSERT_EQUAL_FLOAT(parallel.cost, fresh.build_cost) &&
+                   ASSERT_EQUAL_FLOAT(serial.cost, fresh.build_cost);
+          });
+
+  fw->Run("Refit rebuilds once the SAH cost degrades", "Bvh", []() -> bool {
+    size_t count = 2000;
+    std::unique_ptr<Sphere[]> spheres{RandomSpheres(count, 10.F, 53)};
+    Bvh bvh{spheres.get(), count};
+    WideBvh wide{spheres.get(), count};
+
+    // NOTE: Swapping every sphere with a distant one keeps the tree valid
+    // but makes its boxes span the scene.
+    for (size_t i = 0; i < count / 2; ++i) {
+      Sphere moved{spheres[i]};
+      spheres[i] = spheres[count - 1 - i];
+      spheres[count - 1 - i] = moved;
+    }
+    Bvh refit_only{bvh};
+    bool is_refit_only_rebuilt =
+        refit_only.Refit(spheres.get(), count, INFINITY, 1);
+    bool is_rebuilt = bvh.Refit(spheres.get(), count, 1.5F, 2);
+    bool is_wide_rebuilt = wide.Refit(spheres.get(), count, 1.5F, 2);
+
+    return ASSERT_EQUAL(bool, is_refit_only_rebuilt, false) &&
+           ASSERT_EQUAL(bool,
+                        refit_only.cost > 1.5F * refit_only.build_cost, true) &&
+           ASSERT_EQUAL(bool, is_rebuilt, true) &&
+           ASSERT_EQUAL(bool, is_wide_rebuilt, true) &&
+           ASSERT_EQUAL_FLOAT(bvh.cost, bvh.build_cost) &&
+           ASSERT_EQUAL(bool, bvh.Refit(spheres.get(), count - 1, 1.5F, 2),
+                        true) &&
+           ASSERT_EQUAL(size_t, bvh.indices.size, count - 1);
+  });
+
+  fw->Run("World refits its BVH after objects move", "Bvh", []() -> bool {
+    size_t count = 400;
+    std::unique_ptr<Sphere[]> spheres{RandomSpheres(count, 6.F, 59)};
+    World world;
+    world.AddLight({Color{1, 1, 1}, Point{-20, 20, -20}});
+    for (size_t i = 0; i < count; ++i) {
+      world.AddObject(spheres[i]);
+    }
+    world.BuildBvh();
+
+    for (size_t i = 0; i < count; ++i) {
+      Sphere& object = world.objects[i];
+      object.SetTransform(object.transform_matrix.Translate(0, .2F, 0));
+    }
+    bool is_rebuilt = world.RefitBvh();
+    World brute_force{BruteForceWorld(world)};
+
+    std::mt19937 rng{61};
+    bool is_equal = true;
+    for (size_t i = 0; i < 200; ++i) {
+      Ray ray{RandomRay(&rng, 6.F)};
+      is_equal =
+          is_equal && ColorAt(world, ray) == ColorAt(brute_force, ray);
+    }
+
+    return ASSERT_EQUAL(bool, is_rebuilt, false) &&
+           ASSERT_EQUAL(bool, world.wide_bvh.IsBuilt(), true) &&
+           ASSERT_EQUAL(bool, is_equal, true);
+  });
+
+  fw->Run("World rebuilds a linear BVH after objects move", "Bvh",
+          []() -> bool {
+            size_t count = 400;
+            std::unique_ptr<Sphere[]> spheres{RandomSpheres(count, 6.F, 67)};
+            World world;
+            world.AddLight({Color{1, 1, 1}, Point{-20, 20, -20}});
+            for (size_t i = 0; i < count; ++i) {
+              world.AddObject(spheres[i]);
+            }
+            world.BuildBvh(BVH_LINEAR);
+            bool is_built = world.bvh.IsBuilt() && !world.wide_bvh.IsBuilt();
+
+            for (size_t i = 0; i < count; ++i) {
+              Sphere& object = world.objects[i];
+              object.SetTransform(object.transform_matrix.Translate(0, .5F, 0));
+            }
+            bool is_rebuilt = world.RefitBvh();
+            World brute_force{BruteForceWorld(world)};
+
+            std::mt19937 rng{71};
+            bool is_equal = true;
+            for (size_t i = 0; i < 200; ++i) {
+              Ray ray{RandomRay(&rng, 6.F)};
+              is_equal =
+                  is_equal && ColorAt(world, ray) == ColorAt(brute_force, ray);
+            }
+
+            return ASSERT_EQUAL(bool, is_built, true) &&
+                   ASSERT_EQUAL(bool, is_rebuilt, true) &&
+                   ASSERT_EQUAL(int, world.bvh_layout, BVH_LINEAR) &&
+                   ASSERT_EQUAL(bool, is_equal, true);
+          });
+}
+
+static inline void TestInstance(TestFramework* fw) {
+  fw->Run("Transformed box bounds match its transformed corners", "Instance",
+          []() -> bool {
+            Aabb box{{-1, -2, -3}, {2, 1, .5F}};
+            Matrix transform{
+                RotateY(.7F).Shear(XY).Scale(1, 2, .5F).Translate(3, -1, 2)};
+
+            Aabb expected;
+            for (size_t corner = 0; corner < 8; ++corner) {
+              Point point{corner & 1 ? box.max.x : box.min.x,
+                          corner & 2 ? box.max.y : box.min.y,
+                          corner & 4 ? box.max.z : box.min.z};
+              expected.Grow(transform * point);
+            }
+
+            return ASSERT_EQUAL(Aabb, TransformBounds(box, transform),
+                                expected) &&
+                   ASSERT_EQUAL(bool,
+                                TransformBounds(Aabb{}, transform).IsEmpty(),
+                                true);
+          });
+
+  fw->Run("Instances intersect like flattened copies", "Instance",
+          []() -> bool {
+            size_t blas_count = 50;
+            size_t instance_count = 200;
+            std::unique_ptr<Sphere[]> spheres{
+                RandomSpheres(blas_count, 2.F, 67)};
+            Blas blas{spheres.get(), blas_count};
+
+            std::mt19937 rng{71};
+            std::uniform_real_distribution<float> position{-20.F, 20.F};
+            std::uniform_real_distribution<float> angle{0.F, 6.2831853F};
+            std::uniform_real_distribution<float> scale{.5F, 1.5F};
+
+            Tlas tlas;
+            std::unique_ptr<Sphere[]> flattened =
+                std::make_unique<Sphere[]>(instance_count * blas_count);
+            for (size_t i = 0; i < instance_count; ++i) {
+              float size = scale(rng);
+              Matrix transform{Scale(size, size, size)
+                                   .RotateX(angle(rng))
+                                   .Translate(position(rng), position(rng),
+                                              position(rng))};
+              tlas.AddInstance(&blas, transform);
+              for (size_t j = 0; j < blas_count; ++j) {
+                flattened[i * blas_count + j].SetTransform(
+                    transform * spheres[j].transform_matrix);
+              }
+            }
+            tlas.Build();
+
+            // NOTE: The flattened copies invert one composed matrix, so
+            // distances only agree to a relative 1e-3.
+            size_t mismatches = 0;
+            for (size_t i = 0; i < 500; ++i) {
+              Ray ray{RandomRay(&rng, 20.F)};
+              HitRecord expected{ClosestHit(ray, flattened.get(),
+                                            instance_count * blas_count, 0.F,
+                                            INFINITY)};
+              InstanceHitRecord actual{tlas.ClosestHit(ray, 0.F, INFINITY)};
+              bool is_same_object =
+                  expected.IsHit() == actual.IsHit() &&
+                  (!expected.IsHit() ||
+                   (actual.instance_id * blas_count + actual.object_id ==
+                        expected.object_id &&
+                    std::abs(actual.t - expected.t) < 1e-3F * expected.t));
+
+              float tmax = static_cast<float>(i % 40);
+              bool is_same_occlusion =
+                  tlas.IsOccluded(ray, 0.F, tmax) ==
+                  IsOccluded(ray, flattened.get(), instance_count * blas_count,
+                             0.F, tmax);
+              mismatches += is_same_object && is_same_occlusion ? 0 : 1;
+            }
+
+            return ASSERT_EQUAL(bool, mismatches <= 2, true);
+          });
+
+  fw->Run("Moving an instance only touches the top level", "Instance",
+          []() -> bool {
+            Blas blas{UnitSphereBlas()};
+            Tlas tlas;
+            for (size_t i = 0; i < 64; ++i) {
+              tlas.AddInstance(&blas,
+                               Translate(static_cast<float>(i % 8) * 3.F,
+                                         static_cast<float>(i / 8) * 3.F, 0));
+            }
+            tlas.Build();
+            const Sphere* blas_spheres = blas.spheres.data.get();
+
+            tlas.SetTransform(9, Translate(4.5F, 4.5F, 0));
+            bool is_rebuilt = tlas.Refit(BVH_REBUILD_THRESHOLD, 2);
+
+            Ray ray{{4.5F, 4.5F, -5}, {0, 0, 1}};
+            InstanceHitRecord hit{tlas.ClosestHit(ray, 0.F, INFINITY)};
+            Ray old_ray{{3, 3, -5}, {0, 0, 1}};
+
+            return ASSERT_EQUAL(bool, is_rebuilt, false) &&
+                   ASSERT_EQUAL(uint32_t, hit.instance_id, 9) &&
+                   ASSERT_EQUAL_FLOAT(hit.t, 4.F) &&
+                   ASSERT_EQUAL(bool, tlas.IsOccluded(old_ray, 0.F, 10.F),
+                                false) &&
+                   ASSERT_EQUAL(bool, blas.spheres.data.get() == blas_spheres,
+                                true) &&
+                   ASSERT_EQUAL(Sphere, blas.spheres[0], Sphere{});
+          });
+
+  fw->Run("Instance normals follow the instance transform", "Instance",
+          []() -> bool {
+            Blas blas{UnitSphereBlas()};
+            Tlas tlas;
+            Matrix transform{Scale(2, 1, .5F).RotateZ(.3F).Translate(5, 0, 0)};
+            tlas.AddInstance(&blas, transform);
+            tlas.Build();
+
+            Sphere sphere;
+            sphere.SetTransform(transform);
+            Ray ray{{4.8F, .3F, -10}, {0, 0, 1}};
+            InstanceHitRecord hit{tlas.ClosestHit(ray, 0.F, INFINITY)};
+            HitRecord expected{ClosestHit(ray, sphere, 0.F, INFINITY)};
+            Point point{ray.Position(hit.t)};
+
+            return ASSERT_EQUAL(bool, hit.IsHit(), true) &&
+                   ASSERT_EQUAL_FLOAT(hit.t, expected.t) &&
+                   ASSERT_EQUAL(Vector, tlas.NormalAt(hit, point),
+                                sphere.NormalAt(point));
+          });
+
+  fw->Run("Instances share one Blas instead of copying it", "Instance",
+          []() -> bool {
+            size_t blas_count = 100;
+            size_t instance_count = 1000;
+            std::unique_ptr<Sphere[]> spheres{
+                RandomSpheres(blas_count, 3.F, 73)};
+            Blas blas{spheres.get(), blas_count};
+
+            Tlas tlas;
+            for (size_t i = 0; i < instance_count; ++i) {
+              tlas.AddInstance(&blas,
+                               Translate(static_cast<float>(i) * 10.F, 0, 0));
+            }
+            tlas.Build();
+
+            size_t copies_size = instance_count * blas_count * sizeof(Sphere);
+            size_t instanced_size = tlas.MemoryUsage() + blas.MemoryUsage();
+
+            return ASSERT_EQUAL(bool, instanced_size * 20 < copies_size, true);
+          });
+}
+
+static inline void TestGrid(TestFramework* fw) {
+  fw->Run("Grid queries match brute force", "Grid", []() -> bool {
+    size_t count = 3000;
+    std::unique_ptr<Sphere[]> spheres{RandomSpheres(count, 10.F, 79)};
+    Grid grid{spheres.get(), count, 3};
+
+    // NOTE: Half the rays start inside the grid, so the walk also begins
+    // in an inner cell.
+    std::mt19937 rng{83};
+    std::uniform_real_distribution<float> position{-10.F, 10.F};
+    bool is_closest_equal = true;
+    bool is_any_equal = true;
+    for (size_t i = 0; i < 1000; ++i) {
+      Ray ray{RandomRay(&rng, 10.F)};
+      if (i % 2 == 1) {
+        ray.origin = {position(rng), position(rng), position(rng)};
+      }
+      HitRecord expected{
+          ClosestHit(ray, spheres.get(), count, 0.F, INFINITY)};
+      HitRecord actual{grid.ClosestHit(ray, spheres.get(), 0.F, INFINITY)};
+      is_closest_equal = is_closest_equal &&
+                         actual.object_id == expected.object_id &&
+                         actual.t == expected.t;
+
+      float tmax = static_cast<float>(i % 40);
+      is_any_equal = is_any_equal &&
+                     grid.IsOccluded(ray, spheres.get(), 0.F, tmax) ==
+                         IsOccluded(ray, spheres.get(), count, 0.F, tmax);
+    }
+
+    const uint32_t* indices = grid.indices.data.get();
+    bool is_sorted = true;
+    for (size_t cell = 0; cell < grid.cell_count; ++cell) {
+      is_sorted = is_sorted &&
+                  std::is_sorted(indices + grid.cell_starts[cell],
+                                 indices + grid.cell_starts[cell + 1]);
+    }
+
+    return ASSERT_EQUAL(bool, grid.IsBuilt(), true) &&
+           ASSERT_EQUAL(bool, grid.indices.size >= count, true) &&
+           ASSERT_EQUAL(bool, is_sorted, true) &&
+           ASSERT_EQUAL(bool, is_closest_equal, true) &&
+           ASSERT_EQUAL(bool, is_any_equal, true);
+  });
+
+  fw->Run("Accelerators over a leaf-ordered sphere store match brute force",
+          "Grid", []() -> bool {
+            size_t count = 1500;
+            std::unique_ptr<Sphere[]> spheres{RandomSpheres(count, 10.F, 89)};
+            Bvh bvh{spheres.get(), count};
+            WideBvh wide{bvh};
+            Grid grid{spheres.get(), count, 2};
+            SphereStore bvh_store;
+            bvh_store.Build(spheres.get(), bvh.indices.data.get(),
+                            bvh.indices.size);
+            SphereStore wide_store;
+            wide_store.Build(spheres.get(), wide.indices.data.get(),
+                             wide.indices.size);
+            SphereStore grid_store;
+            grid_store.Build(spheres.get(), grid.indices.data.get(),
+                             grid.indices.size);
+
+            std::mt19937 rng{97};
+            bool is_closest_equal = true;
+            bool is_any_equal = true;
+            for (size_t i = 0; i < 500; ++i) {
+              Ray ray{RandomRay(&rng, 10.F)};
+              HitRecord expected{
+                  ClosestHit(ray, spheres.get(), count, 0.F, INFINITY)};
+              HitRecord actuals[] = {
+                  bvh.ClosestHit(ray, bvh_store, 0.F, INFINITY),
+                  wide.ClosestHit(ray, wide_store, 0.F, INFINITY),
+                  grid.ClosestHit(ray, grid_store, 0.F, INFINITY)};
+              for (const HitRecord& actual : actuals) {
+                is_closest_equal =
+                    is_closest_equal &&
+                    actual.object_id == expected.object_id &&
+                    (actual.t == expected.t ||
+                     std::abs(actual.t - expected.t) <=
+                         1e-5F * std::max(expected.t, 1.F));
+              }
+
+              float tmax = static_cast<float>(i % 40);
+              bool is_occluded =
+                  IsOccluded(ray, spheres.get(), count, 0.F, tmax);
+              is_any_equal =
+                  is_any_equal &&
+                  bvh.IsOccluded(ray, bvh_store, 0.F, tmax) == is_occluded &&
+                  wide.IsOccluded(ray, wide_store, 0.F, tmax) ==
+                      is_occluded &&
+                  grid.IsOccluded(ray, grid_store, 0.F, tmax) == is_occluded;
+            }
+
+            return ASSERT_EQUAL(size_t, grid_store.Count(),
+                                grid.indices.size) &&
+                   ASSERT_EQUAL(bool, is_closest_equal, true) &&
+                   ASSERT_EQUAL(bool, is_any_equal, true);
+          });
+
+  fw->Run("Grid cells do not depend on the thread count", "Grid",
+          []() -> bool {
+            size_t count = 4000;
+            std::unique_ptr<Sphere[]> spheres{RandomSpheres(count, 12.F, 89)};
+            Grid serial{spheres.get(), count, 1};
+
+            bool is_equal = true;
+            for (size_t thread_count : {2, 4, 7}) {
+              Grid parallel{spheres.get(), count, thread_count};
+              is_equal = is_equal &&
+                         parallel.cell_count == serial.cell_count &&
+                         parallel.indices.size == serial.indices.size;
+              for (size_t i = 0; i <= serial.cell_count; ++i) {
+                is_equal = is_equal &&
+                           parallel.cell_starts[i] == serial.cell_starts[i];
+              }
+              for (size_t i = 0; i < serial.indices.size; ++i) {
+                is_equal = is_equal && parallel.indices[i] == serial.indices[i];
+              }
+            }
+
+            return ASSERT_EQUAL(bool, is_equal, true);
+          });
+
+  fw->Run("Grid over coincident, flat and tiny inputs", "Grid", []() -> bool {
+    size_t count = 200;
+    std::unique_ptr<Sphere[]> spheres = std::make_unique<Sphere[]>(count);
+    Grid coincident{spheres.get(), count, 4};
+    Ray ray{{0, 0, -5}, {0, 0, 1}};
+    HitRecord hit{coincident.ClosestHit(ray, spheres.get(), 0.F, INFINITY)};
+
+    // NOTE: A single layer of flat discs gives a grid one cell thick, and
+    // the ray runs parallel to two of its axes.
+    std::unique_ptr<Sphere[]> layer = std::make_unique<Sphere[]>(count);
+    for (size_t i = 0; i < count; ++i) {
+      float x = static_cast<float>(i % 20) * 2.F;
+      float y = static_cast<float>(i / 20) * 2.F;
+      layer[i].SetTransform(Scale(.5F, .5F, .01F).Translate(x, y, 0));
+    }
+    Grid flat{layer.get(), count, 2};
+    Ray layer_ray{{6, 4, -5}, {0, 0, 1}};
+    HitRecord layer_hit{flat.ClosestHit(layer_ray, layer.get(), 0.F, 10.F)};
+
+    Grid single{spheres.get(), 1, 4};
+    HitRecord single_hit{single.ClosestHit(ray, spheres.get(), 0.F, INFINITY)};
+
+    Grid empty{spheres.get(), 0, 4};
+    HitRecord empty_hit{empty.ClosestHit(ray, spheres.get(), 0.F, INFINITY)};
+
+    return ASSERT_EQUAL(uint32_t, hit.object_id, 0) &&
+           ASSERT_EQUAL_FLOAT(hit.t, 4.F) &&
+           ASSERT_EQUAL(uint32_t, flat.resolution_z, 1) &&
+           ASSERT_EQUAL(uint32_t, layer_hit.object_id, 43) &&
+           ASSERT_EQUAL_FLOAT(layer_hit.t, 4.99F) &&
+           ASSERT_EQUAL(size_t, single.indices.size, single.cell_count) &&
+           ASSERT_EQUAL_FLOAT(single_hit.t, 4.F) &&
+           ASSERT_EQUAL(bool, empty.IsBuilt(), false) &&
+           ASSERT_EQUAL(bool, empty_hit.IsHit(), false);
+  });
+
+  fw->Run("World queries through its grid", "Grid", []() -> bool {
+    size_t count = 400;
+    std::unique_ptr<Sphere[]> spheres{RandomSpheres(count, 6.F, 97)};
+    World world;
+    world.AddLight({Color{1, 1, 1}, Point{-20, 20, -20}});
+    for (size_t i = 0; i < count; ++i) {
+      world.AddObject(spheres[i]);
+    }
+    world.BuildBvh();
+    world.BuildGrid();
+    bool is_bvh_dropped = !world.wide_bvh.IsBuilt() && !world.bvh.IsBuilt();
+
+    World brute_force{BruteForceWorld(world)};
+
+    std::mt19937 rng{101};
+    bool is_equal = true;
+    for (size_t i = 0; i < 200; ++i) {
+      Ray ray{RandomRay(&rng, 6.F)};
+      is_equal =
+          is_equal && ColorAt(world, ray) == ColorAt(brute_force, ray);
+    }
+
+    bool is_rebuilt = world.RefitBvh();
+    bool is_still_built = world.grid.IsBuilt();
+    world.AddObject(spheres[0]);
+
+    return ASSERT_EQUAL(bool, is_bvh_dropped, true) &&
+           ASSERT_EQUAL(bool, is_equal, true) &&
+           ASSERT_EQUAL(bool, is_rebuilt, true) &&
+           ASSERT_EQUAL(bool, is_still_built, true) &&
+           ASSERT_EQUAL(bool, world.grid.IsBuilt(), false);
+  });
+}
+
+TriangleMesh RandomTriangles(size_t count, float size, uint32_t seed) {
+  std::mt19937 rng{seed};
+  std::uniform_real_distribution<float> position{-size, size};
+  std::uniform_real_distribution<float> offset{-.6F, .6F};
+
+  TriangleMesh mesh;
+  for (size_t i = 0; i < count; ++i) {
+    Point center{position(rng), position(rng), position(rng)};
+    uint32_t corners[3];
+    for (uint32_t& corner : corners) {
+      corner = mesh.AddVertex(
+          center + Vector{offset(rng), offset(rng), offset(rng)});
+    }
+    mesh.AddTriangle(corners[0], corners[1], corners[2]);
+  }
+  return mesh;
+}
+
+std::string GridObj(size_t width, size_t height) {
+  std::string text{"# grid\no grid\n"};
+  for (size_t y = 0; y < height; ++y) {
+    for (size_t x = 0; x < width; ++x) {
+      text += std::format("v {:.4f} {:.4f} 0\n", static_cast<float>(x) * .1F,
+                          static_cast<float>(y) * .1F);
+    }
+    if (y == 0) {
+      continue;
+    }
+    // NOTE: Vertex (x, y) is -(width - x) and (x, y - 1) is -(2 * width - x).
+    for (size_t x = 0; x + 1 < width; ++x) {
+      text += std::format("f -{} -{} -{} -{}\n", 2 * width - x,
+                          2 * width - x - 1, width - x - 1, width - x);
+    }
+  }
+  return text;
+}
+
+static inline void TestMesh(TestFramework* fw) {
+  fw->Run("Triangle hits from either side inside the edges", "Mesh",
+          []() -> bool {
+            TriangleMesh mesh;
+            mesh.AddVertex({0, 0, 0});
+            mesh.AddVertex({1, 0, 0});
+            mesh.AddVertex({0, 1, 0});
+            mesh.AddTriangle(0, 1, 2);
+            mesh.Build();
+
+            HitRecord front{mesh.ClosestHit({{.25F, .25F, -2}, {0, 0, 1}}, 0.F,
+                                            INFINITY)};
+            HitRecord back{mesh.ClosestHit({{.25F, .25F, 3}, {0, 0, -1}}, 0.F,
+                                           INFINITY)};
+            HitRecord outside{mesh.ClosestHit({{.8F, .8F, -2}, {0, 0, 1}},
+                                              0.F, INFINITY)};
+            HitRecord parallel{mesh.ClosestHit({{-1, .25F, 0}, {1, 0, 0}}, 0.F,
+                                               INFINITY)};
+            HitRecord short_ray{
+                mesh.ClosestHit({{.25F, .25F, -2}, {0, 0, 1}}, 0.F, 2.F)};
+
+            float t = INFINITY;
+            bool is_scalar_hit =
+                IntersectTriangle({{.25F, .25F, -2}, {0, 0, 1}}, {0, 0, 0},
+                                  {1, 0, 0}, {0, 1, 0}, 0.F, &t);
+
+            return ASSERT_EQUAL(uint32_t, front.object_id, 0) &&
+                   ASSERT_EQUAL_FLOAT(front.t, 2.F) &&
+                   ASSERT_EQUAL_FLOAT(back.t, 3.F) &&
+                   ASSERT_EQUAL(bool, outside.IsHit(), false) &&
+                   ASSERT_EQUAL(bool, parallel.IsHit(), false) &&
+                   ASSERT_EQUAL(bool, short_ray.IsHit(), false) &&
+                   ASSERT_EQUAL(bool, is_scalar_hit, true) &&
+                   ASSERT_EQUAL_FLOAT(t, 2.F) &&
+                   ASSERT_EQUAL(Vector, mesh.NormalAt(0), Vector(0, 0, 1));
+          });
+
+  fw->Run("Mesh queries match brute force at every ISA level", "Mesh",
+          []() -> bool {
+            IsaLevel detected = DetectIsaLevel();
+            bool res = true;
+            for (size_t count : {20, 3000}) {
+              TriangleMesh brute_force{RandomTriangles(count, 8.F, 103)};
+              TriangleMesh mesh{brute_force};
+              mesh.Build();
+
+              for (int level = ISA_SSE2; level <= detected; ++level) {
+                ForceIsaLevel(static_cast<IsaLevel>(level));
+                std::mt19937 rng{107};
+                for (size_t i = 0; i < 300; ++i) {
+                  Ray ray{RandomRay(&rng, 8.F)};
+                  HitRecord expected{
+                      brute_force.ClosestHit(ray, 0.F, INFINITY)};
+                  HitRecord actual{mesh.ClosestHit(ray, 0.F, INFINITY)};
+                  float tmax = static_cast<float>(i % 30);
+                  res = res && actual.t == expected.t &&
+                        actual.object_id == expected.object_id &&
+                        mesh.IsOccluded(ray, 0.F, tmax) ==
+                            brute_force.IsOccluded(ray, 0.F, tmax);
+                }
+              }
+              res = res && ASSERT_EQUAL(bool, mesh.bvh.IsBuilt(),
+                                        count > MESH_FLAT_TRIANGLE_COUNT);
+            }
+            ForceIsaLevel(detected);
+
+            return ASSERT_EQUAL(bool, res, true);
+          });
+
+  fw->Run("OBJ parsing covers the common statement forms", "Mesh",
+          []() -> bool {
+            const char source[] =
+                "# comment\n"
+                "o quad\n"
+                "v 0 0 0\n"
+                "  v 1.0 0 0\r\n"
+                "v +1 1e0 0 1\n"
+                "v 0 1 0\n"
+                "vt 0 0\n"
+                "vn 0 0 1\n"
+                "f 1 2 3\n"
+                "f 1/1 3/1 4/1\n"
+                "usemtl white\n"
+                "s off\n"
+                "f -4//1 -3//1\t-2//1 -1//1\n"
+                "f 4/1/1 3/1/1 2/1/1";
+            TriangleMesh mesh;
+            bool is_parsed =
+                ParseObj(source, ArraySize(source) - 1, 4, &mesh);
+            const uint32_t expected[] = {0, 1, 2, 0, 2, 3, 0, 1, 2,
+                                         0, 2, 3, 3, 2, 1};
+
+            bool is_equal = mesh.triangle_indices.size == ArraySize(expected);
+            for (size_t i = 0; is_equal && i < ArraySize(expected); ++i) {
+              is_equal = mesh.triangle_indices[i] == expected[i];
+            }
+
+            return ASSERT_EQUAL(bool, is_parsed, true) &&
+                   ASSERT_EQUAL(size_t, mesh.VertexCount(), 4) &&
+                   ASSERT_EQUAL(size_t, mesh.TriangleCount(), 5) &&
+                   ASSERT_EQUAL(Point, mesh.Vertex(2), Point(1, 1, 0)) &&
+                   ASSERT_EQUAL(bool, is_equal, true);
+          });
+
+  fw->Run("OBJ parsing rejects malformed input", "Mesh", []() -> bool {
+    const char* sources[] = {
+        "v 0 0\n",
+        "v 0 0 0\nv 1 0 0\nv 0 1 0\nf 1 2 4\n",
+        "v 0 0 0\nv 1 0 0\nv 0 1 0\nf 0 1 2\n",
+        "v 0 0 0\nv 1 0 0\nv 0 1 0\nf -4 -2 -1\n",
+        "v 0 0 0\nv 1 0 0\nv 0 1 0\nf 1 2 x\n",
+    };
+
+    bool is_rejected = true;
+    for (const char* source : sources) {
+      TriangleMesh mesh;
+      mesh.AddVertex({1, 2, 3});
+      is_rejected = is_rejected &&
+                    !ParseObj(source, strlen(source), 1, &mesh) &&
+                    mesh.VertexCount() == 0 && mesh.TriangleCount() == 0;
+    }
+
+    TriangleMesh empty;
+    bool is_empty_parsed = ParseObj("", 0, 2, &empty);
+
+    return ASSERT_EQUAL(bool, is_rejected, true) &&
+           ASSERT_EQUAL(bool, is_empty_parsed, true) &&
+           ASSERT_EQUAL(size_t, empty.TriangleCount(), 0);
+  });
+
+  fw->Run("OBJ chunks parse the same as a single pass", "Mesh",
+          [fw]() -> bool {
+            size_t width = 400;
+            size_t height = 400;
+            std::string source{GridObj(width, height)};
+            TriangleMesh serial;
+            bool is_serial_parsed =
+                ParseObj(source.c_str(), source.size(), 1, &serial);
+
+            Path file_path = Join(fw->root, "/data/grid.obj");
+            WriteFileText(file_path, source);
+            TriangleMesh loaded;
+            bool is_loaded = LoadObj(file_path.value, 5, &loaded);
+
+            bool is_equal =
+                loaded.VertexCount() == serial.VertexCount() &&
+                loaded.triangle_indices.size == serial.triangle_indices.size;
+            for (size_t i = 0; is_equal && i < serial.VertexCount(); ++i) {
+              is_equal = loaded.vertex_xs[i] == serial.vertex_xs[i] &&
+                         loaded.vertex_ys[i] == serial.vertex_ys[i];
+            }
+            for (size_t i = 0;
+                 is_equal && i < serial.triangle_indices.size; ++i) {
+              is_equal =
+                  loaded.triangle_indices[i] == serial.triangle_indices[i];
+            }
+
+            // NOTE: The first quad of the last row, split along its diagonal.
+            uint32_t corner = static_cast<uint32_t>(width * (height - 2));
+            loaded.Build();
+            HitRecord hit{loaded.ClosestHit(
+                {{.07F, 39.82F, -1}, {0, 0, 1}}, 0.F, INFINITY)};
+
+            return ASSERT_EQUAL(bool, source.size() > 4 * OBJ_MIN_CHUNK_SIZE,
+                                true) &&
+                   ASSERT_EQUAL(bool, is_serial_parsed, true) &&
+                   ASSERT_EQUAL(bool, is_loaded, true) &&
+                   ASSERT_EQUAL(size_t, serial.TriangleCount(),
+                                2 * (width - 1) * (height - 1)) &&
+                   ASSERT_EQUAL(uint32_t, serial.triangle_indices[0], 0) &&
+                   ASSERT_EQUAL(uint32_t, serial.triangle_indices[1], 1) &&
+                   ASSERT_EQUAL(uint32_t, serial.triangle_indices[2],
+                                static_cast<uint32_t>(width + 1)) &&
+                   ASSERT_EQUAL(bool, is_equal, true) &&
+                   ASSERT_EQUAL(uint32_t,
+                                serial.triangle_indices[3 * hit.object_id],
+                                corner) &&
+                   ASSERT_EQUAL_FLOAT(hit.t, 1.F);
+          });
+}
+
+static inline void TestDispatch(TestFramework* fw) {
+  fw->Run("Forced ISA level is clamped to the CPU", "Dispatch", []() -> bool {
+    IsaLevel detected = DetectIsaLevel();
+
+    IsaLevel lowest = ForceIsaLevel(ISA_SSE2);
+    IsaLevel highest = ForceIsaLevel(ISA_AVX512);
+    ForceIsaLevel(detected);
+
+    return ASSERT_EQUAL(int, lowest, ISA_SSE2) &&
+           ASSERT_EQUAL(int, highest, detected) &&
+           ASSERT_EQUAL(int, GetIsaLevel(), detected);
+  });
+
+  fw->Run("Level callbacks see every applied ISA level", "Dispatch",
+          []() -> bool {
+            static IsaLevel seen_level;
+            static size_t call_count;
+            seen_level = ISA_SSE2;
+            call_count = 0;
+            IsaLevel detected = DetectIsaLevel();
+            ForceIsaLevel(detected);
+
+            bool is_registered = OnIsaLevelChange([](IsaLevel level) {
+              seen_level = level;
+              ++call_count;
+            });
+            IsaLevel registered_level = seen_level;
+            ForceIsaLevel(ISA_SSE2);
+            IsaLevel forced_level = seen_level;
+            ForceIsaLevel(detected);
+
+            return ASSERT_EQUAL(bool, is_registered, true) &&
+                   ASSERT_EQUAL(int, registered_level, detected) &&
+                   ASSERT_EQUAL(int, forced_level, ISA_SSE2) &&
+                   ASSERT_EQUAL(int, seen_level, detected) &&
+                   ASSERT_EQUAL(size_t, call_count, 3);
+          });
+
+  fw->Run("Kernels agree across ISA levels", "Dispatch", []() -> bool {
+    IsaLevel detected = DetectIsaLevel();
+
+    Matrix a{Scale(2, 3, 4).RotateY(.3F).Translate(1, -2, 3)};
+    Matrix b{Shear(XY).RotateZ(1.2F)};
+
+    const size_t count = 21;
+    float xs[count];
+    float ys[count];
+    float zs[count];
+    Color colors[count];
+    for (size_t i = 0; i < count; ++i) {
+      xs[i] = static_cast<float>(i) * .1F;
+      ys[i] = 1.F - static_cast<float>(i) * .05F;
+      zs[i] = static_cast<float>(i % 3);
+      colors[i] = {xs[i], ys[i], zs[i] - .5F};
+    }
+
+    Ray ray{{0, 0, -5}, Vector{.1F, .05F, 1}.Normalize()};
+    Sphere sphere;
+    sphere.SetTransform(Scale(1, .5F, 1));
+    PointLight light{Color{1, 1, 1}, Point{-10, 10, -10}};
+
+    // NOTE: 13 spheres, so the store runs one 8-wide block and a 4-wide tail
+    // on AVX2 and up.
+    size_t sphere_count = 13;
+    std::unique_ptr<Sphere[]> spheres{RandomSpheres(sphere_count, 2.F, 3)};
+    SphereStore store;
+    store.Build(spheres.get(), nullptr, sphere_count);
+    std::mt19937 rng{5};
+    Ray store_rays[16];
+    for (Ray& store_ray : store_rays) {
+      store_ray = RandomRay(&rng, 2.F);
+    }
+
+    ForceIsaLevel(ISA_SSE2);
+    Matrix expected_product{a * b};
+    float expected_xs[count];
+    float expected_ys[count];
+    float expected_zs[count];
+    TransformPoints(a, xs, ys, zs, expected_xs, expected_ys, expected_zs,
+                    count);
+    ColorRGB expected_rgbs[count];
+    NormalizedToRGB(colors, expected_rgbs, count);
+    Hits expected_hits{ray.Intersect(sphere)};
+    Point point{ray.Position(expected_hits[0].t)};
+    Color expected_color{Lighting(sphere.material, light, point,
+                                  -ray.direction, sphere.NormalAt(point))};
+    HitRecord expected_store_hits[16];
+    bool expected_occlusions[16];
+    for (size_t i = 0; i < 16; ++i) {
+      expected_store_hits[i] = store.ClosestHit(store_rays[i], 0.F, INFINITY);
+      expected_occlusions[i] = store.IsOccluded(store_rays[i], 0.F, 3.F);
+    }
+
+    bool res = true;
+    for (int level = ISA_SSE2; level <= detected; ++level) {
+      ForceIsaLevel(static_cast<IsaLevel>(level));
+
+      res = res && ASSERT_EQUAL(Matrix, a * b, expected_product);
+
+      float out_xs[count];
+      float out_ys[count];
+      float out_zs[count];
+      TransformPoints(a, xs, ys, zs, out_xs, out_ys, out_zs, count);
+
+      ColorRGB rgbs[count];
+      NormalizedToRGB(colors, rgbs, count);
+
+      for (size_t i = 0; i < count; ++i) {
+        res = res && ASSERT_EQUAL_FLOAT(out_xs[i], expected_xs[i]) &&
+              ASSERT_EQUAL_FLOAT(out_ys[i], expected_ys[i]) &&
+              ASSERT_EQUAL_FLOAT(out_zs[i], expected_zs[i]) &&
+              ASSERT_EQUAL(int32_t, rgbs[i].r, expected_rgbs[i].r) &&
+              ASSERT_EQUAL(int32_t, rgbs[i].g, expected_rgbs[i].g) &&
+              ASSERT_EQUAL(int32_t, rgbs[i].b, expected_rgbs[i].b);
+      }
+
+      Hits hits{ray.Intersect(sphere)};
+      Color color{Lighting(sphere.material, light, point, -ray.direction,
+                           sphere.NormalAt(point))};
+      res = res && ASSERT_EQUAL(Hits, hits, expected_hits) &&
+            ASSERT_EQUAL(Color, color, expected_color);
+
+      for (size_t i = 0; i < 16; ++i) {
+        HitRecord store_hit{store.ClosestHit(store_rays[i], 0.F, INFINITY)};
+        res = res &&
+              ASSERT_EQUAL(uint32_t, store_hit.object_id,
+                           expected_store_hits[i].object_id) &&
+              ASSERT_EQUAL(bool, store_hit.t == expected_store_hits[i].t,
+                           true) &&
+              ASSERT_EQUAL(bool, store.IsOccluded(store_rays[i], 0.F, 3.F),
+                           expected_occlusions[i]);
+      }
+    }
+
+    ForceIsaLevel(detected);
+
+    return res;
+  });
+}
+
+static inline void TestThreadPool(TestFramework* fw) {
+  fw->Run("Thread pool runs every task once", "ThreadPool", []() -> bool {
+    const size_t task_count = 100;
+    std::unique_ptr<std::atomic<size_t>[]> runs =
+        std::make_unique<std::atomic<size_t>[]>(task_count);
+    ThreadPool pool{3};
+    ThreadPool default_pool{0};
+
+    bool is_once = true;
+    for (size_t frame = 0; frame < 5; ++frame) {
+      for (size_t i = 0; i < task_count; ++i) {
+        runs[i] = 0;
+      }
+      pool.Run([&runs](size_t task_idx) { ++runs[task_idx]; }, task_count);
+      for (size_t i = 0; i < task_count; ++i) {
+        is_once = is_once && runs[i] == 1;
+      }
+    }
+
+    TaskGroup empty;
+    pool.Submit(&empty, [](size_t) {}, 0);
+
+    return ASSERT_EQUAL(bool, is_once, true) &&
+           ASSERT_EQUAL(size_t, pool.thread_count, 3) &&
+           ASSERT_EQUAL(size_t, default_pool.thread_count,
+                        Max(std::thread::hardware_concurrency(), 1)) &&
+           ASSERT_EQUAL(bool, pool.IsDone(&empty), true);
+  });
+
+  fw->Run("Cancelled task group skips unstarted tasks", "ThreadPool",
+          []() -> bool {
+            ThreadPool pool{1};
+            std::atomic<bool> is_started{false};
+            std::atomic<bool> is_released{false};
+            std::atomic<size_t> run_count{0};
+
+            TaskGroup group;
+            pool.Submit(
+                &group,
+                [&](size_t) {
+                  is_started = true;
+                  while (!is_released) {
+                    std::this_thread::yield();
+                  }
+                  ++run_count;
+                },
+                50);
+            while (!is_started) {
+              std::this_thread::yield();
+            }
+            pool.Cancel(&group);
+            bool is_done_while_running = pool.IsDone(&group);
+            is_released = true;
+            pool.Wait(&group);
+
+            // NOTE: The group can be submitted again once it is done.
+            pool.Submit(&group, [&](size_t) { ++run_count; }, 4);
+            pool.Wait(&group);
+
+            return ASSERT_EQUAL(bool, is_done_while_running, false) &&
+                   ASSERT_EQUAL(size_t, run_count, 5) &&
+                   ASSERT_EQUAL(bool, group.IsCancelled(), false);
+          });
+
+  fw->Run("Render calls run on the render pool", "ThreadPool", []() -> bool {
+    SetRenderThreadCount(2);
+    size_t thread_count = RenderPool()->thread_count;
+
+    World world{DefaultWorld()};
+    Point ray_origin{0, 0, -5};
+    Canvas cast{33, 33};
+    CastWorldShaded(&cast, ray_origin, world, 10.F, 7.F);
+
+    Canvas started{33, 33};
+    TileScheduler frame;
+    StartCastWorldShaded(&started, ray_origin, world, 10.F, 7.F, &frame);
+    frame.Wait();
+
+    bool is_equal = true;
+    for (size_t y = 0; y < cast.height; ++y) {
+      for (size_t x = 0; x < cast.width; ++x) {
+        is_equal = is_equal && cast.ColorAt(x, y) == started.ColorAt(x, y);
+      }
+    }
+    SetRenderThreadCount(0);
+
+    return ASSERT_EQUAL(size_t, thread_count, 2) &&
+           ASSERT_EQUAL(size_t, frame.worker_count, 2) &&
+           ASSERT_EQUAL(bool, is_equal, true) &&
+           ASSERT_NOT_EQUAL(Color, cast.ColorAt(16, 16), Color(0, 0, 0));
+  });
+}
+
+static inline uint32_t TileDistance(const Tile& a, const Tile& b) noexcept {
+  uint32_t dx = a.x0 > b.x0 ? a.x0 - b.x0 : b.x0 - a.x0;
+  uint32_t dy = a.y0 > b.y0 ? a.y0 - b.y0 : b.y0 - a.y0;
+  return dx + dy;
+}
+
+static inline void TestTileScheduler(TestFramework* fw) {
+  fw->Run("Tiles cover the canvas once in curve order", "Tile", []() -> bool {
+    bool res = ASSERT_EQUAL(uint32_t, MortonIndex(3, 5), 39) &&
+               ASSERT_EQUAL(uint32_t, HilbertIndex(2, 0, 0), 0) &&
+               ASSERT_EQUAL(uint32_t, HilbertIndex(2, 0, 1), 1) &&
+               ASSERT_EQUAL(uint32_t, HilbertIndex(2, 1, 1), 2) &&
+               ASSERT_EQUAL(uint32_t, HilbertIndex(2, 1, 0), 3);
+
+    const size_t width = 70;
+    const size_t height = 45;
+    TileOrder orders[] = {TILE_ORDER_SCANLINE, TILE_ORDER_MORTON,
+                          TILE_ORDER_HILBERT};
+    for (TileOrder order : orders) {
+      DyArray<Tile> tiles{MakeTiles(width, height, 16, order)};
+      DyArray<uint32_t> covered{width * height};
+      std::fill(covered.data.get(), covered.data.get() + covered.size, 0);
+      for (size_t i = 0; i < tiles.size; ++i) {
+        for (uint32_t y = tiles[i].y0; y < tiles[i].y1; ++y) {
+          for (uint32_t x = tiles[i].x0; x < tiles[i].x1; ++x) {
+            ++covered[y * width + x];
+          }
+        }
+      }
+      bool is_once = true;
+      for (size_t i = 0; i < covered.size; ++i) {
+        is_once = is_once && covered[i] == 1;
+      }
+      res = res && ASSERT_EQUAL(size_t, tiles.size, 15) &&
+            ASSERT_EQUAL(bool, is_once, true);
+    }
+
+    // NOTE: On a power of two grid every Hilbert step goes to a neighbour.
+    DyArray<Tile> square{MakeTiles(64, 64, 16, TILE_ORDER_HILBERT)};
+    bool is_adjacent = true;
+    for (size_t i = 1; i < square.size; ++i) {
+      is_adjacent = is_adjacent && TileDistance(square[i], square[i - 1]) == 16;
+    }
+
+    Tile last{MakeTiles(width, height, 16, TILE_ORDER_SCANLINE)[14]};
+    return res && ASSERT_EQUAL(bool, is_adjacent, true) &&
+           ASSERT_EQUAL(uint32_t, last.x0, 64) &&
+           ASSERT_EQUAL(uint32_t, last.x1, 70) &&
+           ASSERT_EQUAL(uint32_t, last.y0, 32) &&
+           ASSERT_EQUAL(uint32_t, last.y1, 45);
+  });
+
+  fw->Run("Idle workers steal tiles from busy ones", "Tile", []() -> bool {
+    ThreadPool pool{4};
+    TileScheduler scheduler;
+    scheduler.tile_size = 8;
+    std::unique_ptr<std::atomic<size_t>[]> draws =
+        std::make_unique<std::atomic<size_t>[]>(64);
+    for (size_t i = 0; i < 64; ++i) {
+      draws[i] = 0;
+    }
+
+    // NOTE: The first quarter of the tiles in curve order is the first
+    // worker's run; making those slow leaves the others idle unless they
+    // steal.
+    DyArray<Tile> tiles{MakeTiles(64, 64, 8, TILE_ORDER_HILBERT)};
+    uint32_t slow_mask[8] = {};
+    for (size_t i = 0; i < 16; ++i) {
+      slow_mask[tiles[i].y0 / 8] |= 1U << (tiles[i].x0 / 8);
+    }
+    scheduler.Start(&pool, 64, 64, [&](const Tile& tile) {
+      ++draws[tile.y0 / 8 * 8 + tile.x0 / 8];
+      if ((slow_mask[tile.y0 / 8] & (1U << (tile.x0 / 8))) != 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+    });
+    scheduler.Wait();
+
+    bool is_once = true;
+    for (size_t i = 0; i < 64; ++i) {
+      is_once = is_once && draws[i] == 1;
+    }
+    size_t tile_count = 0;
+    size_t steal_count = 0;
+    for (size_t i = 0; i < scheduler.worker_count; ++i) {
+      tile_count += scheduler.workers[i].tile_count;
+      steal_count += scheduler.workers[i].steal_count;
+    }
+
+    return ASSERT_EQUAL(bool, is_once, true) &&
+           ASSERT_EQUAL(size_t, scheduler.worker_count, 4) &&
+           ASSERT_EQUAL(size_t, tile_count, 64) &&
+           ASSERT_EQUAL(bool, steal_count > 0, true) &&
+           ASSERT_EQUAL(bool, scheduler.workers[0].tile_count < 16, true) &&
+           ASSERT_EQUAL(bool, scheduler.FrameSeconds() > 0, true) &&
+           ASSERT_EQUAL(bool,
+                        scheduler.IdleSeconds(0) <= scheduler.FrameSeconds(),
+                        true);
+  });
+
+  fw->Run("Cancelled frame stops at the next tile", "Tile", []() -> bool {
+    ThreadPool pool{1};
+    TileScheduler scheduler;
+    std::atomic<bool> is_started{false};
+    std::atomic<bool> is_released{false};
+    std::atomic<size_t> draw_count{0};
+
+    scheduler.Start(&pool, 64, 64, [&](const Tile&) {
+      is_started = true;
+      while (!is_released) {
+        std::this_thread::yield();
+      }
+      ++draw_count;
+    });
+    while (!is_started) {
+      std::this_thread::yield();
+    }
+    scheduler.Cancel();
+    is_released = true;
+    scheduler.Wait();
+
+    return ASSERT_EQUAL(size_t, draw_count, 1) &&
+           ASSERT_EQUAL(bool, scheduler.IsCancelled(), true) &&
+           ASSERT_EQUAL(bool, scheduler.IsDone(), true);
+  });
+}
+
+static inline void TestNuma(TestFramework* fw) {
+  fw->Run("Pinned pool runs a task on each thread", "Numa", []() -> bool {
+    const NumaTopology& topology = GetNumaTopology();
+    bool is_topology_valid = topology.cpus.size > 0 && topology.node_count > 0;
+    for (size_t i = 0; i < topology.cpus.size; ++i) {
+      is_topology_valid =
+          is_topology_valid && topology.cpus[i].node < topology.node_count;
+    }
+
+    ThreadPool pool{3, true};
+    std::atomic<size_t> runs[3] = {0, 0, 0};
+    std::atomic<bool> is_own_worker{true};
+    std::atomic<bool> is_on_node{true};
+    TaskGroup group;
+    pool.SubmitOnEachThread(&group, [&](size_t worker_idx) {
+      ++runs[worker_idx];
+      is_own_worker = is_own_worker && CurrentPoolWorker() == worker_idx;
+      const NumaCpu& cpu = topology.cpus[worker_idx % topology.cpus.size];
+      is_on_node = is_on_node && CurrentNumaNode() == cpu.node;
+    });
+    pool.Wait(&group);
+
+    return ASSERT_EQUAL(bool, is_topology_valid, true) &&
+           ASSERT_EQUAL(size_t, runs[0], 1) &&
+           ASSERT_EQUAL(size_t, runs[1], 1) &&
+           ASSERT_EQUAL(size_t, runs[2], 1) &&
+           ASSERT_EQUAL(bool, is_own_worker, true) &&
+           ASSERT_EQUAL(bool, is_on_node, true) &&
+           ASSERT_EQUAL(size_t, CurrentPoolWorker(), SIZE_MAX);
+  });
+
+  fw->Run("First touch places canvas pages from the pool", "Numa",
+          []() -> bool {
+            ThreadPool pool{2, true};
+            Canvas canvas{64, 64, false};
+            uint32_t untouched_node = PageNumaNode(canvas.colors.get());
+
+            TileScheduler scheduler;
+            FirstTouchCanvas(&canvas, &scheduler, &pool);
+            bool is_cleared = true;
+            for (size_t y = 0; y < canvas.height; ++y) {
+              for (size_t x = 0; x < canvas.width; ++x) {
+                is_cleared = is_cleared && canvas.ColorAt(x, y) == Color();
+              }
+            }
+            size_t owned_count = scheduler.workers[0].tile_count +
+                                 scheduler.workers[1].tile_count;
+
+            return ASSERT_EQUAL(uint32_t, untouched_node, NUMA_UNKNOWN_NODE) &&
+                   ASSERT_EQUAL(bool, is_cleared, true) &&
+                   ASSERT_EQUAL(size_t, owned_count, 16) &&
+                   ASSERT_EQUAL(size_t, scheduler.workers[0].steal_count, 0) &&
+                   ASSERT_NOT_EQUAL(uint32_t,
+                                    PageNumaNode(canvas.colors.get()),
+                                    NUMA_UNKNOWN_NODE);
+          });
+
+  fw->Run("Scene replicas render like the shared scene", "Numa", []() -> bool {
+    World world{DefaultWorld()};
+    Point ray_origin{0, 0, -5};
+    Canvas shared_canvas{33, 33};
+    CastWorldShaded(&shared_canvas, ray_origin, world, 10.F, 7.F);
+
+    SceneReplicas replicas;
+    replicas.Place(world, SCENE_REPLICATED, RenderPool());
+    size_t replica_count = replicas.ReplicaCount();
+    // NOTE: On a NUMA machine the test thread may run on a node the pool
+    // has no thread on, and read the original.
+    bool is_copy = replicas.node_count > 1 || &replicas.Local() != &world;
+
+    Canvas replica_canvas{33, 33};
+    TileScheduler frame;
+    StartCastWorldShaded(&replica_canvas, ray_origin, replicas, 10.F, 7.F,
+                         &frame);
+    frame.Wait();
+
+    bool is_equal = true;
+    for (size_t y = 0; y < shared_canvas.height; ++y) {
+      for (size_t x = 0; x < shared_canvas.width; ++x) {
+        is_equal = is_equal && shared_canvas.ColorAt(x, y) ==
+                                   replica_canvas.ColorAt(x, y);
+      }
+    }
+
+    SceneReplicas shared;
+    shared.Place(world, SCENE_SHARED, RenderPool());
+
+    return ASSERT_EQUAL(bool, replica_count >= 1, true) &&
+           ASSERT_EQUAL(bool, is_copy, true) &&
+           ASSERT_EQUAL(bool, is_equal, true) &&
+           ASSERT_EQUAL(size_t, shared.ReplicaCount(), 0) &&
+           ASSERT_EQUAL(bool, &shared.Local() == &world, true);
+  });
+}
+
+static inline void TestProgressive(TestFramework* fw) {
+  fw->Run("Progressive passes end on the plain render", "Progressive",
+          []() -> bool {
+            World world{DefaultWorld()};
+            Point ray_origin{0, 0, -5};
+            Canvas plain{45, 37};
+            CastWorldShaded(&plain, ray_origin, world, 10.F, 7.F);
+
+            Canvas canvas{45, 37};
+            ProgressiveRender render;
+            StartProgressiveWorld(&canvas, ray_origin, world, 10.F, 7.F,
+                                  &render);
+            render.Wait();
+            bool is_equal = true;
+            for (size_t y = 0; y < canvas.height; ++y) {
+              for (size_t x = 0; x < canvas.width; ++x) {
+                is_equal =
+                    is_equal && canvas.ColorAt(x, y) == plain.ColorAt(x, y);
+              }
+            }
+            size_t plain_passes = render.CompletedPasses();
+
+            render.max_samples = 4;
+            StartProgressiveWorld(&canvas, ray_origin, world, 10.F, 7.F,
+                                  &render);
+            render.Wait();
+            bool is_sampled = true;
+            for (size_t i = 0; i < render.sample_counts.size; ++i) {
+              is_sampled = is_sampled && render.sample_counts[i] == 4;
+            }
+
+            return ASSERT_EQUAL(size_t, plain_passes, 4) &&
+                   ASSERT_EQUAL(bool, is_equal, true) &&
+                   ASSERT_EQUAL(size_t, render.CompletedPasses(), 7) &&
+                   ASSERT_EQUAL(size_t, ProgressivePassCount(4), 7) &&
+                   ASSERT_EQUAL(bool, is_sampled, true) &&
+                   ASSERT_EQUAL(Color, canvas.ColorAt(0, 0), Color(0, 0, 0));
+          });
+
+  fw->Run("Spent budget leaves the coarse pass", "Progressive", []() -> bool {
+    World world{DefaultWorld()};
+    Point ray_origin{0, 0, -5};
+    Canvas plain{45, 37};
+    CastWorldShaded(&plain, ray_origin, world, 10.F, 7.F);
+
+    Canvas canvas{45, 37};
+    ProgressiveRender render;
+    render.budget_ms = 1e-6;
+    render.max_samples = 16;
+    StartProgressiveWorld(&canvas, ray_origin, world, 10.F, 7.F, &render);
+    render.Wait();
+
+    bool is_blocky = true;
+    for (size_t y = 0; y < canvas.height; ++y) {
+      for (size_t x = 0; x < canvas.width; ++x) {
+        size_t block_x = x - x % PROGRESSIVE_BLOCK_SIZE;
+        size_t block_y = y - y % PROGRESSIVE_BLOCK_SIZE;
+        is_blocky = is_blocky &&
+                    canvas.ColorAt(x, y) == plain.ColorAt(block_x, block_y);
+      }
+    }
+
+    return ASSERT_EQUAL(size_t, render.CompletedPasses(), 1) &&
+           ASSERT_EQUAL(bool, is_blocky, true);
+  });
+
+  fw->Run("Cancelled progressive render stops early", "Progressive",
+          []() -> bool {
+            World world{DefaultWorld()};
+            Canvas canvas{256, 256};
+            ProgressiveRender render;
+            render.max_samples = 64;
+            StartProgressiveWorld(&canvas, {0, 0, -5}, world, 10.F, 7.F,
+                                  &render);
+            render.Cancel();
+            render.Wait();
+            bool is_done = render.IsDone();
+
+            // NOTE: The destructor cancels and waits for a running render.
+            {
+              ProgressiveRender abandoned;
+              abandoned.max_samples = 64;
+              StartProgressiveWorld(&canvas, {0, 0, -5}, world, 10.F, 7.F,
+                                    &abandoned);
+            }
+
+            return ASSERT_EQUAL(bool, is_done, true) &&
+                   ASSERT_EQUAL(bool,
+                                render.CompletedPasses() <
+                                    ProgressivePassCount(64),
+                                true);
+          });
+}
+
+static inline void TestRenderJob(TestFramework* fw) {
+  fw->Run("Jobs in flight match the blocking render", "RenderJob",
+          []() -> bool {
+            std::shared_ptr<const World> world =
+                std::make_shared<const World>(DefaultWorld());
+            Point ray_origin{0, 0, -5};
+            Canvas plain{45, 37};
+            CastWorldShaded(&plain, ray_origin, *world, 10.F, 7.F);
+
+            std::atomic<size_t> completed{0};
+            std::shared_ptr<RenderJob> jobs[4];
+            for (std::shared_ptr<RenderJob>& job : jobs) {
+              job = SubmitRenderJob(world, 45, 37, ray_origin, 10.F, 7.F,
+                                    TASK_PRIORITY_BATCH,
+                                    [&completed](RenderJob*) { ++completed; });
+            }
+
+            bool is_equal = true;
+            size_t tile_count = 0;
+            for (std::shared_ptr<RenderJob>& job : jobs) {
+              job->Wait();
+              tile_count += job->stats.tile_count;
+              for (size_t y = 0; y < plain.height; ++y) {
+                for (size_t x = 0; x < plain.width; ++x) {
+                  is_equal = is_equal &&
+                             job->canvas.ColorAt(x, y) == plain.ColorAt(x, y);
+                }
+              }
+            }
+
+            return ASSERT_EQUAL(bool, is_equal, true) &&
+                   ASSERT_EQUAL(size_t, completed, 4) &&
+                   ASSERT_EQUAL(size_t, tile_count, 4 * 3 * 3) &&
+                   ASSERT_EQUAL(bool, jobs[0]->IsDone(), true) &&
+                   ASSERT_EQUAL(bool, jobs[0]->IsCancelled(), false);
+          });
+
+  fw->Run("Interactive job overtakes queued batch jobs", "RenderJob",
+          []() -> bool {
+            SetRenderThreadCount(1);
+            std::shared_ptr<const World> world =
+                std::make_shared<const World>(DefaultWorld());
+            std::atomic<size_t> next_order{0};
+            size_t orders[3] = {};
+            std::shared_ptr<RenderJob> jobs[3];
+            for (size_t i = 0; i < 3; ++i) {
+              TaskPriority priority =
+                  i < 2 ? TASK_PRIORITY_BATCH : TASK_PRIORITY_INTERACTIVE;
+              jobs[i] = SubmitRenderJob(
+                  world, 128, 128, {0, 0, -5}, 10.F, 7.F, priority,
+                  [&next_order, &orders, i](RenderJob*) {
+                    orders[i] = next_order++;
+                  });
+            }
+            for (std::shared_ptr<RenderJob>& job : jobs) {
+              job->Wait();
+            }
+            SetRenderThreadCount(0);
+
+            // NOTE: The one thread may already be drawing the first batch
+            // job, but takes the interactive one before the second.
+            return ASSERT_EQUAL(bool, orders[2] < orders[1], true) &&
+                   ASSERT_EQUAL(size_t, jobs[2]->stats.tile_count, 8 * 8);
+          });
+
+  fw->Run("Dropped job handle still completes", "RenderJob", []() -> bool {
+    std::shared_ptr<const World> world =
+        std::make_shared<const World>(DefaultWorld());
+    // NOTE: Shared with the callback, which may still be returning from
+    // set_value when get returns.
+    std::shared_ptr<std::promise<Color>> center =
+        std::make_shared<std::promise<Color>>();
+    std::future<Color> result = center->get_future();
+    SubmitRenderJob(world, 45, 37, {0, 0, -5}, 10.F, 7.F,
+                    TASK_PRIORITY_INTERACTIVE, [center](RenderJob* job) {
+                      center->set_value(job->canvas.ColorAt(22, 18));
+                    });
+
+    Canvas plain{45, 37};
+    CastWorldShaded(&plain, {0, 0, -5}, *world, 10.F, 7.F);
+    std::shared_ptr<RenderJob> cancelled = SubmitRenderJob(
+        world, 256, 256, {0, 0, -5}, 10.F, 7.F, TASK_PRIORITY_BATCH);
+    cancelled->Cancel();
+    cancelled->Wait();
+
+    return ASSERT_EQUAL(Color, result.get(), plain.ColorAt(22, 18)) &&
+           ASSERT_EQUAL(bool, cancelled->IsCancelled(), true) &&
+           ASSERT_EQUAL(bool, cancelled->stats.tile_count < 16 * 16, true);
+  });
 }
 
 void RunTests(const char* root) {
@@ -1630,6 +4345,17 @@ void RunTests(const char* root) {
   TestMatrix(&fw);
   TestRay(&fw);
   TestShading(&fw);
+  TestWorld(&fw);
+  TestBvh(&fw);
+  TestInstance(&fw);
+  TestGrid(&fw);
+  TestMesh(&fw);
+  TestDispatch(&fw);
+  TestThreadPool(&fw);
+  TestTileScheduler(&fw);
+  TestNuma(&fw);
+  TestProgressive(&fw);
+  TestRenderJob(&fw);
 
   fw.Summary();
 }
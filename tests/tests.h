@@ -1,10 +1,16 @@
 #ifndef TESTS_TESTS_H_
 #define TESTS_TESTS_H_
 
+#include <geometry/mesh.h>
 #include <geometry/point.h>
+#include <geometry/ray.h>
 #include <geometry/vector.h>
 
+#include <cstdint>
+#include <memory>
 #include <numbers>  // IWYU pragma: keep
+#include <random>
+#include <string>
 
 #define PI std::numbers::pi
 
@@ -24,6 +30,22 @@ struct Environment {
       : gravity(gravity), wind(wind) {}
 };
 
+// NOTE: Deterministic scene of count spheres with random non-uniform scale,
+// rotation and shear scattered through a cube of half size `size`, and rays
+// crossing that cube along +z. Shared by the tests and benchmarks.
+std::unique_ptr<Sphere[]> RandomSpheres(size_t count, float size,
+                                        uint32_t seed);
+Ray RandomRay(std::mt19937* rng, float size);
+
+// NOTE: Unbuilt soup of count small triangles scattered through the same
+// cube as RandomSpheres.
+TriangleMesh RandomTriangles(size_t count, float size, uint32_t seed);
+// NOTE: OBJ text of a width x height vertex grid in the z = 0 plane, one
+// quad per cell. Each row of quads follows the row of vertices it closes
+// and uses negative indices, so they resolve against the vertices parsed
+// so far.
+std::string GridObj(size_t width, size_t height);
+
 void RunTests(const char* root);
 
 #endif  // TESTS_TESTS_H_